@@ -8,9 +8,10 @@
 
 #import "AppDelegate.h"
 #import <AudioToolbox/AudioToolbox.h>
+#include "SFMessageEncoder.h"
 
 @interface AppDelegate ()
-            
+
 @property (weak) IBOutlet NSWindow *window;
 
 
@@ -18,55 +19,153 @@
 
 @implementation AppDelegate
 
--(void)emissionSampleCalcul:(int)frequence : (int)numFrames : (Float32 *)buffer
+/**---------------------------------------------------------------------------------------
+ * WriteMessage
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Render a message with the encoder and write it in a WAV file.
+
+ The samples are the Float32 buffers of renderToneCallback, written without conversion (WAV float 32 bits, mono).
+
+ @param samples Working buffer of at least sfMessageEncoderFrameCount frames
+ @return noErr or the error of ExtAudioFile
+ */
+static OSStatus writeMessage(SFMessageEncoder *encoder, const char *message, int length, float *samples, NSURL *url)
 {
-    double theta_increment = 2.0 * M_PI * frequence / sampleRate;     // θ(n) = 2πƒ n / r
-    double amplitude = .25;
-    // Loop génération for the samples
-    // f(n) = a sin ( θ(n) )
-    
-    for (UInt32 frame = 0; frame < numFrames; frame++)
-    {
-        buffer[frame] = 0;
-        buffer[frame] = sin(theta) * amplitude;
-        
-        //printf("%f\n", buffer[frame]);
-        theta += theta_increment;
-        if (theta > 2.0 * M_PI)
-        {
-            theta -= 2.0 * M_PI;
-        }
-    }
-    
-}
+    int frameCount = 0;
+
+    sfMessageEncoderStart(encoder, message, length);
+    for (int frames; (frames = sfMessageEncoderRender(encoder, samples + frameCount)) > 0; )
+        frameCount += frames;
+
+    AudioStreamBasicDescription format = {0};
+    format.mSampleRate = encoder->plan.sampleRate;
+    format.mFormatID = kAudioFormatLinearPCM;
+    format.mFormatFlags = kAudioFormatFlagIsFloat | kAudioFormatFlagIsPacked;
+    format.mBytesPerPacket = sizeof(Float32);
+    format.mFramesPerPacket = 1;
+    format.mBytesPerFrame = sizeof(Float32);
+    format.mChannelsPerFrame = 1;
+    format.mBitsPerChannel = 32;
 
-- (void)applicationDidFinishLaunching:(NSNotification *)aNotification {
-    // Insert code here to initialize your application
-    
-    AudioBufferList *bufferList;
-    
     ExtAudioFileRef outputFile;
-    
-    ExtAudioFileWriteAsync(outputFile,512,bufferList);
-    
+    OSStatus status = ExtAudioFileCreateWithURL((__bridge CFURLRef)url, kAudioFileWAVEType, &format, NULL, kAudioFileFlags_EraseFile, &outputFile);
+    if (status != noErr)
+        return status;
+
+    AudioBufferList bufferList;
+    bufferList.mNumberBuffers = 1;
+    bufferList.mBuffers[0].mNumberChannels = 1;
+    bufferList.mBuffers[0].mDataByteSize = frameCount * sizeof(Float32);
+    bufferList.mBuffers[0].mData = samples;
+
+    status = ExtAudioFileWrite(outputFile, frameCount, &bufferList);
+    OSStatus closeStatus = ExtAudioFileDispose(outputFile);
+    return status != noErr ? status : closeStatus;
 }
 
-- (void)applicationWillTerminate:(NSNotification *)aNotification {
-    // Insert code here to tear down your application
-}
-
-
-
-
 
+/**---------------------------------------------------------------------------------------
+ * RenderMessages
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Write each message in its own file (000001.wav ...) in directory, on all the cores.
 
+ Each worker keep its own encoder and take the next message of the list. A messages.json file give the text of each file, one JSON object per line like sfrender does.
 
+ @param messages The messages, ASCII
+ @return The number of files that can't be written
+ */
+-(int)renderMessages:(NSArray*)messages inDirectory:(NSURL*)directory
+{
+    SFEmissionPlan plan;
+    sfEmissionPlanDefault(&plan);
+
+    NSUInteger count = [messages count];
+    NSUInteger workers = MIN([[NSProcessInfo processInfo] activeProcessorCount], MAX(count, 1));
+    __block int next = 0;
+    __block int failed = 0;
+
+    dispatch_apply(workers, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t worker) {
+        SFMessageEncoder *encoder = sfMessageEncoderCreate(&plan);
+        float *samples = NULL;
+        int capacity = 0;
+        int index;
+
+        while (encoder != NULL && (index = __atomic_fetch_add(&next, 1, __ATOMIC_RELAXED)) < (int)count) {
+            @autoreleasepool {
+                // Same conversion as sendMessage: è é À... become ASCII
+                NSData *message = [messages[index] dataUsingEncoding:NSASCIIStringEncoding allowLossyConversion:YES];
+                int length = (int)[message length];
+                int frames = sfMessageEncoderFrameCount(&plan, length);
+                if (frames > capacity) {
+                    capacity = frames;
+                    samples = realloc(samples, capacity * sizeof(float));
+                }
+
+                NSURL *url = [directory URLByAppendingPathComponent:[NSString stringWithFormat:@"%06d.wav", index+1]];
+                OSStatus status = writeMessage(encoder, [message bytes], length, samples, url);
+                if (status != noErr) {
+                    NSLog(@"Error - unable to write %@ : %d", url, (int)status);
+                    __atomic_fetch_add(&failed, 1, __ATOMIC_RELAXED);
+                }
+            }
+        }
+        if (encoder == NULL) {
+            NSLog(@"Error - unable to allocate the encoder");
+        }
+        free(samples);
+        sfMessageEncoderDestroy(encoder);
+    });
+
+    NSMutableString *manifest = [[NSMutableString alloc] init];
+    for (NSUInteger i=0; i<count; i++) {
+        NSDictionary *entry = @{@"file": [NSString stringWithFormat:@"%06lu.wav", (unsigned long)i+1], @"text": messages[i]};
+        NSData *json = [NSJSONSerialization dataWithJSONObject:entry options:0 error:nil];
+        [manifest appendFormat:@"%@\n", [[NSString alloc] initWithData:json encoding:NSUTF8StringEncoding]];
+    }
+    [manifest writeToURL:[directory URLByAppendingPathComponent:@"messages.json"] atomically:YES encoding:NSUTF8StringEncoding error:nil];
 
-@end
+    return failed;
+}
 
 
+- (void)applicationDidFinishLaunching:(NSNotification *)aNotification {
+    // The list of messages, one per line
+    NSOpenPanel *listPanel = [NSOpenPanel openPanel];
+    [listPanel setMessage:@"Liste des messages (un message par ligne)"];
+    [listPanel setAllowedFileTypes:@[@"txt"]];
+    if ([listPanel runModal] != NSFileHandlingPanelOKButton)
+        return;
+
+    NSString *list = [NSString stringWithContentsOfURL:[listPanel URL] encoding:NSUTF8StringEncoding error:nil];
+    NSMutableArray *messages = [[NSMutableArray alloc] init];
+    for (NSString *line in [list componentsSeparatedByCharactersInSet:[NSCharacterSet newlineCharacterSet]]) {
+        if ([line length] > 0)
+            [messages addObject:line];
+    }
 
+    // Where the files are written
+    NSOpenPanel *directoryPanel = [NSOpenPanel openPanel];
+    [directoryPanel setMessage:@"Dossier des fichiers audio"];
+    [directoryPanel setCanChooseFiles:NO];
+    [directoryPanel setCanChooseDirectories:YES];
+    [directoryPanel setCanCreateDirectories:YES];
+    if ([directoryPanel runModal] != NSFileHandlingPanelOKButton)
+        return;
+
+    NSDate *start = [NSDate date];
+    int failed = [self renderMessages:messages inDirectory:[directoryPanel URL]];
+
+    NSAlert *alert = [[NSAlert alloc] init];
+    [alert setMessageText:[NSString stringWithFormat:@"%lu messages, %d erreurs", (unsigned long)[messages count], failed]];
+    [alert setInformativeText:[NSString stringWithFormat:@"Générés en %.1f s dans %@", -[start timeIntervalSinceNow], [[directoryPanel URL] path]]];
+    [alert runModal];
+}
 
+- (void)applicationWillTerminate:(NSNotification *)aNotification {
+    // Insert code here to tear down your application
+}
 
 
 
@@ -75,3 +174,4 @@
 
 
 
+@end
@@ -10,6 +10,9 @@
 #import <AudioToolbox/AudioToolbox.h>
 #import <AVFoundation/AVFoundation.h>
 #import <Accelerate/Accelerate.h>
+#include "SFBandPlan.h"
+#include "SFOscillator.h"
+#include "SFChirp.h"
 
 
 @interface AudioController : NSObject
@@ -63,12 +66,20 @@
     NSMutableString *messageReceive;
     
     // Emission mode variables
-    double theta;
+    SFOscillator *oscillator;
     NSString *myMessage;
     pthread_mutex_t emissionMutex;
     int nbCaracRepeat;
     BOOL initSequence;
     int nbrRepeatInit;
+    int toneFrequency;          // of the tone step being sent
+    int toneOffset;             // samples of it already sent, a step is EMISSION_TONE_FRAMES whatever the callbacks
+    
+    // Chirp preamble (SFChirp.h): the chirp then the start tone, exact in samples whatever the callbacks
+    SFChirp *chirp;
+    BOOL chirpPreamble;
+    int chirpOffset;            // samples of the preamble already sent
+    int chirpModeFrames;        // samples of start tone after the chirp
     
     // Test
     int compteur;
@@ -77,6 +88,8 @@
 }
 
 -(void)fftSetup;
+-(void)oscillatorSetup;
+-(void)chirpSetup;
 -(void)setupCallback;
 
 -(int)startAudioUnit:(int)mode;
@@ -89,11 +102,12 @@
 
 -(int)getASCIIFrequency;
 -(void)emissionSampleCalcul:(int)frequence : (int)numFrames : (Float32 *)buffer;
+-(int)chirpSampleCalcul:(int)numFrames : (Float32 *)buffer;
+-(void)setChirpPreamble:(BOOL)enable;
 
 -(void)checkTimeOut;
 -(void)sampleTreatment:(int)numFrames;
 
-- (void)buildSineTable;
 
 
 @end
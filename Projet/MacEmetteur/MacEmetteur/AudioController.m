@@ -9,6 +9,8 @@
 #import "AudioController.h"
 #include <pthread.h>
 
+#define EMISSION_TONE_FRAMES 512    // samples of a step of getASCIIFrequency, the 512 frames buffers it was made for
+
 void smb2PitchShift(float pitchShift, long numSampsToProcess, long fftFrameSize,
 					long osamp, float sampleRate, float *indata, float *outdata,
 					FFTSetup fftSetup, float * frequency);
@@ -258,12 +260,22 @@ OSStatus renderToneCallback(void *userData, AudioUnitRenderActionFlags *actionFl
     
     //If emissionMode = TRUE then start sending stuff
     if (THIS->emissionMode) {
-        int frequence;
-        
-        frequence = [THIS getASCIIFrequency];
-        
-        [THIS emissionSampleCalcul:frequence :numFrames :(Float32 *)buffers->mBuffers[0].mData];
-        
+        Float32 *buffer = (Float32 *)buffers->mBuffers[0].mData;
+        int sent = 0;
+        
+        if (THIS->chirpPreamble)
+            sent = [THIS chirpSampleCalcul:numFrames :buffer];
+        //The tone steps are counted in samples, the size of the buffers doesn't change the length of the caracters
+        while (sent < (int)numFrames) {
+            if (THIS->toneOffset >= EMISSION_TONE_FRAMES) {
+                THIS->toneFrequency = [THIS getASCIIFrequency];
+                THIS->toneOffset = 0;
+            }
+            int count = MIN((int)numFrames-sent, EMISSION_TONE_FRAMES-THIS->toneOffset);
+            [THIS emissionSampleCalcul:THIS->toneFrequency :count :buffer+sent];
+            THIS->toneOffset += count;
+            sent += count;
+        }
     }
     pthread_mutex_unlock(&THIS->emissionMutex);
     
@@ -314,23 +326,6 @@ OSStatus renderCallback(void *userData, AudioUnitRenderActionFlags *actionFlags,
 
 @implementation AudioController
 
-- (void)buildSineTable
-{
-	// Compute a sine table for a 1 Hz tone at the current sample rate.
-	// We can quickly derive the sine wave for any other tone from this
-	// table by stepping through it with the wanted pitch value.
-    int sineLength;
-    float* sine;
-    
-	sineLength = 512;
-	sine = (float *)malloc(sineLength * sizeof(float));
-    
-	for (int i = 0; i < sineLength; ++i)
-    {
-		sine[i] = sinf(i * 2.0f * M_PI / sineLength);
-    }
-}
-
 -(AudioController*)init
 {
     self=[super init];
@@ -338,6 +333,8 @@ OSStatus renderCallback(void *userData, AudioUnitRenderActionFlags *actionFlags,
     [self initAudioSession];
     [self setupCallback];
     [self fftSetup];
+    [self oscillatorSetup];
+    [self chirpSetup];
     [self initAudioStreams];
     
     pthread_mutex_init(&emissionMutex, NULL);
@@ -346,26 +343,56 @@ OSStatus renderCallback(void *userData, AudioUnitRenderActionFlags *actionFlags,
     return self;
 }
 
--(void)emissionSampleCalcul:(int)frequence : (int)numFrames : (Float32 *)buffer
+// The start, caracters and stop tones are precomputed, buffers longer than 1024 frames are rendered in pieces
+-(void)oscillatorSetup
 {
-    double theta_increment = 2.0 * M_PI * frequence / sampleRate;     // θ(n) = 2πƒ n / r
-    double amplitude = .7;
-    // Loop génération for the samples
-    // f(n) = a sin ( θ(n) )
-    //NSLog(@"NumFrame : %d",numFrames);
-    for (UInt32 frame = 0; frame < numFrames; frame++)
-    {
-        buffer[frame] = 0;
-        buffer[frame] = sin(theta) * amplitude;
-        
-        //printf("%f\n", buffer[frame]);
-        theta += theta_increment;
-        if (theta > 2.0 * M_PI)
-        {
-            theta -= 2.0 * M_PI;
-        }
-    }
+    float frequencies[SF_TONE_COUNT];
     
+    sfBandPlanFrequencies(frequencies);
+    oscillator = sfOscillatorCreate(sampleRate, 1024, frequencies, SF_TONE_STOP+1);
+    if (oscillator == NULL)
+        NSLog(@"Error - unable to allocate the emission oscillator");
+}
+
+// The chirp of the preamble lasts SF_CHIRP_LENGTH samples of 44100 Hz, the start tone after it SF_CHIRP_MODE_FRAMES
+-(void)chirpSetup
+{
+    chirpPreamble=FALSE;
+    chirpModeFrames=(int)lroundf(SF_CHIRP_MODE_FRAMES*sampleRate/44100.f);
+    chirp=sfChirpCreate(sampleRate, (int)lroundf(SF_CHIRP_LENGTH*sampleRate/44100.f));
+    if (chirp == NULL)
+        NSLog(@"Error - unable to allocate the chirp preamble");
+}
+
+-(void)setChirpPreamble:(BOOL)enable
+{
+    if (!emissionMode && chirp != NULL)
+        chirpPreamble=enable;
+}
+
+// The chirp then the start tone, counted in samples: the receiver find the first caracter at the end of the start tone
+-(int)chirpSampleCalcul:(int)numFrames : (Float32 *)buffer
+{
+    int preambleEnd=chirp->length+chirpModeFrames;
+    int sent=0;
+    
+    if (chirpOffset < chirp->length) {
+        sent=sfChirpRender(chirp, chirpOffset, .7, buffer, numFrames);
+        chirpOffset+=sent;
+    }
+    if (sent < numFrames && chirpOffset < preambleEnd) {
+        int count=MIN(numFrames-sent, preambleEnd-chirpOffset);
+        [self emissionSampleCalcul:SF_START_FREQUENCY :count :buffer+sent];
+        chirpOffset+=count;
+        sent+=count;
+    }
+    return sent;
+}
+
+-(void)emissionSampleCalcul:(int)frequence : (int)numFrames : (Float32 *)buffer
+{
+    // f(n) = a sin ( θ(n) ), θ follow from the last buffer
+    sfOscillatorRender(oscillator, frequence, .7, buffer, numFrames);
 }
 
 -(int)getASCIIFrequency
@@ -848,7 +875,10 @@ OSStatus renderCallback(void *userData, AudioUnitRenderActionFlags *actionFlags,
         if (!emissionMode)
         {
             emissionMode=TRUE;
-            initSequence=TRUE;
+            initSequence=!chirpPreamble;    // the preamble has its own start tone
+            chirpOffset=0;
+            toneOffset=EMISSION_TONE_FRAMES;
+            sfOscillatorReset(oscillator);
             [self emissionSetup];
             AudioUnitInitialize(emissionUnit);
             AudioOutputUnitStart(emissionUnit);
@@ -10,6 +10,7 @@
 #import <AudioToolbox/AudioToolbox.h>
 #import <AVFoundation/AVFoundation.h>
 #import <Accelerate/Accelerate.h>
+#include "SFOscillator.h"
 
 
 @interface AudioController : NSObject
@@ -62,7 +63,7 @@
     NSMutableString *messageReceive;
     
     // Emission mode variables
-    double theta;
+    SFOscillator *oscillator;
     NSString *myMessage;
     pthread_mutex_t emissionMutex;
     int nbCaracRepeat;
@@ -81,6 +82,7 @@
 }
 
 -(void)fftSetup;
+-(void)oscillatorSetup;
 -(void)setupCallback;
 
 -(int)startAudioUnit:(int)mode;
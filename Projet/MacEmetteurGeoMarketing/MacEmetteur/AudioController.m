@@ -321,6 +321,7 @@ OSStatus renderCallback(void *userData, AudioUnitRenderActionFlags *actionFlags,
     [self initAudioSession];
     [self setupCallback];
     [self fftSetup];
+    [self oscillatorSetup];
     [self initAudioStreams];
     
     pthread_mutex_init(&emissionMutex, NULL);
@@ -329,13 +330,16 @@ OSStatus renderCallback(void *userData, AudioUnitRenderActionFlags *actionFlags,
     return self;
 }
 
+// Only the beacon frequency is used, its table is computed when it change
+-(void)oscillatorSetup
+{
+    oscillator = sfOscillatorCreate(sampleRate, 1024, NULL, 0);
+    if (oscillator == NULL)
+        NSLog(@"Error - unable to allocate the emission oscillator");
+}
+
 -(void)emissionSampleCalcul:(int)frequence : (int)numFrames : (Float32 *)buffer
 {
-    double theta_increment = 2.0 * M_PI * frequence / sampleRate;     // θ(n) = 2πƒ n / r
-    // Loop génération for the samples
-    // f(n) = a sin ( θ(n) )
-    
-    
     if (fadeIn>0) {
         fadeIn--;
         amplitude+=0.018;
@@ -345,17 +349,8 @@ OSStatus renderCallback(void *userData, AudioUnitRenderActionFlags *actionFlags,
         amplitude-=0.018;
     }
     
-    for (UInt32 frame = 0; frame < numFrames; frame++)
-    {
-        buffer[frame] = 0;
-        buffer[frame] = sin(theta) * amplitude;
-        
-        theta += theta_increment;
-        if (theta > 2.0 * M_PI)
-        {
-            theta -= 2.0 * M_PI;
-        }
-    }
+    // f(n) = a sin ( θ(n) ), θ follow from the last buffer and a goes linearly to amplitude
+    sfOscillatorRender(oscillator, frequence, amplitude, buffer, numFrames);
 }
 
 -(int)getASCIIFrequency
@@ -806,6 +801,7 @@ OSStatus renderCallback(void *userData, AudioUnitRenderActionFlags *actionFlags,
         {
             emissionMode=TRUE;
             initSequence=TRUE;
+            sfOscillatorReset(oscillator);
             [self emissionSetup];
             AudioUnitInitialize(emissionUnit);
             AudioOutputUnitStart(emissionUnit);
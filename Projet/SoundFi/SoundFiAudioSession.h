@@ -10,6 +10,8 @@
 #import <AudioToolbox/AudioToolbox.h>
 #import <AVFoundation/AVFoundation.h>
 #import <Accelerate/Accelerate.h>
+#include "SFVocoder.h"
+#include "SFNoiseFloor.h"
 
 @protocol SampleProtocolDelegate <NSObject>
 @required
@@ -60,6 +62,9 @@
     void                *dataBuffer;        //  input buffer from mic/line
 	float               *outputBuffer;      //  fft conversion buffer
 	float               *analysisBuffer;    //  fft analysis buffer
+    SFVocoder           *vocoder;           //  phase vocoder for the high accuracy analysis
+    SFNoiseFloor        *noiseFloor;        //  noise floor of the 17-21.5 kHz bins for the low accuracy analysis
+    float               *noiseMagnitudes;   //  squared magnitudes of the last fft
     
     //Transaction information
     BOOL                isInitiate;
@@ -112,6 +117,10 @@
 -(void)checkTimeOut;
 -(void)sampleTreatment:(int)numFrames;
 
+//Marge de détection au dessus du bruit (dB) et SNR d'une fréquence lors de la dernière fft
+-(void)setDetectionMargin:(float)margin;
+-(float)signalToNoiseRatio:(int)frequency;
+
 -(void)routeChanged;
 
 @end
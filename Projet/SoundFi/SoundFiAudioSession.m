@@ -9,11 +9,6 @@
 #import "SoundFiAudioSession.h"
 #include <pthread.h>
 
-void smb2PitchShift(float pitchShift, long numSampsToProcess, long fftFrameSize,
-					long osamp, float sampleRate, float *indata, float *outdata,
-					FFTSetup fftSetup, float * frequency,void* userData);
-
-
 // for some calculation in the fft callback
 // check to see if there is a vDsp library version
 float MagnitudeSquared(float x, float y) {
@@ -44,6 +39,8 @@ void fixedPointToSInt16( SInt32 * source, SInt16 * target, int length ) {
 
 // Use to get the frequency with an high accuracy
 // during a message transfer
+// Only the analysis half of the smb2PitchShift phase vocoder is run (SFVocoder),
+// the pitch shifted output was never used
 OSStatus fftGetFrequencyHighAccuracy (
                         void *inRefCon,                 // scope (MixerHostAudio)
                         UInt32 inNumberFrames,          // number of frames in this slice
@@ -52,59 +49,14 @@ OSStatus fftGetFrequencyHighAccuracy (
     // scope reference that allows access to everything in MixerHostAudio class
     
 	SoundFiAudioSession *THIS = (__bridge SoundFiAudioSession *)inRefCon;
-    
-  	float *outputBuffer = THIS->outputBuffer;
-	float *analysisBuffer = THIS->analysisBuffer;
-    
-    FFTSetup fftSetup = THIS->fftSetup;      // fft setup structures need to support vdsp functions
-	
-    
-	uint32_t stride = 1;                    // interleaving factor for vdsp functions
-	int bufferCapacity = 2048;               // maximum size of fft buffers
-    
-    float pitchShift = 1.0;                 // pitch shift factor 1=normal, range is .5->2.0
-    long osamp = 4;                         // oversampling factor
-    long fftSize = 2048;                     // fft size
-    
 	
 	float frequency;                        // analysis frequency result
     
-    
-    //	ConvertInt16ToFloat
-    
-    vDSP_vflt16((SInt16 *) sampleBuffer, stride, (float *) analysisBuffer, stride, bufferCapacity );
-    
-    // run the pitch shift
-    
-    // scale the fx control 0->1 to range of pitchShift .5->2.0
-    
-    pitchShift = (0.5 * 1.5) + .5;
-    
-    // osamp should be at least 4, but at this time my ipod touch gets very unhappy with
-    // anything greater than 2
-    
-    osamp = 4;
-    fftSize = 2048;		// this seems to work in real time since we are actually doing the fft on smaller windows
-    
-    smb2PitchShift( pitchShift , (long) inNumberFrames,
-                   fftSize,  osamp, (float) THIS->sampleRate,
-                   (float *) analysisBuffer , (float *) outputBuffer,
-                   fftSetup, &frequency,inRefCon);
-    
-    
-    // display detected pitch
-    
-    
-    THIS->sampleFrequency = (int) frequency;
-    
-    // now convert from float to Sint16
-    
-    vDSP_vfixr16((float *) outputBuffer, stride, (SInt16 *) sampleBuffer, stride, bufferCapacity );
-    
+    // average of the frames analysed in this slice
+    if (sfVocoderProcessInt16(THIS->vocoder, sampleBuffer, inNumberFrames, &frequency) > 0)
+        THIS->sampleFrequency = (int) frequency;
     
     return noErr;
-    
-    
 }
 
 // Use to get the frequency with a low accuracy
@@ -196,18 +148,15 @@ OSStatus fftGetFrequencyLowAccuracy (   void                        *inRefCon,
         
         //printf("\n\n");
         
-        float dominantFrequency = 0;
-        int bin = -1;
-        for (int i=100; i<n; i+=2) {
-            float curFreq = MagnitudeSquared(analysisBuffer[i], analysisBuffer[i+1]);
-            //printf("%d\n",(int)curFreq);
-            if ((curFreq > dominantFrequency) && (curFreq >500000000)) {
-                dominantFrequency = curFreq;
-                bin = (i+1)/2;
-            }
-        }
-        //printf("\n\n");
-        dominantFrequency = bin*(THIS->sampleRate/bufferCapacity);
+        // Each bin of the SoundFi band is compared to its own noise floor, no more fixed threshold:
+        // the peak is the bin with the best SNR over the margin.
+        
+        SFNoiseFloor *noise = THIS->noiseFloor;
+        DSPSplitComplex band = { A.realp + noise->firstBin, A.imagp + noise->firstBin };
+        vDSP_zvmags(&band, 1, THIS->noiseMagnitudes + noise->firstBin, 1, noise->binCount);
+        int bin = sfNoiseFloorUpdate(noise, THIS->noiseMagnitudes);
+        
+        float dominantFrequency = (bin < 0) ? 0 : bin*(THIS->sampleRate/bufferCapacity);
         
         // printf("Dominant frequency: %f   \n" , dominantFrequency);
         THIS->sampleFrequency = (int) dominantFrequency;   // set instance variable with detected frequency
@@ -487,6 +436,28 @@ OSStatus renderCallback(void *userData,
 }
 
 
+//////
+//
+//    Margin over the noise floor to accept a frequency in background (dB, 12 by default)
+//
+/////
+-(void)setDetectionMargin:(float)margin
+{
+    sfNoiseFloorSetMargin(noiseFloor, margin);
+}
+
+
+//////
+//
+//    SNR of a frequency in the last background fft (dB, 0 outside of the 17-21.5 kHz band)
+//
+/////
+-(float)signalToNoiseRatio:(int)frequency
+{
+    return sfNoiseFloorSnr(noiseFloor, (int)(frequency*fftBufferCapacity/sampleRate + 0.5f));
+}
+
+
 ///////////
 //
 // Set up some variable for the renderCallback
@@ -546,6 +517,20 @@ OSStatus renderCallback(void *userData,
         NSLog(@"Error - unable to allocate FFT setup buffers" );
 	}
     
+    // phase vocoder for the high accuracy analysis (fft size 2048, osamp 4, bins k>100)
+    vocoder = sfVocoderCreate(maxFrames, 4, sampleRate, 101);
+    if (vocoder == NULL) {
+        NSLog(@"Error - unable to allocate the phase vocoder" );
+    }
+    
+    // noise floor of the 17-21.5 kHz bins, one fft every maxFrames samples
+    float freqPerBin = sampleRate/maxFrames;
+    noiseFloor = sfNoiseFloorCreate((int)ceilf(17000/freqPerBin), (int)(21500/freqPerBin), maxFrames/sampleRate);
+    noiseMagnitudes = (float*)calloc(fftNOver2, sizeof(float));
+    if (noiseFloor == NULL) {
+        NSLog(@"Error - unable to allocate the noise floor" );
+    }
+    
 }
 
 ///////////
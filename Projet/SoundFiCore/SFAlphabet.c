@@ -0,0 +1,37 @@
+//
+//  SFAlphabet.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+
+#include "SFAlphabet.h"
+
+
+SFAlphabet *sfAlphabetCreate(const char *caracters, int length, int minFrequency, int spacing)
+{
+    SFAlphabet *alphabet = calloc(1, sizeof(SFAlphabet));
+    if (alphabet == NULL)
+        return NULL;
+    alphabet->minFrequency = minFrequency;
+    alphabet->spacing = spacing > 0 ? spacing : 1;
+
+    if (length > SF_ALPHABET_SIZE)
+        length = SF_ALPHABET_SIZE;
+    for (int i = 0; i < length; i++) {
+        unsigned char caracter = (unsigned char)caracters[i];
+        alphabet->caracterOf[alphabet->count] = (char)caracter;
+        if (alphabet->frequencyOf[caracter] == 0)
+            alphabet->frequencyOf[caracter] = minFrequency + alphabet->count * alphabet->spacing;
+        alphabet->count++;
+    }
+    return alphabet;
+}
+
+
+void sfAlphabetDestroy(SFAlphabet *alphabet)
+{
+    free(alphabet);
+}
@@ -0,0 +1,61 @@
+//
+//  SFAlphabet.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFAlphabet_h
+#define SoundFi_SFAlphabet_h
+
+#define SF_ALPHABET_SIZE            256     // caracters of an alphabet, one byte each
+
+// The alphabet of the first emitters (soundCloud): the 94 printable caracters
+// from ' ' to '}', 18 Hz apart from 18000 Hz. '~' is not in it, its tone (19692
+// Hz) is the last one of the band plan of SFBandPlan.h only. Changing this table
+// moves the band plan of every emitter in the field.
+#define SF_ALPHABET_DEFAULT         " !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}"
+#define SF_ALPHABET_DEFAULT_COUNT   94
+
+/**---------------------------------------------------------------------------------------
+ * SFAlphabet
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Frequency plan of a custom alphabet (personaliseFrequencyValue), compiled once.
+
+ The caracter of the slot i is sent at minFrequency + i*spacing. frequencyOf gives the frequency of a caracter (0 if it's not in the alphabet) and caracterOf the caracter of a slot, so the render and reception callbacks never search the alphabet nor allocate a string. A frequency is read in the slot of the nearest one, within spacing/2 (sfAlphabetCaracter).
+
+ The table is never written once created: the session swap the pointer to a new one, a callback use the old one or the new one but never a table being written.
+ */
+typedef struct SFAlphabet {
+    int     minFrequency;
+    int     spacing;
+    int     count;                              // slots used in caracterOf
+    int     frequencyOf[SF_ALPHABET_SIZE];      // frequency of a caracter, 0 if not in the alphabet
+    char    caracterOf[SF_ALPHABET_SIZE];       // caracter of a slot
+} SFAlphabet;
+
+/** Compile an alphabet, the first one win if a caracter is twice in it (the second one still takes its slot).
+
+ @param caracters The caracters in the order of their frequencies, SF_ALPHABET_SIZE at most are kept
+ @param spacing Hz between two slots, 1 if it's under 1
+ @return The table or NULL
+ */
+SFAlphabet *sfAlphabetCreate(const char *caracters, int length, int minFrequency, int spacing);
+void sfAlphabetDestroy(SFAlphabet *alphabet);
+
+/** Frequency of a caracter, 0 if it's not in the alphabet */
+static inline int sfAlphabetFrequency(const SFAlphabet *alphabet, unsigned char caracter) {
+    return alphabet->frequencyOf[caracter];
+}
+
+/** Caracter of a received frequency, 0 if it's not within spacing/2 of a slot */
+static inline char sfAlphabetCaracter(const SFAlphabet *alphabet, int frequency) {
+    int offset = frequency - alphabet->minFrequency + alphabet->spacing / 2;
+    if (offset < 0)
+        return 0;
+    int slot = offset / alphabet->spacing;
+    return slot < alphabet->count ? alphabet->caracterOf[slot] : 0;
+}
+
+#endif
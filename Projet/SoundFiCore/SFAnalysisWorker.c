@@ -0,0 +1,126 @@
+//
+//  SFAnalysisWorker.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "SFAnalysisWorker.h"
+
+
+SFAnalysisWorker *sfAnalysisWorkerCreate(SFRingBuffer *ring, float sampleRate, int maxBlockSize, SFAnalysisProcess process, void *context)
+{
+    if (ring == NULL || process == NULL || sampleRate <= 0 || maxBlockSize <= 0 || (uint32_t)maxBlockSize > ring->capacity)
+        return NULL;
+
+    SFAnalysisWorker *worker = calloc(1, sizeof(SFAnalysisWorker));
+    if (worker == NULL)
+        return NULL;
+
+    worker->block = malloc(maxBlockSize * sizeof(int16_t));
+    if (worker->block == NULL) {
+        free(worker);
+        return NULL;
+    }
+
+    worker->ring = ring;
+    worker->sampleRate = sampleRate;
+    worker->maxBlockSize = maxBlockSize;
+    worker->blockSize = maxBlockSize;
+    worker->process = process;
+    worker->context = context;
+    return worker;
+}
+
+
+void sfAnalysisWorkerDestroy(SFAnalysisWorker *worker)
+{
+    if (worker == NULL)
+        return;
+    sfAnalysisWorkerStop(worker);
+    free(worker->block);
+    free(worker);
+}
+
+
+void sfAnalysisWorkerSetBlockSize(SFAnalysisWorker *worker, int blockSize)
+{
+    if (blockSize < 1)
+        blockSize = 1;
+    if (blockSize > worker->maxBlockSize)
+        blockSize = worker->maxBlockSize;
+    __atomic_store_n(&worker->blockSize, blockSize, __ATOMIC_RELAXED);
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * WorkerThread
+ *  ---------------------------------------------------------------------------------------
+ */
+static void *workerThread(void *context)
+{
+    SFAnalysisWorker *worker = context;
+    float waited = 0;                       // seconds without a complete block
+    int stalled = 0;
+
+    while (__atomic_load_n(&worker->running, __ATOMIC_ACQUIRE)) {
+        int blockSize = __atomic_load_n(&worker->blockSize, __ATOMIC_RELAXED);
+        float blockDuration = blockSize / worker->sampleRate;
+        uint32_t available = sfRingBufferAvailable(worker->ring);
+
+        if (available >= (uint32_t)blockSize) {
+            uint32_t latency = (uint32_t)(available * 1e6f / worker->sampleRate);
+            if (latency > worker->maxLatency)
+                __atomic_store_n(&worker->maxLatency, latency, __ATOMIC_RELAXED);
+
+            sfRingBufferRead(worker->ring, worker->block, blockSize);
+            worker->process(worker->context, worker->block, blockSize);
+            __atomic_store_n(&worker->blocks, worker->blocks + 1, __ATOMIC_RELAXED);
+            waited = 0;
+            stalled = 0;
+            continue;
+        }
+
+        // Nothing to do, look again in a quarter of block
+        float period = blockDuration / SF_WORKER_POLLS_PER_BLOCK;
+        struct timespec sleep = { (time_t)period, (long)((period - (time_t)period) * 1e9) };
+        nanosleep(&sleep, NULL);
+
+        waited += period;
+        if (!stalled && waited > SF_WORKER_STALL_BLOCKS * blockDuration) {
+            __atomic_store_n(&worker->underruns, worker->underruns + 1, __ATOMIC_RELAXED);
+            stalled = 1;
+        }
+    }
+    return NULL;
+}
+
+
+int sfAnalysisWorkerStart(SFAnalysisWorker *worker)
+{
+    if (worker->started)
+        return 0;
+
+    __atomic_store_n(&worker->running, 1, __ATOMIC_RELEASE);
+    if (pthread_create(&worker->thread, NULL, workerThread, worker) != 0) {
+        worker->running = 0;
+        return -1;
+    }
+    worker->started = 1;
+    return 0;
+}
+
+
+void sfAnalysisWorkerStop(SFAnalysisWorker *worker)
+{
+    if (!worker->started)
+        return;
+
+    __atomic_store_n(&worker->running, 0, __ATOMIC_RELEASE);
+    pthread_join(worker->thread, NULL);
+    worker->started = 0;
+}
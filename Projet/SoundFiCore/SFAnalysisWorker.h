@@ -0,0 +1,81 @@
+//
+//  SFAnalysisWorker.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFAnalysisWorker_h
+#define SoundFi_SFAnalysisWorker_h
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "SFRingBuffer.h"
+
+#define SF_WORKER_POLLS_PER_BLOCK   4       // the worker look at the ring 4 times during a block
+#define SF_WORKER_STALL_BLOCKS      2       // blocks without sample before an underrun is counted
+
+/** Called by the worker with each block of samples, on the worker thread */
+typedef void (*SFAnalysisProcess)(void *context, const int16_t *samples, int count);
+
+/**---------------------------------------------------------------------------------------
+ * SFAnalysisWorker
+ *  ---------------------------------------------------------------------------------------
+ */
+/** A thread that empty a SFRingBuffer by blocks and give them to the analysis.
+
+ The producer (the render callback) does not signal the worker, it would need a lock or a system call: the worker look at the ring SF_WORKER_POLLS_PER_BLOCK times per block duration and sleep the rest of the time. A block is so processed at most a quarter of block after its last sample is written, plus the time the worker was late (measured in maxLatency).
+
+ The block size can be changed while the worker is running (the engine change it with the detector, its IO buffer stays the same), it is read at the beginning of each block.
+
+ Statistics, they can be read from any thread:
+ - blocks: blocks given to the process function,
+ - underruns: times the ring stayed empty for more than SF_WORKER_STALL_BLOCKS blocks (the audio stopped or the producer is late), counted once by stall,
+ - maxLatency: the longest time a sample waited in the ring before its block was taken, in microseconds,
+ - the overruns are counted by the ring (sfRingBufferOverruns), the samples that the worker was too slow to take.
+ */
+typedef struct SFAnalysisWorker {
+    SFRingBuffer        *ring;
+    float               sampleRate;
+    int                 maxBlockSize;
+    int                 blockSize;          // may be changed at any time
+    int16_t             *block;             // maxBlockSize samples, given to process
+
+    SFAnalysisProcess   process;
+    void                *context;
+
+    pthread_t           thread;
+    int                 running;
+    int                 started;
+
+    uint32_t            blocks;
+    uint32_t            underruns;
+    uint32_t            maxLatency;         // microseconds
+} SFAnalysisWorker;
+
+
+/** Create a worker, it is not started.
+
+ @param ring The ring to empty, the worker is its only consumer
+ @param sampleRate Sample rate of the stream, for the timing
+ @param maxBlockSize Biggest block size that will be used
+ @param process Function called with each block
+ @param context Given to process
+ @return The worker or NULL if the parameters are wrong or there is not enough memory
+ */
+SFAnalysisWorker *sfAnalysisWorkerCreate(SFRingBuffer *ring, float sampleRate, int maxBlockSize, SFAnalysisProcess process, void *context);
+
+/** Stop the worker if needed, the ring is not destroyed */
+void sfAnalysisWorkerDestroy(SFAnalysisWorker *worker);
+
+/** Start the thread, return 0 on success */
+int sfAnalysisWorkerStart(SFAnalysisWorker *worker);
+
+/** Stop the thread and wait for it, the block being processed is finished */
+void sfAnalysisWorkerStop(SFAnalysisWorker *worker);
+
+/** Change the block size, from 1 to maxBlockSize */
+void sfAnalysisWorkerSetBlockSize(SFAnalysisWorker *worker, int blockSize);
+
+#endif
@@ -0,0 +1,54 @@
+//
+//  SFBandPlan.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+// The frequencies every SoundFi emitter and receiver agree on. These are the
+// numbers that used to be written inline in getASCIIFrequency and in the
+// reception tests (17800, 18000 + 18*k, 19728, 20000-21000 ...).
+
+#ifndef SoundFi_SFBandPlan_h
+#define SoundFi_SFBandPlan_h
+
+#define SF_START_FREQUENCY          17800   // Init sequence tone
+#define SF_FIRST_CHAR_FREQUENCY     18000   // Frequency of the caracter ' ' (ASCII 32)
+#define SF_CHAR_SPACING             18      // Hz between two consecutive caracters
+#define SF_FIRST_CHAR               32      // First printable ASCII caracter
+#define SF_CHAR_COUNT               95      // Printable ASCII 32..126
+#define SF_STOP_FREQUENCY           19728   // End of message tone
+
+#define SF_GEO_MIN_FREQUENCY        20000   // Geomarketing beacons band
+#define SF_GEO_MAX_FREQUENCY        21000
+#define SF_GEO_SPOT_COUNT           20      // Spots in a zone (nbrSpotInZone)
+#define SF_GEO_SPACING              ((SF_GEO_MAX_FREQUENCY-SF_GEO_MIN_FREQUENCY)/SF_GEO_SPOT_COUNT)
+
+// Tone index layout used by the tone bank: start, the 95 caracters, stop, then the geo spots
+#define SF_TONE_START               0
+#define SF_TONE_FIRST_CHAR          1
+#define SF_TONE_STOP                (SF_TONE_FIRST_CHAR+SF_CHAR_COUNT)
+#define SF_TONE_FIRST_GEO           (SF_TONE_STOP+1)
+#define SF_TONE_COUNT               (SF_TONE_FIRST_GEO+SF_GEO_SPOT_COUNT)
+
+/** Frequency of a printable caracter */
+static inline int sfCharFrequency(int c) {
+    return SF_FIRST_CHAR_FREQUENCY + (c - SF_FIRST_CHAR) * SF_CHAR_SPACING;
+}
+
+/** Frequency of the geo spot number spot (centre of its slot) */
+static inline int sfGeoFrequency(int spot) {
+    return SF_GEO_MIN_FREQUENCY + spot * SF_GEO_SPACING + SF_GEO_SPACING / 2;
+}
+
+/** Fill frequencies[SF_TONE_COUNT] with the band plan in tone index order */
+static inline void sfBandPlanFrequencies(float *frequencies) {
+    frequencies[SF_TONE_START] = SF_START_FREQUENCY;
+    for (int c = 0; c < SF_CHAR_COUNT; c++)
+        frequencies[SF_TONE_FIRST_CHAR + c] = sfCharFrequency(SF_FIRST_CHAR + c);
+    frequencies[SF_TONE_STOP] = SF_STOP_FREQUENCY;
+    for (int s = 0; s < SF_GEO_SPOT_COUNT; s++)
+        frequencies[SF_TONE_FIRST_GEO + s] = sfGeoFrequency(s);
+}
+
+#endif
@@ -0,0 +1,163 @@
+//
+//  SFBeaconScanner.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SFBeaconScanner.h"
+
+#define MIN_POWER   1e-12f      // digital silence
+
+
+SFBeaconScanner *sfBeaconScannerCreate(int fftSize, float sampleRate, float framePeriod)
+{
+    if (fftSize <= 0 || sampleRate <= 0 || framePeriod <= 0)
+        return NULL;
+    float freqPerBin = sampleRate / fftSize;
+    if (freqPerBin > SF_GEO_SPACING / 2 || SF_GEO_MAX_FREQUENCY + SF_GEO_SPACING >= sampleRate / 2)
+        return NULL;
+
+    SFBeaconScanner *scanner = calloc(1, sizeof(SFBeaconScanner));
+    if (scanner == NULL)
+        return NULL;
+
+    // The noise is measured from one spacing under the band to one spacing over
+    scanner->freqPerBin = freqPerBin;
+    scanner->firstBin = (int)floorf((SF_GEO_MIN_FREQUENCY - SF_GEO_SPACING) / freqPerBin);
+    scanner->binCount = (int)ceilf((SF_GEO_MAX_FREQUENCY + SF_GEO_SPACING) / freqPerBin) - scanner->firstBin + 1;
+    for (int s = 0; s < SF_GEO_SPOT_COUNT; s++) {
+        float frequency = sfGeoFrequency(s);
+        scanner->spotFirstBin[s] = (int)ceilf((frequency - SF_GEO_SPACING / 4.f) / freqPerBin);
+        scanner->spotLastBin[s] = (int)floorf((frequency + SF_GEO_SPACING / 4.f) / freqPerBin);
+        if (scanner->spotLastBin[s] < scanner->spotFirstBin[s])
+            scanner->spotFirstBin[s] = scanner->spotLastBin[s] = (int)lrintf(frequency / freqPerBin);
+    }
+    scanner->rate = 1.f - expf(-framePeriod / SF_BEACON_TIME_CONSTANT);
+    scanner->scratch = malloc(scanner->binCount * sizeof(float));
+
+    if (scanner->scratch == NULL) {
+        sfBeaconScannerDestroy(scanner);
+        return NULL;
+    }
+
+    sfBeaconScannerReset(scanner);
+    return scanner;
+}
+
+
+void sfBeaconScannerDestroy(SFBeaconScanner *scanner)
+{
+    if (scanner == NULL)
+        return;
+    free(scanner->scratch);
+    free(scanner);
+}
+
+
+void sfBeaconScannerReset(SFBeaconScanner *scanner)
+{
+    memset(scanner->power, 0, sizeof(scanner->power));
+    scanner->noise = 0;
+    scanner->frameCount = 0;
+    scanner->beaconCount = 0;
+    scanner->position = -1;
+}
+
+
+/** Median of values (reordered), Hoare's selection */
+static float median(float *values, int count)
+{
+    int k = count / 2;
+    int low = 0, high = count - 1;
+    while (low < high) {
+        float pivot = values[(low + high) / 2];
+        int i = low, j = high;
+        while (i <= j) {
+            while (values[i] < pivot) i++;
+            while (values[j] > pivot) j--;
+            if (i <= j) {
+                float swap = values[i];
+                values[i++] = values[j];
+                values[j--] = swap;
+            }
+        }
+        if (k <= j)
+            high = j;
+        else if (k >= i)
+            low = i;
+        else
+            break;
+    }
+    return values[k];
+}
+
+
+int sfBeaconScannerUpdate(SFBeaconScanner *scanner, const float *magnitudes)
+{
+    // The first spectrum is taken as it is, then the powers are smoothed
+    float rate = scanner->frameCount == 0 ? 1.f : scanner->rate;
+    scanner->frameCount++;
+
+    memcpy(scanner->scratch, magnitudes + scanner->firstBin, scanner->binCount * sizeof(float));
+    scanner->noise += rate * (median(scanner->scratch, scanner->binCount) + MIN_POWER - scanner->noise);
+
+    float loudest = 0;
+    for (int s = 0; s < SF_GEO_SPOT_COUNT; s++) {
+        float power = 0;
+        for (int k = scanner->spotFirstBin[s]; k <= scanner->spotLastBin[s]; k++)
+            power = fmaxf(power, magnitudes[k]);
+        scanner->power[s] += rate * (power - scanner->power[s]);
+        loudest = fmaxf(loudest, scanner->power[s]);
+    }
+
+    // The beacons heard, loudest first (insertion, there are a few of them)
+    float threshold = fmaxf(scanner->noise * powf(10.f, SF_BEACON_MARGIN / 10.f), loudest * powf(10.f, -SF_BEACON_DYNAMIC / 10.f));
+    int count = 0;
+    for (int s = 0; s < SF_GEO_SPOT_COUNT; s++) {
+        if (scanner->power[s] < threshold)
+            continue;
+        int i = count++;
+        while (i > 0 && scanner->power[scanner->beacons[i - 1].spot] < scanner->power[s]) {
+            scanner->beacons[i] = scanner->beacons[i - 1];
+            i--;
+        }
+        scanner->beacons[i].spot = s;
+        scanner->beacons[i].level = 10.f * log10f(scanner->power[s] / scanner->noise);
+    }
+    scanner->beaconCount = count;
+
+    if (count == 0) {
+        scanner->position = -1;
+        return 0;
+    }
+
+    // Nearest beacon, moved toward its louder neighbour by the ratio of the amplitudes
+    int nearest = scanner->beacons[0].spot;
+    int neighbour = -1;
+    for (int s = nearest - 1; s <= nearest + 1; s += 2) {
+        if (s < 0 || s >= SF_GEO_SPOT_COUNT || scanner->power[s] < threshold)
+            continue;
+        if (neighbour < 0 || scanner->power[s] > scanner->power[neighbour])
+            neighbour = s;
+    }
+    scanner->position = nearest;
+    if (neighbour >= 0) {
+        float near = sqrtf(scanner->power[nearest]);
+        float far = sqrtf(scanner->power[neighbour]);
+        scanner->position += (neighbour - nearest) * far / (near + far);
+    }
+    return count;
+}
+
+
+float sfBeaconScannerFrequency(const SFBeaconScanner *scanner)
+{
+    if (scanner->position < 0)
+        return 0;
+    return SF_GEO_MIN_FREQUENCY + (scanner->position + 0.5f) * SF_GEO_SPACING;
+}
@@ -0,0 +1,83 @@
+//
+//  SFBeaconScanner.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFBeaconScanner_h
+#define SoundFi_SFBeaconScanner_h
+
+#include "SFBandPlan.h"
+
+#define SF_BEACON_MARGIN            15.f    // dB over the noise of the band to hear a beacon
+#define SF_BEACON_DYNAMIC           20.f    // dB under the loudest beacon, the weaker ones are left out (leakage of the loud ones)
+#define SF_BEACON_TIME_CONSTANT     0.3f    // seconds, smoothing of the level of each beacon
+
+/**---------------------------------------------------------------------------------------
+ * SFBeaconScanner
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Every geomarketing beacon heard in a spectrum, with its level, and the position of the user between them.
+
+ In a store with several emitters the strongest peak of the spectrum jump from one beacon to the other as the user walks (and as the fading of the room change), the spot found from the single frequency of the detector flickers. The scanner read the level of every spot of the band plan in the spectrum the detector has already computed, there is no FFT of its own:
+
+ - the power of a spot is the strongest bin within SF_GEO_SPACING/4 of its frequency (with the Hann window of the vocoder the next spot leak 20 dB under),
+ - the noise is the median of the bins of the beacon band, computed again on each spectrum, a beacon that never stops is not learned as noise like with SFNoiseFloor,
+ - the power and the noise are smoothed (SF_BEACON_TIME_CONSTANT), a beacon is heard if it is SF_BEACON_MARGIN over the noise and at most SF_BEACON_DYNAMIC under the loudest one.
+
+ The position is in spot units: the loudest beacon is the nearest one, the position moves toward the louder of its two neighbours in the band plan (the emitters of consecutive spots are installed next to each other) by the ratio of their amplitudes, up to halfway when they are as loud. The spots that are not neighbours don't move the position, their layout in the store is not known.
+
+ The spectrum must resolve the spots: SF_GEO_SPACING/2 at least between two bins (2048 points at 44.1 kHz, not 256). One scanner for each stream, it doesn't allocate memory after the creation.
+ */
+typedef struct SFBeacon {
+    int         spot;
+    float       level;                      // dB over the noise of the band
+} SFBeacon;
+
+typedef struct SFBeaconScanner {
+    float       freqPerBin;
+    int         firstBin;                   // bins of the band where the noise is measured
+    int         binCount;
+    int         spotFirstBin[SF_GEO_SPOT_COUNT];
+    int         spotLastBin[SF_GEO_SPOT_COUNT];
+    float       rate;                       // weight of a new spectrum in the smoothed powers
+    float       *scratch;                   // copy of the band for the median
+
+    float       power[SF_GEO_SPOT_COUNT];   // smoothed power of each spot
+    float       noise;                      // smoothed median power of the band
+    int         frameCount;                 // spectrums since the reset
+
+    SFBeacon    beacons[SF_GEO_SPOT_COUNT]; // the beacons heard, loudest first
+    int         beaconCount;
+    float       position;                   // in spots, -1 if no beacon is heard
+} SFBeaconScanner;
+
+
+/** Create a scanner.
+
+ @param fftSize Size of the FFT of the spectrums
+ @param sampleRate Sample rate of the stream
+ @param framePeriod Time between two spectrums given to sfBeaconScannerUpdate, in seconds
+ @return The scanner, NULL if the spectrum doesn't resolve the spots or there is not enough memory
+ */
+SFBeaconScanner *sfBeaconScannerCreate(int fftSize, float sampleRate, float framePeriod);
+void sfBeaconScannerDestroy(SFBeaconScanner *scanner);
+
+/** Forget the levels, the beacons are heard again from the next spectrum */
+void sfBeaconScannerReset(SFBeaconScanner *scanner);
+
+/** Read the beacons in a new spectrum and update the position.
+
+ @param magnitudes Squared magnitudes indexed by bin (the ones of SFVocoder), only the bins of the beacon band are read
+ @return The number of beacons heard
+ */
+int sfBeaconScannerUpdate(SFBeaconScanner *scanner, const float *magnitudes);
+
+/** The position as a frequency of the band plan (the frequency of the spot for a whole spot), 0 if no beacon is heard.
+
+ It's what the detector of a single beacon would give, to decide the spot with SFZoneEstimator.
+ */
+float sfBeaconScannerFrequency(const SFBeaconScanner *scanner);
+
+#endif
@@ -0,0 +1,313 @@
+//
+//  SFChirp.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SFChirp.h"
+
+
+SFChirp *sfChirpCreate(float sampleRate, int length)
+{
+    if (sampleRate <= 2 * SF_CHIRP_HIGH_FREQUENCY || length < 16)
+        return NULL;
+
+    SFChirp *chirp = calloc(1, sizeof(SFChirp));
+    if (chirp == NULL)
+        return NULL;
+    chirp->sampleRate = sampleRate;
+    chirp->length = length;
+    chirp->samples = malloc(length * sizeof(float));
+    if (chirp->samples == NULL) {
+        sfChirpDestroy(chirp);
+        return NULL;
+    }
+
+    // θ(t) = 2π (f0 t + k t²/2), the frequency goes linearly from f0 to f1
+    const double duration = length / (double)sampleRate;
+    const double rate = (SF_CHIRP_HIGH_FREQUENCY - SF_CHIRP_LOW_FREQUENCY) / duration;
+    const int taper = (int)(length * SF_CHIRP_TAPER / 2);
+    double energy = 0;
+    for (int n = 0; n < length; n++) {
+        double t = n / (double)sampleRate;
+        double window = 1;
+        if (n < taper)
+            window = 0.5 - 0.5 * cos(M_PI * n / taper);
+        else if (n >= length - taper)
+            window = 0.5 - 0.5 * cos(M_PI * (length - 1 - n) / taper);
+        chirp->samples[n] = (float)(window * sin(2 * M_PI * (SF_CHIRP_LOW_FREQUENCY * t + rate * t * t / 2)));
+        energy += chirp->samples[n] * chirp->samples[n];
+    }
+    chirp->energy = (float)energy;
+    return chirp;
+}
+
+
+void sfChirpDestroy(SFChirp *chirp)
+{
+    if (chirp == NULL)
+        return;
+    free(chirp->samples);
+    free(chirp);
+}
+
+
+int sfChirpRender(const SFChirp *chirp, int offset, float amplitude, float *output, int count)
+{
+    int written = chirp->length - offset;
+    if (written < 0)
+        written = 0;
+    if (written > count)
+        written = count;
+    for (int n = 0; n < written; n++)
+        output[n] = amplitude * chirp->samples[offset + n];
+    memset(output + written, 0, (count - written) * sizeof(float));
+    return written;
+}
+
+
+SFChirpDetector *sfChirpDetectorCreate(float sampleRate, int length, int after)
+{
+    if (after < 0)
+        return NULL;
+
+    SFChirpDetector *detector = calloc(1, sizeof(SFChirpDetector));
+    if (detector == NULL)
+        return NULL;
+
+    int log2n = 1;
+    while ((1 << log2n) < 2 * length)
+        log2n++;
+    detector->length = length;
+    detector->size = 1 << log2n;
+    detector->hop = detector->size - length;
+    detector->after = after;
+
+    const int size = detector->size;
+    const int bins = size / 2 + 1;
+    detector->chirp = sfChirpCreate(sampleRate, length);
+    detector->fft = sfFftCreate(log2n);
+    detector->templateRe = calloc(bins, sizeof(float));
+    detector->templateIm = calloc(bins, sizeof(float));
+    detector->input = calloc(size, sizeof(float));
+    detector->re = malloc(bins * sizeof(float));
+    detector->im = malloc(bins * sizeof(float));
+    detector->productRe = malloc(bins * sizeof(float));
+    detector->productIm = malloc(bins * sizeof(float));
+    detector->band = malloc(size * sizeof(float));
+    detector->correlation = malloc(size * sizeof(float));
+    detector->quadrature = malloc(size * sizeof(float));
+    detector->history = malloc((size + after) * sizeof(int16_t));
+    if (detector->chirp == NULL || detector->fft == NULL || !detector->templateRe || !detector->templateIm || !detector->input ||
+        !detector->re || !detector->im || !detector->productRe || !detector->productIm || !detector->band ||
+        !detector->correlation || !detector->quadrature || !detector->history) {
+        sfChirpDetectorDestroy(detector);
+        return NULL;
+    }
+
+    detector->lowBin = (int)((SF_CHIRP_LOW_FREQUENCY - SF_CHIRP_BAND_MARGIN) * size / sampleRate);
+    detector->highBin = (int)ceilf((SF_CHIRP_HIGH_FREQUENCY + SF_CHIRP_BAND_MARGIN) * size / sampleRate);
+    if (detector->lowBin < 1)
+        detector->lowBin = 1;
+    if (detector->highBin > bins - 2)
+        detector->highBin = bins - 2;
+
+    // Conjugate spectrum of the chirp at the start of a window of zeros, the bins out of the band are left at 0
+    memcpy(detector->input, detector->chirp->samples, length * sizeof(float));
+    sfFftForward(detector->fft, detector->input, detector->re, detector->im);
+    for (int k = detector->lowBin; k <= detector->highBin; k++) {
+        detector->templateRe[k] = detector->re[k];
+        detector->templateIm[k] = -detector->im[k];
+    }
+
+    sfChirpDetectorReset(detector);
+    return detector;
+}
+
+
+void sfChirpDetectorDestroy(SFChirpDetector *detector)
+{
+    if (detector == NULL)
+        return;
+    sfChirpDestroy(detector->chirp);
+    sfFftDestroy(detector->fft);
+    free(detector->templateRe);
+    free(detector->templateIm);
+    free(detector->input);
+    free(detector->re);
+    free(detector->im);
+    free(detector->productRe);
+    free(detector->productIm);
+    free(detector->band);
+    free(detector->correlation);
+    free(detector->quadrature);
+    free(detector->history);
+    free(detector);
+}
+
+
+void sfChirpDetectorReset(SFChirpDetector *detector)
+{
+    detector->fill = 0;
+    detector->historyStart = 0;
+    detector->windows = 0;
+    detector->floor = 0;
+    detector->candidate = -1;
+    detector->candidatePeak = 0;
+    detector->candidateCorrelation = 0;
+    detector->found = 0;
+    detector->chirpEnd = 0;
+    detector->peak = 0;
+    detector->correlationPeak = 0;
+}
+
+
+/** The chirp starting at sample start is found */
+static void foundChirp(SFChirpDetector *detector, long start, float peak, float correlation)
+{
+    detector->found = 1;
+    detector->chirpEnd = start + detector->length;
+    detector->peak = peak;
+    detector->correlationPeak = correlation;
+    detector->candidate = -1;
+}
+
+
+/** Matched filter on the full window, then the window moves by hop samples */
+static void processWindow(SFChirpDetector *detector)
+{
+    const int size = detector->size;
+    const int length = detector->length;
+    const int hop = detector->hop;
+    float *re = detector->re, *im = detector->im;
+    float *productRe = detector->productRe, *productIm = detector->productIm;
+
+    for (int n = 0; n < size; n++)
+        detector->input[n] = detector->history[n];
+    sfFftForward(detector->fft, detector->input, re, im);
+
+    // The window in the band, for its energy
+    memset(productRe, 0, (size / 2 + 1) * sizeof(float));
+    memset(productIm, 0, (size / 2 + 1) * sizeof(float));
+    for (int k = detector->lowBin; k <= detector->highBin; k++) {
+        productRe[k] = re[k];
+        productIm[k] = im[k];
+    }
+    sfFftInverse(detector->fft, productRe, productIm, detector->band);
+
+    // Correlation X·conj(T), then its Hilbert transform: -j on the positive frequencies
+    for (int k = detector->lowBin; k <= detector->highBin; k++) {
+        float a = re[k], b = im[k], c = detector->templateRe[k], d = detector->templateIm[k];
+        productRe[k] = a * c - b * d;
+        productIm[k] = a * d + b * c;
+    }
+    sfFftInverse(detector->fft, productRe, productIm, detector->correlation);
+    for (int k = detector->lowBin; k <= detector->highBin; k++) {
+        float value = productRe[k];
+        productRe[k] = productIm[k];
+        productIm[k] = -value;
+    }
+    sfFftInverse(detector->fft, productRe, productIm, detector->quadrature);
+
+    // Envelope of the lags 0..hop-1, the chirp against history[lag .. lag+length-1]
+    double bandEnergy = 0;
+    for (int n = 0; n < length; n++)
+        bandEnergy += detector->band[n] * detector->band[n];
+    double sum = 0;
+    float best = 0, bestCorrelation = 0;
+    int bestLag = -1;
+    for (int lag = 0; lag < hop; lag++) {
+        float r = detector->correlation[lag], h = detector->quadrature[lag];
+        float envelope = r * r + h * h;
+        sum += envelope;
+        float correlation = bandEnergy > 0 ? (float)(envelope / (detector->chirp->energy * bandEnergy)) : 0;
+        if (envelope > best && correlation >= SF_CHIRP_MIN_CORRELATION) {
+            best = envelope;
+            bestCorrelation = correlation;
+            bestLag = lag;
+        }
+        bandEnergy += detector->band[lag + length] * detector->band[lag + length] - detector->band[lag] * detector->band[lag];
+    }
+
+    // Constant false alarm rate: the average of the envelope, or of this window if it's louder (the noise just came)
+    float mean = (float)(sum / hop);
+    float reference = detector->floor > mean ? detector->floor : mean;
+    int peak = bestLag >= 0 && detector->windows > 0 && best > SF_CHIRP_THRESHOLD * reference;
+    int guard = (int)(4 * detector->chirp->sampleRate / (SF_CHIRP_HIGH_FREQUENCY - SF_CHIRP_LOW_FREQUENCY));
+
+    // A peak at the end of the lags of the last window is kept if this window has nothing louder
+    if (detector->candidate >= 0 && (!peak || best <= detector->candidatePeak))
+        foundChirp(detector, detector->candidate, detector->candidatePeak / reference, detector->candidateCorrelation);
+    else if (peak && bestLag < hop - guard)
+        foundChirp(detector, detector->historyStart + bestLag, best / reference, bestCorrelation);
+    else if (peak) {
+        detector->candidate = detector->historyStart + bestLag;
+        detector->candidatePeak = best;
+        detector->candidateCorrelation = bestCorrelation;
+    }
+    else
+        detector->candidate = -1;
+
+    if (!peak)
+        detector->floor = detector->windows == 0 ? mean : detector->floor + SF_CHIRP_FLOOR_SMOOTHING * (mean - detector->floor);
+    detector->windows++;
+
+    // Once the chirp is found the history start at its end, the following samples are kept from there
+    int shift = detector->found ? (int)(detector->chirpEnd - detector->historyStart) : hop;
+    memmove(detector->history, detector->history + shift, (detector->fill - shift) * sizeof(int16_t));
+    detector->fill -= shift;
+    detector->historyStart += shift;
+}
+
+
+/** Samples the history must hold once the chirp is found */
+static int followingEnd(const SFChirpDetector *detector)
+{
+    return (int)(detector->chirpEnd - detector->historyStart) + detector->after;
+}
+
+
+int sfChirpDetectorProcess(SFChirpDetector *detector, const int16_t *samples, int count, int *used)
+{
+    int taken = 0;
+
+    while (taken < count) {
+        if (detector->found) {
+            int missing = followingEnd(detector) - detector->fill;
+            if (missing <= 0)
+                break;
+            int chunk = count - taken < missing ? count - taken : missing;
+            memcpy(detector->history + detector->fill, samples + taken, chunk * sizeof(int16_t));
+            detector->fill += chunk;
+            taken += chunk;
+            continue;
+        }
+
+        int chunk = detector->size - detector->fill;
+        if (chunk > count - taken)
+            chunk = count - taken;
+        memcpy(detector->history + detector->fill, samples + taken, chunk * sizeof(int16_t));
+        detector->fill += chunk;
+        taken += chunk;
+        if (detector->fill == detector->size)
+            processWindow(detector);
+    }
+
+    if (used != NULL)
+        *used = taken;
+    return detector->found && detector->fill >= followingEnd(detector);
+}
+
+
+const int16_t *sfChirpDetectorFollowing(const SFChirpDetector *detector, int *count)
+{
+    int first = (int)(detector->chirpEnd - detector->historyStart);
+    if (count != NULL)
+        *count = detector->found ? detector->fill - first : 0;
+    return detector->history + first;
+}
@@ -0,0 +1,147 @@
+//
+//  SFChirp.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+// The chirp preamble. Instead of 26 callbacks of start tone, that the receiver
+// finds when one buffer has its dominant frequency in 17650-17950 Hz, a message
+// can start with a linear chirp from SF_CHIRP_LOW_FREQUENCY to
+// SF_CHIRP_HIGH_FREQUENCY, then the start tone of its mode for
+// SF_CHIRP_MODE_FRAMES only:
+//
+//   chirp 17000 -> 19500 Hz   2048 samples (46 ms)
+//   start tone of the mode     768 samples (3 callbacks)
+//   symbols ...
+//
+// The receiver correlates the samples with the chirp (a matched filter, by FFT),
+// the peak of the correlation gives the end of the chirp to the sample, whatever
+// the size of the buffers, where the end of a start tone is known to a quarter of
+// a window. The chirp is sent at the full amplitude of the emission, the start
+// tone that follows at the level of the message: it tells the mode, and its
+// length is known so the first symbol starts at a known sample too.
+
+#ifndef SoundFi_SFChirp_h
+#define SoundFi_SFChirp_h
+
+#include <stdint.h>
+
+#include "SFFft.h"
+
+#define SF_CHIRP_LOW_FREQUENCY      17000   // Hz at the start of the chirp
+#define SF_CHIRP_HIGH_FREQUENCY     19500   // Hz at its end
+#define SF_CHIRP_LENGTH             2048    // samples at 44100 Hz
+#define SF_CHIRP_TAPER              0.1f    // part of the chirp faded in and out (Tukey window)
+#define SF_CHIRP_MODE_FRAMES        768     // start tone of the mode after the chirp (3 callbacks of 256)
+#define SF_CHIRP_THRESHOLD          25.f    // peak of the matched filter over its average (14 dB)
+#define SF_CHIRP_MIN_CORRELATION    0.08f   // normalised correlation in the band, a click is ~0.01
+#define SF_CHIRP_FLOOR_SMOOTHING    0.1f    // of the average of the matched filter, per window
+#define SF_CHIRP_BAND_MARGIN        200     // Hz kept around the band of the chirp
+
+/** The chirp, computed once, rendered by copy */
+typedef struct SFChirp {
+    float   sampleRate;
+    int     length;                 // samples
+    float   *samples;               // amplitude 1, tapered
+    float   energy;                 // sum of the squares of samples
+} SFChirp;
+
+
+/** Create the chirp of the preamble.
+
+ @param sampleRate Sample rate of the output
+ @param length Samples of the chirp, SF_CHIRP_LENGTH at 44100 Hz (the same duration at an other rate)
+ @return The chirp or NULL
+ */
+SFChirp *sfChirpCreate(float sampleRate, int length);
+void sfChirpDestroy(SFChirp *chirp);
+
+/** Render a part of the chirp.
+
+ @param offset First sample of the chirp to render
+ @param output count floats, the samples after the end of the chirp are 0
+ @return The number of samples of the chirp written
+ */
+int sfChirpRender(const SFChirp *chirp, int offset, float amplitude, float *output, int count);
+
+
+/**---------------------------------------------------------------------------------------
+ * SFChirpDetector
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Matched filter of the chirp preamble.
+
+ The correlation with the chirp is computed by overlap-save: a window of size (a power of 2, twice the chirp at least) samples is transformed, multiplied by the conjugate spectrum of the chirp and transformed back, that gives size - length lags at once, then the window moves by as many samples. Only the bins of the chirp band are kept, so the speech and the music under 17 kHz don't count. The envelope of the correlation (with its Hilbert transform, one more inverse FFT) has a single peak, about sampleRate/bandwidth wide, where the chirp start.
+
+ A peak is a chirp when it is SF_CHIRP_THRESHOLD times over the average of the envelope (a constant false alarm rate on the noise, about one per 2 weeks of white noise), and when its correlation normalised by the energy of the band is over SF_CHIRP_MIN_CORRELATION (a click is as loud as a chirp for the matched filter, but it's not the same waveform). A peak at the end of the lags of a window is confirmed by the next window.
+
+ Once the chirp is found the detector keeps the samples that follow it: the caller get them with sfChirpDetectorFollowing (the start tone of the mode, then the first symbols) and gives them to its decoder, because the detection comes up to one window after the end of the chirp. The samples are counted from the last reset, chirpEnd is the first one after the chirp.
+
+ Memory is allocated by sfChirpDetectorCreate only. About 3 FFT of size per size - length samples, one detector per thread.
+ */
+typedef struct SFChirpDetector {
+    SFChirp     *chirp;
+    SFFft       *fft;
+    int         length;             // of the chirp
+    int         size;               // of the FFT window
+    int         hop;                // lags per window, size - length
+    int         after;              // samples kept after the chirp before it's reported
+    int         lowBin;             // band of the chirp in the FFT
+    int         highBin;
+
+    float       *templateRe;        // conjugate spectrum of the chirp, band only
+    float       *templateIm;
+    float       *input;             // the window in float
+    float       *re;                // size/2+1 bins
+    float       *im;
+    float       *productRe;
+    float       *productIm;
+    float       *band;              // the window in the band of the chirp
+    float       *correlation;
+    float       *quadrature;        // Hilbert transform of correlation
+
+    int16_t     *history;           // the window and the samples kept after a chirp, size + after
+    int         fill;
+    long        historyStart;       // sample number of history[0]
+    int         windows;            // evaluated since the reset
+    float       floor;              // average of the envelope
+    long        candidate;          // start of a peak at the end of the last window, -1 if none
+    float       candidatePeak;
+    float       candidateCorrelation;
+
+    int         found;              // the chirp is found, the following samples are kept
+    long        chirpEnd;           // first sample after the chirp
+    float       peak;               // envelope over floor of the chirp found
+    float       correlationPeak;    // its normalised correlation
+} SFChirpDetector;
+
+
+/** Create a detector.
+
+ @param sampleRate Sample rate of the input
+ @param length Samples of the chirp (SF_CHIRP_LENGTH at 44100 Hz)
+ @param after Samples to keep after the chirp before reporting it (SF_CHIRP_MODE_FRAMES to read the mode)
+ @return The detector or NULL
+ */
+SFChirpDetector *sfChirpDetectorCreate(float sampleRate, int length, int after);
+void sfChirpDetectorDestroy(SFChirpDetector *detector);
+
+/** Forget the samples and the chirp found, the next sample is number 0 */
+void sfChirpDetectorReset(SFChirpDetector *detector);
+
+/** Give samples to the detector.
+
+ @param used Receive the number of samples taken in the detector: all of them, or the ones up to the last sample kept after the chirp when it's found. The next ones belong to the message.
+ @return 1 when the chirp is found and after samples that follow it are kept, 0 otherwise
+ */
+int sfChirpDetectorProcess(SFChirpDetector *detector, const int16_t *samples, int count, int *used);
+
+/** Samples kept after the chirp, once it's found.
+
+ @param count Receive the number of samples, after at least
+ @return The first sample after the chirp, valid until the next call to the detector
+ */
+const int16_t *sfChirpDetectorFollowing(const SFChirpDetector *detector, int *count);
+
+#endif
@@ -0,0 +1,196 @@
+//
+//  SFDownconverter.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SFDownconverter.h"
+
+
+/** Hamming windowed sinc, cutoff in fraction of the sample rate, gain 1 at 0 Hz */
+static void designLowPass(float *taps, int tapCount, double cutoff)
+{
+    double sum = 0;
+    double middle = (tapCount - 1) / 2.0;
+
+    for (int k = 0; k < tapCount; k++) {
+        double x = k - middle;
+        double sinc = x == 0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+        double window = 0.54 - 0.46 * cos(2.0 * M_PI * k / (tapCount - 1));
+        taps[k] = (float)(sinc * window);
+        sum += taps[k];
+    }
+    for (int k = 0; k < tapCount; k++)
+        taps[k] = (float)(taps[k] / sum);
+}
+
+
+/** Setup one stage: the band [-halfBand, halfBand] must survive, what folds on it must be removed */
+static int decimatorSetup(struct SFDecimator *stage, int factor, double inputRate, double halfBand)
+{
+    double outputRate = inputRate / factor;
+    double transition = outputRate - 2.0 * halfBand;      // from halfBand to outputRate-halfBand
+
+    stage->factor = factor;
+    stage->tapCount = (int)ceil(3.3 * inputRate / transition) | 1;       // Hamming: transition ~3.3/N
+    stage->taps = malloc(stage->tapCount * sizeof(float));
+    stage->lineRe = calloc(2 * stage->tapCount, sizeof(float));
+    stage->lineIm = calloc(2 * stage->tapCount, sizeof(float));
+    if (!stage->taps || !stage->lineRe || !stage->lineIm)
+        return -1;
+
+    designLowPass(stage->taps, stage->tapCount, 0.5 / factor);
+    return 0;
+}
+
+
+static void decimatorDestroy(struct SFDecimator *stage)
+{
+    free(stage->taps);
+    free(stage->lineRe);
+    free(stage->lineIm);
+}
+
+
+SFDownconverter *sfDownconverterCreate(float sampleRate, float lowFrequency, float highFrequency, int decimation)
+{
+    double halfBand = (highFrequency - lowFrequency) / 2.0;
+
+    if (decimation < 2 || decimation % 2 != 0 || highFrequency <= lowFrequency || sampleRate / decimation <= 2.0 * halfBand)
+        return NULL;
+
+    SFDownconverter *downconverter = calloc(1, sizeof(SFDownconverter));
+    if (downconverter == NULL)
+        return NULL;
+
+    downconverter->sampleRate = sampleRate;
+    downconverter->decimation = decimation;
+    downconverter->outputRate = sampleRate / decimation;
+    downconverter->centreFrequency = (lowFrequency + highFrequency) / 2.f;
+
+    downconverter->phaseIncrement = 2.0 * M_PI * downconverter->centreFrequency / sampleRate;
+    downconverter->stepRe = (float)cos(downconverter->phaseIncrement);
+    downconverter->stepIm = (float)-sin(downconverter->phaseIncrement);
+    downconverter->oscRe = 1.f;
+    downconverter->oscIm = 0.f;
+
+    // A short first stage (its aliases are far from the band) then a sharper one at a lower rate
+    int first = decimation / 2;
+    if (decimatorSetup(&downconverter->stage[0], first, sampleRate, halfBand) != 0
+        || decimatorSetup(&downconverter->stage[1], 2, (double)sampleRate / first, halfBand) != 0) {
+        sfDownconverterDestroy(downconverter);
+        return NULL;
+    }
+
+    sfDownconverterReset(downconverter);
+    return downconverter;
+}
+
+
+void sfDownconverterDestroy(SFDownconverter *downconverter)
+{
+    if (downconverter == NULL)
+        return;
+    decimatorDestroy(&downconverter->stage[0]);
+    decimatorDestroy(&downconverter->stage[1]);
+    free(downconverter);
+}
+
+
+void sfDownconverterReset(SFDownconverter *downconverter)
+{
+    for (int s = 0; s < 2; s++) {
+        struct SFDecimator *stage = &downconverter->stage[s];
+        memset(stage->lineRe, 0, 2 * stage->tapCount * sizeof(float));
+        memset(stage->lineIm, 0, 2 * stage->tapCount * sizeof(float));
+        stage->position = 0;
+        stage->phase = stage->factor;
+    }
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * DecimatorPush
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Push one complex sample in a stage, return 1 and the filtered sample when it's one we keep. */
+static int decimatorPush(struct SFDecimator *stage, float re, float im, float *outRe, float *outIm)
+{
+    const int tapCount = stage->tapCount;
+
+    stage->lineRe[stage->position] = re;
+    stage->lineRe[stage->position + tapCount] = re;
+    stage->lineIm[stage->position] = im;
+    stage->lineIm[stage->position + tapCount] = im;
+    if (++stage->position == tapCount)
+        stage->position = 0;
+
+    if (--stage->phase > 0)
+        return 0;
+    stage->phase = stage->factor;
+
+    // The window starts with the oldest sample, the taps are symmetric
+    const float *restrict lineRe = stage->lineRe + stage->position;
+    const float *restrict lineIm = stage->lineIm + stage->position;
+    const float *restrict taps = stage->taps;
+    float sumRe = 0, sumIm = 0;
+    for (int k = 0; k < tapCount; k++) {
+        sumRe += taps[k] * lineRe[k];
+        sumIm += taps[k] * lineIm[k];
+    }
+    *outRe = sumRe;
+    *outIm = sumIm;
+    return 1;
+}
+
+
+int sfDownconverterProcessFloat(SFDownconverter *downconverter, const float *samples, int count, float *outRe, float *outIm)
+{
+    float oscRe = downconverter->oscRe;
+    float oscIm = downconverter->oscIm;
+    const float stepRe = downconverter->stepRe;
+    const float stepIm = downconverter->stepIm;
+    int written = 0;
+
+    for (int i = 0; i < count; i++) {
+        float re, im;
+
+        // x * e^-j*phase, then turn the oscillator
+        if (decimatorPush(&downconverter->stage[0], samples[i] * oscRe, samples[i] * oscIm, &re, &im)
+            && decimatorPush(&downconverter->stage[1], re, im, &outRe[written], &outIm[written]))
+            written++;
+
+        float next = oscRe * stepRe - oscIm * stepIm;
+        oscIm = oscRe * stepIm + oscIm * stepRe;
+        oscRe = next;
+    }
+
+    // Keep the rotator on the unit circle, the float error would change its amplitude in the long run
+    float norm = 1.f / sqrtf(oscRe * oscRe + oscIm * oscIm);
+    downconverter->oscRe = oscRe * norm;
+    downconverter->oscIm = oscIm * norm;
+    return written;
+}
+
+
+int sfDownconverterProcessInt16(SFDownconverter *downconverter, const int16_t *samples, int count, float *outRe, float *outIm)
+{
+    float buffer[256];
+    int written = 0;
+
+    // Convert by small chunks on the stack, no allocation in the audio thread
+    while (count > 0) {
+        int chunk = count < 256 ? count : 256;
+        for (int i = 0; i < chunk; i++)
+            buffer[i] = (float)samples[i];
+        written += sfDownconverterProcessFloat(downconverter, buffer, chunk, outRe + written, outIm + written);
+        samples += chunk;
+        count -= chunk;
+    }
+    return written;
+}
@@ -0,0 +1,81 @@
+//
+//  SFDownconverter.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFDownconverter_h
+#define SoundFi_SFDownconverter_h
+
+#include <stdint.h>
+
+#define SF_BASEBAND_LOW_FREQUENCY   17000   // Band kept by the engine front end, every SoundFi tone is in it
+#define SF_BASEBAND_HIGH_FREQUENCY  21500
+#define SF_BASEBAND_DECIMATION      8       // 44100 -> 5512.5 Hz
+
+/**---------------------------------------------------------------------------------------
+ * SFDownconverter
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Bring an ultrasonic band down to a complex baseband stream at a lower sample rate.
+
+ Every SoundFi tone is between 17 and 21.5 kHz, the rest of the 44.1 kHz stream is useless for the detectors. The downconverter:
+
+ - mix the samples with a numerically controlled oscillator (a complex rotator) at the centre of the band, so the band is now centred on 0 Hz (a tone at f is at f - centreFrequency, the sign is kept because the output is complex),
+ - low pass filter and decimate in two stages (decimation/2 then 2), both are windowed sinc FIR computed only for the samples that are kept.
+
+ Once decimated by 8 the stream is at 5512.5 Hz, so a detector need 8 times less samples for the same frequency resolution (a 256 points transform give the 21.5 Hz bins of a 2048 points one).
+
+ Like the other objects of the core the state is in the instance, one downconverter for each stream.
+ */
+typedef struct SFDownconverter {
+    float       sampleRate;         // input rate
+    float       outputRate;         // sampleRate/decimation
+    float       centreFrequency;    // NCO frequency, becomes 0 Hz
+    int         decimation;
+
+    // NCO
+    double      phaseIncrement;
+    float       oscRe;              // e^-j*phase
+    float       oscIm;
+    float       stepRe;             // e^-j*phaseIncrement
+    float       stepIm;
+
+    // Decimation stages: stage[0] by decimation/2, stage[1] by 2
+    struct SFDecimator {
+        int     factor;
+        int     tapCount;
+        float   *taps;
+        float   *lineRe;            // 2*tapCount, each sample written twice so the window is contiguous
+        float   *lineIm;
+        int     position;
+        int     phase;              // samples before the next output
+    } stage[2];
+} SFDownconverter;
+
+
+/** Create a downconverter.
+
+ @param sampleRate Input sample rate
+ @param lowFrequency Lower edge of the band to keep
+ @param highFrequency Upper edge of the band to keep
+ @param decimation Decimation factor, even (SF_BASEBAND_DECIMATION in the engine). sampleRate/decimation must be greater than the bandwidth.
+ @return The downconverter or NULL if the parameters are wrong or there is not enough memory
+ */
+SFDownconverter *sfDownconverterCreate(float sampleRate, float lowFrequency, float highFrequency, int decimation);
+void sfDownconverterDestroy(SFDownconverter *downconverter);
+
+/** Forget the filter history (the NCO is not reset) */
+void sfDownconverterReset(SFDownconverter *downconverter);
+
+/** Downconvert count input samples.
+
+ @param outRe Receive the real part of the baseband samples, must hold count/decimation+1 floats
+ @param outIm Receive the imaginary part
+ @return The number of baseband samples written
+ */
+int sfDownconverterProcessFloat(SFDownconverter *downconverter, const float *samples, int count, float *outRe, float *outIm);
+int sfDownconverterProcessInt16(SFDownconverter *downconverter, const int16_t *samples, int count, float *outRe, float *outIm);
+
+#endif
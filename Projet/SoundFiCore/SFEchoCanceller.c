@@ -0,0 +1,116 @@
+//
+//  SFEchoCanceller.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SFEchoCanceller.h"
+
+
+SFEchoCanceller *sfEchoCancellerCreate(int tapCount, int delay, float step)
+{
+    if (tapCount < 1 || delay < 0 || step <= 0 || step >= 2)
+        return NULL;
+
+    SFEchoCanceller *canceller = calloc(1, sizeof(SFEchoCanceller));
+    if (canceller == NULL)
+        return NULL;
+
+    canceller->tapCount = tapCount;
+    canceller->delay = delay;
+    canceller->step = step;
+    canceller->historyLength = delay + tapCount;
+    canceller->weights = calloc(tapCount, sizeof(float));
+    canceller->history = calloc(2 * canceller->historyLength, sizeof(float));
+    if (!canceller->weights || !canceller->history) {
+        sfEchoCancellerDestroy(canceller);
+        return NULL;
+    }
+    return canceller;
+}
+
+
+void sfEchoCancellerDestroy(SFEchoCanceller *canceller)
+{
+    if (canceller == NULL)
+        return;
+    free(canceller->weights);
+    free(canceller->history);
+    free(canceller);
+}
+
+
+void sfEchoCancellerReset(SFEchoCanceller *canceller)
+{
+    memset(canceller->weights, 0, canceller->tapCount * sizeof(float));
+    memset(canceller->history, 0, 2 * canceller->historyLength * sizeof(float));
+    canceller->position = 0;
+    canceller->power = 0;
+    canceller->inputEnergy = 0;
+    canceller->outputEnergy = 0;
+}
+
+
+void sfEchoCancellerProcess(SFEchoCanceller *canceller, const float *reference, int16_t *samples, int count)
+{
+    const int taps = canceller->tapCount;
+    const int length = canceller->historyLength;
+    float *weights = canceller->weights;
+    float *history = canceller->history;
+    float eps = taps * SF_ECHO_MIN_POWER;
+    double inputEnergy = 0, outputEnergy = 0;
+
+    // The running energy drifts with the rounding, it is computed again for each call
+    double power = 0;
+    const float *window = history + canceller->position + 1;
+    for (int k = 0; k < taps; k++)
+        power += window[k] * window[k];
+
+    for (int n = 0; n < count; n++) {
+        int position = canceller->position;
+        float x = reference ? reference[n] : 0.f;
+
+        // The oldest sample of the history leaves the window, the one delay samples ago enters it
+        float leaving = history[position];
+        history[position] = history[position + length] = x;
+        window = history + position + 1;
+        float entering = window[taps - 1];
+        power += entering * entering - leaving * leaving;
+        if (power < 0)
+            power = 0;
+
+        float echo = 0;
+        for (int k = 0; k < taps; k++)
+            echo += weights[k] * window[k];
+
+        float microphone = samples[n];
+        float error = microphone - echo;
+        float update = canceller->step * error / ((float)power + eps);
+        if (power > 0)
+            for (int k = 0; k < taps; k++)
+                weights[k] += update * window[k];
+
+        float output = error > 32767.f ? 32767.f : (error < -32768.f ? -32768.f : error);
+        samples[n] = (int16_t)lrintf(output);
+        inputEnergy += microphone * microphone;
+        outputEnergy += output * output;
+
+        canceller->position = position + 1 < length ? position + 1 : 0;
+    }
+    canceller->power = power;
+    canceller->inputEnergy = SF_ECHO_ENERGY_DECAY * canceller->inputEnergy + inputEnergy;
+    canceller->outputEnergy = SF_ECHO_ENERGY_DECAY * canceller->outputEnergy + outputEnergy;
+}
+
+
+float sfEchoCancellerAttenuation(const SFEchoCanceller *canceller)
+{
+    if (canceller->inputEnergy <= 0)
+        return 0;
+    return (float)(10.0 * log10(canceller->inputEnergy / (canceller->outputEnergy + 1e-9)));
+}
@@ -0,0 +1,72 @@
+//
+//  SFEchoCanceller.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFEchoCanceller_h
+#define SoundFi_SFEchoCanceller_h
+
+#include <stdint.h>
+
+#define SF_ECHO_DEFAULT_TAPS        256     // 5.8 ms at 44.1 kHz after the bulk delay
+#define SF_ECHO_DEFAULT_STEP        0.05f   // NLMS step, 0 < step < 2
+#define SF_ECHO_MIN_POWER           1e-6f   // regularisation per tap, the reference is in [-1, 1]
+#define SF_ECHO_ENERGY_DECAY        0.9     // smoothing of the attenuation, per call of sfEchoCancellerProcess
+
+/**---------------------------------------------------------------------------------------
+ * SFEchoCanceller
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Remove the emission of the device from its own microphone (full duplex).
+
+ When the device sends and listens at the same time (the full duplex modes of SFMultiTone.h), the microphone hears the loudspeaker tens of dB above the other device. The two are not in the same part of the band, but the emission is so loud that its side lobes and the distortion of the speaker still cover the other device. The canceller knows what was sent (the reference, the samples given to the loudspeaker) and learns the path to the microphone:
+
+ - the reference is delayed by the bulk delay (output + input latency), then filtered by an adaptive FIR of tapCount taps: this is the echo expected in the microphone,
+ - it is subtracted from the microphone, what is left is the other device and the noise,
+ - the taps are updated with the normalised LMS rule: w += step * error * x / (|x|² + eps), so the speed of the adaptation doesn't depend on the level of the emission.
+
+ There is no double talk detection: the other device is in another band, it is not correlated with the reference and only slows down the adaptation a little.
+
+ The delay must be a bit shorter than the real one: the taps cover [delay, delay + tapCount[ samples after the reference.
+ */
+typedef struct SFEchoCanceller {
+    int         tapCount;
+    int         delay;              // bulk delay in samples, before the first tap
+    float       step;
+    float       *weights;           // tapCount, weights[0] for the oldest reference sample of the window
+    float       *history;           // 2*historyLength, each sample written twice so the window is contiguous
+    int         historyLength;      // delay + tapCount
+    int         position;
+    double      power;              // energy of the reference in the window of the taps
+
+    double      inputEnergy;        // smoothed energy before and after the canceller
+    double      outputEnergy;
+} SFEchoCanceller;
+
+
+/** Create a canceller.
+
+ @param tapCount Length of the adaptive filter (SF_ECHO_DEFAULT_TAPS)
+ @param delay Bulk delay between the reference and the microphone, in samples
+ @param step NLMS step (SF_ECHO_DEFAULT_STEP)
+ @return The canceller or NULL if the parameters are wrong or there is not enough memory
+ */
+SFEchoCanceller *sfEchoCancellerCreate(int tapCount, int delay, float step);
+void sfEchoCancellerDestroy(SFEchoCanceller *canceller);
+
+/** Forget the reference and what was learned */
+void sfEchoCancellerReset(SFEchoCanceller *canceller);
+
+/** Subtract the echo of the reference from count samples of the microphone, in place.
+
+ @param reference The count samples sent at the same time as the microphone samples were recorded (before the delay), NULL for silence (the end of the last emission is still subtracted)
+ @param samples The microphone samples, replaced by the residual
+ */
+void sfEchoCancellerProcess(SFEchoCanceller *canceller, const float *reference, int16_t *samples, int count);
+
+/** Echo attenuation (ERLE) in dB over the last calls: the energy of the microphone against what is left */
+float sfEchoCancellerAttenuation(const SFEchoCanceller *canceller);
+
+#endif
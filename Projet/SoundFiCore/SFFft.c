@@ -0,0 +1,273 @@
+//
+//  SFFft.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SFFft.h"
+
+#if defined(__APPLE__)
+#include <Accelerate/Accelerate.h>
+
+struct SFFft {
+    int             log2n;
+    int             n;
+    FFTSetup        setup;
+    COMPLEX_SPLIT   split;
+};
+
+#else
+
+// A real FFT of size n is computed with a complex FFT of size n/2 on the
+// (even,odd) pairs of samples, then the two interleaved spectrums are separated.
+struct SFFft {
+    int             log2n;
+    int             n;
+    float           *zr;            // complex work buffer (n/2)
+    float           *zi;
+    float           *cosTable;      // e^-j2PIk/(n/2), k<n/4, for the complex FFT
+    float           *sinTable;
+    float           *splitCos;      // e^-j2PIk/n, k<=n/2, to separate the spectrums
+    float           *splitSin;
+    int             *bitReverse;
+};
+
+#endif
+
+
+int sfFftSize(const SFFft *fft)
+{
+    return fft->n;
+}
+
+
+#if defined(__APPLE__)
+
+SFFft *sfFftCreate(int log2n)
+{
+    SFFft *fft = calloc(1, sizeof(SFFft));
+    if (fft == NULL)
+        return NULL;
+
+    fft->log2n = log2n;
+    fft->n = 1 << log2n;
+    fft->setup = vDSP_create_fftsetup(log2n, FFT_RADIX2);
+    fft->split.realp = malloc(fft->n / 2 * sizeof(float));
+    fft->split.imagp = malloc(fft->n / 2 * sizeof(float));
+
+    if (fft->setup == NULL || !fft->split.realp || !fft->split.imagp) {
+        sfFftDestroy(fft);
+        return NULL;
+    }
+    return fft;
+}
+
+
+void sfFftDestroy(SFFft *fft)
+{
+    if (fft == NULL)
+        return;
+    if (fft->setup != NULL)
+        vDSP_destroy_fftsetup(fft->setup);
+    free(fft->split.realp);
+    free(fft->split.imagp);
+    free(fft);
+}
+
+
+void sfFftForward(SFFft *fft, const float *input, float *re, float *im)
+{
+    const int half = fft->n / 2;
+    const float scale = 0.5f;           // vDSP give 2*DFT
+
+    vDSP_ctoz((const DSPComplex *)input, 2, &fft->split, 1, half);
+    vDSP_fft_zrip(fft->setup, &fft->split, 1, fft->log2n, FFT_FORWARD);
+
+    vDSP_vsmul(fft->split.realp, 1, &scale, re, 1, half);
+    vDSP_vsmul(fft->split.imagp, 1, &scale, im, 1, half);
+
+    // DC and Nyquist are packed in the first bin
+    re[half] = im[0];
+    im[0] = 0;
+    im[half] = 0;
+}
+
+
+void sfFftInverse(SFFft *fft, const float *re, const float *im, float *output)
+{
+    const int half = fft->n / 2;
+    const float scale = 1.f / fft->n;
+
+    memcpy(fft->split.realp, re, half * sizeof(float));
+    memcpy(fft->split.imagp, im, half * sizeof(float));
+    fft->split.imagp[0] = re[half];
+
+    vDSP_fft_zrip(fft->setup, &fft->split, 1, fft->log2n, FFT_INVERSE);
+    vDSP_vsmul(fft->split.realp, 1, &scale, fft->split.realp, 1, half);
+    vDSP_vsmul(fft->split.imagp, 1, &scale, fft->split.imagp, 1, half);
+    vDSP_ztoc(&fft->split, 1, (DSPComplex *)output, 2, half);
+}
+
+#else
+
+SFFft *sfFftCreate(int log2n)
+{
+    SFFft *fft = calloc(1, sizeof(SFFft));
+    if (fft == NULL || log2n < 2) {
+        free(fft);
+        return NULL;
+    }
+
+    int n = 1 << log2n;
+    int half = n / 2;
+
+    fft->log2n = log2n;
+    fft->n = n;
+    fft->zr = malloc(half * sizeof(float));
+    fft->zi = malloc(half * sizeof(float));
+    fft->cosTable = malloc(half / 2 * sizeof(float));
+    fft->sinTable = malloc(half / 2 * sizeof(float));
+    fft->splitCos = malloc((half + 1) * sizeof(float));
+    fft->splitSin = malloc((half + 1) * sizeof(float));
+    fft->bitReverse = malloc(half * sizeof(int));
+
+    if (!fft->zr || !fft->zi || !fft->cosTable || !fft->sinTable || !fft->splitCos || !fft->splitSin || !fft->bitReverse) {
+        sfFftDestroy(fft);
+        return NULL;
+    }
+
+    for (int k = 0; k < half / 2; k++) {
+        fft->cosTable[k] = (float)cos(2.0 * M_PI * k / half);
+        fft->sinTable[k] = (float)-sin(2.0 * M_PI * k / half);
+    }
+    for (int k = 0; k <= half; k++) {
+        fft->splitCos[k] = (float)cos(2.0 * M_PI * k / n);
+        fft->splitSin[k] = (float)-sin(2.0 * M_PI * k / n);
+    }
+    for (int i = 0; i < half; i++) {
+        int r = 0;
+        for (int b = 0; b < log2n - 1; b++)
+            if (i & (1 << b)) r |= 1 << (log2n - 2 - b);
+        fft->bitReverse[i] = r;
+    }
+    return fft;
+}
+
+
+void sfFftDestroy(SFFft *fft)
+{
+    if (fft == NULL)
+        return;
+    free(fft->zr);
+    free(fft->zi);
+    free(fft->cosTable);
+    free(fft->sinTable);
+    free(fft->splitCos);
+    free(fft->splitSin);
+    free(fft->bitReverse);
+    free(fft);
+}
+
+
+/** In place radix 2 complex FFT of size n/2 on zr/zi (sign -1 forward, 1 inverse, not scaled) */
+static void complexFft(SFFft *fft, float sign)
+{
+    const int size = fft->n / 2;
+    float *zr = fft->zr;
+    float *zi = fft->zi;
+
+    for (int i = 0; i < size; i++) {
+        int j = fft->bitReverse[i];
+        if (i < j) {
+            float t = zr[i]; zr[i] = zr[j]; zr[j] = t;
+            t = zi[i]; zi[i] = zi[j]; zi[j] = t;
+        }
+    }
+
+    for (int le = 2; le <= size; le <<= 1) {
+        int le2 = le >> 1;
+        int step = size / le;
+        for (int j = 0; j < le2; j++) {
+            float wr = fft->cosTable[j * step];
+            float wi = -sign * fft->sinTable[j * step];
+            for (int i = j; i < size; i += le) {
+                int k = i + le2;
+                float tr = zr[k] * wr - zi[k] * wi;
+                float ti = zr[k] * wi + zi[k] * wr;
+                zr[k] = zr[i] - tr;
+                zi[k] = zi[i] - ti;
+                zr[i] += tr;
+                zi[i] += ti;
+            }
+        }
+    }
+}
+
+
+void sfFftForward(SFFft *fft, const float *input, float *re, float *im)
+{
+    const int half = fft->n / 2;
+    float *zr = fft->zr;
+    float *zi = fft->zi;
+
+    for (int m = 0; m < half; m++) {
+        zr[m] = input[2 * m];
+        zi[m] = input[2 * m + 1];
+    }
+
+    complexFft(fft, -1.f);
+
+    // X[k] = E[k] + W^k O[k] with E = (Z[k]+Z*[M-k])/2 and O = -j(Z[k]-Z*[M-k])/2
+    for (int k = 0; k <= half; k++) {
+        int a = k % half;
+        int b = (half - k) % half;
+        float er = 0.5f * (zr[a] + zr[b]);
+        float ei = 0.5f * (zi[a] - zi[b]);
+        float oddRe = 0.5f * (zi[a] + zi[b]);
+        float oddIm = -0.5f * (zr[a] - zr[b]);
+        float wr = fft->splitCos[k];
+        float wi = fft->splitSin[k];
+        re[k] = er + wr * oddRe - wi * oddIm;
+        im[k] = ei + wr * oddIm + wi * oddRe;
+    }
+    im[0] = 0;
+    im[half] = 0;
+}
+
+
+void sfFftInverse(SFFft *fft, const float *re, const float *im, float *output)
+{
+    const int half = fft->n / 2;
+    float *zr = fft->zr;
+    float *zi = fft->zi;
+
+    // E = (X[k]+X*[M-k])/2, O = (X[k]-X*[M-k])/(2W^k), Z = E + jO
+    for (int k = 0; k < half; k++) {
+        int b = half - k;
+        float er = 0.5f * (re[k] + re[b]);
+        float ei = 0.5f * (im[k] - im[b]);
+        float dr = 0.5f * (re[k] - re[b]);
+        float di = 0.5f * (im[k] + im[b]);
+        float wr = fft->splitCos[k];
+        float wi = -fft->splitSin[k];           // 1/W^k = conj(W^k)
+        float oddRe = dr * wr - di * wi;
+        float oddIm = dr * wi + di * wr;
+        zr[k] = er - oddIm;
+        zi[k] = ei + oddRe;
+    }
+
+    complexFft(fft, 1.f);
+
+    const float scale = 1.f / half;
+    for (int m = 0; m < half; m++) {
+        output[2 * m] = zr[m] * scale;
+        output[2 * m + 1] = zi[m] * scale;
+    }
+}
+
+#endif
@@ -0,0 +1,36 @@
+//
+//  SFFft.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFFft_h
+#define SoundFi_SFFft_h
+
+/**---------------------------------------------------------------------------------------
+ * SFFft
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Real FFT used by the portable part of the engine.
+
+ On Apple platforms this is a thin wrapper on vDSP_fft_zrip (Accelerate), anywhere else (Linux tools) it use a radix 2 FFT derived from smbFft. Both give the same result: the true DFT, without the factor 2 of vDSP.
+
+ The spectrum is returned as n/2+1 bins, re[0] is the DC and re[n/2] the Nyquist frequency (their imaginary part is 0).
+ */
+typedef struct SFFft SFFft;
+
+/** Create the setup for a 2^log2n real FFT */
+SFFft *sfFftCreate(int log2n);
+void sfFftDestroy(SFFft *fft);
+
+/** Size of the FFT (in samples) */
+int sfFftSize(const SFFft *fft);
+
+/** Forward transform of n real samples into n/2+1 complex bins (re and im must hold n/2+1 floats). input is not modified. */
+void sfFftForward(SFFft *fft, const float *input, float *re, float *im);
+
+/** Inverse transform of n/2+1 bins into n real samples, scaled so that sfFftInverse(sfFftForward(x)) == x. re and im are not modified. */
+void sfFftInverse(SFFft *fft, const float *re, const float *im, float *output);
+
+#endif
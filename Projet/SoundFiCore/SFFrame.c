@@ -0,0 +1,60 @@
+//
+//  SFFrame.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stddef.h>
+
+#include "SFFrame.h"
+
+#define SF_FRAME_CRC_POLYNOMIAL     0x1021
+#define SF_FRAME_CRC_INIT           0xFFFF
+
+
+uint16_t sfFrameCrc(uint16_t crc, const char *bytes, int length)
+{
+    for (int i = 0; i < length; i++) {
+        crc ^= (uint16_t)((unsigned char)bytes[i] << 8);
+        for (int bit = 0; bit < 8; bit++)
+            crc = crc & 0x8000 ? (uint16_t)((crc << 1) ^ SF_FRAME_CRC_POLYNOMIAL) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+
+/** CRC of the type and length bytes of a header, then of the payload */
+static uint16_t frameCrc(const char *header, const char *payload, int length)
+{
+    return sfFrameCrc(sfFrameCrc(SF_FRAME_CRC_INIT, header, 2), payload, length);
+}
+
+
+void sfFrameEncodeHeader(SFFrameType type, const char *payload, int length, char *header)
+{
+    header[0] = (char)((type << 4) | ((length >> 8) & 0x0F));
+    header[1] = (char)(length & 0xFF);
+
+    uint16_t crc = frameCrc(header, payload, length);
+    header[2] = (char)(crc >> 8);
+    header[3] = (char)(crc & 0xFF);
+}
+
+
+int sfFrameParseHeader(const char *header, SFFrameType *type)
+{
+    int frameType = (unsigned char)header[0] >> 4;
+    if (frameType >= SFFrameTypeCount)
+        return -1;
+    if (type != NULL)
+        *type = frameType;
+    return (((unsigned char)header[0] & 0x0F) << 8) | (unsigned char)header[1];
+}
+
+
+int sfFrameCheck(const char *header, const char *payload, int length)
+{
+    uint16_t crc = ((unsigned char)header[2] << 8) | (unsigned char)header[3];
+    return frameCrc(header, payload, length) == crc;
+}
@@ -0,0 +1,61 @@
+//
+//  SFFrame.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+// The frame of the multi tone messages. The payload follows a binary header:
+//
+//   byte 0     type (4 bits) and length bits 11..8
+//   byte 1     length bits 7..0
+//   byte 2..3  CRC-16 (CCITT, 0x1021, initial value 0xFFFF) of the bytes 0..1 and of the payload
+//
+// The receiver knows the length of the message after the header, so it ends it
+// on its last symbol without waiting for a stop tone or a time out, and a frame
+// whose CRC doesn't match is dropped before anything is given to the
+// application. The single tone messaging ("init:" ... ":stop") is not framed.
+
+#ifndef SoundFi_SFFrame_h
+#define SoundFi_SFFrame_h
+
+#include <stdint.h>
+
+#define SF_FRAME_HEADER_LENGTH      4       // bytes of the header
+#define SF_FRAME_MAX_LENGTH         4095    // bytes of a payload, 12 bits
+#define SF_FRAME_HEADER_PARITY      8       // Reed-Solomon parity of the header in a coded mode, it corrects 4 bytes
+
+enum {
+    SFFrameTypeMessage = 0,                 // text for messageReceived
+    SFFrameTypePayment,                     // a step of the payment, for transactionUpdate
+    SFFrameTypeData,                        // bytes that are not text (a ciphertext...), for dataReceived
+    SFFrameTypeCount
+};
+typedef int SFFrameType;
+
+/** Continue a CRC-16 CCITT over bytes, start with 0xFFFF */
+uint16_t sfFrameCrc(uint16_t crc, const char *bytes, int length);
+
+/** Write the header of a payload.
+
+ @param length Bytes of payload, SF_FRAME_MAX_LENGTH at most
+ @param header Receive SF_FRAME_HEADER_LENGTH bytes
+ */
+void sfFrameEncodeHeader(SFFrameType type, const char *payload, int length, char *header);
+
+/** Read a received header.
+
+ @param type Receive the type of the frame (may be NULL)
+ @return The length of the payload, -1 if the type is unknown
+ */
+int sfFrameParseHeader(const char *header, SFFrameType *type);
+
+/** Check the CRC of a received frame.
+
+ @param header The header, as received
+ @param payload The payload, sfFrameParseHeader bytes
+ @return 1 if the CRC of the header match the frame, 0 otherwise
+ */
+int sfFrameCheck(const char *header, const char *payload, int length);
+
+#endif
@@ -0,0 +1,375 @@
+//
+//  SFLexicon.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "SFLexicon.h"
+
+#define SF_LEXICON_COST_EPSILON     1e-4f   // two costs closer than that are equal
+
+
+static inline int lowerCase(int caracter)
+{
+    return caracter >= 'A' && caracter <= 'Z' ? caracter - 'A' + 'a' : caracter;
+}
+
+static inline int isWordCaracter(int caracter)
+{
+    return (caracter >= 'a' && caracter <= 'z') || (caracter >= 'A' && caracter <= 'Z') || (caracter >= '0' && caracter <= '9');
+}
+
+static int compareWords(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+
+#pragma mark - Vocabulary
+
+SFLexicon *sfLexiconCreate(const char *const *words, int count)
+{
+    SFLexicon *lexicon = calloc(1, sizeof(SFLexicon));
+    char **sorted = calloc(count > 0 ? count : 1, sizeof(char *));
+    int wordCount = 0, caracters = 0;
+
+    if (lexicon == NULL || sorted == NULL)
+        goto failed;
+
+    // The words in lower case, sorted: the words of a prefix follow each other, the prefix itself first
+    for (int i = 0; i < count; i++) {
+        int length = (int)strlen(words[i]);
+        if (length < SF_LEXICON_MIN_WORD || length > SF_LEXICON_MAX_WORD)
+            continue;
+        char *word = malloc(length + 1);
+        if (word == NULL)
+            goto failed;
+        for (int k = 0; k <= length; k++)
+            word[k] = (char)lowerCase((unsigned char)words[i][k]);
+        sorted[wordCount++] = word;
+        caracters += length;
+    }
+    qsort(sorted, wordCount, sizeof(char *), compareWords);
+
+    // One node per caracter at most, plus the root. The children of node i are found when i is reached,
+    // so the nodes are in breadth first order and the children of a node are together.
+    int capacity = caracters + 1;
+    SFLexiconNode *nodes = calloc(capacity, sizeof(SFLexiconNode));
+    int *first = malloc(capacity * sizeof(int));        // words of the node: [first, last[
+    int *last = malloc(capacity * sizeof(int));
+    int *depth = malloc(capacity * sizeof(int));
+    lexicon->nodes = nodes;
+    if (nodes == NULL || first == NULL || last == NULL || depth == NULL) {
+        free(first);
+        free(last);
+        free(depth);
+        goto failed;
+    }
+
+    int nodeCount = 1;
+    first[0] = 0;
+    last[0] = wordCount;
+    depth[0] = 0;
+    lexicon->wordCount = 0;
+    for (int n = 0; n < nodeCount; n++) {
+        int d = depth[n], w = first[n];
+        while (w < last[n] && sorted[w][d] == '\0') {
+            if (!nodes[n].terminal)
+                lexicon->wordCount++;
+            nodes[n].terminal = 1;                      // the duplicates too
+            w++;
+        }
+        nodes[n].firstChild = nodeCount;
+        while (w < last[n]) {
+            char caracter = sorted[w][d];
+            int child = nodeCount++;
+            nodes[child].caracter = (uint8_t)caracter;
+            first[child] = w;
+            depth[child] = d + 1;
+            while (w < last[n] && sorted[w][d] == caracter)
+                w++;
+            last[child] = w;
+            nodes[n].childCount++;
+        }
+    }
+    lexicon->nodeCount = nodeCount;
+
+    free(first);
+    free(last);
+    free(depth);
+    for (int i = 0; i < wordCount; i++)
+        free(sorted[i]);
+    free(sorted);
+    return lexicon;
+
+failed:
+    if (sorted != NULL)
+        for (int i = 0; i < wordCount; i++)
+            free(sorted[i]);
+    free(sorted);
+    sfLexiconDestroy(lexicon);
+    return NULL;
+}
+
+
+SFLexicon *sfLexiconOpen(const char *path)
+{
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+        return NULL;
+
+    struct stat status;
+    void *mapping = MAP_FAILED;
+    if (fstat(file, &status) == 0 && status.st_size >= (off_t)sizeof(SFLexiconHeader))
+        mapping = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED)
+        return NULL;
+
+    const SFLexiconHeader *header = mapping;
+    size_t length = (size_t)status.st_size;
+    SFLexicon *lexicon = NULL;
+    if (!memcmp(header->magic, SF_LEXICON_MAGIC, 4) && header->version == SF_LEXICON_VERSION && header->nodeCount > 0 &&
+        length == sizeof(SFLexiconHeader) + (size_t)header->nodeCount * sizeof(SFLexiconNode))
+        lexicon = calloc(1, sizeof(SFLexicon));
+    if (lexicon == NULL) {
+        munmap(mapping, length);
+        return NULL;
+    }
+
+    lexicon->nodes = (const SFLexiconNode *)(header + 1);
+    lexicon->nodeCount = (int)header->nodeCount;
+    lexicon->wordCount = (int)header->wordCount;
+    lexicon->mapping = mapping;
+    lexicon->mappingLength = length;
+    return lexicon;
+}
+
+
+void sfLexiconDestroy(SFLexicon *lexicon)
+{
+    if (lexicon == NULL)
+        return;
+    if (lexicon->mapping != NULL)
+        munmap(lexicon->mapping, lexicon->mappingLength);
+    else
+        free((void *)lexicon->nodes);
+    free(lexicon);
+}
+
+
+int sfLexiconWrite(const SFLexicon *lexicon, const char *path)
+{
+    SFLexiconHeader header;
+    memcpy(header.magic, SF_LEXICON_MAGIC, 4);
+    header.version = SF_LEXICON_VERSION;
+    header.nodeCount = (uint32_t)lexicon->nodeCount;
+    header.wordCount = (uint32_t)lexicon->wordCount;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return -1;
+    int written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  fwrite(lexicon->nodes, sizeof(SFLexiconNode), lexicon->nodeCount, file) == (size_t)lexicon->nodeCount;
+    return fclose(file) == 0 && written ? 0 : -1;
+}
+
+
+/** Child of node for a caracter, -1 if there is none */
+static int findChild(const SFLexicon *lexicon, const SFLexiconNode *node, int caracter)
+{
+    const SFLexiconNode *children = lexicon->nodes + node->firstChild;
+    int low = 0, high = node->childCount - 1;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        if (children[middle].caracter == caracter)
+            return (int)node->firstChild + middle;
+        if (children[middle].caracter < caracter)
+            low = middle + 1;
+        else
+            high = middle - 1;
+    }
+    return -1;
+}
+
+
+int sfLexiconContains(const SFLexicon *lexicon, const char *word, int length)
+{
+    int node = 0;
+    for (int i = 0; i < length && node >= 0; i++)
+        node = findChild(lexicon, &lexicon->nodes[node], lowerCase((unsigned char)word[i]));
+    return node >= 0 && lexicon->nodes[node].terminal;
+}
+
+
+#pragma mark - Correction
+
+typedef struct {
+    const SFLexicon *lexicon;
+    uint8_t     word[SF_LEXICON_MAX_WORD];  // received, lower case
+    int         length;
+    float       insertion[SF_LEXICON_MAX_WORD];             // cost of word[j] as an extra caracter
+    float       rows[SF_LEXICON_MAX_WORD + 1][SF_LEXICON_MAX_WORD + 1];   // rows[d][j]: the d first caracters of the prefix to the j first of word
+    char        prefix[SF_LEXICON_MAX_WORD];
+    float       budget;
+    float       best;
+    char        bestWord[SF_LEXICON_MAX_WORD];
+    int         bestLength;
+    int         ties;                       // other words at the best cost
+} SFLexiconSearch;
+
+
+/** Cost of the sent caracter sent read as received */
+static inline float substitutionCost(int sent, int received)
+{
+    if (sent == received)
+        return 0;
+    return sent - received == 1 || received - sent == 1 ? SF_LEXICON_NEIGHBOUR_COST : SF_LEXICON_EDIT_COST;
+}
+
+
+/** The prefix of depth caracters is a word at this cost */
+static void addCandidate(SFLexiconSearch *search, int depth, float cost)
+{
+    if (cost < search->best - SF_LEXICON_COST_EPSILON) {
+        search->best = cost;
+        search->ties = 0;
+        memcpy(search->bestWord, search->prefix, depth);
+        search->bestLength = depth;
+    }
+    else if (cost <= search->best + SF_LEXICON_COST_EPSILON)
+        search->ties++;
+}
+
+
+/** Children of the node whose prefix has depth caracters: the row of each one from the row of its parent */
+static void searchChildren(SFLexiconSearch *search, int nodeIndex, int depth)
+{
+    const SFLexiconNode *node = &search->lexicon->nodes[nodeIndex];
+    const int length = search->length;
+    const float *parent = search->rows[depth];
+    float *row = search->rows[depth + 1];
+
+    if (depth >= SF_LEXICON_MAX_WORD)
+        return;
+
+    for (int c = 0; c < node->childCount; c++) {
+        int childIndex = (int)node->firstChild + c;
+        const SFLexiconNode *child = &search->lexicon->nodes[childIndex];
+        int caracter = child->caracter;
+        float deletion = depth > 0 && (uint8_t)search->prefix[depth - 1] == caracter ? SF_LEXICON_REPEAT_COST : SF_LEXICON_EDIT_COST;
+
+        search->prefix[depth] = (char)caracter;
+        row[0] = parent[0] + deletion;
+        float lowest = row[0];
+        for (int j = 1; j <= length; j++) {
+            float cost = parent[j - 1] + substitutionCost(caracter, search->word[j - 1]);
+            if (parent[j] + deletion < cost)
+                cost = parent[j] + deletion;
+            if (row[j - 1] + search->insertion[j - 1] < cost)
+                cost = row[j - 1] + search->insertion[j - 1];
+            row[j] = cost;
+            if (cost < lowest)
+                lowest = cost;
+        }
+
+        if (child->terminal && row[length] <= search->budget)
+            addCandidate(search, depth + 1, row[length]);
+        if (lowest <= search->budget)
+            searchChildren(search, childIndex, depth + 1);
+    }
+}
+
+
+int sfLexiconCorrect(const SFLexicon *lexicon, const char *word, int length, char *corrected, float *cost)
+{
+    if (length < SF_LEXICON_MIN_WORD || length > SF_LEXICON_MAX_WORD)
+        return -1;
+    if (sfLexiconContains(lexicon, word, length)) {
+        memcpy(corrected, word, length);
+        if (cost != NULL)
+            *cost = 0;
+        return length;
+    }
+
+    SFLexiconSearch search;
+    search.lexicon = lexicon;
+    search.length = length;
+    search.budget = length * SF_LEXICON_COST_PER_CARACTER < SF_LEXICON_MAX_COST ? length * SF_LEXICON_COST_PER_CARACTER : SF_LEXICON_MAX_COST;
+    search.best = search.budget + 1;
+    search.bestLength = 0;
+    search.ties = 0;
+    search.rows[0][0] = 0;
+    for (int j = 0; j < length; j++) {
+        search.word[j] = (uint8_t)lowerCase((unsigned char)word[j]);
+        search.insertion[j] = j > 0 && search.word[j] == search.word[j - 1] ? SF_LEXICON_REPEAT_COST : SF_LEXICON_EDIT_COST;
+        search.rows[0][j + 1] = search.rows[0][j] + search.insertion[j];
+    }
+    searchChildren(&search, 0, 0);
+
+    if (search.best > search.budget || search.ties > 0)
+        return -1;
+
+    // The case of the received word: all in capitals, a capital first or nothing
+    int capitals = 0, letters = 0;
+    for (int j = 0; j < length; j++) {
+        if (word[j] >= 'A' && word[j] <= 'Z')
+            capitals++;
+        if (isWordCaracter((unsigned char)word[j]) && !(word[j] >= '0' && word[j] <= '9'))
+            letters++;
+    }
+    int upper = letters > 1 && capitals == letters;
+    for (int k = 0; k < search.bestLength; k++) {
+        char caracter = search.bestWord[k];
+        if ((upper || (k == 0 && word[0] >= 'A' && word[0] <= 'Z')) && caracter >= 'a' && caracter <= 'z')
+            caracter = caracter - 'a' + 'A';
+        corrected[k] = caracter;
+    }
+    if (cost != NULL)
+        *cost = search.best;
+    return search.bestLength;
+}
+
+
+int sfLexiconCorrectText(const SFLexicon *lexicon, const char *text, int length, char *corrected, int capacity)
+{
+    char word[SF_LEXICON_MAX_WORD];
+    int written = 0;
+
+    for (int i = 0; i < length;) {
+        if (!isWordCaracter((unsigned char)text[i])) {
+            if (written < capacity)
+                corrected[written++] = text[i];
+            i++;
+            continue;
+        }
+
+        int start = i;
+        while (i < length && isWordCaracter((unsigned char)text[i]))
+            i++;
+        const char *result = text + start;
+        int resultLength = sfLexiconCorrect(lexicon, result, i - start, word, NULL);
+        if (resultLength >= 0)
+            result = word;
+        else
+            resultLength = i - start;
+
+        if (resultLength > capacity - written)
+            resultLength = capacity - written;
+        memcpy(corrected + written, result, resultLength);
+        written += resultLength;
+    }
+
+    if (written < capacity)
+        corrected[written] = '\0';
+    return written;
+}
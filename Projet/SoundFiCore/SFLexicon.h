@@ -0,0 +1,104 @@
+//
+//  SFLexicon.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFLexicon_h
+#define SoundFi_SFLexicon_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SF_LEXICON_MAX_WORD         32      // longer words are never corrected
+#define SF_LEXICON_MIN_WORD         2       // shorter ones neither
+#define SF_LEXICON_NEIGHBOUR_COST   0.25f   // a caracter read as the one of the next tone (±18 Hz, ±1 in the ASCII table)
+#define SF_LEXICON_REPEAT_COST      0.5f    // a double letter lost or a caracter kept once more by phase 5
+#define SF_LEXICON_EDIT_COST        1.f     // any other substitution, missing or extra caracter
+#define SF_LEXICON_COST_PER_CARACTER 0.2f   // cost allowed for a correction, per caracter of the received word (an edit from 5 caracters)
+#define SF_LEXICON_MAX_COST         1.5f    // and at most
+#define SF_LEXICON_MAGIC            "SFLX"
+#define SF_LEXICON_VERSION          1
+
+/**---------------------------------------------------------------------------------------
+ * SFLexicon
+ *  ---------------------------------------------------------------------------------------
+ */
+/** The vocabulary of the domain (store names, product words, URL tokens) and the correction of the received words against it, the phase 6 of the analysis.
+
+ The words are in a trie whose nodes are in one array, the children of a node follow each other sorted by caracter: the array is written as is in a file (sfLexiconWrite, the sflexicon tool) and the file is mapped in memory by sfLexiconOpen, there is nothing to parse or to allocate at the start. The words are stored in lower case, the search ignores the case of the letters and the correction keeps the case of the received word.
+
+ A received word is corrected to the word of the vocabulary at the lowest edit distance, the distance being weighted by the errors the single tone receiver really makes:
+
+ - a caracter read as its neighbour in the band plan (±18 Hz) costs SF_LEXICON_NEIGHBOUR_COST, the detectors mix up adjacent tones far more often than any other pair,
+ - a double letter lost or a caracter repeated once more (phase 5 counts the repetitions) costs SF_LEXICON_REPEAT_COST,
+ - anything else costs SF_LEXICON_EDIT_COST.
+
+ The search walks the trie with one row of the distance matrix per depth, a branch is left as soon as its whole row is over the allowed cost (SF_LEXICON_COST_PER_CARACTER per caracter, SF_LEXICON_MAX_COST at most): a word takes a few microseconds. A word that is not close to any word of the vocabulary is not changed (a product code or a name it doesn't know), nor a word that is as close to two of them.
+
+ The trie can be shared by several threads, the search doesn't allocate memory.
+ */
+typedef struct SFLexiconNode {
+    uint32_t    firstChild;                 // index of the first child, the others follow
+    uint16_t    childCount;
+    uint8_t     caracter;                   // last caracter of the prefix of the node, lower case
+    uint8_t     terminal;                   // the prefix is a word
+} SFLexiconNode;
+
+typedef struct SFLexiconHeader {
+    char        magic[4];                   // SF_LEXICON_MAGIC
+    uint32_t    version;                    // SF_LEXICON_VERSION
+    uint32_t    nodeCount;                  // then the nodes, native byte order, the root first
+    uint32_t    wordCount;
+} SFLexiconHeader;
+
+typedef struct SFLexicon {
+    const SFLexiconNode *nodes;
+    int         nodeCount;
+    int         wordCount;
+    void        *mapping;                   // the file mapped by sfLexiconOpen, NULL for sfLexiconCreate
+    size_t      mappingLength;
+} SFLexicon;
+
+
+/** Build a vocabulary in memory.
+
+ @param words The words, in any order and case, duplicates allowed. The ones shorter than SF_LEXICON_MIN_WORD or longer than SF_LEXICON_MAX_WORD are ignored.
+ @return The vocabulary or NULL
+ */
+SFLexicon *sfLexiconCreate(const char *const *words, int count);
+
+/** Map a vocabulary written by sfLexiconWrite.
+
+ @return The vocabulary or NULL if the file can't be read or is not a vocabulary
+ */
+SFLexicon *sfLexiconOpen(const char *path);
+void sfLexiconDestroy(SFLexicon *lexicon);
+
+/** Write a vocabulary in a file for sfLexiconOpen.
+
+ @return 0, -1 if the file can't be written
+ */
+int sfLexiconWrite(const SFLexicon *lexicon, const char *path);
+
+/** Tell if a word is in the vocabulary, whatever its case */
+int sfLexiconContains(const SFLexicon *lexicon, const char *word, int length);
+
+/** Correct one word.
+
+ @param corrected Receive the corrected word, SF_LEXICON_MAX_WORD caracters at most, not NUL terminated
+ @param cost Receive the cost of the correction, 0 for a word of the vocabulary (may be NULL)
+ @return The length of corrected, -1 if the word is left as it is (not close to the vocabulary, ambiguous, too short or too long)
+ */
+int sfLexiconCorrect(const SFLexicon *lexicon, const char *word, int length, char *corrected, float *cost);
+
+/** Correct the words of a message: the runs of letters and digits are corrected one by one, the other caracters are kept (so an URL is corrected token by token).
+
+ @param corrected Receive the message, NUL terminated if there is room for it
+ @param capacity Size of corrected, the end of the message is dropped if it is too small
+ @return The length of corrected
+ */
+int sfLexiconCorrectText(const SFLexicon *lexicon, const char *text, int length, char *corrected, int capacity);
+
+#endif
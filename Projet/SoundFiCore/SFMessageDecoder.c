@@ -0,0 +1,354 @@
+//
+//  SFMessageDecoder.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFMessageDecoder.h"
+
+
+SFMessageDecoder *sfMessageDecoderCreate(void)
+{
+    SFMessageDecoder *decoder = calloc(1, sizeof(SFMessageDecoder));
+    if (decoder == NULL)
+        return NULL;
+
+    decoder->raw = malloc(SF_MESSAGE_CAPACITY);
+    decoder->message = decoder->stream.message;
+    if (!decoder->raw) {
+        sfMessageDecoderDestroy(decoder);
+        return NULL;
+    }
+
+    sfMessageDecoderReset(decoder);
+    return decoder;
+}
+
+
+void sfMessageDecoderDestroy(SFMessageDecoder *decoder)
+{
+    if (decoder == NULL)
+        return;
+    free(decoder->raw);
+    free(decoder);
+}
+
+
+void sfMessageDecoderReset(SFMessageDecoder *decoder)
+{
+    decoder->receiving = 0;
+    decoder->counter = 0;
+    decoder->bufferSize = SF_MESSAGE_IDLE_BUFFER;
+    decoder->rawLength = 0;
+    decoder->dropped = 0;
+    sfMessageStreamReset(&decoder->stream);
+    decoder->messageLength = 0;
+    decoder->quality = 0;
+}
+
+
+/** End of the message: the last caracters of the stream, and back to the waiting state */
+static void finishMessage(SFMessageDecoder *decoder)
+{
+    decoder->receiving = 0;
+    decoder->counter = 0;
+    decoder->bufferSize = SF_MESSAGE_IDLE_BUFFER;
+    decoder->messageLength = sfMessageStreamFinish(&decoder->stream);
+    decoder->quality = decoder->stream.quality;
+}
+
+
+SFMessageEvent sfMessageDecoderPush(SFMessageDecoder *decoder, int frequency)
+{
+    SFMessageEvent event = SFMessageEventNone;
+
+    if (decoder->receiving) {
+        if (frequency >= SF_RECEPTION_CHAR_MIN && frequency <= SF_RECEPTION_CHAR_MAX) {
+            char caracter = (char)((frequency - SF_RECEPTION_CHAR_MIN) / 18 + 32);
+            if (decoder->rawLength < SF_MESSAGE_CAPACITY) {
+                decoder->raw[decoder->rawLength++] = caracter;
+                sfMessageStreamPush(&decoder->stream, caracter);
+            }
+            else
+                decoder->dropped++;
+            decoder->counter = 0;
+            event = SFMessageEventCaracter;
+        }
+        else if (frequency >= SF_RECEPTION_STOP_MIN && frequency <= SF_RECEPTION_STOP_MAX) {
+            finishMessage(decoder);
+            return SFMessageEventCompleted;
+        }
+    }
+    else if (frequency >= SF_RECEPTION_START_MIN && frequency < SF_RECEPTION_START_MAX) {
+        decoder->receiving = 1;
+        decoder->counter = 0;
+        decoder->bufferSize = SF_MESSAGE_RECEPTION_BUFFER;
+        decoder->rawLength = 0;
+        decoder->dropped = 0;
+        sfMessageStreamReset(&decoder->stream);
+        decoder->messageLength = 0;
+        decoder->quality = 0;
+        event = SFMessageEventStarted;
+    }
+
+    // renderCallback / analysisWorkerProcess then checkTimeOut
+    if (decoder->receiving) {
+        decoder->counter++;
+        if (decoder->counter > SF_MESSAGE_TIMEOUT) {
+            finishMessage(decoder);
+            return SFMessageEventTimedOut;
+        }
+    }
+    return event;
+}
+
+
+#pragma mark - Analysis
+
+/** The last caracter of the result was seen once more */
+static void confirmCaracter(SFMessageStream *stream)
+{
+    if (stream->messageLength == 0)
+        return;
+    int seen = ++stream->seen;
+    stream->confidence[stream->messageLength - 1] = seen >= SF_MESSAGE_CONFIDENT_REPEAT ? SF_CONFIDENCE_MAX : SF_CONFIDENCE_MAX * seen / SF_MESSAGE_CONFIDENT_REPEAT;
+}
+
+
+/** A caracter of the result, final, seen seen times in a row */
+static void emitCaracter(SFMessageStream *stream, char caracter, int seen)
+{
+    if (stream->messageLength >= SF_MESSAGE_CAPACITY)
+        return;
+    stream->message[stream->messageLength++] = caracter;
+    stream->seen = seen - 1;
+    confirmCaracter(stream);
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * AnalysisPhase5
+ *  ---------------------------------------------------------------------------------------
+ */
+/** A caracter repeated 2 times is valid, more than 5 more times it's a double letter ("aaaaaaaaaa" -> "aa").
+
+ A pair is only looked at with a third caracter after it, and a repetition only goes on with one more caracter after it: the last two caracters of the message are never kept.
+ */
+static void analysisPhase5(SFMessageStream *stream, char caracter)
+{
+    char *window = stream->window5;
+
+    window[stream->length5++] = caracter;
+    for (;;) {
+        if (stream->repeated) {
+            if (stream->length5 < 2)
+                return;
+            if (window[0] != stream->repeated) {
+                stream->repeated = 0;
+                continue;
+            }
+            if (++stream->repetitions > 5) {
+                emitCaracter(stream, stream->repeated, 1);
+                stream->repetitions = 0;
+            }
+            else
+                confirmCaracter(stream);
+            memmove(window, window + 1, --stream->length5);
+        }
+        else {
+            if (stream->length5 < 3)
+                return;
+            if (window[0] == window[1]) {
+                emitCaracter(stream, window[0], 2);
+                stream->quality++;
+                stream->repeated = window[0];
+                stream->repetitions = 0;
+                window[0] = window[2];
+                stream->length5 = 1;
+            }
+            else {
+                stream->quality--;
+                memmove(window, window + 1, --stream->length5);
+            }
+        }
+    }
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * AnalysisPhase4
+ *  ---------------------------------------------------------------------------------------
+ */
+/** "fgg" -> "ggg" and "ggf" -> "ggg" when f and g are neighbours in the ASCII table */
+static void analysisPhase4(SFMessageStream *stream, char caracter)
+{
+    char *window = stream->window4;
+
+    window[stream->length4++] = caracter;
+    if (stream->length4 < 3)
+        return;
+
+    char un = window[0], deux = window[1], trois = window[2];
+    char repeated = 0;
+
+    if ((un == deux && trois != deux) || (un == trois && trois != deux)) {
+        if (abs(trois - deux) == 1)
+            repeated = un;
+    }
+    else if (deux == trois && un != deux) {
+        if (abs(un - deux) == 1)
+            repeated = deux;
+    }
+
+    if (repeated) {
+        stream->length4 = 0;
+        analysisPhase5(stream, repeated);
+        analysisPhase5(stream, repeated);
+        analysisPhase5(stream, repeated);
+    }
+    else {
+        window[0] = deux;
+        window[1] = trois;
+        stream->length4 = 2;
+        analysisPhase5(stream, un);
+    }
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * AnalysisPhase3
+ *  ---------------------------------------------------------------------------------------
+ */
+/** "bacb" -> "bb": two caracters between two same caracters are dropped if they are both different */
+static void analysisPhase3(SFMessageStream *stream, char caracter)
+{
+    char *window = stream->window3;
+
+    window[stream->length3++] = caracter;
+    if (stream->length3 < 4)
+        return;
+
+    char un = window[0];
+    if (un == window[3] && un != window[1] && un != window[2]) {
+        window[0] = window[3];
+        stream->length3 = 1;
+    }
+    else
+        memmove(window, window + 1, --stream->length3);
+    analysisPhase4(stream, un);
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * AnalysisPhase2
+ *  ---------------------------------------------------------------------------------------
+ */
+/** "aba" -> "aaa": a caracter between two same caracters is dropped if it's different. The first and the last one are always kept. */
+static void analysisPhase2(SFMessageStream *stream, char caracter)
+{
+    if (stream->count == 0)
+        analysisPhase3(stream, caracter);
+    else if (stream->count >= 2 && (stream->previous != caracter || stream->previous == stream->current))
+        analysisPhase3(stream, stream->current);
+
+    stream->previous = stream->current;
+    stream->current = caracter;
+    stream->count++;
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * AnalysisPhase1
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Keep what is after the last "init:" and before the first ":stop" that follow it.
+
+ The last 4 caracters are kept back until it is known they are not the beginning of one of the two strings.
+ */
+static void analysisPhase1(SFMessageStream *stream, char caracter)
+{
+    char *window = stream->initWindow;
+
+    window[stream->initLength++] = caracter;
+    if (stream->initLength < 5)
+        return;
+
+    if (!memcmp(window, "init:", 5)) {
+        sfMessageStreamReset(stream);
+        return;
+    }
+    if (!stream->closed && !memcmp(window, ":stop", 5)) {
+        stream->initLength = 0;
+        sfMessageStreamFinish(stream);
+        stream->closed = 1;
+        return;
+    }
+    if (!stream->closed)
+        analysisPhase2(stream, window[0]);
+    memmove(window, window + 1, --stream->initLength);
+}
+
+
+void sfMessageStreamReset(SFMessageStream *stream)
+{
+    stream->received = 0;
+    stream->initLength = 0;
+    stream->closed = 0;
+    stream->count = 0;
+    stream->length3 = 0;
+    stream->length4 = 0;
+    stream->length5 = 0;
+    stream->repeated = 0;
+    stream->repetitions = 0;
+    stream->seen = 0;
+    stream->message[0] = 0;
+    stream->messageLength = 0;
+    stream->quality = 0;
+}
+
+
+void sfMessageStreamPush(SFMessageStream *stream, char caracter)
+{
+    stream->received++;
+    analysisPhase1(stream, caracter);
+}
+
+
+int sfMessageStreamFinish(SFMessageStream *stream)
+{
+    if (!stream->closed) {
+        // What each window kept back goes to the next phase, the end of the string is known now
+        for (int i = 0; i < stream->initLength; i++)
+            analysisPhase2(stream, stream->initWindow[i]);
+        stream->initLength = 0;
+        if (stream->count >= 2)
+            analysisPhase3(stream, stream->current);
+        stream->count = 0;
+        for (int i = 0; i < stream->length3; i++)
+            analysisPhase4(stream, stream->window3[i]);
+        stream->length3 = 0;
+        for (int i = 0; i < stream->length4; i++)
+            analysisPhase5(stream, stream->window4[i]);
+        stream->length4 = 0;
+        stream->length5 = 0;                // phase 5 never keeps the last two
+        stream->repeated = 0;
+        stream->closed = 1;
+    }
+    stream->message[stream->messageLength] = 0;
+    return stream->messageLength;
+}
+
+
+int sfMessageAnalyse(const char *raw, int length, SFMessageStream *stream)
+{
+    sfMessageStreamReset(stream);
+    if (length > SF_MESSAGE_CAPACITY)
+        length = SF_MESSAGE_CAPACITY;
+    for (int i = 0; i < length; i++)
+        sfMessageStreamPush(stream, raw[i]);
+    return sfMessageStreamFinish(stream);
+}
@@ -0,0 +1,149 @@
+//
+//  SFMessageDecoder.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFMessageDecoder_h
+#define SoundFi_SFMessageDecoder_h
+
+#include <stdint.h>
+
+#define SF_MESSAGE_CAPACITY         4096    // caracters kept for one message, the next ones are dropped
+#define SF_MESSAGE_TIMEOUT          300     // buffers without caracter before the message is closed (checkTimeOut)
+#define SF_MESSAGE_IDLE_BUFFER      2048    // nbrEchantillon while waiting for a message
+#define SF_MESSAGE_RECEPTION_BUFFER 256     // nbrEchantillon while a message is received
+#define SF_MESSAGE_CONFIDENT_REPEAT 4       // a caracter seen that many times in a row is sure
+#define SF_CONFIDENCE_MAX           255     // confidence of a caracter that can't be wrong, 0 for a guess
+
+// Windows of the receiver around the band plan (messagingReceptionSampleTreatment)
+#define SF_RECEPTION_START_MIN      17650   // start tone, SF_START_FREQUENCY
+#define SF_RECEPTION_START_MAX      17950   // excluded
+#define SF_RECEPTION_CHAR_MIN       17995   // caracter (f-17995)/18+32
+#define SF_RECEPTION_CHAR_MAX       19710
+#define SF_RECEPTION_STOP_MIN       19720   // stop tone, SF_STOP_FREQUENCY
+#define SF_RECEPTION_STOP_MAX       19736
+
+enum {
+    SFMessageEventNone = 0,
+    SFMessageEventStarted,                  // start tone, the receiver switch to SF_MESSAGE_RECEPTION_BUFFER
+    SFMessageEventCaracter,                 // a caracter was added to raw
+    SFMessageEventCompleted,                // stop tone, message is ready
+    SFMessageEventTimedOut                  // no caracter for SF_MESSAGE_TIMEOUT buffers, message is ready (maybe empty)
+};
+typedef int SFMessageEvent;
+
+/**---------------------------------------------------------------------------------------
+ * SFMessageStream
+ *  ---------------------------------------------------------------------------------------
+ */
+/** The analysis of a single tone message, one caracter at a time as they are received.
+
+ The caracters are repeated 4 or 5 times by the emitter (one by buffer of 256 frames), the phases remove the init and stop strings, the isolated errors and the repetitions:
+
+ - phase 1: keep what is between "init:" and ":stop" if they are in the string,
+ - phase 2: "aba" -> "aaa",
+ - phase 3: "bacb" -> "bb" when a and c are both different from b,
+ - phase 4: "fgg" or "ggf" -> "ggg" when f and g are neighbours (±1 in the ASCII table, ±18 Hz),
+ - phase 5: a caracter seen at least 2 times in a row is kept, one more time every 6 more repetitions ("aaaaaaaaaa" -> "aa").
+
+ Each phase only looks a few caracters ahead (4 for phase 3, the longest), so each one is a small window in the stream: a caracter given to sfMessageStreamPush goes through the phases as far as their windows allow, the caracters of message are final as soon as they are written. The stop tone only empties the windows (sfMessageStreamFinish), the message is ready without going over the string again. "init:" forget what was received before it, ":stop" closes the message until the next "init:", as the last "init:" and the first ":stop" after it did on the whole string.
+
+ Each caracter of message has a confidence, from the times phase 5 saw it in a row: SF_CONFIDENCE_MAX * seen / SF_MESSAGE_CONFIDENT_REPEAT, half of it for a pair. Only the confidence of the last caracter can still change (it goes up while the repetition goes on), so the prefix can be shown while the message is received (messageProgress:confidence:).
+
+ Everything is in the structure, there is nothing to allocate: it can be a member of an other one or on the stack. The result is the same as the analysis of the whole string, caracter for caracter.
+ */
+typedef struct SFMessageStream {
+    int     received;                       // caracters given since the reset
+
+    char    initWindow[5];                  // phase 1: the last caracters, "init:" or ":stop" once full
+    int     initLength;
+    int     closed;                         // ":stop" was seen, the caracters are ignored until "init:"
+
+    int     count;                          // phase 2: caracters given to it
+    char    previous;
+    char    current;
+
+    char    window3[4];                     // phase 3
+    int     length3;
+    char    window4[3];                     // phase 4
+    int     length4;
+    char    window5[3];                     // phase 5
+    int     length5;
+    char    repeated;                       // caracter of the repetition in progress, 0 outside of one
+    int     repetitions;                    // after the first two
+    int     seen;                           // times the last caracter of message was seen in a row
+
+    char    message[SF_MESSAGE_CAPACITY + 1];
+    uint8_t confidence[SF_MESSAGE_CAPACITY];// of each caracter of message, 0..SF_CONFIDENCE_MAX
+    int     messageLength;
+    int     quality;                        // receptionQuality: caracters kept by phase 5 minus caracters rejected
+} SFMessageStream;
+
+
+/** Empty the stream for a new message */
+void sfMessageStreamReset(SFMessageStream *stream);
+
+/** Give one received caracter */
+void sfMessageStreamPush(SFMessageStream *stream, char caracter);
+
+/** End of the message (stop tone or time out): the caracters still in the windows go through the phases.
+
+ @return The length of message, NUL terminated. The stream must be reset before the next message.
+ */
+int sfMessageStreamFinish(SFMessageStream *stream);
+
+
+/**---------------------------------------------------------------------------------------
+ * SFMessageDecoder
+ *  ---------------------------------------------------------------------------------------
+ */
+/** The messaging side of the reception, without Core Audio.
+
+ It is what SoundFiAudioSession does with the frequency found in each buffer: messagingReceptionSampleTreatment (start tone, caracters, stop tone), the buffer counter and the time out of checkTimeOut, then startAnalysis. It is used by the offline tools to decode captures exactly like the engine. The caracters go to a SFMessageStream as they are received.
+
+ The decoder is given one frequency per buffer. bufferSize is the size the engine would ask to the audio session after this buffer (setReceptionBufferSize:), the caller should use it for the next one.
+
+ When a message ends (SFMessageEventCompleted or SFMessageEventTimedOut) the received caracters are in raw and the result of the analysis in message (NUL terminated), they stay there until the next start tone.
+ */
+typedef struct SFMessageDecoder {
+    int     receiving;                      // isInitiate
+    int     counter;                        // compteur, buffers since the last caracter
+    int     bufferSize;                     // SF_MESSAGE_IDLE_BUFFER or SF_MESSAGE_RECEPTION_BUFFER
+
+    char    *raw;                           // caracters received, before the analysis
+    int     rawLength;
+    int     dropped;                        // caracters over SF_MESSAGE_CAPACITY
+
+    char    *message;                       // stream.message, the analysis of the last message
+    int     messageLength;
+    int     quality;                        // receptionQuality of the last message
+
+    SFMessageStream stream;                 // the caracters are analysed as they come
+} SFMessageDecoder;
+
+
+/** Create a decoder waiting for a start tone, NULL if there is not enough memory */
+SFMessageDecoder *sfMessageDecoderCreate(void);
+void sfMessageDecoderDestroy(SFMessageDecoder *decoder);
+
+/** Go back to the waiting state and forget the last message */
+void sfMessageDecoderReset(SFMessageDecoder *decoder);
+
+/** Give the frequency found in one buffer.
+
+ @param frequency sampleFrequency in Hz, 0 if nothing was detected
+ @return What happened, see SFMessageEvent
+ */
+SFMessageEvent sfMessageDecoderPush(SFMessageDecoder *decoder, int frequency);
+
+/** Analysis of a whole received string, given to the stream caracter by caracter (a recorded stream, the tools).
+
+ @param raw Received caracters, length at most SF_MESSAGE_CAPACITY
+ @param stream Receive the result in message, and quality (<20 very bad, 20-40 not so bad, 40-70 some errors, >70 perfect)
+ @return The length of message
+ */
+int sfMessageAnalyse(const char *raw, int length, SFMessageStream *stream);
+
+#endif
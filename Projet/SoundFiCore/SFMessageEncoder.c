@@ -0,0 +1,314 @@
+//
+//  SFMessageEncoder.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFMessageEncoder.h"
+#include "SFBandPlan.h"
+
+
+void sfEmissionPlanDefault(SFEmissionPlan *plan)
+{
+    plan->sampleRate = 44100;
+    plan->frames = SF_EMISSION_FRAMES;
+    plan->startFrequency = SF_START_FREQUENCY;
+    plan->initRepeat = SF_EMISSION_INIT_REPEAT;
+    plan->firstCharFrequency = SF_FIRST_CHAR_FREQUENCY;
+    plan->charSpacing = SF_CHAR_SPACING;
+    plan->charRepeat = SF_EMISSION_CHAR_REPEAT;
+    plan->stopFrequency = SF_STOP_FREQUENCY;
+    plan->stopRepeat = SF_EMISSION_STOP_REPEAT;
+    plan->amplitude = SF_EMISSION_AMPLITUDE;
+    plan->fadeStep = SF_EMISSION_FADE_STEP;
+    plan->multiToneMode = SF_MFSK_SINGLE_TONE;
+    plan->chirpLength = 0;
+    plan->chirpAmplitude = 0;
+    plan->initAmplitude = 0;
+}
+
+
+void sfEmissionPlanSetMode(SFEmissionPlan *plan, int mode)
+{
+    plan->multiToneMode = mode;
+    if (mode >= 0 && mode < SF_MFSK_MODE_COUNT) {
+        plan->startFrequency = sfMultiToneModes[mode].startFrequency;
+        plan->charRepeat = sfMultiToneModes[mode].repeat;
+        plan->stopRepeat = 1;
+    }
+    else {
+        plan->startFrequency = SF_START_FREQUENCY;
+        plan->charRepeat = SF_EMISSION_CHAR_REPEAT;
+        plan->stopRepeat = SF_EMISSION_STOP_REPEAT;
+    }
+}
+
+
+void sfEmissionPlanSetChirp(SFEmissionPlan *plan, int chirpLength)
+{
+    plan->chirpLength = chirpLength;
+    if (chirpLength > 0) {
+        double level = SF_EMISSION_INIT_REPEAT * plan->fadeStep;
+        plan->initRepeat = SF_EMISSION_CHIRP_INIT_REPEAT;
+        plan->chirpAmplitude = plan->amplitude;
+        plan->initAmplitude = level < plan->amplitude ? level : plan->amplitude;
+    }
+    else {
+        plan->initRepeat = SF_EMISSION_INIT_REPEAT;
+        plan->chirpAmplitude = 0;
+        plan->initAmplitude = 0;
+    }
+}
+
+
+/** Multi tone mode of a plan, NULL in single tone mode */
+static const SFMultiToneMode *planMode(const SFEmissionPlan *plan)
+{
+    return plan->multiToneMode >= 0 && plan->multiToneMode < SF_MFSK_MODE_COUNT ? &sfMultiToneModes[plan->multiToneMode] : NULL;
+}
+
+
+SFMessageEncoder *sfMessageEncoderCreate(const SFEmissionPlan *plan)
+{
+    if (plan->sampleRate <= 0 || plan->frames < 1 || plan->initRepeat < 0 || plan->charRepeat < 1 || plan->stopRepeat < 0)
+        return NULL;
+    if (plan->multiToneMode != SF_MFSK_SINGLE_TONE && planMode(plan) == NULL)
+        return NULL;
+    if (plan->chirpLength < 0 || plan->chirpLength % plan->frames != 0)
+        return NULL;
+
+    SFMessageEncoder *encoder = calloc(1, sizeof(SFMessageEncoder));
+    if (encoder == NULL)
+        return NULL;
+    encoder->plan = *plan;
+    encoder->mode = planMode(plan);
+    encoder->toneCount = encoder->mode != NULL ? encoder->mode->toneCount : 1;
+    const SFMultiToneMode *mode = encoder->mode;
+
+    // Same tones as oscillatorSetup: start, the printable caracters, stop
+    float frequencies[SF_CHAR_COUNT + 2];
+    int count = 0;
+    frequencies[count++] = plan->startFrequency;
+    frequencies[count++] = plan->stopFrequency;
+    if (mode == NULL) {
+        for (int c = 0; c < SF_CHAR_COUNT; c++)
+            frequencies[count++] = plan->firstCharFrequency + c * plan->charSpacing;
+    }
+    else {
+        for (int v = 0; v < 1 << mode->bits; v++)
+            frequencies[count++] = sfMultiToneFrequency(mode, 0, v);
+    }
+    encoder->oscillator = sfOscillatorCreate(plan->sampleRate, SF_OSCILLATOR_DEFAULT_BLOCK, frequencies, count);
+    if (encoder->oscillator == NULL) {
+        free(encoder);
+        return NULL;
+    }
+
+    if (plan->chirpLength > 0) {
+        encoder->chirp = sfChirpCreate(plan->sampleRate, plan->chirpLength);
+        if (encoder->chirp == NULL) {
+            sfMessageEncoderDestroy(encoder);
+            return NULL;
+        }
+        encoder->chirpCallbacks = plan->chirpLength / plan->frames;
+    }
+
+    // Multi tone mode: one oscillator per other sub-band, with its tones
+    if (mode != NULL) {
+        encoder->scratch = malloc(plan->frames * sizeof(float));
+        encoder->frame = malloc(sfMultiToneFrameLength(mode, SF_FRAME_MAX_LENGTH));
+        encoder->values = malloc(sfMultiToneSymbolCount(mode, sfMultiToneFrameLength(mode, SF_FRAME_MAX_LENGTH)) * mode->toneCount);
+        encoder->toneTable = malloc((mode->toneCount << mode->bits) * sizeof(float));
+        if (mode->parity > 0) {
+            encoder->rs = sfReedSolomonCreate(mode->parity);
+            encoder->headerRs = sfReedSolomonCreate(SF_FRAME_HEADER_PARITY);
+        }
+        if (encoder->scratch == NULL || encoder->frame == NULL || encoder->values == NULL || encoder->toneTable == NULL ||
+            (mode->parity > 0 && (encoder->rs == NULL || encoder->headerRs == NULL))) {
+            sfMessageEncoderDestroy(encoder);
+            return NULL;
+        }
+        for (int band = 0; band < mode->toneCount; band++)
+            for (int v = 0; v < 1 << mode->bits; v++)
+                encoder->toneTable[(band << mode->bits) + v] = sfMultiToneFrequency(mode, band, v);
+        for (int band = 1; band < mode->toneCount; band++) {
+            count = 0;
+            for (int v = 0; v < 1 << mode->bits; v++)
+                frequencies[count++] = sfMultiToneFrequency(mode, band, v);
+            encoder->bandOscillators[band] = sfOscillatorCreate(plan->sampleRate, SF_OSCILLATOR_DEFAULT_BLOCK, frequencies, count);
+            if (encoder->bandOscillators[band] == NULL) {
+                sfMessageEncoderDestroy(encoder);
+                return NULL;
+            }
+        }
+    }
+
+    sfMessageEncoderStart(encoder, "", 0);
+    return encoder;
+}
+
+
+void sfMessageEncoderDestroy(SFMessageEncoder *encoder)
+{
+    if (encoder == NULL)
+        return;
+    sfOscillatorDestroy(encoder->oscillator);
+    for (int band = 1; band < SF_MFSK_MAX_TONES; band++)
+        sfOscillatorDestroy(encoder->bandOscillators[band]);
+    sfReedSolomonDestroy(encoder->rs);
+    sfReedSolomonDestroy(encoder->headerRs);
+    sfChirpDestroy(encoder->chirp);
+    free(encoder->scratch);
+    free(encoder->frame);
+    free(encoder->values);
+    free(encoder->toneTable);
+    free(encoder);
+}
+
+
+/** Caracters of the message, or symbols of its frame in multi tone mode */
+static int symbolCount(const SFEmissionPlan *plan, int length)
+{
+    const SFMultiToneMode *mode = planMode(plan);
+    if (mode == NULL)
+        return length;
+    if (length > SF_FRAME_MAX_LENGTH)
+        length = SF_FRAME_MAX_LENGTH;
+    return sfMultiToneSymbolCount(mode, sfMultiToneFrameLength(mode, length));
+}
+
+
+int sfMessageEncoderFrameCount(const SFEmissionPlan *plan, int length)
+{
+    return plan->chirpLength + (plan->initRepeat + symbolCount(plan, length) * plan->charRepeat + plan->stopRepeat) * plan->frames;
+}
+
+
+/** Write the frame of a payload in encoder->frame, return its length */
+static int buildFrame(SFMessageEncoder *encoder, SFFrameType type, const char *payload, int length)
+{
+    const SFMultiToneMode *mode = encoder->mode;
+    char *frame = encoder->frame;
+
+    sfFrameEncodeHeader(type, payload, length, frame);
+    if (encoder->headerRs != NULL)
+        sfReedSolomonEncode(encoder->headerRs, (const uint8_t *)frame, SF_FRAME_HEADER_LENGTH, (uint8_t *)frame + SF_FRAME_HEADER_LENGTH);
+    frame += sfMultiToneHeaderLength(mode);
+
+    if (encoder->rs != NULL && length > 0)
+        sfReedSolomonEncodeMessage(encoder->rs, payload, length, frame);
+    else
+        memcpy(frame, payload, length);
+    return sfMultiToneFrameLength(mode, length);
+}
+
+
+int sfMessageEncoderStartFrame(SFMessageEncoder *encoder, SFFrameType type, const char *payload, int length)
+{
+    const SFEmissionPlan *plan = &encoder->plan;
+
+    encoder->symbolCount = symbolCount(plan, length);
+    if (encoder->mode != NULL) {
+        if (length > SF_FRAME_MAX_LENGTH)
+            length = SF_FRAME_MAX_LENGTH;
+        length = buildFrame(encoder, type, payload, length);
+        payload = encoder->frame;
+        sfMultiToneSplit(encoder->mode, payload, length, encoder->values);
+    }
+    encoder->message = payload;
+    encoder->length = length;
+    encoder->callback = 0;
+    encoder->callbackCount = encoder->chirpCallbacks + plan->initRepeat + encoder->symbolCount * plan->charRepeat + plan->stopRepeat;
+    encoder->amplitude = 0;
+    sfOscillatorReset(encoder->oscillator);
+    for (int band = 1; band < encoder->toneCount; band++)
+        sfOscillatorReset(encoder->bandOscillators[band]);
+    return encoder->callbackCount;
+}
+
+
+int sfMessageEncoderStart(SFMessageEncoder *encoder, const char *message, int length)
+{
+    return sfMessageEncoderStartFrame(encoder, SFFrameTypeMessage, message, length);
+}
+
+
+int sfMessageEncoderFrequency(const SFMessageEncoder *encoder, int callback)
+{
+    float frequencies[SF_MFSK_MAX_TONES];
+    return sfMessageEncoderTones(encoder, callback, frequencies) > 0 ? (int)frequencies[0] : 0;
+}
+
+
+int sfMessageEncoderTones(const SFMessageEncoder *encoder, int callback, float *frequencies)
+{
+    const SFEmissionPlan *plan = &encoder->plan;
+
+    if (callback < encoder->chirpCallbacks || callback >= encoder->callbackCount)
+        return 0;
+    callback -= encoder->chirpCallbacks;
+    if (callback < plan->initRepeat) {
+        frequencies[0] = plan->startFrequency;
+        return 1;
+    }
+
+    int index = (callback - plan->initRepeat) / plan->charRepeat;
+    if (index >= encoder->symbolCount) {
+        frequencies[0] = plan->stopFrequency;
+        return 1;
+    }
+    if (encoder->mode == NULL) {
+        frequencies[0] = plan->firstCharFrequency + ((int)(unsigned char)encoder->message[index] - SF_FIRST_CHAR) * plan->charSpacing;
+        return 1;
+    }
+    // The tones of the symbol are in the flat tables, no bit to extract while rendering
+    const uint8_t *values = encoder->values + index * encoder->toneCount;
+    for (int band = 0; band < encoder->toneCount; band++)
+        frequencies[band] = encoder->toneTable[(band << encoder->mode->bits) + values[band]];
+    return encoder->toneCount;
+}
+
+
+int sfMessageEncoderRender(SFMessageEncoder *encoder, float *buffer)
+{
+    const SFEmissionPlan *plan = &encoder->plan;
+    float frequencies[SF_MFSK_MAX_TONES];
+
+    if (encoder->callback >= encoder->callbackCount)
+        return 0;
+    if (encoder->callback < encoder->chirpCallbacks) {
+        sfChirpRender(encoder->chirp, encoder->callback++ * plan->frames, (float)plan->chirpAmplitude, buffer, plan->frames);
+        return plan->frames;
+    }
+    int tones = sfMessageEncoderTones(encoder, encoder->callback++, frequencies);
+
+    // emissionSampleCalcul: fade in on the start tone, fade out on the stop tone. In multi tone mode the stop tone
+    // is shorter than the fade, the amplitude reaches 0 on its last callback. After a chirp the start tone is at its level.
+    if (encoder->chirp != NULL && encoder->callback <= encoder->chirpCallbacks + plan->initRepeat)
+        encoder->amplitude = plan->initAmplitude;
+    else if (frequencies[0] == plan->startFrequency && encoder->amplitude < plan->amplitude)
+        encoder->amplitude += plan->fadeStep;
+    else if (frequencies[0] == plan->stopFrequency && encoder->mode != NULL)
+        encoder->amplitude -= encoder->amplitude / (encoder->callbackCount - encoder->callback + 1);
+    else if (frequencies[0] == plan->stopFrequency && encoder->amplitude > 0)
+        encoder->amplitude -= plan->fadeStep;
+
+    // The tones of a symbol share the amplitude, the sub-bands without tone fade to 0
+    sfOscillatorRender(encoder->oscillator, frequencies[0], encoder->amplitude / tones, buffer, plan->frames);
+    for (int band = 1; band < encoder->toneCount; band++) {
+        SFOscillator *oscillator = encoder->bandOscillators[band];
+        if (band < tones)
+            sfOscillatorRender(oscillator, frequencies[band], encoder->amplitude / tones, encoder->scratch, plan->frames);
+        else if (oscillator->amplitude != 0)
+            sfOscillatorRender(oscillator, oscillator->current->frequency, 0, encoder->scratch, plan->frames);
+        else
+            continue;
+        for (int n = 0; n < plan->frames; n++)
+            buffer[n] += encoder->scratch[n];
+    }
+    return plan->frames;
+}
@@ -0,0 +1,141 @@
+//
+//  SFMessageEncoder.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFMessageEncoder_h
+#define SoundFi_SFMessageEncoder_h
+
+#include "SFOscillator.h"
+#include "SFMultiTone.h"
+#include "SFChirp.h"
+
+#define SF_EMISSION_FRAMES          256     // nbrEchantillon while sending, frames of one callback
+#define SF_EMISSION_INIT_REPEAT     26      // callbacks of start tone (nbrRepeatInit 0..25)
+#define SF_EMISSION_CHAR_REPEAT     5       // callbacks per caracter (nbCaracRepeat 0..4)
+#define SF_EMISSION_STOP_REPEAT     26      // callbacks of stop tone before the end of a rendered message
+#define SF_EMISSION_AMPLITUDE       0.8     // amplitude reached by the fade in
+#define SF_EMISSION_FADE_STEP       0.01    // amplitude change per callback of start or stop tone
+#define SF_EMISSION_CHIRP_INIT_REPEAT   (SF_CHIRP_MODE_FRAMES / SF_EMISSION_FRAMES)    // callbacks of start tone after a chirp
+
+/** Parameters of an emission, the band plan and the timing of getASCIIFrequency and emissionSampleCalcul by default */
+typedef struct SFEmissionPlan {
+    float   sampleRate;
+    int     frames;                 // frames per callback
+    int     startFrequency;         // SF_START_FREQUENCY
+    int     initRepeat;
+    int     firstCharFrequency;     // frequency of ' '
+    int     charSpacing;            // Hz between two consecutive caracters
+    int     charRepeat;
+    int     stopFrequency;          // SF_STOP_FREQUENCY
+    int     stopRepeat;
+    double  amplitude;              // end of the fade in
+    double  fadeStep;
+    int     multiToneMode;          // SF_MFSK_SINGLE_TONE, or a mode of sfMultiToneModes (SFMultiTone.h)
+    int     chirpLength;            // samples of the chirp preamble (SFChirp.h), 0 without chirp
+    double  chirpAmplitude;         // of the chirp
+    double  initAmplitude;          // of the start tone after the chirp, no fade in
+} SFEmissionPlan;
+
+/**---------------------------------------------------------------------------------------
+ * SFMessageEncoder
+ *  ---------------------------------------------------------------------------------------
+ */
+/** The emitting side of the messaging, without Core Audio.
+
+ Each callback of plan.frames samples has a tone (init sequence, each caracter repeated, stop tone), the amplitude fades in on the start tone and out on the stop tone, then the tone is rendered with SFOscillator. The amplitude is kept in double and the oscillator is the one of the engine (same block length, same tables). SoundFiAudioSession sends its messages with an encoder: the callbacks are cut or joined to fill the IO buffers, so the symbols last the same number of samples whatever buffer size the hardware gives.
+
+ With a plan.multiToneMode the message is sent in multi tone mode: the start tone of the mode, then each symbol (charRepeat callbacks) is toneCount tones at once, one per sub-band, each at amplitude/toneCount so the peak level stay the one of the single tone mode. Every sub-band has its own oscillator. The symbols carry a frame (SFFrame.h), built by sfMessageEncoderStartFrame in a buffer of the encoder: the header, then the message, with their Reed-Solomon parity in a coded mode. The receiver knows the end of the frame from its header, so the stop tone is only the fade out, on the stopRepeat callbacks of the plan.
+
+ With a plan.chirpLength the message starts with the chirp preamble (SFChirp.h), chirpLength / frames callbacks, then the start tone for initRepeat callbacks at initAmplitude: the fade in is not needed, the receiver finds the chirp and not the dominant frequency of a buffer.
+
+ It is used by the offline renderers (GenerateAudioMessage, sfrender) to write messages in audio files. An encoder render one message at a time, use one encoder per thread.
+ */
+typedef struct SFMessageEncoder {
+    SFEmissionPlan  plan;
+    SFOscillator    *oscillator;    // start, stop, and the caracters or the first sub-band
+    SFOscillator    *bandOscillators[SF_MFSK_MAX_TONES];   // the other sub-bands (index 1..toneCount-1)
+    const SFMultiToneMode *mode;    // NULL in single tone mode
+    int             toneCount;      // 1 in single tone mode
+    float           *scratch;       // plan.frames, one sub-band before it's added
+    SFReedSolomon   *rs;            // coded modes only
+    SFReedSolomon   *headerRs;      // SF_FRAME_HEADER_PARITY, coded modes only
+    SFChirp         *chirp;         // plan.chirpLength only
+    int             chirpCallbacks; // callbacks of the chirp, before the start tone
+    char            *frame;         // multi tone mode, the frame of the message
+    uint8_t         *values;        // multi tone mode, the values of the tones of every symbol of the frame
+    float           *toneTable;     // multi tone mode, frequency of value v of sub-band b at (b << bits) + v
+    int             symbolCount;    // caracters, or symbols in multi tone mode
+
+    const char      *message;       // not copied, must stay valid until the end of the message (frame in multi tone mode)
+    int             length;
+    int             callback;       // next callback to render
+    int             callbackCount;
+    double          amplitude;      // emissionSampleCalcul amplitude
+} SFMessageEncoder;
+
+
+/** Fill plan with the default emission: SFBandPlan frequencies, 44100 Hz, callbacks of 256 frames, single tone */
+void sfEmissionPlanDefault(SFEmissionPlan *plan);
+
+/** Switch a plan to a mode: the start tone that announce it, the callbacks per symbol and of stop tone.
+
+ @param mode A mode of sfMultiToneModes, SF_MFSK_SINGLE_TONE for the single tone mode
+ */
+void sfEmissionPlanSetMode(SFEmissionPlan *plan, int mode);
+
+/** Start the messages of a plan with a chirp preamble: the chirp at the amplitude of the plan, then SF_EMISSION_CHIRP_INIT_REPEAT callbacks of start tone at the level the fade in of the start tone reaches (the level of the message).
+
+ @param chirpLength Samples of the chirp, a multiple of plan->frames (SF_CHIRP_LENGTH at 44100 Hz), 0 for the start tone only (SF_EMISSION_INIT_REPEAT callbacks with a fade in)
+ */
+void sfEmissionPlanSetChirp(SFEmissionPlan *plan, int chirpLength);
+
+/** Create an encoder, the tables of the start, caracters and stop tones are computed here.
+
+ @param plan Parameters of the emission, copied
+ @return The encoder or NULL if the plan is not valid or there is not enough memory
+ */
+SFMessageEncoder *sfMessageEncoderCreate(const SFEmissionPlan *plan);
+void sfMessageEncoderDestroy(SFMessageEncoder *encoder);
+
+/** Start a message: phase 0, amplitude 0, like startAudioUnit:SFSendingMode.
+
+ @param message The caracters to send, ASCII (an other byte give a tone out of the band plan like the emitter does)
+ @param length Number of caracters, SF_FRAME_MAX_LENGTH at most in multi tone mode
+ @return The number of callbacks of the message (chirp, init, caracters and stop tones)
+ */
+int sfMessageEncoderStart(SFMessageEncoder *encoder, const char *message, int length);
+
+/** Start a message with the type of its frame, sfMessageEncoderStart send a SFFrameTypeMessage. The type is not sent in single tone mode.
+
+ @return The number of callbacks of the message
+ */
+int sfMessageEncoderStartFrame(SFMessageEncoder *encoder, SFFrameType type, const char *payload, int length);
+
+/** Frequency of a callback of the current message, getASCIIFrequency.
+
+ @param callback 0..callbackCount-1
+ @return The frequency in Hz (the tone of the first sub-band in multi tone mode), 0 for the chirp and after the end of the message
+ */
+int sfMessageEncoderFrequency(const SFMessageEncoder *encoder, int callback);
+
+/** Every tone of a callback of the current message.
+
+ @param frequencies Receive the tones, at least SF_MFSK_MAX_TONES floats
+ @return The number of tones, the toneCount of the mode for a symbol, 1 for the start and stop tones and in single tone mode, 0 for the chirp and after the end of the message
+ */
+int sfMessageEncoderTones(const SFMessageEncoder *encoder, int callback, float *frequencies);
+
+/** Render the next callback of the current message.
+
+ @param buffer plan.frames floats
+ @return The number of frames written, 0 when the message is over
+ */
+int sfMessageEncoderRender(SFMessageEncoder *encoder, float *buffer);
+
+/** Number of frames of a message of length caracters (bytes of payload in multi tone mode), without rendering it */
+int sfMessageEncoderFrameCount(const SFEmissionPlan *plan, int length);
+
+#endif
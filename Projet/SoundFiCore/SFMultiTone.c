@@ -0,0 +1,556 @@
+//
+//  SFMultiTone.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SFMultiTone.h"
+
+#define SF_MFSK_TONE_START          0
+#define SF_MFSK_TONE_STOP           1
+#define SF_MFSK_TONE_OTHER_START    2       // start tones of the other modes, single tone included
+#define SF_MFSK_TONE_FIRST_DATA     (SF_MFSK_TONE_OTHER_START + SF_MFSK_MODE_COUNT)
+#define SF_MFSK_SILENT_SYMBOLS      2       // symbols without tone before the message is lost
+#define SF_MFSK_CLEAR_RATIO         4.f     // strongest tone of a sub-band over the second one for a clear decision
+#define SF_MFSK_WAIT_SAMPLES        10240   // of start tone at most, after its detection (26 callbacks are 6656)
+
+
+/** Energy of a tone in samples, squared amplitude in the unit of the samples (one Goertzel filter) */
+static float toneEnergy(const int16_t *samples, int count, float sampleRate, float frequency)
+{
+    const float coefficient = 2.f * cosf(2.f * (float)M_PI * frequency / sampleRate);
+    float s1 = 0, s2 = 0;
+    for (int n = 0; n < count; n++) {
+        float s0 = samples[n] + coefficient * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    float power = s1 * s1 + s2 * s2 - coefficient * s1 * s2;
+    return 4.f * power / ((float)count * count);
+}
+
+
+int sfMultiToneIdentifyMode(const int16_t *samples, int count, float sampleRate)
+{
+    if (count <= 0)
+        return SF_MFSK_NO_MODE;
+
+    // The single tone start, then the modes
+    int best = SF_MFSK_NO_MODE;
+    float first = toneEnergy(samples, count, sampleRate, SF_START_FREQUENCY), second = 0;
+    if (first > 0)
+        best = SF_MFSK_SINGLE_TONE;
+    for (int m = 0; m < SF_MFSK_MODE_COUNT; m++) {
+        float energy = toneEnergy(samples, count, sampleRate, sfMultiToneModes[m].startFrequency);
+        if (energy > first) {
+            second = first;
+            first = energy;
+            best = m;
+        }
+        else if (energy > second)
+            second = energy;
+    }
+    if (first < SF_TONEBANK_MIN_ENERGY || first < SF_MFSK_CLEAR_RATIO * second)
+        return SF_MFSK_NO_MODE;
+    return best;
+}
+
+
+SFMultiToneDecoder *sfMultiToneDecoderCreate(float sampleRate, const SFMultiToneMode *mode)
+{
+    if (mode == NULL || mode->toneCount < 1 || mode->toneCount > SF_MFSK_MAX_TONES || (1 << mode->bits) > SF_MFSK_MAX_VALUES || mode->repeat < 1)
+        return NULL;
+    // Tones closer than sampleRate / window share their main lobe, a sub-band must hold its tones
+    const int window = sfMultiToneWindow(mode, sampleRate);
+    if (window == 0 || (1 << mode->bits) * mode->spacing > mode->bandWidth / mode->toneCount)
+        return NULL;
+
+    SFMultiToneDecoder *decoder = calloc(1, sizeof(SFMultiToneDecoder));
+    if (decoder == NULL)
+        return NULL;
+
+    decoder->mode = mode;
+    decoder->toneCount = mode->toneCount;
+    decoder->bits = mode->bits;
+    decoder->values = 1 << mode->bits;
+    decoder->symbolLength = mode->repeat * SF_MFSK_CALLBACK_FRAMES;
+
+    int bankCount = SF_MFSK_TONE_FIRST_DATA + decoder->toneCount * decoder->values;
+    float frequencies[SF_MFSK_TONE_FIRST_DATA + SF_MFSK_MAX_TONES * SF_MFSK_MAX_VALUES];
+    frequencies[SF_MFSK_TONE_START] = mode->startFrequency;
+    frequencies[SF_MFSK_TONE_STOP] = SF_STOP_FREQUENCY;
+    int other = SF_MFSK_TONE_OTHER_START;
+    decoder->otherModes[0] = SF_MFSK_SINGLE_TONE;
+    frequencies[other++] = SF_START_FREQUENCY;
+    for (int m = 0; m < SF_MFSK_MODE_COUNT && other < SF_MFSK_TONE_FIRST_DATA; m++) {
+        if (&sfMultiToneModes[m] != mode && sfMultiToneModes[m].startFrequency != mode->startFrequency) {
+            decoder->otherModes[other - SF_MFSK_TONE_OTHER_START] = m;
+            frequencies[other++] = sfMultiToneModes[m].startFrequency;
+        }
+    }
+    while (other < SF_MFSK_TONE_FIRST_DATA) {       // a mode out of the table
+        decoder->otherModes[other - SF_MFSK_TONE_OTHER_START] = SF_MFSK_SINGLE_TONE;
+        frequencies[other++] = SF_START_FREQUENCY;
+    }
+    for (int band = 0; band < decoder->toneCount; band++)
+        for (int value = 0; value < decoder->values; value++)
+            frequencies[SF_MFSK_TONE_FIRST_DATA + band * decoder->values + value] = sfMultiToneFrequency(mode, band, value);
+
+    decoder->bank = sfToneBankCreate(sampleRate, frequencies, bankCount, window);
+    decoder->energies = calloc(bankCount, sizeof(float));
+    decoder->boundary = calloc(bankCount, sizeof(float));
+    decoder->frame = malloc(sfMultiToneFrameLength(mode, SF_FRAME_MAX_LENGTH));
+    decoder->confidence = malloc(sfMultiToneFrameLength(mode, SF_FRAME_MAX_LENGTH));
+    decoder->message = malloc(SF_FRAME_MAX_LENGTH + 1);
+    if (mode->parity > 0) {
+        decoder->rs = sfReedSolomonCreate(mode->parity);
+        decoder->headerRs = sfReedSolomonCreate(SF_FRAME_HEADER_PARITY);
+    }
+    if (decoder->bank == NULL || decoder->energies == NULL || decoder->boundary == NULL || decoder->frame == NULL || decoder->confidence == NULL || decoder->message == NULL ||
+        (mode->parity > 0 && (decoder->rs == NULL || decoder->headerRs == NULL))) {
+        sfMultiToneDecoderDestroy(decoder);
+        return NULL;
+    }
+
+    sfMultiToneDecoderReset(decoder);
+    return decoder;
+}
+
+
+void sfMultiToneDecoderDestroy(SFMultiToneDecoder *decoder)
+{
+    if (decoder == NULL)
+        return;
+    sfToneBankDestroy(decoder->bank);
+    sfReedSolomonDestroy(decoder->rs);
+    sfReedSolomonDestroy(decoder->headerRs);
+    free(decoder->energies);
+    free(decoder->boundary);
+    free(decoder->frame);
+    free(decoder->confidence);
+    free(decoder->message);
+    free(decoder);
+}
+
+
+void sfMultiToneDecoderReset(SFMultiToneDecoder *decoder)
+{
+    sfToneBankReset(decoder->bank);
+    memset(decoder->energies, 0, decoder->bank->toneCount * sizeof(float));
+    decoder->position = 0;
+    decoder->synchronised = 0;
+    decoder->startPeak = 0;
+    decoder->symbolStart = 0;
+    decoder->symbolPeriod = decoder->symbolLength;
+    decoder->boundaryValid = 0;
+    for (int band = 0; band < SF_MFSK_MAX_TONES; band++)
+        decoder->previousTones[band] = -1;
+    decoder->windows = 0;
+    decoder->silentSymbols = 0;
+    decoder->waiting = 0;
+    decoder->accumulator = 0;
+    decoder->accumulated = 0;
+    decoder->byteConfidence = SF_CONFIDENCE_MAX;
+    decoder->frameLength = 0;
+    decoder->expectedSymbols = 0;
+    decoder->frameType = SFFrameTypeMessage;
+    decoder->payloadLength = 0;
+    decoder->message[0] = '\0';
+    decoder->messageLength = 0;
+    decoder->rejected = 0;
+    decoder->dropped = 0;
+    decoder->symbolCount = 0;
+    decoder->quality = 0;
+    decoder->corrected = 0;
+    decoder->failedBlocks = 0;
+    decoder->handover = SF_MFSK_SINGLE_TONE;
+}
+
+
+void sfMultiToneDecoderResetAtSymbol(SFMultiToneDecoder *decoder)
+{
+    sfMultiToneDecoderReset(decoder);
+    decoder->synchronised = 1;
+}
+
+
+/** The header is received: correct it in a coded mode, then the length of the frame give the number of symbols */
+static void readHeader(SFMultiToneDecoder *decoder)
+{
+    const SFMultiToneMode *mode = decoder->mode;
+
+    if (decoder->headerRs != NULL) {
+        int fixed = sfReedSolomonDecode(decoder->headerRs, (uint8_t *)decoder->frame, sfMultiToneHeaderLength(mode));
+        if (fixed < 0) {
+            decoder->rejected = 1;
+            return;
+        }
+        decoder->corrected += fixed;
+    }
+
+    int length = sfFrameParseHeader(decoder->frame, &decoder->frameType);
+    if (length < 0) {
+        decoder->rejected = 1;
+        return;
+    }
+    decoder->payloadLength = length;
+    decoder->expectedSymbols = sfMultiToneSymbolCount(mode, sfMultiToneFrameLength(mode, length));
+}
+
+
+/** Add the bits of one tone to the frame, return 1 if a byte was completed. A byte is as sure as the least sure of its tones. */
+static int appendBits(SFMultiToneDecoder *decoder, int value, int confidence)
+{
+    decoder->accumulator = (decoder->accumulator << decoder->bits) | (uint32_t)value;
+    decoder->accumulated += decoder->bits;
+    if (confidence < decoder->byteConfidence)
+        decoder->byteConfidence = confidence;
+    if (decoder->accumulated < 8)
+        return 0;
+
+    decoder->accumulated -= 8;
+    char byte = (char)((decoder->accumulator >> decoder->accumulated) & 0xFF);
+    if (decoder->frameLength < sfMultiToneFrameLength(decoder->mode, SF_FRAME_MAX_LENGTH)) {
+        decoder->confidence[decoder->frameLength] = (uint8_t)decoder->byteConfidence;
+        decoder->frame[decoder->frameLength++] = byte;
+    }
+    else
+        decoder->dropped++;
+    decoder->byteConfidence = decoder->accumulated > 0 ? confidence : SF_CONFIDENCE_MAX;
+
+    if (decoder->frameLength == sfMultiToneHeaderLength(decoder->mode) && decoder->expectedSymbols == 0 && !decoder->rejected)
+        readHeader(decoder);
+    return 1;
+}
+
+
+/** Add the values of one symbol and the confidence of their decisions, return 1 if a byte was completed */
+static int appendSymbol(SFMultiToneDecoder *decoder, const int *values, const int *confidences)
+{
+    int bytes = 0;
+    for (int band = 0; band < decoder->toneCount; band++)
+        bytes += appendBits(decoder, values[band], confidences[band]);
+    decoder->symbolCount++;
+    return bytes > 0;
+}
+
+
+/** Decide the symbol accumulated in energies.
+
+ A silent symbol is kept in held: if the message goes on it was a weak symbol, its values are the best guess and keep the bytes aligned (the Reed-Solomon code see one wrong byte, not a shifted message). Their confidence is 0.
+
+ The confidence of a sub-band is SF_CONFIDENCE_MAX for a clear decision (SF_MFSK_CLEAR_RATIO), down to 0 when the two strongest tones are equal.
+
+ @param tones Receive the tone of the bank decided in each sub-band, -1 for a silent symbol or the stop tone
+ @return SFMessageEventCaracter, SFMessageEventCompleted on the last symbol of the frame or on the stop tone, SFMessageEventTimedOut after SF_MFSK_SILENT_SYMBOLS silent symbols or on a wrong header, SFMessageEventNone
+ */
+static SFMessageEvent decideSymbol(SFMultiToneDecoder *decoder, int *tones)
+{
+    const float *energies = decoder->energies;
+    float loudest = 0;
+    int values[SF_MFSK_MAX_TONES];
+    int confidences[SF_MFSK_MAX_TONES];
+    int clear = 0;
+
+    for (int band = 0; band < decoder->toneCount; band++)
+        tones[band] = -1;
+
+    // Multi peak: the strongest tone of each sub-band
+    for (int band = 0; band < decoder->toneCount; band++) {
+        const float *tones = energies + SF_MFSK_TONE_FIRST_DATA + band * decoder->values;
+        int best = 0;
+        float first = tones[0], second = 0;
+        for (int v = 1; v < decoder->values; v++) {
+            if (tones[v] > first) {
+                second = first;
+                first = tones[v];
+                best = v;
+            }
+            else if (tones[v] > second)
+                second = tones[v];
+        }
+        values[band] = best;
+        clear += first >= SF_MFSK_CLEAR_RATIO * second ? 1 : -1;
+        float margin = first > 0 ? (1.f - second / first) / (1.f - 1.f / SF_MFSK_CLEAR_RATIO) : 0.f;
+        confidences[band] = margin >= 1.f ? SF_CONFIDENCE_MAX : (int)(SF_CONFIDENCE_MAX * margin);
+        if (first > loudest)
+            loudest = first;
+    }
+
+    int windows = decoder->windows > 0 ? decoder->windows : 1;
+    float stop = energies[SF_MFSK_TONE_STOP];
+    memset(decoder->energies, 0, decoder->bank->toneCount * sizeof(float));
+    decoder->windows = 0;
+
+    if (stop > loudest && stop >= SF_TONEBANK_MIN_ENERGY * windows)
+        return SFMessageEventCompleted;
+    if (loudest < SF_TONEBANK_MIN_ENERGY * windows) {
+        if (++decoder->silentSymbols >= SF_MFSK_SILENT_SYMBOLS)
+            return SFMessageEventTimedOut;
+        memcpy(decoder->held, values, sizeof(values));
+        return SFMessageEventNone;
+    }
+
+    for (int band = 0; band < decoder->toneCount; band++)
+        tones[band] = SF_MFSK_TONE_FIRST_DATA + band * decoder->values + values[band];
+
+    int bytes = 0;
+    if (decoder->silentSymbols > 0) {
+        int guess[SF_MFSK_MAX_TONES] = {0};
+        bytes += appendSymbol(decoder, decoder->held, guess);
+    }
+    decoder->silentSymbols = 0;
+    decoder->quality += clear;
+    bytes += appendSymbol(decoder, values, confidences);
+
+    if (decoder->rejected)
+        return SFMessageEventTimedOut;
+    if (decoder->expectedSymbols > 0 && decoder->symbolCount >= decoder->expectedSymbols)
+        return SFMessageEventCompleted;
+    return bytes > 0 ? SFMessageEventCaracter : SFMessageEventNone;
+}
+
+
+/** Take the payload of a complete frame in message: correct its blocks in a coded mode, then check the CRC */
+static void checkFrame(SFMultiToneDecoder *decoder)
+{
+    const SFMultiToneMode *mode = decoder->mode;
+    const int headerLength = sfMultiToneHeaderLength(mode);
+    const char *payload = decoder->frame + headerLength;
+    int length = sfFrameParseHeader(decoder->frame, NULL);
+    int sent = sfMultiToneFrameLength(mode, length) - headerLength;
+
+    if (decoder->frameLength - headerLength < sent) {
+        decoder->rejected = 1;
+        return;
+    }
+    if (decoder->rs != NULL && length > 0) {
+        int fixed = 0;
+        sfReedSolomonDecodeMessage(decoder->rs, payload, sent, decoder->message, &fixed, &decoder->failedBlocks);
+        decoder->corrected += fixed;
+    }
+    else
+        memcpy(decoder->message, payload, length);
+
+    if (!sfFrameCheck(decoder->frame, decoder->message, length))
+        decoder->rejected = 1;
+    else
+        decoder->messageLength = length;
+}
+
+
+/** End of a message: only a complete frame with the right CRC gives a message */
+static SFMessageEvent finishMessage(SFMultiToneDecoder *decoder, SFMessageEvent event)
+{
+    decoder->messageLength = 0;
+    if (decoder->expectedSymbols > 0 && !decoder->rejected)
+        checkFrame(decoder);
+    else if (decoder->frameLength > 0)
+        decoder->rejected = 1;
+    decoder->message[decoder->messageLength] = '\0';
+    decoder->synchronised = 0;
+    decoder->startPeak = 0;
+    return event;
+}
+
+
+/** Strongest data tone of the current symbol */
+static float loudestData(const SFMultiToneDecoder *decoder)
+{
+    float loudest = 0;
+    for (int t = SF_MFSK_TONE_FIRST_DATA; t < decoder->bank->toneCount; t++) {
+        if (decoder->energies[t] > loudest)
+            loudest = decoder->energies[t];
+    }
+    return loudest;
+}
+
+
+/** Timing error of the start of the symbol just decided, from the window centred on it: in a sub-band where the tone
+ changes, the amplitudes of the two tones are the parts of the window in each symbol. Tones too close leak in each
+ other's filter with a phase that changes from one symbol to the next, they are left out.
+
+ @param tones The tones of the symbol, from decideSymbol
+ @return The samples between symbolStart and the boundary seen in the signal, positive if it's later, 0 without a change of tone
+ */
+static double clockError(SFMultiToneDecoder *decoder, const int *tones)
+{
+    const SFToneBank *bank = decoder->bank;
+    const float minimumSpacing = 2 * bank->sampleRate / bank->blockLength;    // the main lobe of half a window
+    double error = 0;
+    int edges = 0;
+
+    if (decoder->boundaryValid) {
+        for (int band = 0; band < decoder->toneCount; band++) {
+            int before = decoder->previousTones[band], after = tones[band];
+            if (before < 0 || after < 0 || fabsf(bank->frequencies[after] - bank->frequencies[before]) < minimumSpacing)
+                continue;
+            float early = decoder->boundary[before], late = decoder->boundary[after];
+            if (early + late < SF_TONEBANK_MIN_ENERGY)
+                continue;
+            double a = sqrt(early), b = sqrt(late);
+            error += (a - b) / (a + b);
+            edges++;
+        }
+    }
+    memcpy(decoder->previousTones, tones, decoder->toneCount * sizeof(int));
+    decoder->boundaryValid = 0;
+
+    // (a - b) / (a + b) = 2 * error / window from the centre of the window
+    return edges > 0 ? decoder->boundaryOffset + error / edges * decoder->bank->blockLength / 2 : 0;
+}
+
+
+/** Move the next boundary on the clock of the emitter, a second order loop on the timing error */
+static void trackClock(SFMultiToneDecoder *decoder, double error)
+{
+    const double length = decoder->symbolLength;
+
+    decoder->symbolPeriod += SF_MFSK_CLOCK_PERIOD_GAIN * error;
+    if (decoder->symbolPeriod < length * (1 - SF_MFSK_CLOCK_MAX_DRIFT))
+        decoder->symbolPeriod = length * (1 - SF_MFSK_CLOCK_MAX_DRIFT);
+    if (decoder->symbolPeriod > length * (1 + SF_MFSK_CLOCK_MAX_DRIFT))
+        decoder->symbolPeriod = length * (1 + SF_MFSK_CLOCK_MAX_DRIFT);
+    decoder->symbolStart += decoder->symbolPeriod + SF_MFSK_CLOCK_PHASE_GAIN * error;
+}
+
+
+/** One evaluation of the bank, window ending at position */
+static SFMessageEvent processWindow(SFMultiToneDecoder *decoder)
+{
+    const SFToneBank *bank = decoder->bank;
+    const float *energies = bank->energies;
+    const int window = bank->blockLength;
+    const double end = (double)decoder->position;
+    const int margin = window / 8;              // samples of a window allowed out of its symbol
+
+    if (!decoder->synchronised) {
+        float start = energies[SF_MFSK_TONE_START];
+
+        // The start tone of an other mode: a wrong detection (the start tones are 100 Hz apart), the receiver must
+        // hand the message to the decoder of that mode. During the fade in the start tone can be under the noise of
+        // the other ones, it must be clearly over.
+        float own = start > decoder->startPeak ? start : decoder->startPeak;
+        for (int other = SF_MFSK_TONE_OTHER_START; other < SF_MFSK_TONE_FIRST_DATA; other++) {
+            if (energies[other] > SF_MFSK_CLEAR_RATIO * own && energies[other] >= SF_TONEBANK_MIN_ENERGY) {
+                decoder->handover = decoder->otherModes[other - SF_MFSK_TONE_OTHER_START];
+                return finishMessage(decoder, SFMessageEventTimedOut);
+            }
+        }
+        if (start > decoder->startPeak) {
+            decoder->startPeak = start;
+            return SFMessageEventNone;
+        }
+        if (decoder->startPeak < SF_TONEBANK_MIN_ENERGY || start >= decoder->startPeak / 4)
+            return SFMessageEventNone;
+
+        // The part of the window still in the start tone give its end: energy ~ (part of the window)^2
+        double inside = window * sqrt(start / decoder->startPeak);
+        double boundary = end - window + inside;
+        if (boundary < end - 3 * window / 4)
+            boundary = end - 3 * window / 4;
+        if (boundary > end - window / 2)
+            boundary = end - window / 2;
+
+        decoder->synchronised = 1;
+        decoder->symbolStart = boundary;
+        decoder->windows = 0;
+        memset(decoder->energies, 0, bank->toneCount * sizeof(float));
+    }
+
+    // Close the symbols this window is after
+    SFMessageEvent event = SFMessageEventNone;
+    while (end > decoder->symbolStart + decoder->symbolPeriod + margin) {
+        // Still the start tone in the first symbol: the drop was the noise at the beginning of the fade in
+        if (decoder->symbolCount == 0 && decoder->silentSymbols == 0 && decoder->energies[SF_MFSK_TONE_START] > loudestData(decoder)) {
+            decoder->synchronised = 0;
+            decoder->startPeak = energies[SF_MFSK_TONE_START];
+            decoder->boundaryValid = 0;
+            decoder->windows = 0;
+            memset(decoder->energies, 0, bank->toneCount * sizeof(float));
+            return SFMessageEventNone;
+        }
+        int tones[SF_MFSK_MAX_TONES];
+        SFMessageEvent decided = decideSymbol(decoder, tones);
+        trackClock(decoder, clockError(decoder, tones));
+        if (decided == SFMessageEventCompleted || decided == SFMessageEventTimedOut)
+            return finishMessage(decoder, decided);
+        if (decided != SFMessageEventNone)
+            event = decided;
+    }
+
+    // Window across the start of the current symbol, the end of the previous one
+    if (!decoder->boundaryValid && fabs(end - window / 2 - decoder->symbolStart) <= bank->segmentLength / 2) {
+        memcpy(decoder->boundary, energies, bank->toneCount * sizeof(float));
+        decoder->boundaryOffset = end - window / 2 - decoder->symbolStart;
+        decoder->boundaryValid = 1;
+    }
+
+    // Window almost entirely in the current symbol
+    if (end >= decoder->symbolStart + window - margin) {
+        for (int t = 0; t < bank->toneCount; t++)
+            decoder->energies[t] += energies[t];
+        decoder->windows++;
+    }
+    return event;
+}
+
+
+SFMessageEvent sfMultiToneDecoderProcess(SFMultiToneDecoder *decoder, const int16_t *samples, int count)
+{
+    SFMessageEvent event = SFMessageEventNone;
+    const int segment = decoder->bank->segmentLength;
+
+    // One segment at a time, each evaluation is at a known position
+    while (count > 0) {
+        int chunk = segment - decoder->bank->segmentFill;
+        if (chunk > count)
+            chunk = count;
+        int updated = sfToneBankProcessInt16(decoder->bank, samples, chunk);
+        decoder->position += chunk;
+        samples += chunk;
+        count -= chunk;
+        if (!decoder->synchronised)
+            decoder->waiting += chunk;
+
+        if (updated) {
+            SFMessageEvent result = processWindow(decoder);
+            if (result == SFMessageEventCompleted || result == SFMessageEventTimedOut)
+                return result;
+            if (result != SFMessageEventNone)
+                event = result;
+        }
+
+        // The start tone never ended
+        if (!decoder->synchronised && decoder->waiting > SF_MFSK_WAIT_SAMPLES)
+            return finishMessage(decoder, SFMessageEventTimedOut);
+    }
+    return event;
+}
+
+
+int sfMultiToneDecoderPartial(const SFMultiToneDecoder *decoder, char *text, uint8_t *confidence)
+{
+    if (decoder->expectedSymbols == 0 || decoder->rejected)
+        return 0;
+
+    const int parity = decoder->mode->parity;
+    const int headerLength = sfMultiToneHeaderLength(decoder->mode);
+    int received = decoder->frameLength - headerLength;
+    int length = 0;
+
+    for (; length < decoder->payloadLength; length++) {
+        int position = parity > 0 ? sfReedSolomonCodedPosition(parity, decoder->payloadLength, length) : length;
+        if (position >= received)
+            break;
+        text[length] = decoder->frame[headerLength + position];
+        if (confidence != NULL)
+            confidence[length] = decoder->confidence[headerLength + position];
+    }
+    return length;
+}
@@ -0,0 +1,279 @@
+//
+//  SFMultiTone.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+// The multi tone (MFSK) messaging. The caracters band of the plan (18000 Hz
+// and up) is cut in up to 4 sub-bands and a symbol is one tone in each
+// sub-band at the same time, so one symbol carry several tones worth of bits.
+// The payload is the bytes of a frame (SFFrame.h: header, then the message),
+// most significant bit first, padded with zeros in the last symbol. Any byte
+// can be sent, not only the printable caracters of the single tone mode.
+//
+// The modes are in sfMultiToneModes (SFMultiToneMode.c, with sfMultiToneSplit:
+// all an emitter links, the decoder is in SFMultiTone.c):
+//
+//   start  tones  tones per sub-band  spacing  callbacks   bits        Reed-Solomon
+//                                              per symbol  per symbol  parity
+//   17300    2          16             44 Hz      5          8        -
+//   17400    3           8             44 Hz      5          9        -
+//   17500    4           8             44 Hz      5         12        -
+//   17100    1          16             87 Hz      2          4        8 per block
+//   17200    1          16             87 Hz      2          4        4 per block
+//   17600    1          16             58 Hz      3          4        8 per block
+//   17000    2           8             58 Hz      3          6        8 per block   18000-19000 Hz
+//   21300    2           8             58 Hz      3          6        8 per block   19800-21000 Hz
+//
+// The spacing is the resolution of the window of the receiver at least (44100 /
+// 1000 samples for 5 callbacks, / 760 for 3, / 504 for 2), and the window is
+// a whole number of periods of the spacing (sfMultiToneWindow): the tones of a
+// sub-band are orthogonal, a strong tone doesn't leak in its neighbours.
+//
+// The first three are the uncoded modes: 8 to 12 bits per symbol of 5
+// callbacks, against one of the 95 caracters (6.6 bits) in 5 callbacks for the
+// single tone mode. The fastest is the mode 2: 1.3x the payload of the single
+// tone mode on 24 caracters, 1.4x on 100, and no frame lost from 0 dB where the
+// single tone mode needs 6 dB.
+//
+// The next two are the coded modes: one tone of 16 for 2 callbacks, the bytes
+// that are wrong are fixed by the Reed-Solomon code (SFReedSolomon), mode 4
+// with half the parity for the short messages. The emission is shared by the
+// tones of a symbol, so one tone has 4 times the power of a tone of mode 0:
+// they are the robust modes, not faster ones. On 24 caracters they send 188 and
+// 207 b/s of payload (276 b/s in the single tone mode, 348 b/s in mode 2) and
+// receive 92-94% of the frames at -12 dB, where no uncoded mode gets more than
+// 2%; on 100 caracters 287 and 297 b/s (394 b/s in mode 2), the header and the
+// parity weigh less. One callback per symbol (8 tones 175 Hz apart) would send
+// 1.5x the single tone mode on 100 caracters, but loses more frames than mode 0
+// under -6 dB. sfbench mfsk checks that a coded mode loses no more frames than
+// any uncoded mode as fast or slower, at every SNR. The header is one codeword
+// with its own parity (SF_FRAME_HEADER_PARITY), then the message is cut in
+// blocks with the parity of the mode.
+//
+// Mode 5 is the binary mode (SF_MFSK_BINARY_MODE): one tone at a time like the
+// single tone mode, so at its full amplitude, each one a group of 4 bits, coded
+// like the modes 3 and 4. It is the mode of the ciphertexts and of the other
+// binary payloads, which don't need to go through base64 (a third more
+// caracters) any more.
+//
+// The last two are the full duplex modes (SF_MFSK_DUPLEX_LOW_MODE and
+// SF_MFSK_DUPLEX_HIGH_MODE): each one keeps to its own part of the band, so two
+// devices can send at the same time, one in each, and listen to the other one.
+// Their start tones are out of the band of the other mode too. The receiver
+// still hears its own emission a lot louder than the other device, it is
+// subtracted first (SFEchoCanceller).
+//
+// The mode is given by the start tone: 17800 Hz is the single tone mode, the
+// multi tone modes have their own start tones under it, out of the window of
+// the single tone receivers (17650-17950 Hz) which ignore these messages. The
+// end of a message is known from its header: the stop tone is one callback only,
+// the fade out of the emission.
+
+#ifndef SoundFi_SFMultiTone_h
+#define SoundFi_SFMultiTone_h
+
+#include <stdint.h>
+
+#include "SFBandPlan.h"
+#include "SFMessageDecoder.h"
+#include "SFToneBank.h"
+#include "SFReedSolomon.h"
+#include "SFFrame.h"
+
+#define SF_MFSK_MODE_COUNT          8
+#define SF_MFSK_MAX_TONES           4
+#define SF_MFSK_MAX_VALUES          16      // tones of the largest sub-band (modes 0, 3, 4 and 5)
+#define SF_MFSK_BAND_WIDTH          1712    // from SF_FIRST_CHAR_FREQUENCY, shared by the sub-bands
+#define SF_MFSK_DUPLEX_LOW_MODE     6       // full duplex, the 18000-19000 Hz half
+#define SF_MFSK_DUPLEX_HIGH_MODE    7       // full duplex, the 19800-21000 Hz half
+#define SF_MFSK_DUPLEX_LOW_FREQUENCY    18000
+#define SF_MFSK_DUPLEX_LOW_WIDTH        1000
+#define SF_MFSK_DUPLEX_HIGH_FREQUENCY   19800
+#define SF_MFSK_DUPLEX_HIGH_WIDTH       1200
+#define SF_MFSK_START_TOLERANCE     50      // Hz around a start tone for the receiver
+#define SF_MFSK_CALLBACK_FRAMES     256     // frames of an emission callback (SF_EMISSION_FRAMES)
+#define SF_MFSK_SINGLE_TONE         (-1)    // mode number of the single tone messaging
+#define SF_MFSK_BINARY_MODE         5       // one tone of 16, the most robust mode for the binary payloads
+#define SF_MFSK_NO_MODE             (-2)    // no start tone after a chirp (sfMultiToneIdentifyMode)
+#define SF_MFSK_CLOCK_PHASE_GAIN    0.1     // part of the timing error of a symbol boundary moved on the next one
+#define SF_MFSK_CLOCK_PERIOD_GAIN   0.002    // part of it added to the symbol period
+#define SF_MFSK_CLOCK_MAX_DRIFT     0.01    // the symbol period stays within 1% of symbolLength
+
+/** A multi tone mode, the receiver know it by its start tone */
+typedef struct SFMultiToneMode {
+    int     startFrequency;
+    int     toneCount;              // tones per symbol, one per sub-band
+    int     bits;                   // per tone, 1 << bits tones in a sub-band
+    int     spacing;                // Hz between two tones of a sub-band
+    int     repeat;                 // callbacks per symbol
+    int     parity;                 // Reed-Solomon parity bytes per block, 0 without error correction
+    int     firstFrequency;         // Hz of the first tone of the first sub-band
+    int     bandWidth;              // Hz from firstFrequency, shared by the sub-bands
+} SFMultiToneMode;
+
+extern const SFMultiToneMode sfMultiToneModes[SF_MFSK_MODE_COUNT];
+
+/** The full duplex mode heard while sending in a full duplex mode, SF_MFSK_SINGLE_TONE for the other modes */
+static inline int sfMultiToneDuplexPeer(int mode) {
+    if (mode == SF_MFSK_DUPLEX_LOW_MODE)
+        return SF_MFSK_DUPLEX_HIGH_MODE;
+    if (mode == SF_MFSK_DUPLEX_HIGH_MODE)
+        return SF_MFSK_DUPLEX_LOW_MODE;
+    return SF_MFSK_SINGLE_TONE;
+}
+
+/** Mode of a start tone found by the receiver: its number in sfMultiToneModes, SF_MFSK_SINGLE_TONE if it's not a multi tone start tone */
+static inline int sfMultiToneFindMode(int frequency) {
+    for (int m = 0; m < SF_MFSK_MODE_COUNT; m++) {
+        int start = sfMultiToneModes[m].startFrequency;
+        if (frequency >= start - SF_MFSK_START_TOLERANCE && frequency < start + SF_MFSK_START_TOLERANCE)
+            return m;
+    }
+    return SF_MFSK_SINGLE_TONE;
+}
+
+/** Mode of the start tone that follows a chirp preamble (SFChirp.h), measured on its samples only.
+
+ @param samples The SF_CHIRP_MODE_FRAMES samples after the chirp
+ @return The number of the mode, SF_MFSK_SINGLE_TONE for SF_START_FREQUENCY, SF_MFSK_NO_MODE if no start tone is clearly there (the chirp was a false detection)
+ */
+int sfMultiToneIdentifyMode(const int16_t *samples, int count, float sampleRate);
+
+/** Frequency of the value of a sub-band */
+static inline float sfMultiToneFrequency(const SFMultiToneMode *mode, int band, int value) {
+    return mode->firstFrequency + band * (mode->bandWidth / mode->toneCount) + value * mode->spacing;
+}
+
+/** Samples of the window of the decoder: one symbol, as long as the bank default at most, cut to a whole number of
+ periods of the spacing. The tones of a sub-band are then orthogonal, each one on a zero of the filters of the others.
+ @return The window, 0 if the symbol is shorter than sampleRate / spacing (the tones can't be told apart)
+ */
+static inline int sfMultiToneWindow(const SFMultiToneMode *mode, float sampleRate) {
+    int longest = mode->repeat * SF_MFSK_CALLBACK_FRAMES;
+    if (longest > SF_TONEBANK_DEFAULT_LENGTH)
+        longest = SF_TONEBANK_DEFAULT_LENGTH;
+    int periods = (int)(longest * mode->spacing / sampleRate);
+    int window = (int)(periods * sampleRate / mode->spacing);
+    return window - window % SF_TONEBANK_SEGMENTS;
+}
+
+/** Bytes sent for the header of a frame, with its parity in a coded mode */
+static inline int sfMultiToneHeaderLength(const SFMultiToneMode *mode) {
+    return mode->parity > 0 ? SF_FRAME_HEADER_LENGTH + SF_FRAME_HEADER_PARITY : SF_FRAME_HEADER_LENGTH;
+}
+
+/** Bytes sent for a message of length bytes: the header, the message and the parity of its blocks */
+static inline int sfMultiToneFrameLength(const SFMultiToneMode *mode, int length) {
+    return sfMultiToneHeaderLength(mode) + (mode->parity > 0 ? sfReedSolomonCodedLength(mode->parity, length) : length);
+}
+
+/** Number of symbols of length bytes (a frame) */
+static inline int sfMultiToneSymbolCount(const SFMultiToneMode *mode, int length) {
+    int bits = mode->toneCount * mode->bits;
+    return (8 * length + bits - 1) / bits;
+}
+
+/** Cut bytes in the values of the tones, the bits most significant first, the last symbol padded with zeros.
+
+ @param values Receive toneCount values per symbol, sfMultiToneSymbolCount(mode, length) symbols: value of band b of symbol s at s * toneCount + b
+ @return The number of symbols
+ */
+int sfMultiToneSplit(const SFMultiToneMode *mode, const char *bytes, int length, uint8_t *values);
+
+
+/**---------------------------------------------------------------------------------------
+ * SFMultiToneDecoder
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Receiver of a multi tone message, from the samples that follow the detection of its start tone.
+
+ A bank of Goertzel filters (SFToneBank, windows of one symbol up to 1024 samples cut to sfMultiToneWindow, evaluated 4 times per window) is tuned on the start tones, the stop tone and every tone of the sub-bands. The multi peak detection is the strongest tone of each sub-band.
+
+ The symbols are sampled on the clock of the emitter: the end of the start tone is found where its energy drops under a quarter of its peak (half the window is in the first symbol), or is given by the chirp preamble (sfMultiToneDecoderResetAtSymbol), then each symbol lasts symbolPeriod samples. The emitter and the receiver don't share a clock (two sound cards are a few hundred ppm apart, a long message in a slow mode drifts by more than a window), so the symbol clock is recovered from the message itself: the window centred on the start of a symbol is half in the previous one, and when the two symbols have different tones in a sub-band their energies give the error on the boundary (an early/late gate, the amplitude of a tone is the part of the window it fills). A second order loop moves the next boundary by a part of the error and corrects symbolPeriod, the drift of the emitter clock. The energies of the windows that are almost entirely in the symbol (an eighth of a window out at most) are added, and the symbol is decided when the next window is out. A symbol where the stop tone is stronger than every data tone ends the message.
+
+ The received bytes are in frame. Once the header is there (corrected first in a coded mode) the length of the frame is known: a header that can't be read ends the reception at once, else the message ends on the last symbol of the frame. Then the Reed-Solomon blocks are corrected, the CRC is checked and the message goes to message. A frame that is cut (stop tone or silence before its end) or whose CRC doesn't match is rejected, message is empty.
+
+ The message can be followed while it is received: frameType and payloadLength are known as soon as the header is read (expectedSymbols > 0), and sfMultiToneDecoderPartial gives the bytes of the payload received so far with the confidence of each one, from the decisions of the tones that carried it (a clear decision is sure, a tone barely above the second one of its sub-band is a guess). These bytes are not corrected yet.
+
+ Like SFMessageDecoder, the decoder is fed by the caller with the buffers of the engine and tell what happened. Memory is allocated by sfMultiToneDecoderCreate only.
+ */
+typedef struct SFMultiToneDecoder {
+    const SFMultiToneMode *mode;
+    int             toneCount;
+    int             bits;                   // per tone
+    int             values;                 // tones per sub-band, 1 << bits
+    int             symbolLength;           // samples
+    SFToneBank      *bank;                  // start tones, stop, then values tones per sub-band
+    SFReedSolomon   *rs;                    // coded modes only
+    SFReedSolomon   *headerRs;              // SF_FRAME_HEADER_PARITY, coded modes only
+    int             otherModes[SF_MFSK_MODE_COUNT];     // modes of the other start tones of the bank
+
+    long            position;               // samples since the reset
+    int             synchronised;
+    float           startPeak;              // strongest start tone seen
+    double          symbolStart;            // first sample of the current symbol
+    double          symbolPeriod;           // samples per symbol on the clock of the emitter, symbolLength at the reset
+    float           *boundary;              // energies of the window centred on symbolStart, for the clock recovery
+    double          boundaryOffset;         // from symbolStart to the centre of that window
+    int             boundaryValid;
+    int             previousTones[SF_MFSK_MAX_TONES];   // tone of each sub-band in the last symbol decided, -1 if unknown
+    float           *energies;              // sum of the windows of the current symbol
+    int             windows;                // windows in energies
+    int             silentSymbols;          // symbols in a row without any tone
+    int             held[SF_MFSK_MAX_TONES];// values of the last silent symbol, appended if the message goes on
+    long            waiting;                // samples since the reset without synchronisation
+
+    uint32_t        accumulator;            // bits not yet in a byte
+    int             accumulated;
+    char            *frame;                 // received bytes, as sent
+    uint8_t         *confidence;            // of each byte of frame, 0..SF_CONFIDENCE_MAX
+    int             byteConfidence;         // lowest confidence of the tones of the byte in accumulator
+    int             frameLength;
+    int             expectedSymbols;        // symbols of the frame once its header is received, 0 before
+    SFFrameType     frameType;              // known with expectedSymbols
+    int             payloadLength;          // bytes of the message, from the header
+    char            *message;               // payload of the frame once it is checked, NUL terminated
+    int             messageLength;
+    int             rejected;               // the frame was cut or corrupted
+    int             dropped;                // bytes over the capacity of frame
+    int             symbolCount;
+    int             quality;                // clear decisions minus doubtful ones, per sub-band
+    int             corrected;              // bytes fixed by the Reed-Solomon code
+    int             failedBlocks;           // blocks with too many errors, the CRC rejects the frame then
+    int             handover;               // mode of the start tone found instead of its own one, SF_MFSK_SINGLE_TONE otherwise
+} SFMultiToneDecoder;
+
+
+/** Create a decoder for a mode.
+
+ @param mode A mode of sfMultiToneModes
+ @return The decoder or NULL
+ */
+SFMultiToneDecoder *sfMultiToneDecoderCreate(float sampleRate, const SFMultiToneMode *mode);
+void sfMultiToneDecoderDestroy(SFMultiToneDecoder *decoder);
+
+/** Start a new message, the start tone has just been detected */
+void sfMultiToneDecoderReset(SFMultiToneDecoder *decoder);
+
+/** Start a new message whose first symbol starts with the next sample given, the end of the start tone is known from a chirp preamble (SFChirp.h) */
+void sfMultiToneDecoderResetAtSymbol(SFMultiToneDecoder *decoder);
+
+/** Give the samples of one buffer.
+
+ @return SFMessageEventCaracter when bytes have been received, SFMessageEventCompleted on the last symbol of the frame (or at the stop tone, rejected tells if the frame is cut), SFMessageEventTimedOut when the header can't be read, when the signal is lost or when the start tone is the one of an other mode (handover, the caller should reset the decoder of that mode and give it the next samples), SFMessageEventNone otherwise
+ */
+SFMessageEvent sfMultiToneDecoderProcess(SFMultiToneDecoder *decoder, const int16_t *samples, int count);
+
+/** The beginning of the payload received so far, before the Reed-Solomon correction.
+
+ The bytes are given as long as they follow each other from the start of the payload. In a coded mode the blocks of a long message are interleaved, the prefix then grows with the bytes of the first block only (one byte every block count bytes received) and the last blocks come with the end of the frame.
+
+ @param text Receive payloadLength bytes at most, not NUL terminated
+ @param confidence Receive the confidence of each byte, 0..SF_CONFIDENCE_MAX (may be NULL)
+ @return The number of bytes, 0 before the header or when the frame is rejected
+ */
+int sfMultiToneDecoderPartial(const SFMultiToneDecoder *decoder, char *text, uint8_t *confidence);
+
+#endif
@@ -0,0 +1,44 @@
+//
+//  SFMultiToneMode.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+// The modes and the cutting of the bytes in tones, all the emitter needs of
+// SFMultiTone.h. The decoder is in SFMultiTone.c, with the tone bank it needs:
+// a renderer links this file alone.
+
+#include "SFMultiTone.h"
+
+const SFMultiToneMode sfMultiToneModes[SF_MFSK_MODE_COUNT] = {
+    //  start  tones  bits  spacing  repeat  parity  first band               band width
+    {   17300,   2,    4,     44,      5,      0,    SF_FIRST_CHAR_FREQUENCY,  SF_MFSK_BAND_WIDTH },
+    {   17400,   3,    3,     44,      5,      0,    SF_FIRST_CHAR_FREQUENCY,  SF_MFSK_BAND_WIDTH },
+    {   17500,   4,    3,     44,      5,      0,    SF_FIRST_CHAR_FREQUENCY,  SF_MFSK_BAND_WIDTH },
+    {   17100,   1,    4,     87,      2,      8,    SF_FIRST_CHAR_FREQUENCY,  SF_MFSK_BAND_WIDTH },
+    {   17200,   1,    4,     87,      2,      4,    SF_FIRST_CHAR_FREQUENCY,  SF_MFSK_BAND_WIDTH },
+    {   17600,   1,    4,     58,      3,      8,    SF_FIRST_CHAR_FREQUENCY,  SF_MFSK_BAND_WIDTH },
+    {   17000,   2,    3,     58,      3,      8,    SF_MFSK_DUPLEX_LOW_FREQUENCY,  SF_MFSK_DUPLEX_LOW_WIDTH },
+    {   21300,   2,    3,     58,      3,      8,    SF_MFSK_DUPLEX_HIGH_FREQUENCY, SF_MFSK_DUPLEX_HIGH_WIDTH },
+};
+
+
+int sfMultiToneSplit(const SFMultiToneMode *mode, const char *bytes, int length, uint8_t *values)
+{
+    const int symbols = sfMultiToneSymbolCount(mode, length);
+    const uint32_t mask = (1u << mode->bits) - 1;
+    uint32_t accumulator = 0;
+    int accumulated = 0, byte = 0;
+
+    for (int v = 0; v < symbols * mode->toneCount; v++) {
+        while (accumulated < mode->bits) {
+            accumulator = (accumulator << 8) | (byte < length ? (unsigned char)bytes[byte] : 0);
+            accumulated += 8;
+            byte++;
+        }
+        accumulated -= mode->bits;
+        values[v] = (uint8_t)((accumulator >> accumulated) & mask);
+    }
+    return symbols;
+}
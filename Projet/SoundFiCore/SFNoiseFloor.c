@@ -0,0 +1,143 @@
+//
+//  SFNoiseFloor.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SFNoiseFloor.h"
+
+#define MIN_POWER   1e-12f      // floor of a digital silence, avoid a division by 0
+
+
+SFNoiseFloor *sfNoiseFloorCreate(int firstBin, int lastBin, float framePeriod)
+{
+    if (firstBin < 0 || lastBin < firstBin || framePeriod <= 0)
+        return NULL;
+
+    SFNoiseFloor *noise = calloc(1, sizeof(SFNoiseFloor));
+    if (noise == NULL)
+        return NULL;
+
+    noise->firstBin = firstBin;
+    noise->binCount = lastBin - firstBin + 1;
+    noise->rate = 1.f - expf(-framePeriod / SF_NOISE_TIME_CONSTANT);
+    noise->toneRate = 1.f - expf(-framePeriod / SF_NOISE_TONE_TIME_CONSTANT);
+    noise->averageLength = (int)lrintf(2.f / noise->rate - 1.f);      // same variance as the exponential average
+    noise->floor = malloc(noise->binCount * sizeof(float));
+    noise->snr = malloc(noise->binCount * sizeof(float));
+
+    if (!noise->floor || !noise->snr) {
+        sfNoiseFloorDestroy(noise);
+        return NULL;
+    }
+
+    sfNoiseFloorSetMargin(noise, SF_NOISE_DEFAULT_MARGIN);
+    sfNoiseFloorReset(noise);
+    return noise;
+}
+
+
+void sfNoiseFloorDestroy(SFNoiseFloor *noise)
+{
+    if (noise == NULL)
+        return;
+    free(noise->floor);
+    free(noise->snr);
+    free(noise);
+}
+
+
+void sfNoiseFloorReset(SFNoiseFloor *noise)
+{
+    memset(noise->floor, 0, noise->binCount * sizeof(float));
+    memset(noise->snr, 0, noise->binCount * sizeof(float));
+    noise->frameCount = 0;
+}
+
+
+void sfNoiseFloorSetMargin(SFNoiseFloor *noise, float marginDb)
+{
+    noise->margin = powf(10.f, marginDb / 10.f);
+}
+
+
+/** Median of the floors of the bins around bin k, the ones of the band */
+static float neighbourFloor(const float *noiseFloor, int binCount, int k)
+{
+    float window[2 * SF_NOISE_NEIGHBOURS + 1];
+    int first = k - SF_NOISE_NEIGHBOURS < 0 ? 0 : k - SF_NOISE_NEIGHBOURS;
+    int last = k + SF_NOISE_NEIGHBOURS >= binCount ? binCount - 1 : k + SF_NOISE_NEIGHBOURS;
+    int count = 0;
+
+    // Insertion sort, a few values
+    for (int j = first; j <= last; j++) {
+        int i = count++;
+        while (i > 0 && window[i - 1] > noiseFloor[j]) {
+            window[i] = window[i - 1];
+            i--;
+        }
+        window[i] = noiseFloor[j];
+    }
+    return window[count / 2];
+}
+
+
+int sfNoiseFloorUpdate(SFNoiseFloor *noise, const float *magnitudes)
+{
+    const int binCount = noise->binCount;
+    const float margin = noise->margin;
+    const float *restrict power = magnitudes + noise->firstBin;
+    float *restrict noiseFloor = noise->floor;
+    float *restrict snr = noise->snr;
+
+    // Warm up: plain average of the first frames
+    if (noise->frameCount < SF_NOISE_WARMUP) {
+        float weight = 1.f / (float)(++noise->frameCount);
+        for (int k = 0; k < binCount; k++) {
+            noiseFloor[k] += weight * (power[k] + MIN_POWER - noiseFloor[k]);
+            snr[k] = (power[k] + MIN_POWER) / noiseFloor[k];
+        }
+        return -1;
+    }
+
+    int best = -1;
+    int over = 0;
+    float bestSnr = margin;
+    const int averaging = noise->frameCount < noise->averageLength;
+
+    for (int k = 0; k < binCount; k++) {
+        snr[k] = (power[k] + MIN_POWER) / (averaging ? neighbourFloor(noiseFloor, binCount, k) : noiseFloor[k]);
+        if (snr[k] >= margin) {
+            over++;
+            if (snr[k] > bestSnr) {
+                bestSnr = snr[k];
+                best = k;
+            }
+        }
+    }
+
+    // A tone only light a few bins, if the whole band is over the margin the noise has changed
+    int broadband = over > SF_NOISE_BROADBAND * binCount;
+    const float rate = averaging ? 1.f / (float)(noise->frameCount + 1) : noise->rate;
+    const float toneRate = broadband ? rate : noise->toneRate;
+
+    for (int k = 0; k < binCount; k++)
+        noiseFloor[k] += (snr[k] < margin ? rate : toneRate) * (power[k] + MIN_POWER - noiseFloor[k]);
+
+    noise->frameCount++;
+    return (best < 0 || broadband) ? -1 : noise->firstBin + best;
+}
+
+
+float sfNoiseFloorSnr(const SFNoiseFloor *noise, int bin)
+{
+    int k = bin - noise->firstBin;
+    if (k < 0 || k >= noise->binCount || noise->snr[k] <= 0)
+        return 0;
+    return 10.f * log10f(noise->snr[k]);
+}
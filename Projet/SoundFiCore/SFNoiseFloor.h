@@ -0,0 +1,72 @@
+//
+//  SFNoiseFloor.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFNoiseFloor_h
+#define SoundFi_SFNoiseFloor_h
+
+#define SF_NOISE_DEFAULT_MARGIN     12.f    // dB over the floor to accept a peak
+#define SF_NOISE_TIME_CONSTANT      1.f     // seconds, how fast the floor follow the noise
+#define SF_NOISE_TONE_TIME_CONSTANT 30.f    // seconds, same thing for a bin over the margin
+#define SF_NOISE_WARMUP             8       // frames used to learn the floor before the first detection
+#define SF_NOISE_BROADBAND          0.25f   // share of the bins over the margin when it's the noise that grows
+#define SF_NOISE_NEIGHBOURS         8       // bins on each side of a bin for its floor at the start
+
+/**---------------------------------------------------------------------------------------
+ * SFNoiseFloor
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Running noise floor of each bin of a band, and the SNR of the last spectrum.
+
+ A single threshold on the magnitude can't work everywhere: the level of the microphone change from one device to the other, and the noise of a store can be over the tones of a quiet room. Each bin keep its own floor, the exponentially smoothed power of the bin (time constant SF_NOISE_TIME_CONSTANT), and the SNR of the bin is its power over its floor. A peak is detected when the SNR is over the margin, in dB.
+
+ - A bin over the margin update its floor much more slowly (SF_NOISE_TONE_TIME_CONSTANT): a tone is not learned as noise in the few seconds it last.
+ - When a lot of bins are over the margin at the same time (SF_NOISE_BROADBAND) it's the noise that has grown, not a tone: there is no detection and every floor is updated normally.
+ - The SF_NOISE_WARMUP first frames only learn the floor (a plain average), without detection.
+ - The floor of a bin is still a plain average until it has as many frames as the exponential average (averageLength, 2 time constants), and it is too noisy for the margin: the power of a noise bin over the mean of n frames is an F(2, 2n) variable, after 8 frames 1.6e-4 of the noise bins are over 12 dB, a false peak in 3% of the spectrums. Until then the SNR of a bin is taken over the median of the floors of its SF_NOISE_NEIGHBOURS neighbours on each side (the noise is smooth in frequency, a tone is only one or two bins): about 17 times more frames in the floor, under 1e-6 false detections like the running floor.
+
+ The spectrum is given as squared magnitudes indexed by bin, only the bins from firstBin to lastBin are used. Like the other objects of the core, one tracker for each stream.
+ */
+typedef struct SFNoiseFloor {
+    int         firstBin;
+    int         binCount;
+    float       margin;             // power ratio, 10^(dB/10)
+    float       rate;               // weight of a new frame in the floor
+    float       toneRate;           // same thing over the margin
+    int         averageLength;      // frames of the exponential average (2/rate - 1), a plain average before
+    float       *floor;             // noise floor of each bin
+    float       *snr;               // power/floor of the last frame (power ratio)
+    int         frameCount;         // frames since the reset
+} SFNoiseFloor;
+
+
+/** Create a tracker.
+
+ @param firstBin First bin of the band
+ @param lastBin Last bin of the band (included)
+ @param framePeriod Time between two spectrums, in seconds (fftSize/sampleRate without overlap)
+ @return The tracker or NULL if the parameters are wrong or there is not enough memory
+ */
+SFNoiseFloor *sfNoiseFloorCreate(int firstBin, int lastBin, float framePeriod);
+void sfNoiseFloorDestroy(SFNoiseFloor *noise);
+
+/** Forget the floor, it is learned again from the next frame */
+void sfNoiseFloorReset(SFNoiseFloor *noise);
+
+/** Change the margin of the detection, SF_NOISE_DEFAULT_MARGIN by default. */
+void sfNoiseFloorSetMargin(SFNoiseFloor *noise, float marginDb);
+
+/** Update the floor with a new spectrum and compute the SNR of each bin.
+
+ @param magnitudes Squared magnitudes, magnitudes[firstBin] to magnitudes[lastBin] are read
+ @return The bin with the best SNR if this SNR is over the margin, -1 otherwise (always -1 during the warm up)
+ */
+int sfNoiseFloorUpdate(SFNoiseFloor *noise, const float *magnitudes);
+
+/** SNR of a bin in the last frame, in dB (0 outside of the band) */
+float sfNoiseFloorSnr(const SFNoiseFloor *noise, int bin);
+
+#endif
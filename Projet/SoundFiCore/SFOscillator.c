@@ -0,0 +1,183 @@
+//
+//  SFOscillator.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SFOscillator.h"
+
+#if defined(__APPLE__)
+#include <Accelerate/Accelerate.h>
+#endif
+
+
+static int allocateTable(SFToneTable *table, int blockLength)
+{
+    table->cosine = malloc((blockLength + 1) * sizeof(float));
+    table->sine = malloc((blockLength + 1) * sizeof(float));
+    return table->cosine && table->sine ? 0 : -1;
+}
+
+static void fillTable(SFToneTable *table, float frequency, float sampleRate, int blockLength)
+{
+    double increment = 2.0 * M_PI * frequency / sampleRate;
+
+    // Each angle is computed from n, no error accumulate along the table
+    for (int n = 0; n <= blockLength; n++) {
+        table->cosine[n] = (float)cos(n * increment);
+        table->sine[n] = (float)sin(n * increment);
+    }
+    table->frequency = frequency;
+}
+
+static int compareFrequencies(const void *a, const void *b)
+{
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+
+SFOscillator *sfOscillatorCreate(float sampleRate, int blockLength, const float *frequencies, int count)
+{
+    if (sampleRate <= 0 || blockLength < 1 || count < 0 || (count > 0 && frequencies == NULL))
+        return NULL;
+
+    SFOscillator *oscillator = calloc(1, sizeof(SFOscillator));
+    if (oscillator == NULL)
+        return NULL;
+
+    oscillator->sampleRate = sampleRate;
+    oscillator->blockLength = blockLength;
+    oscillator->tones = calloc(count > 0 ? count : 1, sizeof(SFToneTable));
+    if (oscillator->tones == NULL || allocateTable(&oscillator->scratch, blockLength) != 0) {
+        sfOscillatorDestroy(oscillator);
+        return NULL;
+    }
+
+    // Sorted without the duplicates for the binary search of sfOscillatorRender
+    float *sorted = malloc((count > 0 ? count : 1) * sizeof(float));
+    if (sorted == NULL) {
+        sfOscillatorDestroy(oscillator);
+        return NULL;
+    }
+    memcpy(sorted, frequencies, count * sizeof(float));
+    qsort(sorted, count, sizeof(float), compareFrequencies);
+
+    for (int t = 0; t < count; t++) {
+        if (oscillator->toneCount > 0 && oscillator->tones[oscillator->toneCount - 1].frequency == sorted[t])
+            continue;
+        SFToneTable *table = &oscillator->tones[oscillator->toneCount++];
+        if (allocateTable(table, blockLength) != 0) {
+            free(sorted);
+            sfOscillatorDestroy(oscillator);
+            return NULL;
+        }
+        fillTable(table, sorted[t], sampleRate, blockLength);
+    }
+    free(sorted);
+
+    oscillator->scratch.frequency = -1;
+    sfOscillatorReset(oscillator);
+    return oscillator;
+}
+
+
+void sfOscillatorDestroy(SFOscillator *oscillator)
+{
+    if (oscillator == NULL)
+        return;
+    for (int t = 0; t < oscillator->toneCount; t++) {
+        free(oscillator->tones[t].cosine);
+        free(oscillator->tones[t].sine);
+    }
+    free(oscillator->tones);
+    free(oscillator->scratch.cosine);
+    free(oscillator->scratch.sine);
+    free(oscillator);
+}
+
+
+void sfOscillatorReset(SFOscillator *oscillator)
+{
+    oscillator->re = 1;
+    oscillator->im = 0;
+    oscillator->amplitude = 0;
+    oscillator->current = NULL;
+}
+
+
+/** Table of a frequency: the last one, the cache, or the scratch table computed now */
+static SFToneTable *findTable(SFOscillator *oscillator, float frequency)
+{
+    if (oscillator->current != NULL && oscillator->current->frequency == frequency)
+        return oscillator->current;
+
+    int low = 0, high = oscillator->toneCount - 1;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        float tone = oscillator->tones[middle].frequency;
+        if (tone == frequency)
+            return oscillator->current = &oscillator->tones[middle];
+        if (tone < frequency)
+            low = middle + 1;
+        else
+            high = middle - 1;
+    }
+
+    if (oscillator->scratch.frequency != frequency)
+        fillTable(&oscillator->scratch, frequency, oscillator->sampleRate, oscillator->blockLength);
+    return oscillator->current = &oscillator->scratch;
+}
+
+
+void sfOscillatorRender(SFOscillator *oscillator, float frequency, float amplitude, float *output, int count)
+{
+    SFToneTable *table = findTable(oscillator, frequency);
+
+    while (count > 0) {
+        int chunk = count < oscillator->blockLength ? count : oscillator->blockLength;
+        float start = oscillator->amplitude;
+        float step = (amplitude - start) / count;
+        float end = start + step * chunk;
+        float sinTheta = (float)oscillator->im;
+        float cosTheta = (float)oscillator->re;
+
+        // output[n] = (sin θ cos nω + cos θ sin nω) * gain[n]
+#if defined(__APPLE__)
+        vDSP_vsmsma(table->cosine, 1, &sinTheta, table->sine, 1, &cosTheta, output, 1, chunk);
+        if (step != 0)
+            vDSP_vrampmul(output, 1, &start, &step, output, 1, chunk);
+        else
+            vDSP_vsmul(output, 1, &start, output, 1, chunk);
+#else
+        {
+            // The gain is accumulated like vDSP_vrampmul does, not computed from n
+            const float *restrict cosine = table->cosine;
+            const float *restrict sine = table->sine;
+            float *restrict out = output;
+            float gain = start;
+            for (int n = 0; n < chunk; n++) {
+                out[n] = (sinTheta * cosine[n] + cosTheta * sine[n]) * gain;
+                gain += step;
+            }
+        }
+#endif
+
+        // θ += chunk ω
+        double c = table->cosine[chunk], s = table->sine[chunk];
+        double re = oscillator->re * c - oscillator->im * s;
+        double im = oscillator->re * s + oscillator->im * c;
+        double norm = 1.0 / sqrt(re * re + im * im);
+        oscillator->re = re * norm;
+        oscillator->im = im * norm;
+        oscillator->amplitude = count == chunk ? amplitude : end;
+
+        output += chunk;
+        count -= chunk;
+    }
+}
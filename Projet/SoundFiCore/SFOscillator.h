@@ -0,0 +1,75 @@
+//
+//  SFOscillator.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFOscillator_h
+#define SoundFi_SFOscillator_h
+
+#define SF_OSCILLATOR_DEFAULT_BLOCK 256     // emission callbacks of the engine (nbrEchantillon)
+
+/** cos(nω) and sin(nω) of one tone for n = 0..blockLength */
+typedef struct SFToneTable {
+    float   frequency;
+    float   *cosine;
+    float   *sine;
+} SFToneTable;
+
+/**---------------------------------------------------------------------------------------
+ * SFOscillator
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Phase continuous sine generator for the emission, without sin() in the render callback.
+
+ The phase is kept as a phasor e^{iθ} (double). A block starting at θ is
+
+    sin(θ + nω) = sin θ cos nω + cos θ sin nω
+
+ so with the cos nω and sin nω of the tone in a table the block is one multiply-add of two tables by two scalars (vDSP_vsmsma on Apple), then the phasor is turned by e^{i count ω} taken in the same table. The phase stays continuous when the frequency change, like the theta of emissionSampleCalcul.
+
+ The tables of the tones given to sfOscillatorCreate are computed once (the cache, the band plan for a SoundFi emitter): sending a message is then only copying. An other frequency use a scratch table computed the first time it's rendered (blockLength+1 sin and cos, once per change of frequency), it's enough for a beacon or a tone generator that keep the same frequency.
+
+ The amplitude is ramped linearly over each block, from the amplitude of the end of the last block to the new one: the fade in and fade out of the emitter don't make a step every callback anymore.
+
+ Memory is allocated by sfOscillatorCreate only, sfOscillatorRender can be called from a render callback.
+ */
+typedef struct SFOscillator {
+    float       sampleRate;
+    int         blockLength;        // longest block rendered in one pass, the longer ones are cut
+
+    double      re;                 // e^{iθ}, θ phase of the next sample
+    double      im;
+    float       amplitude;          // reached at the end of the last block
+
+    SFToneTable *tones;             // the cache, sorted by frequency
+    int         toneCount;
+    SFToneTable scratch;            // last frequency that is not in the cache
+    SFToneTable *current;           // table of the last frequency rendered
+} SFOscillator;
+
+
+/** Create an oscillator.
+
+ @param sampleRate Sample rate of the output
+ @param blockLength Longest block rendered in one pass (SF_OSCILLATOR_DEFAULT_BLOCK, or the largest callback)
+ @param frequencies Tones to precompute, may be NULL
+ @param count Number of tones
+ @return The oscillator or NULL if there is not enough memory
+ */
+SFOscillator *sfOscillatorCreate(float sampleRate, int blockLength, const float *frequencies, int count);
+void sfOscillatorDestroy(SFOscillator *oscillator);
+
+/** Phase 0 and amplitude 0, for a new emission */
+void sfOscillatorReset(SFOscillator *oscillator);
+
+/** Render count samples of a tone, the amplitude goes linearly from the last one to amplitude.
+
+ @param frequency Frequency in Hz, cached or not
+ @param amplitude Amplitude at the end of the block
+ @param output count floats
+ */
+void sfOscillatorRender(SFOscillator *oscillator, float frequency, float amplitude, float *output, int count);
+
+#endif
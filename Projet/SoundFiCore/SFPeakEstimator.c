@@ -0,0 +1,276 @@
+//
+//  SFPeakEstimator.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SFPeakEstimator.h"
+
+#if defined(__APPLE__)
+#include <Accelerate/Accelerate.h>
+#endif
+
+#define JACOBSEN_HANN_CORRECTION    2.f     // for the periodic Hann window, the estimator is then unbiased for a lone tone
+#define MAIN_LOBE                   2       // half width of the Hann main lobe, in bins
+
+
+SFPeakEstimator *sfPeakEstimatorCreate(int fftSize, int hopSize, float sampleRate, float lowFrequency, float highFrequency, SFInterpolation method)
+{
+    int log2n = 0;
+    while ((1 << log2n) < fftSize)
+        log2n++;
+    if (fftSize < 8 || (1 << log2n) != fftSize || hopSize <= 0 || hopSize > fftSize || highFrequency <= lowFrequency
+        || (method != SFInterpolationQuadratic && method != SFInterpolationJacobsen))
+        return NULL;
+
+    int bins = fftSize / 2 + 1;
+    float freqPerBin = sampleRate / (float)fftSize;
+    int firstBin = (int)ceilf(lowFrequency / freqPerBin);
+    int lastBin = (int)floorf(highFrequency / freqPerBin);
+
+    // The interpolation needs a bin on each side of the peak
+    if (firstBin < 1)
+        firstBin = 1;
+    if (lastBin > bins - 2)
+        lastBin = bins - 2;
+    if (lastBin < firstBin)
+        return NULL;
+
+    SFPeakEstimator *estimator = calloc(1, sizeof(SFPeakEstimator));
+    if (estimator == NULL)
+        return NULL;
+
+    estimator->fftSize = fftSize;
+    estimator->hopSize = hopSize;
+    estimator->firstBin = firstBin;
+    estimator->lastBin = lastBin;
+    estimator->sampleRate = sampleRate;
+    estimator->freqPerBin = freqPerBin;
+    estimator->method = method;
+
+    estimator->fft = sfFftCreate(log2n);
+    estimator->window = malloc(fftSize * sizeof(float));
+    estimator->inFIFO = malloc(fftSize * sizeof(float));
+    estimator->frame = malloc(fftSize * sizeof(float));
+    estimator->re = malloc(bins * sizeof(float));
+    estimator->im = malloc(bins * sizeof(float));
+    estimator->magnitudes = malloc(bins * sizeof(float));
+
+    if (!estimator->fft || !estimator->window || !estimator->inFIFO || !estimator->frame || !estimator->re || !estimator->im
+        || !estimator->magnitudes) {
+        sfPeakEstimatorDestroy(estimator);
+        return NULL;
+    }
+
+    // Periodic Hann window, its sum is fftSize/2
+    double sum = 0;
+    for (int k = 0; k < fftSize; k++) {
+        estimator->window[k] = (float)(.5 - .5 * cos(2. * M_PI * (double)k / (double)fftSize));
+        sum += estimator->window[k];
+    }
+    estimator->windowGain = (float)(4. / (sum * sum));
+
+    sfPeakEstimatorReset(estimator);
+    return estimator;
+}
+
+
+void sfPeakEstimatorDestroy(SFPeakEstimator *estimator)
+{
+    if (estimator == NULL)
+        return;
+    sfFftDestroy(estimator->fft);
+    free(estimator->window);
+    free(estimator->inFIFO);
+    free(estimator->frame);
+    free(estimator->re);
+    free(estimator->im);
+    free(estimator->magnitudes);
+    free(estimator);
+}
+
+
+void sfPeakEstimatorReset(SFPeakEstimator *estimator)
+{
+    memset(estimator->inFIFO, 0, estimator->fftSize * sizeof(float));
+    memset(&estimator->peak, 0, sizeof(SFPeak));
+    estimator->rover = estimator->fftSize - estimator->hopSize;
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * PeakOffset
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Position of the tone relative to the centre of the peak bin, in bins (-0.5..0.5 for a clean tone). */
+static float peakOffset(SFPeakEstimator *estimator, int peak)
+{
+    const float *re = estimator->re;
+    const float *im = estimator->im;
+    const float *magnitudes = estimator->magnitudes;
+
+    if (estimator->method == SFInterpolationJacobsen) {
+        // (X[k-1] - X[k+1]) / (2X[k] - X[k-1] - X[k+1]), only the real part is used
+        float nr = re[peak - 1] - re[peak + 1];
+        float ni = im[peak - 1] - im[peak + 1];
+        float dr = 2.f * re[peak] - re[peak - 1] - re[peak + 1];
+        float di = 2.f * im[peak] - im[peak - 1] - im[peak + 1];
+        float denominator = dr * dr + di * di;
+        if (denominator <= 0)
+            return 0;
+        return JACOBSEN_HANN_CORRECTION * (nr * dr + ni * di) / denominator;
+    }
+
+    // Parabola on the log magnitude, the log of the squared magnitude give the same vertex
+    float a = logf(magnitudes[peak - 1] + 1e-20f);
+    float b = logf(magnitudes[peak] + 1e-20f);
+    float c = logf(magnitudes[peak + 1] + 1e-20f);
+    float curvature = a - 2.f * b + c;
+    if (curvature >= 0)
+        return 0;
+    return .5f * (a - c) / curvature;
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * PeakAnalyseFrame
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Analyse the frame in inFIFO and update estimator->peak. */
+static void peakAnalyseFrame(SFPeakEstimator *estimator)
+{
+    const int fftSize = estimator->fftSize;
+    const int firstBin = estimator->firstBin;
+    const int lastBin = estimator->lastBin;
+    float *restrict re = estimator->re;
+    float *restrict im = estimator->im;
+    float *restrict magnitudes = estimator->magnitudes;
+    SFPeak *result = &estimator->peak;
+    int peak = firstBin;
+    float peakMagnitude = 0;
+    float bandEnergy = 0;
+
+#if defined(__APPLE__)
+    vDSP_vmul(estimator->inFIFO, 1, estimator->window, 1, estimator->frame, 1, fftSize);
+#else
+    {
+        const float *restrict in = estimator->inFIFO;
+        const float *restrict window = estimator->window;
+        float *restrict frame = estimator->frame;
+        for (int k = 0; k < fftSize; k++)
+            frame[k] = in[k] * window[k];
+    }
+#endif
+
+    sfFftForward(estimator->fft, estimator->frame, re, im);
+
+    // The neighbours of the band edges are needed by the interpolation
+#if defined(__APPLE__)
+    {
+        DSPSplitComplex spectrum = { re + firstBin - 1, im + firstBin - 1 };
+        vDSP_Length index = 0;
+        vDSP_zvmags(&spectrum, 1, magnitudes + firstBin - 1, 1, lastBin - firstBin + 3);
+        vDSP_maxvi(magnitudes + firstBin, 1, &peakMagnitude, &index, lastBin - firstBin + 1);
+        vDSP_sve(magnitudes + firstBin, 1, &bandEnergy, lastBin - firstBin + 1);
+        peak = firstBin + (int)index;
+    }
+#else
+    for (int k = firstBin - 1; k <= lastBin + 1; k++)
+        magnitudes[k] = re[k] * re[k] + im[k] * im[k];
+    for (int k = firstBin; k <= lastBin; k++) {
+        bandEnergy += magnitudes[k];
+        if (magnitudes[k] > peakMagnitude) {
+            peakMagnitude = magnitudes[k];
+            peak = k;
+        }
+    }
+#endif
+
+    if (peakMagnitude <= 0) {
+        memset(result, 0, sizeof(SFPeak));
+        return;
+    }
+
+    float offset = peakOffset(estimator, peak);
+    if (offset > .5f)
+        offset = .5f;
+    else if (offset < -.5f)
+        offset = -.5f;
+
+    // Height of the log parabola at the vertex, it corrects the loss when the tone is between two bins
+    float a = logf(magnitudes[peak - 1] + 1e-20f);
+    float c = logf(magnitudes[peak + 1] + 1e-20f);
+    float logPeak = logf(peakMagnitude) - .25f * (a - c) * offset;
+
+    float lobeEnergy = 0;
+    for (int k = peak - MAIN_LOBE; k <= peak + MAIN_LOBE; k++) {
+        if (k >= firstBin && k <= lastBin)
+            lobeEnergy += magnitudes[k];
+    }
+
+    result->frequency = ((float)peak + offset) * estimator->freqPerBin;
+    result->power = expf(logPeak) * estimator->windowGain;
+    result->confidence = lobeEnergy / bandEnergy;
+}
+
+
+int sfPeakEstimatorProcessFloat(SFPeakEstimator *estimator, const float *samples, int count, SFPeak *peak)
+{
+    const int fftSize = estimator->fftSize;
+    const int hopSize = estimator->hopSize;
+    const int latency = fftSize - hopSize;
+    int frameCount = 0;
+
+    while (count > 0) {
+        int chunk = fftSize - estimator->rover;
+        if (chunk > count)
+            chunk = count;
+
+        memcpy(estimator->inFIFO + estimator->rover, samples, chunk * sizeof(float));
+        estimator->rover += chunk;
+        samples += chunk;
+        count -= chunk;
+
+        if (estimator->rover >= fftSize) {
+            peakAnalyseFrame(estimator);
+            frameCount++;
+
+            memmove(estimator->inFIFO, estimator->inFIFO + hopSize, latency * sizeof(float));
+            estimator->rover = latency;
+        }
+    }
+
+    if (frameCount > 0 && peak != NULL)
+        *peak = estimator->peak;
+    return frameCount;
+}
+
+
+int sfPeakEstimatorProcessInt16(SFPeakEstimator *estimator, const int16_t *samples, int count, SFPeak *peak)
+{
+    float buffer[256];
+    int frameCount = 0;
+
+    // Convert by small chunks on the stack, no allocation in the audio thread
+    while (count > 0) {
+        int chunk = count < 256 ? count : 256;
+#if defined(__APPLE__)
+        vDSP_vflt16((short *)samples, 1, buffer, 1, chunk);
+#else
+        for (int i = 0; i < chunk; i++)
+            buffer[i] = (float)samples[i];
+#endif
+        frameCount += sfPeakEstimatorProcessFloat(estimator, buffer, chunk, NULL);
+        samples += chunk;
+        count -= chunk;
+    }
+
+    if (frameCount > 0 && peak != NULL)
+        *peak = estimator->peak;
+    return frameCount;
+}
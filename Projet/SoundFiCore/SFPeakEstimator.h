@@ -0,0 +1,94 @@
+//
+//  SFPeakEstimator.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFPeakEstimator_h
+#define SoundFi_SFPeakEstimator_h
+
+#include <stdint.h>
+
+#include "SFFft.h"
+
+#define SF_PEAK_DEFAULT_SIZE        1024    // 43 Hz bins at 44.1 kHz, the interpolation does the rest
+#define SF_PEAK_DEFAULT_HOP         256     // a result every 256 samples, as the messaging callbacks
+#define SF_PEAK_MIN_POWER           4900    // same minimal level as the tone bank (amplitude 70)
+#define SF_PEAK_MIN_CONFIDENCE      0.5f
+
+enum {
+    SFInterpolationQuadratic = 0,           // parabola on the log magnitude of the 3 bins around the peak
+    SFInterpolationJacobsen = 1             // complex ratio of the 3 bins, corrected for the Hann window
+};
+typedef int SFInterpolation;
+
+/** The result of one transform */
+typedef struct SFPeak {
+    float       frequency;          // interpolated frequency of the peak, 0 when the band is empty
+    float       power;              // amplitude^2 of the tone, corrected from the window and the position in the bin
+    float       confidence;         // share of the band energy that is in the main lobe of the peak, 0..1
+} SFPeak;
+
+/**---------------------------------------------------------------------------------------
+ * SFPeakEstimator
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Frequency of the strongest peak of a band, from a single windowed FFT.
+
+ The FFT bin of a 1024 points transform is 43 Hz wide, far more than the 18 Hz between two caracters, but the 3 bins around a peak are enough to place the tone inside its bin:
+
+ - SFInterpolationQuadratic fit a parabola on the log of the magnitudes, with a Hann window the main lobe is close to a gaussian so the bias stay under 1 Hz at 1024 points,
+ - SFInterpolationJacobsen use the complex values, delta = P * Re((X[k-1] - X[k+1]) / (2X[k] - X[k-1] - X[k+1])), P = 2 correct the widening of the lobe by the Hann window.
+
+ With one transform every hop and no phase from the previous frame (at the opposite of SFVocoder) the result does not depend on how the stream is cut in buffers: the engine can keep the same IO buffer size in every mode.
+
+ The confidence is the energy of the 5 bins of the main lobe over the energy of the whole band, near 1 for a clean tone and near 5/bandBins for white noise. Like the other objects of the core, one estimator for each stream.
+ */
+typedef struct SFPeakEstimator {
+    int             fftSize;
+    int             hopSize;
+    int             firstBin;           // band searched for the peak, the neighbours of these bins are in the spectrum
+    int             lastBin;
+    float           sampleRate;
+    float           freqPerBin;
+    SFInterpolation method;
+
+    SFFft           *fft;
+    float           *window;            // Hann table
+    float           windowGain;         // 4/(sum of the window)^2, |X|^2 to amplitude^2
+    float           *inFIFO;            // fftSize samples
+    float           *frame;
+    float           *re;                // fftSize/2+1
+    float           *im;
+    float           *magnitudes;        // squared magnitudes
+    int             rover;              // write index in inFIFO
+    SFPeak          peak;               // last result
+} SFPeakEstimator;
+
+
+/** Create an estimator.
+
+ @param fftSize FFT size, a power of 2 (SF_PEAK_DEFAULT_SIZE in the engine)
+ @param hopSize Samples between two transforms, at most fftSize
+ @param sampleRate The sample rate of the stream
+ @param lowFrequency Lower edge of the band searched for the peak
+ @param highFrequency Upper edge of the band
+ @param method SFInterpolationQuadratic or SFInterpolationJacobsen
+ @return The estimator or NULL if the parameters are wrong or there is not enough memory
+ */
+SFPeakEstimator *sfPeakEstimatorCreate(int fftSize, int hopSize, float sampleRate, float lowFrequency, float highFrequency, SFInterpolation method);
+void sfPeakEstimatorDestroy(SFPeakEstimator *estimator);
+
+/** Forget the samples and the last result */
+void sfPeakEstimatorReset(SFPeakEstimator *estimator);
+
+/** Push samples and analyse every frame that is complete.
+
+ @param peak Receive the result of the last frame analysed during this call, not modified if no frame was analysed
+ @return The number of frames analysed
+ */
+int sfPeakEstimatorProcessFloat(SFPeakEstimator *estimator, const float *samples, int count, SFPeak *peak);
+int sfPeakEstimatorProcessInt16(SFPeakEstimator *estimator, const int16_t *samples, int count, SFPeak *peak);
+
+#endif
@@ -0,0 +1,432 @@
+//
+//  SFPromotionCache.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "SFPromotionCache.h"
+
+
+SFPromotionCache *sfPromotionCacheCreate(int capacity)
+{
+    if (capacity < 0)
+        return NULL;
+    if (capacity == 0)
+        capacity = SF_PROMOTION_CAPACITY;
+
+    SFPromotionCache *cache = calloc(1, sizeof(SFPromotionCache));
+    if (cache == NULL)
+        return NULL;
+    cache->capacity = capacity;
+    cache->promotions = calloc(capacity, sizeof(SFPromotion));
+    if (cache->promotions == NULL) {
+        sfPromotionCacheDestroy(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+
+void sfPromotionCacheDestroy(SFPromotionCache *cache)
+{
+    if (cache == NULL)
+        return;
+    free(cache->promotions);
+    free(cache);
+}
+
+
+static int findPromotion(const SFPromotionCache *cache, int id)
+{
+    for (int i = 0; i < cache->count; i++) {
+        if (cache->promotions[i].id == id)
+            return i;
+    }
+    return -1;
+}
+
+
+SFPromotionState sfPromotionCacheLookup(const SFPromotionCache *cache, int id, double now, const SFPromotion **promotion)
+{
+    int index = findPromotion(cache, id);
+    if (promotion != NULL)
+        *promotion = index < 0 ? NULL : &cache->promotions[index];
+    if (index < 0)
+        return SFPromotionMissing;
+    return now < cache->promotions[index].expires ? SFPromotionFresh : SFPromotionStale;
+}
+
+
+#pragma mark - JSON
+
+// Only what the responses of the server need: the string and number fields of
+// flat objects, the other values are skipped.
+
+static const char *skipSpace(const char *p, const char *end)
+{
+    while (p < end && isspace((unsigned char)*p))
+        p++;
+    return p;
+}
+
+/** Append a code point in UTF-8 if it fits whole (the NUL is always kept) */
+static void appendCodePoint(char *out, int capacity, int *length, unsigned int code)
+{
+    char bytes[4];
+    int count;
+    if (code < 0x80) {
+        bytes[0] = (char)code;
+        count = 1;
+    }
+    else if (code < 0x800) {
+        bytes[0] = (char)(0xc0 | (code >> 6));
+        bytes[1] = (char)(0x80 | (code & 0x3f));
+        count = 2;
+    }
+    else if (code < 0x10000) {
+        bytes[0] = (char)(0xe0 | (code >> 12));
+        bytes[1] = (char)(0x80 | ((code >> 6) & 0x3f));
+        bytes[2] = (char)(0x80 | (code & 0x3f));
+        count = 3;
+    }
+    else {
+        bytes[0] = (char)(0xf0 | (code >> 18));
+        bytes[1] = (char)(0x80 | ((code >> 12) & 0x3f));
+        bytes[2] = (char)(0x80 | ((code >> 6) & 0x3f));
+        bytes[3] = (char)(0x80 | (code & 0x3f));
+        count = 4;
+    }
+    if (*length + count >= capacity)
+        return;
+    memcpy(out + *length, bytes, count);
+    *length += count;
+}
+
+static int readHex(const char *p, const char *end, unsigned int *value)
+{
+    if (end - p < 4)
+        return -1;
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = (unsigned char)p[i];
+        int digit = isdigit(c) ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        if (digit < 0)
+            return -1;
+        *value = *value * 16 + digit;
+    }
+    return 0;
+}
+
+/** Read the string at p (on its quote) in out, truncated to capacity if needed (may be NULL to skip it).
+
+ @return The caracter after the closing quote, NULL if it's not a string
+ */
+static const char *parseString(const char *p, const char *end, char *out, int capacity)
+{
+    char scratch[1];
+    if (out == NULL) {
+        out = scratch;
+        capacity = 1;
+    }
+    int length = 0;
+
+    if (p >= end || *p != '"')
+        return NULL;
+    for (p++; p < end && *p != '"'; p++) {
+        unsigned int code = (unsigned char)*p;
+        if (code == '\\') {
+            if (++p >= end)
+                return NULL;
+            switch (*p) {
+                case 'b': code = '\b'; break;
+                case 'f': code = '\f'; break;
+                case 'n': code = '\n'; break;
+                case 'r': code = '\r'; break;
+                case 't': code = '\t'; break;
+                case 'u':
+                    if (readHex(p + 1, end, &code) != 0)
+                        return NULL;
+                    p += 4;
+                    // A pair of surrogates is one code point
+                    if (code >= 0xd800 && code < 0xdc00 && end - p > 6 && p[1] == '\\' && p[2] == 'u') {
+                        unsigned int low;
+                        if (readHex(p + 3, end, &low) == 0 && low >= 0xdc00 && low < 0xe000) {
+                            code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                            p += 6;
+                        }
+                    }
+                    appendCodePoint(out, capacity, &length, code);
+                    continue;
+                default: code = (unsigned char)*p; break;      // \" \\ \/
+            }
+        }
+        // The bytes of the UTF-8 of the response are copied as they are
+        if (length + 1 < capacity)
+            out[length++] = (char)code;
+    }
+    if (p >= end)
+        return NULL;
+
+    // Don't end on a truncated UTF-8 sequence
+    if (length + 1 >= capacity) {
+        int start = length;
+        while (start > 0 && ((unsigned char)out[start - 1] & 0xc0) == 0x80)
+            start--;
+        if (start > 0 && (unsigned char)out[start - 1] >= 0xc0) {
+            int lead = (unsigned char)out[start - 1];
+            int expected = lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : 2;
+            if (length - (start - 1) < expected)
+                length = start - 1;
+        }
+    }
+    out[length] = '\0';
+    return p + 1;
+}
+
+/** Skip the value at p, return the caracter after it or NULL */
+static const char *skipValue(const char *p, const char *end)
+{
+    if (p >= end)
+        return NULL;
+    if (*p == '"')
+        return parseString(p, end, NULL, 0);
+    if (*p != '{' && *p != '[') {
+        while (p < end && *p != ',' && *p != '}' && *p != ']' && !isspace((unsigned char)*p))
+            p++;
+        return p;
+    }
+
+    int depth = 0;
+    while (p < end) {
+        if (*p == '"') {
+            p = parseString(p, end, NULL, 0);
+            if (p == NULL)
+                return NULL;
+            continue;
+        }
+        if (*p == '{' || *p == '[')
+            depth++;
+        else if ((*p == '}' || *p == ']') && --depth == 0)
+            return p + 1;
+        p++;
+    }
+    return NULL;
+}
+
+/** Read the object at p (on its brace) in promotion.
+
+ @return The caracter after the object, NULL if it's not an object or it has no "Promotion"
+ */
+static const char *parseObject(const char *p, const char *end, SFPromotion *promotion)
+{
+    char key[16];
+    int hasText = 0;
+
+    memset(promotion, 0, sizeof(SFPromotion));
+    if (p >= end || *p != '{')
+        return NULL;
+    p = skipSpace(p + 1, end);
+    if (p < end && *p == '}')
+        return NULL;
+
+    while (p < end) {
+        p = parseString(p, end, key, sizeof(key));
+        if (p == NULL)
+            return NULL;
+        p = skipSpace(p, end);
+        if (p >= end || *p != ':')
+            return NULL;
+        p = skipSpace(p + 1, end);
+
+        if (!strcmp(key, "Promotion") && p < end && *p == '"') {
+            p = parseString(p, end, promotion->text, SF_PROMOTION_TEXT);
+            hasText = 1;
+        }
+        else if (!strcmp(key, "image_url") && p < end && *p == '"')
+            p = parseString(p, end, promotion->imageUrl, SF_PROMOTION_URL);
+        else if (!strcmp(key, "etag") && p < end && *p == '"')
+            p = parseString(p, end, promotion->etag, SF_PROMOTION_ETAG);
+        else if (!strcmp(key, "id") && p < end) {
+            // A number or a string of digits, the body is not NUL terminated
+            const char *digits = p + (*p == '"');
+            int32_t id = 0;
+            int sign = digits < end && *digits == '-' ? -1 : 1;
+            for (digits += sign < 0; digits < end && *digits >= '0' && *digits <= '9' && id < 100000000; digits++)
+                id = id * 10 + (*digits - '0');
+            promotion->id = sign * id;
+            p = skipValue(p, end);
+        }
+        else
+            p = skipValue(p, end);
+        if (p == NULL)
+            return NULL;
+
+        p = skipSpace(p, end);
+        if (p < end && *p == ',') {
+            p = skipSpace(p + 1, end);
+            continue;
+        }
+        if (p < end && *p == '}')
+            return hasText ? p + 1 : NULL;
+        return NULL;
+    }
+    return NULL;
+}
+
+
+#pragma mark - Store
+
+/** Put a promotion in the cache: in place of the one of the same spot, in a free record, or in place of the one that expire first */
+static void putPromotion(SFPromotionCache *cache, const SFPromotion *promotion)
+{
+    int index = findPromotion(cache, promotion->id);
+    if (index < 0 && cache->count < cache->capacity)
+        index = cache->count++;
+    if (index < 0) {
+        index = 0;
+        for (int i = 1; i < cache->count; i++) {
+            if (cache->promotions[i].expires < cache->promotions[index].expires)
+                index = i;
+        }
+    }
+    cache->promotions[index] = *promotion;
+}
+
+
+int sfPromotionCacheStore(SFPromotionCache *cache, int id, const char *body, int length, const char *etag, double maxAge, double now)
+{
+    // Whatever the server prints before the object is ignored, like the regular expressions did
+    const char *end = body + length;
+    const char *p = memchr(body, '{', length);
+    SFPromotion promotion;
+    if (id == 0 || p == NULL || parseObject(p, end, &promotion) == NULL)
+        return -1;
+
+    promotion.id = id;
+    promotion.expires = now + maxAge;
+    if (etag != NULL) {
+        strncpy(promotion.etag, etag, SF_PROMOTION_ETAG - 1);
+        promotion.etag[SF_PROMOTION_ETAG - 1] = '\0';
+    }
+    putPromotion(cache, &promotion);
+    return 0;
+}
+
+
+int sfPromotionCacheStoreArea(SFPromotionCache *cache, const char *body, int length, double maxAge, double now)
+{
+    const char *end = body + length;
+    const char *p = skipSpace(body, end);
+    if (p >= end || *p != '[')
+        return -1;
+    p = skipSpace(p + 1, end);
+
+    int stored = 0;
+    while (p < end && *p != ']') {
+        SFPromotion promotion;
+        const char *next = parseObject(p, end, &promotion);
+        if (next == NULL) {
+            // Not a promotion, the next object may be one
+            next = skipValue(p, end);
+            if (next == NULL)
+                return -1;
+        }
+        else if (promotion.id != 0) {
+            promotion.expires = now + maxAge;
+            putPromotion(cache, &promotion);
+            stored++;
+        }
+        p = skipSpace(next, end);
+        if (p < end && *p == ',')
+            p = skipSpace(p + 1, end);
+    }
+    return p < end ? stored : -1;
+}
+
+
+int sfPromotionCacheRevalidate(SFPromotionCache *cache, int id, double maxAge, double now)
+{
+    int index = findPromotion(cache, id);
+    if (index < 0)
+        return -1;
+    cache->promotions[index].expires = now + maxAge;
+    return 0;
+}
+
+
+double sfPromotionMaxAge(const char *cacheControl)
+{
+    if (cacheControl == NULL)
+        return SF_PROMOTION_DEFAULT_TTL;
+
+    double maxAge = SF_PROMOTION_DEFAULT_TTL;
+    for (const char *p = cacheControl; *p;) {
+        while (*p == ',' || isspace((unsigned char)*p))
+            p++;
+        const char *directive = p;
+        while (*p && *p != ',')
+            p++;
+        size_t length = p - directive;
+        if ((length >= 8 && !strncasecmp(directive, "no-cache", 8)) || (length >= 8 && !strncasecmp(directive, "no-store", 8)))
+            return 0;
+        if (length > 8 && !strncasecmp(directive, "max-age=", 8))
+            maxAge = strtod(directive + 8, NULL);
+    }
+    return maxAge < 0 ? 0 : maxAge;
+}
+
+
+#pragma mark - File
+
+int sfPromotionCacheSave(const SFPromotionCache *cache, const char *path)
+{
+    SFPromotionHeader header;
+    memcpy(header.magic, SF_PROMOTION_MAGIC, 4);
+    header.version = SF_PROMOTION_VERSION;
+    header.count = (uint32_t)cache->count;
+    header.reserved = 0;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return -1;
+    int written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  fwrite(cache->promotions, sizeof(SFPromotion), cache->count, file) == (size_t)cache->count;
+    return fclose(file) == 0 && written ? 0 : -1;
+}
+
+
+int sfPromotionCacheLoad(SFPromotionCache *cache, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return -1;
+
+    // The size is checked first, a file cut short doesn't change the cache
+    SFPromotionHeader header;
+    long size = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    int count = -1;
+    if (size >= (long)sizeof(header) && fseek(file, 0, SEEK_SET) == 0 && fread(&header, sizeof(header), 1, file) == 1 &&
+        !memcmp(header.magic, SF_PROMOTION_MAGIC, 4) && header.version == SF_PROMOTION_VERSION &&
+        (size_t)size == sizeof(header) + (size_t)header.count * sizeof(SFPromotion)) {
+        count = header.count < (uint32_t)cache->capacity ? (int)header.count : cache->capacity;
+        if (fread(cache->promotions, sizeof(SFPromotion), count, file) != (size_t)count)
+            count = 0;
+        cache->count = count;
+
+        // The strings of a file are not trusted to be terminated
+        for (int i = 0; i < count; i++) {
+            cache->promotions[i].etag[SF_PROMOTION_ETAG - 1] = '\0';
+            cache->promotions[i].text[SF_PROMOTION_TEXT - 1] = '\0';
+            cache->promotions[i].imageUrl[SF_PROMOTION_URL - 1] = '\0';
+        }
+    }
+    fclose(file);
+    return count;
+}
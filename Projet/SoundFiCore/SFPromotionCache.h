@@ -0,0 +1,117 @@
+//
+//  SFPromotionCache.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFPromotionCache_h
+#define SoundFi_SFPromotionCache_h
+
+#include <stdint.h>
+
+#define SF_PROMOTION_CAPACITY       256     // promotions kept, the ones that expire first are replaced
+#define SF_PROMOTION_TEXT           256     // bytes of the text of a promotion, UTF-8, NUL included
+#define SF_PROMOTION_URL            256     // bytes of the URL of its image
+#define SF_PROMOTION_ETAG           64      // bytes of the ETag of the response
+#define SF_PROMOTION_DEFAULT_TTL    3600.   // seconds, when the server doesn't give a max-age
+#define SF_PROMOTION_MAGIC          "SFPC"
+#define SF_PROMOTION_VERSION        1
+
+/**---------------------------------------------------------------------------------------
+ * SFPromotionCache
+ *  ---------------------------------------------------------------------------------------
+ */
+/** The promotions of the geomarketing spots, kept on the phone so a validated spot is notified without waiting for the server.
+
+ A promotion is keyed by the id of its spot, the frequency sent to the server (test.php?id=). The response of the server is parsed once, when it's stored: the fields "image_url" and "Promotion" of a JSON object, or of each object of an array for the bulk prefetch of an area (each object has its "id" then, and its "etag" for the revalidation). The strings are unescaped, the \u escapes are written in UTF-8.
+
+ Each promotion has the ETag of its response and an expiry date, from the max-age of the Cache-Control header (SF_PROMOTION_DEFAULT_TTL without it):
+
+ - fresh, it's used as it is,
+ - stale, it's still used (the user is in the store now) but it must be revalidated: the request is sent with If-None-Match, a 304 only gives a new expiry date (sfPromotionCacheRevalidate),
+ - missing, the request is sent and the notification waits for it.
+
+ The dates are in seconds, on any clock of the caller. The promotions are fixed size records, sfPromotionCacheSave write them as they are in a file and sfPromotionCacheLoad read them back: the promotions of the last area are there without network. The cache doesn't do any network and isn't thread safe, the caller serialise the calls.
+ */
+typedef enum SFPromotionState {
+    SFPromotionMissing = 0,
+    SFPromotionFresh,
+    SFPromotionStale,
+} SFPromotionState;
+
+typedef struct SFPromotion {
+    int32_t     id;                             // id of the spot, 0 for a free record
+    int32_t     reserved;
+    double      expires;                        // date after which it must be revalidated
+    char        etag[SF_PROMOTION_ETAG];        // "" if the server didn't give one
+    char        text[SF_PROMOTION_TEXT];
+    char        imageUrl[SF_PROMOTION_URL];
+} SFPromotion;
+
+typedef struct SFPromotionHeader {
+    char        magic[4];                       // SF_PROMOTION_MAGIC
+    uint32_t    version;                        // SF_PROMOTION_VERSION
+    uint32_t    count;                          // then the promotions, native byte order
+    uint32_t    reserved;
+} SFPromotionHeader;
+
+typedef struct SFPromotionCache {
+    SFPromotion *promotions;
+    int         capacity;
+    int         count;
+} SFPromotionCache;
+
+
+/** Create an empty cache.
+
+ @param capacity Number of promotions kept, SF_PROMOTION_CAPACITY for 0
+ @return The cache or NULL
+ */
+SFPromotionCache *sfPromotionCacheCreate(int capacity);
+void sfPromotionCacheDestroy(SFPromotionCache *cache);
+
+/** Find the promotion of a spot.
+
+ @param promotion Receive the promotion if there is one (may be NULL), valid until the next change of the cache
+ @return Fresh, stale or missing
+ */
+SFPromotionState sfPromotionCacheLookup(const SFPromotionCache *cache, int id, double now, const SFPromotion **promotion);
+
+/** Store the response of the server for one spot.
+
+ @param body The JSON object of the response, not NUL terminated
+ @param etag The ETag header, NULL if there is none
+ @param maxAge Seconds before it must be revalidated (sfPromotionMaxAge)
+ @return 0, -1 if the body is not a promotion (the cache is not changed)
+ */
+int sfPromotionCacheStore(SFPromotionCache *cache, int id, const char *body, int length, const char *etag, double maxAge, double now);
+
+/** Store the promotions of an area, a JSON array of objects with their "id".
+
+ @return The number of promotions stored, -1 if the body is not an array of promotions
+ */
+int sfPromotionCacheStoreArea(SFPromotionCache *cache, const char *body, int length, double maxAge, double now);
+
+/** The server answered 304 to a revalidation: the promotion is fresh again for maxAge.
+
+ @return 0, -1 if there is no promotion for this spot
+ */
+int sfPromotionCacheRevalidate(SFPromotionCache *cache, int id, double maxAge, double now);
+
+/** Time to live given by a Cache-Control header: its max-age, 0 for no-cache or no-store, SF_PROMOTION_DEFAULT_TTL if there is no header or no max-age */
+double sfPromotionMaxAge(const char *cacheControl);
+
+/** Write the promotions in a file for sfPromotionCacheLoad.
+
+ @return 0, -1 if the file can't be written
+ */
+int sfPromotionCacheSave(const SFPromotionCache *cache, const char *path);
+
+/** Replace the promotions by the ones of a file written by sfPromotionCacheSave.
+
+ @return The number of promotions read, -1 if the file can't be read or is not a cache (the cache is not changed)
+ */
+int sfPromotionCacheLoad(SFPromotionCache *cache, const char *path);
+
+#endif
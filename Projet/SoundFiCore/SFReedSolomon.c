@@ -0,0 +1,253 @@
+//
+//  SFReedSolomon.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFReedSolomon.h"
+
+#define SF_RS_POLYNOMIAL            0x11d   // x^8 + x^4 + x^3 + x^2 + 1, α = 2
+
+
+static inline uint8_t multiply(const SFReedSolomon *rs, uint8_t a, uint8_t b)
+{
+    return (a == 0 || b == 0) ? 0 : rs->exp[rs->log[a] + rs->log[b]];
+}
+
+static inline uint8_t divide(const SFReedSolomon *rs, uint8_t a, uint8_t b)
+{
+    return a == 0 ? 0 : rs->exp[rs->log[a] + 255 - rs->log[b]];
+}
+
+
+SFReedSolomon *sfReedSolomonCreate(int parity)
+{
+    if (parity < 2 || parity > SF_RS_MAX_PARITY || parity % 2 != 0)
+        return NULL;
+
+    SFReedSolomon *rs = calloc(1, sizeof(SFReedSolomon));
+    if (rs == NULL)
+        return NULL;
+    rs->parity = parity;
+
+    int x = 1;
+    for (int i = 0; i < 255; i++) {
+        rs->exp[i] = rs->exp[i + 255] = (uint8_t)x;
+        rs->log[x] = (uint8_t)i;
+        x <<= 1;
+        if (x & 0x100)
+            x ^= SF_RS_POLYNOMIAL;
+    }
+    rs->exp[510] = rs->exp[0];
+    rs->exp[511] = rs->exp[1];
+
+    // Roots α^0 .. α^(parity-1)
+    rs->generator[0] = 1;
+    for (int i = 0; i < parity; i++) {
+        uint8_t root = rs->exp[i];
+        rs->generator[i + 1] = 0;
+        for (int j = i + 1; j > 0; j--)
+            rs->generator[j] ^= multiply(rs, rs->generator[j - 1], root);
+    }
+    return rs;
+}
+
+
+void sfReedSolomonDestroy(SFReedSolomon *rs)
+{
+    free(rs);
+}
+
+
+void sfReedSolomonEncode(const SFReedSolomon *rs, const uint8_t *data, int length, uint8_t *parity)
+{
+    const int p = rs->parity;
+
+    // Remainder of data(x)·x^parity by the generator, a shift register
+    memset(parity, 0, p);
+    for (int i = 0; i < length; i++) {
+        uint8_t feedback = data[i] ^ parity[0];
+        for (int j = 0; j < p - 1; j++)
+            parity[j] = parity[j + 1] ^ multiply(rs, feedback, rs->generator[j + 1]);
+        parity[p - 1] = multiply(rs, feedback, rs->generator[p]);
+    }
+}
+
+
+/** Syndromes S_i = c(α^i), return 1 if one of them is not 0 */
+static int syndromes(const SFReedSolomon *rs, const uint8_t *block, int length, uint8_t *syndrome)
+{
+    int errors = 0;
+    for (int i = 0; i < rs->parity; i++) {
+        uint8_t s = 0;
+        for (int k = 0; k < length; k++)
+            s = multiply(rs, s, rs->exp[i]) ^ block[k];
+        syndrome[i] = s;
+        errors |= s;
+    }
+    return errors != 0;
+}
+
+
+int sfReedSolomonDecode(const SFReedSolomon *rs, uint8_t *block, int length)
+{
+    const int p = rs->parity;
+    uint8_t syndrome[SF_RS_MAX_PARITY];
+
+    if (length <= p || length > SF_RS_BLOCK_LENGTH)
+        return -1;
+    if (!syndromes(rs, block, length, syndrome))
+        return 0;
+
+    // Berlekamp-Massey: error locator Λ(x), lowest degree first
+    uint8_t locator[SF_RS_MAX_PARITY + 1] = { 1 }, previous[SF_RS_MAX_PARITY + 1] = { 1 }, saved[SF_RS_MAX_PARITY + 1];
+    int degree = 0, shift = 1;
+    uint8_t lastDiscrepancy = 1;
+    for (int n = 0; n < p; n++) {
+        uint8_t discrepancy = syndrome[n];
+        for (int i = 1; i <= degree; i++)
+            discrepancy ^= multiply(rs, locator[i], syndrome[n - i]);
+
+        if (discrepancy == 0) {
+            shift++;
+            continue;
+        }
+        uint8_t factor = divide(rs, discrepancy, lastDiscrepancy);
+        if (2 * degree <= n) {
+            memcpy(saved, locator, sizeof(locator));
+            for (int i = 0; i + shift <= p; i++)
+                locator[i + shift] ^= multiply(rs, factor, previous[i]);
+            degree = n + 1 - degree;
+            memcpy(previous, saved, sizeof(previous));
+            lastDiscrepancy = discrepancy;
+            shift = 1;
+        }
+        else {
+            for (int i = 0; i + shift <= p; i++)
+                locator[i + shift] ^= multiply(rs, factor, previous[i]);
+            shift++;
+        }
+    }
+    if (degree > p / 2)
+        return -1;
+
+    // Ω(x) = S(x)Λ(x) mod x^parity
+    uint8_t evaluator[SF_RS_MAX_PARITY];
+    for (int i = 0; i < p; i++) {
+        uint8_t value = 0;
+        for (int j = 0; j <= i && j <= degree; j++)
+            value ^= multiply(rs, locator[j], syndrome[i - j]);
+        evaluator[i] = value;
+    }
+
+    // Chien search on the positions of the block, Forney for the values. block[k] is the coefficient of x^(length-1-k)
+    int found = 0;
+    for (int k = 0; k < length; k++) {
+        int power = length - 1 - k;                     // X = α^power
+        int inverse = (255 - power) % 255;              // X^-1
+
+        uint8_t value = 0;
+        for (int i = degree; i >= 0; i--)
+            value = multiply(rs, value, rs->exp[inverse]) ^ locator[i];
+        if (value != 0)
+            continue;
+
+        uint8_t omega = 0, derivative = 0;
+        for (int i = p - 1; i >= 0; i--)
+            omega = multiply(rs, omega, rs->exp[inverse]) ^ evaluator[i];
+        for (int i = 1; i <= degree; i += 2)            // Λ'(x) keeps the odd terms only
+            derivative ^= multiply(rs, locator[i], rs->exp[(inverse * (i - 1)) % 255]);
+        if (derivative == 0)
+            return -1;
+
+        block[k] ^= multiply(rs, rs->exp[power], divide(rs, omega, derivative));
+        found++;
+    }
+
+    // Every root must be in the block, and the result must be a codeword
+    if (found != degree || syndromes(rs, block, length, syndrome))
+        return -1;
+    return found;
+}
+
+
+int sfReedSolomonCodedLength(int parity, int length)
+{
+    int blocks = (length + SF_RS_BLOCK_LENGTH - parity - 1) / (SF_RS_BLOCK_LENGTH - parity);
+    return length + blocks * parity;
+}
+
+
+/** Data bytes of block i when length bytes are cut in blocks of the same size, the first ones take the remainder */
+static inline int blockData(int length, int blocks, int i)
+{
+    return length / blocks + (i < length % blocks);
+}
+
+// The blocks are interleaved byte by byte: byte j of block i is at j*blocks + i. Only the first
+// blocks can have one byte more, so the last row is the start of a full one.
+
+int sfReedSolomonCodedPosition(int parity, int length, int index)
+{
+    int blocks = (sfReedSolomonCodedLength(parity, length) + SF_RS_BLOCK_LENGTH - 1) / SF_RS_BLOCK_LENGTH;
+    int first = 0, i = 0;
+
+    for (int data = blockData(length, blocks, 0); index >= first + data; data = blockData(length, blocks, ++i))
+        first += data;
+    return (index - first) * blocks + i;
+}
+
+int sfReedSolomonEncodeMessage(const SFReedSolomon *rs, const char *message, int length, char *coded)
+{
+    const int p = rs->parity;
+    int codedLength = sfReedSolomonCodedLength(p, length);
+    int blocks = (codedLength + SF_RS_BLOCK_LENGTH - 1) / SF_RS_BLOCK_LENGTH;
+    uint8_t block[SF_RS_BLOCK_LENGTH];
+
+    for (int i = 0, first = 0; i < blocks; i++) {
+        int data = blockData(length, blocks, i);
+        memcpy(block, message + first, data);
+        sfReedSolomonEncode(rs, block, data, block + data);
+        first += data;
+        for (int j = 0; j < data + p; j++)
+            coded[j * blocks + i] = (char)block[j];
+    }
+    return codedLength;
+}
+
+
+int sfReedSolomonDecodeMessage(const SFReedSolomon *rs, const char *coded, int codedLength, char *message, int *corrected, int *failed)
+{
+    const int p = rs->parity;
+    int blocks = (codedLength + SF_RS_BLOCK_LENGTH - 1) / SF_RS_BLOCK_LENGTH;
+    int length = codedLength - blocks * p;
+    uint8_t block[SF_RS_BLOCK_LENGTH];
+    int fixed = 0, lost = 0;
+
+    if (blocks == 0 || length < blocks || sfReedSolomonCodedLength(p, length) != codedLength)
+        return -1;
+
+    for (int i = 0, first = 0; i < blocks; i++) {
+        int data = blockData(length, blocks, i);
+        for (int j = 0; j < data + p; j++)
+            block[j] = (uint8_t)coded[j * blocks + i];
+
+        int errors = sfReedSolomonDecode(rs, block, data + p);
+        if (errors < 0)
+            lost++;
+        else
+            fixed += errors;
+        memcpy(message + first, block, data);
+        first += data;
+    }
+
+    if (corrected != NULL)
+        *corrected = fixed;
+    if (failed != NULL)
+        *failed = lost;
+    return length;
+}
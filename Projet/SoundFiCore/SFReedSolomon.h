@@ -0,0 +1,81 @@
+//
+//  SFReedSolomon.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFReedSolomon_h
+#define SoundFi_SFReedSolomon_h
+
+#include <stdint.h>
+
+#define SF_RS_BLOCK_LENGTH          255     // bytes of a full codeword, GF(256)
+#define SF_RS_MAX_PARITY            64      // parity bytes of a codeword, corrects parity/2 bytes
+
+/**---------------------------------------------------------------------------------------
+ * SFReedSolomon
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Reed-Solomon code over the bytes, the forward error correction of the coded messages.
+
+ A codeword is the data bytes followed by parity bytes (systematic code, shortened from RS(255, 255-parity)), it corrects up to parity/2 wrong bytes wherever they are. The decoder is the usual one: syndromes, Berlekamp-Massey for the error locator, Chien search for its roots and Forney for the values. It either gives back the sent bytes or tell the block can't be corrected, it never guess.
+
+ A message longer than a codeword is cut in blocks of the same size, and the bytes of the blocks are interleaved (byte j of every block, then byte j+1...): a burst of errors on the air, like a lost symbol that carries 2 bytes, is spread over the blocks.
+
+ The tables are in the struct, the coding and decoding don't allocate memory. A codec can be shared by several threads.
+ */
+typedef struct SFReedSolomon {
+    int         parity;
+    uint8_t     exp[512];                       // α^i, twice so the products don't need a modulo
+    uint8_t     log[256];
+    uint8_t     generator[SF_RS_MAX_PARITY + 1];// ∏(x - α^i), highest degree first
+} SFReedSolomon;
+
+
+/** Create a codec.
+
+ @param parity Parity bytes of a codeword, even, 2..SF_RS_MAX_PARITY
+ @return The codec or NULL
+ */
+SFReedSolomon *sfReedSolomonCreate(int parity);
+void sfReedSolomonDestroy(SFReedSolomon *rs);
+
+/** Compute the parity of one codeword.
+
+ @param data length bytes, length <= SF_RS_BLOCK_LENGTH - parity
+ @param parity Receive the parity bytes
+ */
+void sfReedSolomonEncode(const SFReedSolomon *rs, const uint8_t *data, int length, uint8_t *parity);
+
+/** Correct one codeword in place.
+
+ @param block data then parity, length bytes
+ @return The number of corrected bytes, -1 if the block has too many errors
+ */
+int sfReedSolomonDecode(const SFReedSolomon *rs, uint8_t *block, int length);
+
+/** Length of a coded message: the message and the parity of each of its blocks */
+int sfReedSolomonCodedLength(int parity, int length);
+
+/** Position in the coded message of the byte index of a message of length bytes (where it is received) */
+int sfReedSolomonCodedPosition(int parity, int length, int index);
+
+/** Cut a message in blocks, add their parity and interleave them.
+
+ @param coded Receive sfReedSolomonCodedLength bytes
+ @return The coded length
+ */
+int sfReedSolomonEncodeMessage(const SFReedSolomon *rs, const char *message, int length, char *coded);
+
+/** Deinterleave and correct a coded message.
+
+ @param coded codedLength bytes, as received
+ @param message Receive the message (at most codedLength bytes), the data bytes as received for the blocks that can't be corrected
+ @param corrected Receive the number of corrected bytes (may be NULL)
+ @param failed Receive the number of blocks that can't be corrected (may be NULL)
+ @return The length of message, -1 if codedLength is not the length of a coded message
+ */
+int sfReedSolomonDecodeMessage(const SFReedSolomon *rs, const char *coded, int codedLength, char *message, int *corrected, int *failed);
+
+#endif
@@ -0,0 +1,111 @@
+//
+//  SFRingBuffer.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFRingBuffer.h"
+
+
+SFRingBuffer *sfRingBufferCreate(uint32_t capacity)
+{
+    uint32_t size = 1;
+    while (size < capacity && size < 0x40000000)
+        size <<= 1;
+
+    SFRingBuffer *ring = calloc(1, sizeof(SFRingBuffer));
+    if (ring == NULL)
+        return NULL;
+
+    ring->samples = calloc(size, sizeof(int16_t));
+    if (ring->samples == NULL) {
+        free(ring);
+        return NULL;
+    }
+    ring->capacity = size;
+    ring->mask = size - 1;
+    return ring;
+}
+
+
+void sfRingBufferDestroy(SFRingBuffer *ring)
+{
+    if (ring == NULL)
+        return;
+    free(ring->samples);
+    free(ring);
+}
+
+
+void sfRingBufferReset(SFRingBuffer *ring)
+{
+    __atomic_store_n(&ring->writeIndex, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->readIndex, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->overruns, 0, __ATOMIC_RELEASE);
+}
+
+
+int sfRingBufferWrite(SFRingBuffer *ring, const int16_t *samples, int count)
+{
+    uint32_t writeIndex = ring->writeIndex;                                     // ours, no need to synchronise
+    uint32_t readIndex = __atomic_load_n(&ring->readIndex, __ATOMIC_ACQUIRE);
+    uint32_t space = ring->capacity - (writeIndex - readIndex);
+
+    if (count < 0)
+        count = 0;
+    if ((uint32_t)count > space) {
+        __atomic_store_n(&ring->overruns, ring->overruns + (uint32_t)count - space, __ATOMIC_RELAXED);
+        count = (int)space;
+    }
+
+    // At most two copies, before and after the end of the ring
+    uint32_t position = writeIndex & ring->mask;
+    uint32_t first = ring->capacity - position;
+    if (first > (uint32_t)count)
+        first = (uint32_t)count;
+    memcpy(ring->samples + position, samples, first * sizeof(int16_t));
+    memcpy(ring->samples, samples + first, (count - first) * sizeof(int16_t));
+
+    __atomic_store_n(&ring->writeIndex, writeIndex + (uint32_t)count, __ATOMIC_RELEASE);
+    return count;
+}
+
+
+int sfRingBufferRead(SFRingBuffer *ring, int16_t *samples, int count)
+{
+    uint32_t readIndex = ring->readIndex;
+    uint32_t writeIndex = __atomic_load_n(&ring->writeIndex, __ATOMIC_ACQUIRE);
+    uint32_t available = writeIndex - readIndex;
+
+    if (count < 0)
+        count = 0;
+    if ((uint32_t)count > available)
+        count = (int)available;
+
+    uint32_t position = readIndex & ring->mask;
+    uint32_t first = ring->capacity - position;
+    if (first > (uint32_t)count)
+        first = (uint32_t)count;
+    memcpy(samples, ring->samples + position, first * sizeof(int16_t));
+    memcpy(samples + first, ring->samples, (count - first) * sizeof(int16_t));
+
+    __atomic_store_n(&ring->readIndex, readIndex + (uint32_t)count, __ATOMIC_RELEASE);
+    return count;
+}
+
+
+uint32_t sfRingBufferAvailable(const SFRingBuffer *ring)
+{
+    uint32_t readIndex = __atomic_load_n(&ring->readIndex, __ATOMIC_ACQUIRE);
+    return __atomic_load_n(&ring->writeIndex, __ATOMIC_ACQUIRE) - readIndex;
+}
+
+
+uint32_t sfRingBufferOverruns(const SFRingBuffer *ring)
+{
+    return __atomic_load_n(&ring->overruns, __ATOMIC_RELAXED);
+}
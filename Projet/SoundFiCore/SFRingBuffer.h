@@ -0,0 +1,69 @@
+//
+//  SFRingBuffer.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFRingBuffer_h
+#define SoundFi_SFRingBuffer_h
+
+#include <stdint.h>
+
+#define SF_RING_DEFAULT_CAPACITY    16384   // ~370 ms at 44.1 kHz, 8 buffers of 2048 frames
+
+/**---------------------------------------------------------------------------------------
+ * SFRingBuffer
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Lock-free ring of Int16 samples between one producer thread and one consumer thread.
+
+ The audio render callback must never wait: it only copy its samples in the ring and return, the analysis is done by an other thread (SFAnalysisWorker) that empty the ring.
+
+ - The memory is allocated by sfRingBufferCreate, nothing is allocated after.
+ - There is no lock: the producer is the only one to write writeIndex, the consumer the only one to write readIndex. Both are counters that are never wrapped (the position in the ring is index & mask), they are published with a release store and read with an acquire load so the samples are visible before the index.
+ - When the ring is full the producer does not wait for the consumer: the samples that don't fit are dropped and counted in overruns.
+
+ Only one thread may call sfRingBufferWrite and only one thread may call sfRingBufferRead.
+ */
+typedef struct SFRingBuffer {
+    int16_t     *samples;
+    uint32_t    capacity;           // power of 2
+    uint32_t    mask;               // capacity - 1
+
+    uint32_t    writeIndex;         // written by the producer only
+    uint32_t    readIndex;          // written by the consumer only
+    uint32_t    overruns;           // samples dropped by the producer because the ring was full
+} SFRingBuffer;
+
+
+/** Create a ring.
+
+ @param capacity Number of samples, rounded up to a power of 2 (SF_RING_DEFAULT_CAPACITY if you don't know)
+ @return The ring or NULL if there is not enough memory
+ */
+SFRingBuffer *sfRingBufferCreate(uint32_t capacity);
+void sfRingBufferDestroy(SFRingBuffer *ring);
+
+/** Empty the ring and clear the counter, neither the producer nor the consumer may be running. */
+void sfRingBufferReset(SFRingBuffer *ring);
+
+/** Producer side: copy samples in the ring, never block and never allocate.
+
+ @return The number of samples written, less than count if the ring was full (the others are counted in overruns)
+ */
+int sfRingBufferWrite(SFRingBuffer *ring, const int16_t *samples, int count);
+
+/** Consumer side: copy up to count samples out of the ring.
+
+ @return The number of samples read
+ */
+int sfRingBufferRead(SFRingBuffer *ring, int16_t *samples, int count);
+
+/** Samples waiting in the ring, can be read from any thread (exact on the consumer side) */
+uint32_t sfRingBufferAvailable(const SFRingBuffer *ring);
+
+/** Samples dropped since the reset, can be read from any thread */
+uint32_t sfRingBufferOverruns(const SFRingBuffer *ring);
+
+#endif
@@ -0,0 +1,306 @@
+//
+//  SFToneBank.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SFToneBank.h"
+
+
+SFToneBank *sfToneBankCreate(float sampleRate, const float *frequencies, int toneCount, int blockLength)
+{
+    if (toneCount <= 0 || blockLength < SF_TONEBANK_SEGMENTS)
+        return NULL;
+
+    SFToneBank *bank = calloc(1, sizeof(SFToneBank));
+    if (bank == NULL)
+        return NULL;
+
+    bank->toneCount = toneCount;
+    bank->segmentLength = blockLength / SF_TONEBANK_SEGMENTS;
+    bank->blockLength = bank->segmentLength * SF_TONEBANK_SEGMENTS;
+    bank->sampleRate = sampleRate;
+
+    bank->frequencies = malloc(toneCount * sizeof(float));
+    bank->coefficients = malloc(toneCount * sizeof(float));
+    bank->endRe = malloc(toneCount * sizeof(float));
+    bank->endIm = malloc(toneCount * sizeof(float));
+    bank->shiftRe = malloc(toneCount * sizeof(float));
+    bank->shiftIm = malloc(toneCount * sizeof(float));
+    bank->s1 = calloc(toneCount, sizeof(float));
+    bank->s2 = calloc(toneCount, sizeof(float));
+    bank->s1Im = calloc(toneCount, sizeof(float));
+    bank->s2Im = calloc(toneCount, sizeof(float));
+    bank->segmentRe = calloc(SF_TONEBANK_SEGMENTS * toneCount, sizeof(float));
+    bank->segmentIm = calloc(SF_TONEBANK_SEGMENTS * toneCount, sizeof(float));
+    bank->energies = calloc(toneCount, sizeof(float));
+
+    if (!bank->frequencies || !bank->coefficients || !bank->endRe || !bank->endIm || !bank->shiftRe || !bank->shiftIm
+        || !bank->s1 || !bank->s2 || !bank->s1Im || !bank->s2Im || !bank->segmentRe || !bank->segmentIm || !bank->energies) {
+        sfToneBankDestroy(bank);
+        return NULL;
+    }
+
+    for (int t = 0; t < toneCount; t++) {
+        double w = 2.0 * M_PI * frequencies[t] / sampleRate;
+        bank->frequencies[t] = frequencies[t];
+        bank->coefficients[t] = (float)(2.0 * cos(w));
+        bank->endRe[t] = (float)cos(w * (bank->segmentLength - 1));
+        bank->endIm[t] = (float)-sin(w * (bank->segmentLength - 1));
+        bank->shiftRe[t] = (float)cos(w * bank->segmentLength);
+        bank->shiftIm[t] = (float)-sin(w * bank->segmentLength);
+    }
+
+    return bank;
+}
+
+
+void sfToneBankDestroy(SFToneBank *bank)
+{
+    if (bank == NULL)
+        return;
+    free(bank->frequencies);
+    free(bank->coefficients);
+    free(bank->endRe);
+    free(bank->endIm);
+    free(bank->shiftRe);
+    free(bank->shiftIm);
+    free(bank->s1);
+    free(bank->s2);
+    free(bank->s1Im);
+    free(bank->s2Im);
+    free(bank->segmentRe);
+    free(bank->segmentIm);
+    free(bank->energies);
+    free(bank);
+}
+
+
+/** Empty the Goertzel filters */
+static void toneBankClearFilters(SFToneBank *bank)
+{
+    memset(bank->s1, 0, bank->toneCount * sizeof(float));
+    memset(bank->s2, 0, bank->toneCount * sizeof(float));
+    memset(bank->s1Im, 0, bank->toneCount * sizeof(float));
+    memset(bank->s2Im, 0, bank->toneCount * sizeof(float));
+}
+
+
+void sfToneBankReset(SFToneBank *bank)
+{
+    toneBankClearFilters(bank);
+    memset(bank->energies, 0, bank->toneCount * sizeof(float));
+    bank->segmentFill = 0;
+    bank->segmentIndex = 0;
+    bank->segmentDone = 0;
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * ToneBankFilter
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Run every Goertzel filter on count samples.
+
+ s(n) = x(n) + 2cos(w)*s(n-1) - s(n-2). The tone loop is the inner one, the arrays are contiguous and not aliased so it's vectorised.
+ */
+static void toneBankFilter(SFToneBank *bank, const float *restrict samples, int count, float *restrict s1, float *restrict s2)
+{
+    const int toneCount = bank->toneCount;
+    const float *restrict coefficients = bank->coefficients;
+
+    for (int i = 0; i < count; i++) {
+        const float x = samples[i];
+        for (int t = 0; t < toneCount; t++) {
+            float s0 = x + coefficients[t] * s1[t] - s2[t];
+            s2[t] = s1[t];
+            s1[t] = s0;
+        }
+    }
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * ToneBankEndSegment
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Store the DFT of the segment that just ended and restart the filters.
+
+ X = e^-jw(N-1) * (s1 - e^-jw * s2), the phase is relative to the first sample of the segment. For a complex input the DFT of the imaginary part is added times j (the imaginary filters are empty with a real input).
+ */
+static void toneBankEndSegment(SFToneBank *bank)
+{
+    const int toneCount = bank->toneCount;
+    float *restrict re = bank->segmentRe + bank->segmentIndex * toneCount;
+    float *restrict im = bank->segmentIm + bank->segmentIndex * toneCount;
+
+    for (int t = 0; t < toneCount; t++) {
+        // s1*e^-jw(N-1) - s2*e^-jwN
+        float realRe = bank->s1[t] * bank->endRe[t] - bank->s2[t] * bank->shiftRe[t];
+        float realIm = bank->s1[t] * bank->endIm[t] - bank->s2[t] * bank->shiftIm[t];
+        float imagRe = bank->s1Im[t] * bank->endRe[t] - bank->s2Im[t] * bank->shiftRe[t];
+        float imagIm = bank->s1Im[t] * bank->endIm[t] - bank->s2Im[t] * bank->shiftIm[t];
+        re[t] = realRe - imagIm;
+        im[t] = realIm + imagRe;
+    }
+
+    toneBankClearFilters(bank);
+    bank->segmentFill = 0;
+    if (++bank->segmentIndex == SF_TONEBANK_SEGMENTS)
+        bank->segmentIndex = 0;
+    if (bank->segmentDone < SF_TONEBANK_SEGMENTS)
+        bank->segmentDone++;
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * ToneBankEvaluate
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Energy of each tone on the whole window.
+
+ The segments are summed from the newest to the oldest, each sum being shifted by e^-jwN (Horner), so every segment get the phase of its position in the window.
+ */
+static void toneBankEvaluate(SFToneBank *bank)
+{
+    const int toneCount = bank->toneCount;
+    float *restrict energies = bank->energies;
+    const float scale = 4.f / ((float)bank->blockLength * (float)bank->blockLength);    // a sinus of amplitude A give A^2
+
+    int newest = (bank->segmentIndex + SF_TONEBANK_SEGMENTS - 1) % SF_TONEBANK_SEGMENTS;
+    const float *re = bank->segmentRe + newest * toneCount;
+    const float *im = bank->segmentIm + newest * toneCount;
+    float *restrict sumRe = bank->s1;           // the filters are empty at this point, use their memory
+    float *restrict sumIm = bank->s2;
+
+    memcpy(sumRe, re, toneCount * sizeof(float));
+    memcpy(sumIm, im, toneCount * sizeof(float));
+
+    for (int j = 1; j < SF_TONEBANK_SEGMENTS; j++) {
+        int slot = (newest + SF_TONEBANK_SEGMENTS - j) % SF_TONEBANK_SEGMENTS;
+        re = bank->segmentRe + slot * toneCount;
+        im = bank->segmentIm + slot * toneCount;
+        for (int t = 0; t < toneCount; t++) {
+            float r = sumRe[t] * bank->shiftRe[t] - sumIm[t] * bank->shiftIm[t] + re[t];
+            float i = sumRe[t] * bank->shiftIm[t] + sumIm[t] * bank->shiftRe[t] + im[t];
+            sumRe[t] = r;
+            sumIm[t] = i;
+        }
+    }
+
+    for (int t = 0; t < toneCount; t++) {
+        energies[t] = (sumRe[t] * sumRe[t] + sumIm[t] * sumIm[t]) * scale;
+    }
+
+    memset(sumRe, 0, toneCount * sizeof(float));
+    memset(sumIm, 0, toneCount * sizeof(float));
+}
+
+
+/** Run the filters on a real (im == NULL) or complex stream, segment by segment */
+static int toneBankProcess(SFToneBank *bank, const float *re, const float *im, int count)
+{
+    int updated = 0;
+
+    // Only the last blockLength samples matter, restart on a segment boundary
+    if (count > bank->blockLength) {
+        re += count - bank->blockLength;
+        if (im != NULL)
+            im += count - bank->blockLength;
+        count = bank->blockLength;
+        toneBankClearFilters(bank);
+        bank->segmentFill = 0;
+    }
+
+    while (count > 0) {
+        int chunk = bank->segmentLength - bank->segmentFill;
+        if (chunk > count)
+            chunk = count;
+
+        toneBankFilter(bank, re, chunk, bank->s1, bank->s2);
+        re += chunk;
+        if (im != NULL) {
+            toneBankFilter(bank, im, chunk, bank->s1Im, bank->s2Im);
+            im += chunk;
+        }
+        bank->segmentFill += chunk;
+        count -= chunk;
+
+        if (bank->segmentFill == bank->segmentLength) {
+            toneBankEndSegment(bank);
+            if (bank->segmentDone == SF_TONEBANK_SEGMENTS)
+                updated = 1;
+        }
+    }
+
+    if (updated)
+        toneBankEvaluate(bank);
+    return updated;
+}
+
+
+int sfToneBankProcessFloat(SFToneBank *bank, const float *samples, int count)
+{
+    return toneBankProcess(bank, samples, NULL, count);
+}
+
+
+int sfToneBankProcessComplex(SFToneBank *bank, const float *re, const float *im, int count)
+{
+    return toneBankProcess(bank, re, im, count);
+}
+
+
+int sfToneBankProcessInt16(SFToneBank *bank, const int16_t *samples, int count)
+{
+    float buffer[256];
+    int updated = 0;
+
+    if (count > bank->blockLength) {
+        samples += count - bank->blockLength;
+        count = bank->blockLength;
+        toneBankClearFilters(bank);
+        bank->segmentFill = 0;
+    }
+
+    // Convert by small chunks on the stack, no allocation in the audio thread
+    while (count > 0) {
+        int chunk = count < 256 ? count : 256;
+        for (int i = 0; i < chunk; i++)
+            buffer[i] = (float)samples[i];
+        updated |= sfToneBankProcessFloat(bank, buffer, chunk);
+        samples += chunk;
+        count -= chunk;
+    }
+    return updated;
+}
+
+
+int sfToneBankStrongest(const SFToneBank *bank, float *energy)
+{
+    int best = -1;
+    float bestEnergy = 0;
+    float total = 0;
+
+    for (int t = 0; t < bank->toneCount; t++) {
+        total += bank->energies[t];
+        if (bank->energies[t] > bestEnergy) {
+            bestEnergy = bank->energies[t];
+            best = t;
+        }
+    }
+
+    if (energy != NULL)
+        *energy = bestEnergy;
+
+    if (bestEnergy < SF_TONEBANK_MIN_ENERGY)
+        return -1;
+    if (bestEnergy * bank->toneCount < SF_TONEBANK_MIN_DOMINANCE * total)
+        return -1;
+    return best;
+}
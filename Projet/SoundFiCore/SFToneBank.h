@@ -0,0 +1,90 @@
+//
+//  SFToneBank.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFToneBank_h
+#define SoundFi_SFToneBank_h
+
+#include <stdint.h>
+
+#define SF_TONEBANK_DEFAULT_LENGTH  1024    // ~23ms at 44.1kHz, shorter than one caracter (5*256 frames)
+#define SF_TONEBANK_MIN_ENERGY      4900.f  // Amplitude ~70 in Int16 unit, same level as the 5e9 FFT threshold
+#define SF_TONEBANK_MIN_DOMINANCE   4.f     // Strongest tone must be 4 times over the bank average
+#define SF_TONEBANK_SEGMENTS        4       // Window update every blockLength/4 samples (256 frames)
+
+/**---------------------------------------------------------------------------------------
+ * SFToneBank
+ *  ---------------------------------------------------------------------------------------
+ */
+/** A bank of Goertzel filters tuned on a fixed list of frequencies.
+
+ Instead of a whole FFT we only compute the energy of the frequencies we are looking for (the band plan). The result is the DFT of the last blockLength samples at each frequency, updated every blockLength/SF_TONEBANK_SEGMENTS samples.
+
+ To avoid running the filters again on the whole window at each update, the window is cut in SF_TONEBANK_SEGMENTS segments: each sample goes only once in the Goertzel filters, and at the end of a segment its complex result is kept. The window value is the sum of the last segments, phase aligned. The filters are run side by side (the loop on the tones is the inner one) so the compiler can vectorise it.
+
+ The CPU cost is about toneCount operations per sample, it does not depend on the callback size. Like SFVocoder, a bank has no shared state and can be used on any thread, one thread at a time.
+ */
+typedef struct SFToneBank {
+    int         toneCount;
+    int         blockLength;        // window size in samples
+    int         segmentLength;      // blockLength/SF_TONEBANK_SEGMENTS
+    float       sampleRate;
+
+    float       *frequencies;       // tone frequencies (Hz)
+    float       *coefficients;      // 2*cos(w), w=2*PI*f/sampleRate
+    float       *endRe;             // e^-jw(segmentLength-1), DFT of a segment from the filter state
+    float       *endIm;
+    float       *shiftRe;           // e^-jw*segmentLength, phase shift between two segments
+    float       *shiftIm;
+    float       *s1;                // Goertzel states
+    float       *s2;
+    float       *s1Im;              // Goertzel states of the imaginary part (complex input only)
+    float       *s2Im;
+    float       *segmentRe;         // SF_TONEBANK_SEGMENTS*toneCount, DFT of the last segments
+    float       *segmentIm;
+    float       *energies;          // result of the last evaluation
+
+    int         segmentFill;        // samples in the current segment
+    int         segmentIndex;       // next slot of segmentRe/segmentIm (the oldest one)
+    int         segmentDone;        // number of complete segments (up to SF_TONEBANK_SEGMENTS)
+} SFToneBank;
+
+
+/** Create a tone bank.
+
+ @param sampleRate The sample rate of the audio stream
+ @param frequencies The frequencies to track (copied)
+ @param toneCount Number of frequencies
+ @param blockLength Window size, a multiple of SF_TONEBANK_SEGMENTS (use SF_TONEBANK_DEFAULT_LENGTH if you don't know)
+ @return The bank or NULL if there is not enough memory
+ */
+SFToneBank *sfToneBankCreate(float sampleRate, const float *frequencies, int toneCount, int blockLength);
+void sfToneBankDestroy(SFToneBank *bank);
+
+/** Forget the samples in the window */
+void sfToneBankReset(SFToneBank *bank);
+
+/** Push samples in the filters and evaluate every tone on the last blockLength samples each time a segment is complete.
+
+ @return 1 if the energies have been updated, 0 if the window is not full yet or no segment has been completed
+ */
+int sfToneBankProcessInt16(SFToneBank *bank, const int16_t *samples, int count);
+int sfToneBankProcessFloat(SFToneBank *bank, const float *samples, int count);
+
+/** Same as sfToneBankProcessFloat for a complex stream (like the SFDownconverter output).
+
+ With a complex input the sign of the frequencies matter, a bank for a baseband stream is created with negative and positive frequencies (f - centreFrequency) and the baseband sample rate.
+ */
+int sfToneBankProcessComplex(SFToneBank *bank, const float *re, const float *im, int count);
+
+/** Index of the strongest tone of the last evaluation.
+
+ @param energy If not NULL receive the energy of the tone (squared amplitude, input unit)
+ @return The tone index, or -1 if no tone is over SF_TONEBANK_MIN_ENERGY and SF_TONEBANK_MIN_DOMINANCE
+ */
+int sfToneBankStrongest(const SFToneBank *bank, float *energy);
+
+#endif
@@ -0,0 +1,236 @@
+//
+//  SFVocoder.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SFVocoder.h"
+
+#if defined(__APPLE__)
+#include <Accelerate/Accelerate.h>
+#endif
+
+
+SFVocoder *sfVocoderCreate(int fftSize, int osamp, float sampleRate, int firstBin)
+{
+    int log2n = 0;
+    while ((1 << log2n) < fftSize)
+        log2n++;
+    if (fftSize < 4 || (1 << log2n) != fftSize || osamp <= 0 || fftSize % osamp != 0)
+        return NULL;
+
+    SFVocoder *vocoder = calloc(1, sizeof(SFVocoder));
+    if (vocoder == NULL)
+        return NULL;
+
+    int bins = fftSize / 2 + 1;
+
+    vocoder->fftSize = fftSize;
+    vocoder->osamp = osamp;
+    vocoder->stepSize = fftSize / osamp;
+    vocoder->firstBin = firstBin < 0 ? 0 : firstBin;
+    vocoder->sampleRate = sampleRate;
+    vocoder->freqPerBin = sampleRate / (float)fftSize;
+    vocoder->expct = (float)(2. * M_PI * (double)vocoder->stepSize / (double)fftSize);
+
+    vocoder->fft = sfFftCreate(log2n);
+    vocoder->window = malloc(fftSize * sizeof(float));
+    vocoder->inFIFO = malloc(fftSize * sizeof(float));
+    vocoder->frame = malloc(fftSize * sizeof(float));
+    vocoder->re = malloc(bins * sizeof(float));
+    vocoder->im = malloc(bins * sizeof(float));
+    vocoder->lastRe = malloc(bins * sizeof(float));
+    vocoder->lastIm = malloc(bins * sizeof(float));
+    vocoder->magnitudes = malloc(bins * sizeof(float));
+
+    if (!vocoder->fft || !vocoder->window || !vocoder->inFIFO || !vocoder->frame || !vocoder->re || !vocoder->im
+        || !vocoder->lastRe || !vocoder->lastIm || !vocoder->magnitudes) {
+        sfVocoderDestroy(vocoder);
+        return NULL;
+    }
+
+    // Same window as smb2PitchShift: -.5*cos(2PI*k/fftFrameSize)+.5
+    for (int k = 0; k < fftSize; k++)
+        vocoder->window[k] = (float)(-.5 * cos(2. * M_PI * (double)k / (double)fftSize) + .5);
+
+    sfVocoderReset(vocoder);
+    return vocoder;
+}
+
+
+void sfVocoderDestroy(SFVocoder *vocoder)
+{
+    if (vocoder == NULL)
+        return;
+    sfFftDestroy(vocoder->fft);
+    free(vocoder->window);
+    free(vocoder->inFIFO);
+    free(vocoder->frame);
+    free(vocoder->re);
+    free(vocoder->im);
+    free(vocoder->lastRe);
+    free(vocoder->lastIm);
+    free(vocoder->magnitudes);
+    free(vocoder);
+}
+
+
+void sfVocoderReset(SFVocoder *vocoder)
+{
+    int bins = vocoder->fftSize / 2 + 1;
+
+    memset(vocoder->inFIFO, 0, vocoder->fftSize * sizeof(float));
+    memset(vocoder->lastRe, 0, bins * sizeof(float));
+    memset(vocoder->lastIm, 0, bins * sizeof(float));
+    vocoder->rover = vocoder->fftSize - vocoder->stepSize;      // inFifoLatency
+    vocoder->frameCount = 0;
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * VocoderAnalyseFrame
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Analyse the frame in inFIFO and return the true frequency of its strongest bin (0 if the frame is empty). */
+static float vocoderAnalyseFrame(SFVocoder *vocoder)
+{
+    const int fftSize = vocoder->fftSize;
+    const int bins = fftSize / 2 + 1;
+    const int firstBin = vocoder->firstBin;
+    float *restrict re = vocoder->re;
+    float *restrict im = vocoder->im;
+    float *restrict magnitudes = vocoder->magnitudes;
+    int peak = -1;
+    float peakMagnitude = 0;
+
+#if defined(__APPLE__)
+    vDSP_vmul(vocoder->inFIFO, 1, vocoder->window, 1, vocoder->frame, 1, fftSize);
+#else
+    {
+        const float *restrict in = vocoder->inFIFO;
+        const float *restrict window = vocoder->window;
+        float *restrict frame = vocoder->frame;
+        for (int k = 0; k < fftSize; k++)
+            frame[k] = in[k] * window[k];
+    }
+#endif
+
+    sfFftForward(vocoder->fft, vocoder->frame, re, im);
+
+    if (firstBin < bins) {
+#if defined(__APPLE__)
+        DSPSplitComplex spectrum = { re + firstBin, im + firstBin };
+        vDSP_Length index = 0;
+        vDSP_zvmags(&spectrum, 1, magnitudes + firstBin, 1, bins - firstBin);
+        vDSP_maxvi(magnitudes + firstBin, 1, &peakMagnitude, &index, bins - firstBin);
+        peak = firstBin + (int)index;
+#else
+        for (int k = firstBin; k < bins; k++)
+            magnitudes[k] = re[k] * re[k] + im[k] * im[k];
+        for (int k = firstBin; k < bins; k++) {
+            if (magnitudes[k] > peakMagnitude) {
+                peakMagnitude = magnitudes[k];
+                peak = k;
+            }
+        }
+#endif
+    }
+
+    float frequency = 0;
+    if (peak >= 0 && peakMagnitude > 0) {
+        // Phase difference with the previous frame, arg(X * conj(Xprev))
+        float dr = re[peak] * vocoder->lastRe[peak] + im[peak] * vocoder->lastIm[peak];
+        float di = im[peak] * vocoder->lastRe[peak] - re[peak] * vocoder->lastIm[peak];
+        float tmp = atan2f(di, dr);
+
+        /* subtract expected phase difference */
+        tmp -= (float)peak * vocoder->expct;
+
+        /* map delta phase into +/- Pi interval */
+        tmp -= 2.f * (float)M_PI * floorf(tmp / (2.f * (float)M_PI) + .5f);
+
+        /* get deviation from bin frequency, then the true frequency */
+        tmp = vocoder->osamp * tmp / (2.f * (float)M_PI);
+        frequency = ((float)peak + tmp) * vocoder->freqPerBin;
+    }
+
+    // Keep this spectrum for the next frame
+    float *swap = vocoder->lastRe;
+    vocoder->lastRe = vocoder->re;
+    vocoder->re = swap;
+    swap = vocoder->lastIm;
+    vocoder->lastIm = vocoder->im;
+    vocoder->im = swap;
+
+    vocoder->frameCount++;
+    return frequency;
+}
+
+
+int sfVocoderProcessFloat(SFVocoder *vocoder, const float *samples, int count, float *frequency)
+{
+    const int fftSize = vocoder->fftSize;
+    const int stepSize = vocoder->stepSize;
+    const int inFifoLatency = fftSize - stepSize;
+    float freqTotal = 0;
+    int pitchCount = 0;
+
+    while (count > 0) {
+        int chunk = fftSize - vocoder->rover;
+        if (chunk > count)
+            chunk = count;
+
+        memcpy(vocoder->inFIFO + vocoder->rover, samples, chunk * sizeof(float));
+        vocoder->rover += chunk;
+        samples += chunk;
+        count -= chunk;
+
+        /* now we have enough data for processing */
+        if (vocoder->rover >= fftSize) {
+            freqTotal += vocoderAnalyseFrame(vocoder);
+            pitchCount++;
+
+            /* move input FIFO */
+            memmove(vocoder->inFIFO, vocoder->inFIFO + stepSize, inFifoLatency * sizeof(float));
+            vocoder->rover = inFifoLatency;
+        }
+    }
+
+    if (pitchCount > 0 && frequency != NULL)
+        *frequency = freqTotal / pitchCount;
+    return pitchCount;
+}
+
+
+int sfVocoderProcessInt16(SFVocoder *vocoder, const int16_t *samples, int count, float *frequency)
+{
+    float buffer[256];
+    float freqTotal = 0;
+    int pitchCount = 0;
+
+    // Convert by small chunks on the stack, no allocation in the audio thread
+    while (count > 0) {
+        int chunk = count < 256 ? count : 256;
+        float chunkFrequency = 0;
+#if defined(__APPLE__)
+        vDSP_vflt16((short *)samples, 1, buffer, 1, chunk);
+#else
+        for (int i = 0; i < chunk; i++)
+            buffer[i] = (float)samples[i];
+#endif
+        int frames = sfVocoderProcessFloat(vocoder, buffer, chunk, &chunkFrequency);
+        freqTotal += chunkFrequency * frames;
+        pitchCount += frames;
+        samples += chunk;
+        count -= chunk;
+    }
+
+    if (pitchCount > 0 && frequency != NULL)
+        *frequency = freqTotal / pitchCount;
+    return pitchCount;
+}
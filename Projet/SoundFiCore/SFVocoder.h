@@ -0,0 +1,74 @@
+//
+//  SFVocoder.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFVocoder_h
+#define SoundFi_SFVocoder_h
+
+#include <stdint.h>
+
+#include "SFFft.h"
+
+/**---------------------------------------------------------------------------------------
+ * SFVocoder
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Analysis half of the phase vocoder of smb2PitchShift (http://www.dspdimension.com).
+
+ smb2PitchShift was only called to get the frequency of the strongest bin, refined with the phase difference between two overlapping frames. The pitch shift synthesis, the inverse FFT and the output FIFO were computed for nothing. This estimator only keep the analysis:
+
+ - the Hann window is a precomputed table,
+ - the magnitudes are single precision and vectorised (vDSP on Apple) and only the squared magnitude is needed to find the peak,
+ - the phase is only computed for the peak bin, from the current and the previous spectrum: arg(X(k) * conj(Xprev(k))) is the same phase difference as phase - lastPhase in smb2PitchShift.
+
+ All the state is in the SFVocoder, there is no static variable: create one estimator for each stream (and each FFT size), different estimators can be used at the same time on different threads. One estimator must only be used by one thread at a time.
+ */
+typedef struct SFVocoder {
+    int         fftSize;
+    int         osamp;              // oversampling factor, a frame every fftSize/osamp samples
+    int         stepSize;
+    int         firstBin;           // lower bin taken in account for the peak
+    float       sampleRate;
+    float       freqPerBin;
+    float       expct;              // expected phase advance of bin 1 between two frames
+
+    SFFft       *fft;
+    float       *window;            // Hann table
+    float       *inFIFO;            // fftSize samples
+    float       *frame;             // windowed frame
+    float       *re;                // current spectrum (fftSize/2+1)
+    float       *im;
+    float       *lastRe;            // previous spectrum
+    float       *lastIm;
+    float       *magnitudes;        // squared magnitudes
+    int         rover;              // write index in inFIFO
+    int         frameCount;         // frames analysed since the reset
+} SFVocoder;
+
+
+/** Create an estimator.
+
+ @param fftSize FFT size, a power of 2
+ @param osamp Oversampling factor (4 in the engine), fftSize/osamp must be an integer
+ @param sampleRate The sample rate of the stream
+ @param firstBin Bins under this one are ignored (smb2PitchShift used k>100)
+ @return The estimator or NULL if the parameters are wrong or there is not enough memory
+ */
+SFVocoder *sfVocoderCreate(int fftSize, int osamp, float sampleRate, int firstBin);
+void sfVocoderDestroy(SFVocoder *vocoder);
+
+/** Forget the samples and the last spectrum */
+void sfVocoderReset(SFVocoder *vocoder);
+
+/** Push samples and analyse every frame that is complete.
+
+ @param frequency Receive the average of the peak frequency of the frames analysed during this call (as *frequency in smb2PitchShift), not modified if no frame was analysed
+ @return The number of frames analysed
+ */
+int sfVocoderProcessFloat(SFVocoder *vocoder, const float *samples, int count, float *frequency);
+int sfVocoderProcessInt16(SFVocoder *vocoder, const int16_t *samples, int count, float *frequency);
+
+#endif
@@ -0,0 +1,100 @@
+//
+//  SFZoneEstimator.c
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <string.h>
+#include <math.h>
+
+#include "SFZoneEstimator.h"
+#include "SFBandPlan.h"
+
+
+void sfZoneEstimatorReset(SFZoneEstimator *zone)
+{
+    memset(zone, 0, sizeof(SFZoneEstimator));
+    zone->spot = -1;
+}
+
+
+static void addDetection(SFZoneEstimator *zone, float frequency)
+{
+    // Window full: the oldest detection is taken out of the sums first
+    if (zone->count == SF_ZONE_WINDOW) {
+        double oldest = zone->window[zone->first];
+        zone->first = (zone->first + 1) % SF_ZONE_WINDOW;
+        zone->count--;
+        if (zone->count == 0) {
+            zone->mean = 0;
+            zone->squares = 0;
+        }
+        else {
+            double delta = oldest - zone->mean;
+            zone->mean -= delta / zone->count;
+            zone->squares -= delta * (oldest - zone->mean);
+            if (zone->squares < 0)
+                zone->squares = 0;
+        }
+    }
+
+    zone->window[(zone->first + zone->count) % SF_ZONE_WINDOW] = frequency;
+    zone->count++;
+    double delta = frequency - zone->mean;
+    zone->mean += delta / zone->count;
+    zone->squares += delta * (frequency - zone->mean);
+}
+
+
+float sfZoneEstimatorDeviation(const SFZoneEstimator *zone)
+{
+    if (zone->count < 2)
+        return 0;
+    return (float)sqrt(zone->squares / (zone->count - 1));
+}
+
+
+int sfZoneEstimatorUpdate(SFZoneEstimator *zone, float frequency)
+{
+    if (zone->count > 0 && fabs(frequency - zone->mean) > SF_ZONE_MAX_DEVIATION) {
+        // Away from the mean: noise, or a new beacon if the next ones agree with it
+        if (zone->changeCount > 0 && fabsf(frequency - zone->changes[zone->changeCount - 1]) > SF_ZONE_MAX_DEVIATION)
+            zone->changeCount = 0;
+        zone->changes[zone->changeCount++] = frequency;
+        if (zone->changeCount < SF_ZONE_CHANGE_COUNT)
+            return -1;
+
+        zone->first = 0;
+        zone->count = 0;
+        zone->mean = 0;
+        zone->squares = 0;
+        for (int i = 0; i < SF_ZONE_CHANGE_COUNT; i++)
+            addDetection(zone, zone->changes[i]);
+        zone->changeCount = 0;
+    }
+    else {
+        zone->changeCount = 0;
+        addDetection(zone, frequency);
+    }
+
+    int spot = (int)floor((zone->mean - SF_GEO_MIN_FREQUENCY) / SF_GEO_SPACING);
+    if (spot < 0 || spot >= SF_GEO_SPOT_COUNT) {
+        zone->confidence = 0;
+        return -1;
+    }
+
+    // Probability that the error of the mean is under its distance to the closest border of the spot
+    float deviation = sfZoneEstimatorDeviation(zone);
+    double error = fmax(deviation, SF_ZONE_MIN_DEVIATION) / sqrt(zone->count);
+    double low = zone->mean - (SF_GEO_MIN_FREQUENCY + spot * SF_GEO_SPACING);
+    double margin = fmin(low, SF_GEO_SPACING - low);
+    zone->confidence = (float)erf(margin / (error * M_SQRT2));
+
+    if (zone->count < SF_ZONE_MIN_COUNT || deviation > SF_ZONE_MAX_DEVIATION || zone->confidence < SF_ZONE_CONFIDENCE)
+        return -1;
+    if (spot == zone->spot)
+        return -1;
+    zone->spot = spot;
+    return spot;
+}
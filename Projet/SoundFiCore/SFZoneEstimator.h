@@ -0,0 +1,61 @@
+//
+//  SFZoneEstimator.h
+//  SoundFiCore
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFZoneEstimator_h
+#define SoundFi_SFZoneEstimator_h
+
+#define SF_ZONE_WINDOW          25      // detections in the window, the 25 of the old zoneDetection (1.2 s of 2048 samples buffers)
+#define SF_ZONE_MIN_COUNT       4       // detections before a decision
+#define SF_ZONE_MAX_DEVIATION   25.f    // Hz, over it the detections are not concluding (the "passage entre 2 zones")
+#define SF_ZONE_MIN_DEVIATION   5.f     // Hz, the deviation is never taken under it, the detections are quantized
+#define SF_ZONE_CONFIDENCE      0.95f   // confidence that the mean is in the spot needed to decide it
+#define SF_ZONE_CHANGE_COUNT    3       // consecutive detections away from the mean, and close together, that restart the window
+
+/**---------------------------------------------------------------------------------------
+ * SFZoneEstimator
+ *  ---------------------------------------------------------------------------------------
+ */
+/** The spot of the geomarketing zone the user is in, from the beacon frequencies detected one buffer at a time.
+
+ The mean and the deviation of the last SF_ZONE_WINDOW detections are updated at each one (Welford, the oldest detection is removed from the sums when the window is full), nothing is computed again over the window. A spot is decided as soon as the detections are concluding:
+
+ - at least SF_ZONE_MIN_COUNT detections and a deviation under SF_ZONE_MAX_DEVIATION,
+ - a confidence over SF_ZONE_CONFIDENCE, the probability that the true frequency is in the same spot as the mean (its distance to the closest border of the spot over the standard error of the mean, deviation/sqrt(count)).
+
+ A detection further than SF_ZONE_MAX_DEVIATION from the mean is not added to the window: a lone one is noise and is dropped, SF_ZONE_CHANGE_COUNT of them in a row and close together are a new beacon, the window restarts with them. So a change of zone is decided a few detections after the new beacon is heard instead of when the window has forgotten the old one.
+
+ The spots are the ones of the band plan (SF_GEO_MIN_FREQUENCY, SF_GEO_SPACING). The estimator doesn't allocate memory, it can be a member of the object that receive.
+ */
+typedef struct SFZoneEstimator {
+    float       window[SF_ZONE_WINDOW];         // the detections in the window, circular
+    int         first;                          // index of the oldest one
+    int         count;
+    double      mean;                           // of the window
+    double      squares;                        // sum of the squared differences to the mean (Welford's M2)
+
+    float       changes[SF_ZONE_CHANGE_COUNT];  // the last detections away from the mean
+    int         changeCount;
+
+    int         spot;                           // the spot decided, -1 before the first decision
+    float       confidence;                     // of the spot of the mean at the last detection
+} SFZoneEstimator;
+
+
+/** Forget the detections and the spot decided */
+void sfZoneEstimatorReset(SFZoneEstimator *zone);
+
+/** Give one detection of the beacon band.
+
+ @param frequency The frequency detected, in Hz
+ @return The spot when a new one is decided (the first one, or a change), -1 otherwise
+ */
+int sfZoneEstimatorUpdate(SFZoneEstimator *zone, float frequency);
+
+/** Standard deviation of the detections of the window, in Hz (0 under 2 detections) */
+float sfZoneEstimatorDeviation(const SFZoneEstimator *zone);
+
+#endif
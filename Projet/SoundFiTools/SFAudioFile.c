@@ -0,0 +1,194 @@
+//
+//  SFAudioFile.c
+//  SoundFiTools
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "SFAudioFile.h"
+
+
+static int hasWavExtension(const char *path)
+{
+    const char *dot = strrchr(path, '.');
+    return dot != NULL && strcasecmp(dot, ".wav") == 0;
+}
+
+static uint32_t readLE32(const unsigned char *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint16_t readLE16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+
+static void writeLE32(unsigned char *p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+static void writeLE16(unsigned char *p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+
+
+static unsigned char *readWholeFile(const char *path, long *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char *data = malloc(*size > 0 ? *size : 1);
+    if (data != NULL && fread(data, 1, *size, file) != (size_t)*size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    return data;
+}
+
+
+static int16_t *decodeWav(const unsigned char *data, long size, int *frameCount, float *sampleRate)
+{
+    if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+        return NULL;
+
+    int format = 0, channels = 0, bits = 0;
+    const unsigned char *samples = NULL;
+    uint32_t dataSize = 0;
+
+    // Walk the chunks, we only need "fmt " and "data"
+    long offset = 12;
+    while (offset + 8 <= size) {
+        const unsigned char *chunk = data + offset;
+        uint32_t chunkSize = readLE32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16) {
+            format = readLE16(chunk + 8);
+            channels = readLE16(chunk + 10);
+            *sampleRate = (float)readLE32(chunk + 12);
+            bits = readLE16(chunk + 22);
+        }
+        else if (memcmp(chunk, "data", 4) == 0) {
+            samples = chunk + 8;
+            dataSize = chunkSize;
+            if (offset + 8 + (long)dataSize > size)
+                dataSize = (uint32_t)(size - offset - 8);
+        }
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    if (samples == NULL || channels <= 0)
+        return NULL;
+
+    int16_t *result = NULL;
+    if (format == 1 && bits == 16) {
+        int frames = dataSize / (2 * channels);
+        result = malloc(frames * sizeof(int16_t) + 1);
+        for (int i = 0; result && i < frames; i++)
+            result[i] = (int16_t)readLE16(samples + 2 * channels * i);
+        *frameCount = frames;
+    }
+    else if (format == 3 && bits == 32) {
+        int frames = dataSize / (4 * channels);
+        result = malloc(frames * sizeof(int16_t) + 1);
+        for (int i = 0; result && i < frames; i++) {
+            uint32_t raw = readLE32(samples + 4 * channels * i);
+            float value;
+            memcpy(&value, &raw, sizeof(float));
+            if (value > 1.f) value = 1.f;
+            if (value < -1.f) value = -1.f;
+            result[i] = (int16_t)(value * 32767.f);
+        }
+        *frameCount = frames;
+    }
+    return result;
+}
+
+
+int16_t *sfReadAudioFile(const char *path, float defaultRate, int *frameCount, float *sampleRate)
+{
+    long size = 0;
+    unsigned char *data = readWholeFile(path, &size);
+    if (data == NULL)
+        return NULL;
+
+    int16_t *result;
+    if (hasWavExtension(path)) {
+        result = decodeWav(data, size, frameCount, sampleRate);
+    }
+    else {
+        int frames = (int)(size / 2);
+        result = malloc(frames * sizeof(int16_t) + 1);
+        for (int i = 0; result && i < frames; i++)
+            result[i] = (int16_t)readLE16(data + 2 * i);
+        *frameCount = frames;
+        *sampleRate = defaultRate;
+    }
+
+    free(data);
+    return result;
+}
+
+
+/** Write the WAV header (when the extension is .wav) and the samples, little endian.
+
+ @param format 1 for PCM 16 bits, 3 for float 32 bits
+ */
+static int writeAudioFile(const char *path, const void *samples, int frameCount, int channels, int sampleRate, int format)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return -1;
+
+    int bytes = format == 3 ? 4 : 2;
+    if (hasWavExtension(path)) {
+        unsigned char header[44];
+        uint32_t dataSize = (uint32_t)frameCount * channels * bytes;
+        memcpy(header, "RIFF", 4);
+        writeLE32(header + 4, 36 + dataSize);
+        memcpy(header + 8, "WAVEfmt ", 8);
+        writeLE32(header + 16, 16);
+        writeLE16(header + 20, format);
+        writeLE16(header + 22, channels);
+        writeLE32(header + 24, sampleRate);
+        writeLE32(header + 28, sampleRate * channels * bytes);
+        writeLE16(header + 32, channels * bytes);
+        writeLE16(header + 34, 8 * bytes);
+        memcpy(header + 36, "data", 4);
+        writeLE32(header + 40, dataSize);
+        fwrite(header, 1, sizeof(header), file);
+    }
+
+    // Little endian on disk whatever the host is
+    unsigned char buffer[4096];
+    int sampleCount = frameCount * channels;
+    int done = 0;
+    while (done < sampleCount) {
+        int chunk = sampleCount - done;
+        if (chunk > (int)sizeof(buffer) / bytes)
+            chunk = sizeof(buffer) / bytes;
+        for (int i = 0; i < chunk; i++) {
+            if (format == 3) {
+                uint32_t raw;
+                memcpy(&raw, (const float *)samples + done + i, sizeof(raw));
+                writeLE32(buffer + 4 * i, raw);
+            }
+            else
+                writeLE16(buffer + 2 * i, (uint16_t)((const int16_t *)samples)[done + i]);
+        }
+        fwrite(buffer, bytes, chunk, file);
+        done += chunk;
+    }
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+
+int sfWriteAudioFile(const char *path, const int16_t *samples, int frameCount, int channels, int sampleRate)
+{
+    return writeAudioFile(path, samples, frameCount, channels, sampleRate, 1);
+}
+
+
+int sfWriteAudioFileFloat(const char *path, const float *samples, int frameCount, int channels, int sampleRate)
+{
+    return writeAudioFile(path, samples, frameCount, channels, sampleRate, 3);
+}
@@ -0,0 +1,39 @@
+//
+//  SFAudioFile.h
+//  SoundFiTools
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFAudioFile_h
+#define SoundFi_SFAudioFile_h
+
+#include <stdint.h>
+
+/** Read a capture in memory as mono Int16.
+
+ Accept WAV files (PCM 16 bits or float 32 bits, only the first channel is kept) and raw PCM (signed 16 bits little endian, mono) for any other extension. A raw file is supposed to be at defaultRate.
+
+ @param path The file to read
+ @param defaultRate Sample rate of a raw file
+ @param frameCount Receive the number of samples
+ @param sampleRate Receive the sample rate of the file
+ @return A malloc'd buffer (free it) or NULL on error
+ */
+int16_t *sfReadAudioFile(const char *path, float defaultRate, int *frameCount, float *sampleRate);
+
+/** Write Int16 samples in a WAV file (or raw PCM if the extension is not .wav).
+
+ @param samples frameCount*channels samples, interleaved
+ @param channels 1 for mono, 2 for stereo (or I/Q)
+ @return 0 if ok, -1 on error
+ */
+int sfWriteAudioFile(const char *path, const int16_t *samples, int frameCount, int channels, int sampleRate);
+
+/** Write float samples in a WAV file (IEEE float 32 bits) or in raw float little endian if the extension is not .wav.
+
+ The samples are written as they are, without conversion, a SoundFiAudioSession buffer can be compared bit for bit.
+ */
+int sfWriteAudioFileFloat(const char *path, const float *samples, int frameCount, int channels, int sampleRate);
+
+#endif
@@ -0,0 +1,378 @@
+//
+//  SFDetector.c
+//  SoundFiTools
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "SFBandPlan.h"
+#include "SFFft.h"
+#include "SFToneBank.h"
+#include "SFVocoder.h"
+#include "SFDownconverter.h"
+#include "SFPeakEstimator.h"
+#include "SFNoiseFloor.h"
+#include "SFDetector.h"
+
+
+// "fft": fftGetFrequencyLowAccuracy, a 2048 samples FFT and a peak over 5e9
+// "floor": the same FFT, the peak is the best SNR over the noise floor of the 17-21.5 kHz bins
+
+typedef struct {
+    SFFft       *fft;
+    SFNoiseFloor *noise;            // NULL for the 5e9 threshold
+    int16_t     dataBuffer[BACKGROUND_FRAMES];
+    float       outputBuffer[BACKGROUND_FRAMES];
+    float       re[BACKGROUND_FRAMES / 2 + 1];
+    float       im[BACKGROUND_FRAMES / 2 + 1];
+    float       magnitudes[BACKGROUND_FRAMES / 2 + 1];
+    int         index;
+    float       frequency;
+} LowAccuracyState;
+
+static void *lowAccuracyCreate(void)
+{
+    LowAccuracyState *state = calloc(1, sizeof(LowAccuracyState));
+    state->fft = sfFftCreate(11);
+    return state;
+}
+
+static void *noiseFloorCreate(void)
+{
+    LowAccuracyState *state = lowAccuracyCreate();
+    float freqPerBin = (float)SAMPLE_RATE / BACKGROUND_FRAMES;
+    state->noise = sfNoiseFloorCreate((int)ceilf(SF_BASEBAND_LOW_FREQUENCY / freqPerBin), (int)(SF_BASEBAND_HIGH_FREQUENCY / freqPerBin),
+                                      (float)BACKGROUND_FRAMES / SAMPLE_RATE);
+    return state;
+}
+
+static float lowAccuracyProcess(void *context, int16_t *samples, int count)
+{
+    LowAccuracyState *state = context;
+    int read = BACKGROUND_FRAMES - state->index;
+
+    if (read > count) {
+        memcpy(state->dataBuffer + state->index, samples, count * sizeof(int16_t));
+        state->index += count;
+        return state->frequency;
+    }
+    memcpy(state->dataBuffer + state->index, samples, read * sizeof(int16_t));
+    state->index = 0;
+
+    for (int i = 0; i < BACKGROUND_FRAMES; i++)
+        state->outputBuffer[i] = state->dataBuffer[i];
+    sfFftForward(state->fft, state->outputBuffer, state->re, state->im);
+
+    // vDSP gives 2*DFT, the threshold is on that scale
+    float dominant = 0;
+    int bin = -1;
+    if (state->noise != NULL) {
+        for (int k = 0; k < BACKGROUND_FRAMES / 2; k++)
+            state->magnitudes[k] = 4.f * (state->re[k] * state->re[k] + state->im[k] * state->im[k]);
+        bin = sfNoiseFloorUpdate(state->noise, state->magnitudes);
+    }
+    else {
+        for (int k = 50; k < BACKGROUND_FRAMES / 2; k++) {
+            float magnitude = 4.f * (state->re[k] * state->re[k] + state->im[k] * state->im[k]);
+            if (magnitude > dominant && magnitude > 5000000000.f) {
+                dominant = magnitude;
+                bin = k;
+            }
+        }
+    }
+
+    // The engine also run the inverse FFT to give back the samples
+    sfFftInverse(state->fft, state->re, state->im, state->outputBuffer);
+
+    state->frequency = bin < 0 ? 0 : bin * ((float)SAMPLE_RATE / BACKGROUND_FRAMES);
+    return state->frequency;
+}
+
+static void lowAccuracyDestroy(void *context)
+{
+    LowAccuracyState *state = context;
+    sfFftDestroy(state->fft);
+    sfNoiseFloorDestroy(state->noise);
+    free(state);
+}
+
+
+// "vocoder": fftGetFrequencyHighAccuracy, the phase vocoder of smb2PitchShift
+// with fftSize 256 and osamp 4, analysis and synthesis as in the engine.
+
+#define VOCODER_SIZE    256
+#define VOCODER_OSAMP   4
+#define VOCODER_WINDOW  (VOCODER_SIZE + CALLBACK_FRAMES - VOCODER_SIZE / VOCODER_OSAMP)    // samples seen by the frames of one callback
+
+typedef struct {
+    SFFft       *fft;
+    float       inFIFO[VOCODER_SIZE];
+    float       outFIFO[VOCODER_SIZE];
+    float       workspace[VOCODER_SIZE];
+    float       re[VOCODER_SIZE / 2 + 1];
+    float       im[VOCODER_SIZE / 2 + 1];
+    float       lastPhase[VOCODER_SIZE / 2 + 1];
+    float       sumPhase[VOCODER_SIZE / 2 + 1];
+    float       outputAccum[2 * VOCODER_SIZE];
+    float       anaFreq[VOCODER_SIZE];
+    float       anaMagn[VOCODER_SIZE];
+    float       synFreq[VOCODER_SIZE];
+    float       synMagn[VOCODER_SIZE];
+    float       analysisBuffer[CALLBACK_FRAMES];
+    float       outputBuffer[CALLBACK_FRAMES];
+    long        rover;
+} VocoderState;
+
+static void *vocoderCreate(void)
+{
+    VocoderState *state = calloc(1, sizeof(VocoderState));
+    state->fft = sfFftCreate(8);
+    state->rover = VOCODER_SIZE - VOCODER_SIZE / VOCODER_OSAMP;
+    return state;
+}
+
+static float vocoderProcess(void *context, int16_t *samples, int count)
+{
+    VocoderState *state = context;
+    const long fftFrameSize = VOCODER_SIZE, fftFrameSize2 = VOCODER_SIZE / 2, osamp = VOCODER_OSAMP;
+    const long stepSize = fftFrameSize / osamp;
+    const long inFifoLatency = fftFrameSize - stepSize;
+    const double freqPerBin = SAMPLE_RATE / (double)fftFrameSize;
+    const double expct = 2. * M_PI * (double)stepSize / (double)fftFrameSize;
+    const float pitchShift = 1.25f;
+    float freqTotal = 0;
+    int pitchCount = 0;
+
+    for (int i = 0; i < count; i++)
+        state->analysisBuffer[i] = samples[i];
+
+    for (long i = 0; i < count; i++) {
+        state->inFIFO[state->rover] = state->analysisBuffer[i];
+        state->outputBuffer[i] = state->outFIFO[state->rover - inFifoLatency];
+        state->rover++;
+
+        if (state->rover < fftFrameSize)
+            continue;
+        state->rover = inFifoLatency;
+
+        for (long k = 0; k < fftFrameSize; k++) {
+            double window = -.5 * cos(2. * M_PI * (double)k / (double)fftFrameSize) + .5;
+            state->workspace[k] = state->inFIFO[k] * window;
+        }
+        sfFftForward(state->fft, state->workspace, state->re, state->im);
+
+        for (long k = 0; k <= fftFrameSize2; k++) {
+            double real = 2. * state->re[k];
+            double imag = 2. * state->im[k];
+            double magn = 2. * sqrt(real * real + imag * imag);
+            double phase = atan2(imag, real);
+            double tmp = phase - state->lastPhase[k];
+            state->lastPhase[k] = phase;
+            tmp -= (double)k * expct;
+            long qpd = tmp / M_PI;
+            if (qpd >= 0) qpd += qpd & 1;
+            else qpd -= qpd & 1;
+            tmp -= M_PI * (double)qpd;
+            tmp = osamp * tmp / (2. * M_PI);
+            state->anaMagn[k] = magn;
+            state->anaFreq[k] = (double)k * freqPerBin + tmp * freqPerBin;
+        }
+
+        float maxMag = 0, displayFreq = 0;
+        for (long k = 0; k <= fftFrameSize2; k++) {
+            if (state->anaMagn[k] > maxMag && k > 100) {
+                maxMag = state->anaMagn[k];
+                displayFreq = state->anaFreq[k];
+            }
+        }
+        freqTotal += displayFreq;
+        pitchCount++;
+
+        memset(state->synMagn, 0, sizeof(state->synMagn));
+        memset(state->synFreq, 0, sizeof(state->synFreq));
+        for (long k = 0; k <= fftFrameSize2; k++) {
+            long index = (long)(k * pitchShift);
+            if (index <= fftFrameSize2) {
+                state->synMagn[index] += state->anaMagn[k];
+                state->synFreq[index] = state->anaFreq[k] * pitchShift;
+            }
+        }
+
+        for (long k = 0; k <= fftFrameSize2; k++) {
+            double tmp = state->synFreq[k];
+            tmp -= (double)k * freqPerBin;
+            tmp /= freqPerBin;
+            tmp = 2. * M_PI * tmp / osamp;
+            tmp += (double)k * expct;
+            state->sumPhase[k] += tmp;
+            state->re[k] = state->synMagn[k] * cos(state->sumPhase[k]);
+            state->im[k] = state->synMagn[k] * sin(state->sumPhase[k]);
+        }
+        sfFftInverse(state->fft, state->re, state->im, state->workspace);
+
+        for (long k = 0; k < fftFrameSize; k++) {
+            double window = -.5 * cos(2. * M_PI * (double)k / (double)fftFrameSize) + .5;
+            state->outputAccum[k] += 2. * window * state->workspace[k] / (fftFrameSize2 * osamp);
+        }
+        for (long k = 0; k < stepSize; k++)
+            state->outFIFO[k] = state->outputAccum[k];
+        memmove(state->outputAccum, state->outputAccum + stepSize, fftFrameSize * sizeof(float));
+        memmove(state->inFIFO, state->inFIFO + stepSize, inFifoLatency * sizeof(float));
+    }
+
+    for (int i = 0; i < count; i++)
+        samples[i] = (int16_t)lrintf(state->outputBuffer[i]);
+
+    return pitchCount ? freqTotal / pitchCount : 0;
+}
+
+static void vocoderDestroy(void *context)
+{
+    VocoderState *state = context;
+    sfFftDestroy(state->fft);
+    free(state);
+}
+
+
+// "estimator": SFVocoder, the analysis half of the vocoder only
+
+static void *estimatorCreate(void)
+{
+    return sfVocoderCreate(VOCODER_SIZE, VOCODER_OSAMP, SAMPLE_RATE, 101);
+}
+
+static float estimatorProcess(void *context, int16_t *samples, int count)
+{
+    float frequency = 0;
+    sfVocoderProcessInt16(context, samples, count, &frequency);
+    return frequency;
+}
+
+static void estimatorDestroy(void *context)
+{
+    sfVocoderDestroy(context);
+}
+
+
+// "tonebank": Goertzel filters on the band plan only
+
+static void *toneBankCreate(void)
+{
+    float plan[SF_TONE_COUNT];
+    sfBandPlanFrequencies(plan);
+    return sfToneBankCreate(SAMPLE_RATE, plan, SF_TONE_COUNT, SF_TONEBANK_DEFAULT_LENGTH);
+}
+
+static float toneBankProcess(void *context, int16_t *samples, int count)
+{
+    SFToneBank *bank = context;
+    if (!sfToneBankProcessInt16(bank, samples, count))
+        return 0;
+    int tone = sfToneBankStrongest(bank, NULL);
+    return tone < 0 ? 0 : bank->frequencies[tone];
+}
+
+static void toneBankDestroy(void *context)
+{
+    sfToneBankDestroy(context);
+}
+
+
+// "baseband": SFDownconverter to 5.5 kHz, then the same tone bank on the complex stream
+
+#define BASEBAND_DELAY  96          // group delay of the decimation filters, in input samples
+
+typedef struct {
+    SFDownconverter *downconverter;
+    SFToneBank      *bank;
+    float           centreFrequency;
+    float           re[CALLBACK_FRAMES / SF_BASEBAND_DECIMATION + 1];
+    float           im[CALLBACK_FRAMES / SF_BASEBAND_DECIMATION + 1];
+} BasebandState;
+
+static void *basebandCreate(void)
+{
+    BasebandState *state = calloc(1, sizeof(BasebandState));
+    float plan[SF_TONE_COUNT];
+
+    state->downconverter = sfDownconverterCreate(SAMPLE_RATE, SF_BASEBAND_LOW_FREQUENCY, SF_BASEBAND_HIGH_FREQUENCY, SF_BASEBAND_DECIMATION);
+    state->centreFrequency = state->downconverter->centreFrequency;
+
+    sfBandPlanFrequencies(plan);
+    for (int t = 0; t < SF_TONE_COUNT; t++)
+        plan[t] -= state->centreFrequency;
+    state->bank = sfToneBankCreate(state->downconverter->outputRate, plan, SF_TONE_COUNT, SF_TONEBANK_DEFAULT_LENGTH / SF_BASEBAND_DECIMATION);
+    return state;
+}
+
+static float basebandProcess(void *context, int16_t *samples, int count)
+{
+    BasebandState *state = context;
+    int n = sfDownconverterProcessInt16(state->downconverter, samples, count, state->re, state->im);
+    if (!sfToneBankProcessComplex(state->bank, state->re, state->im, n))
+        return 0;
+    int tone = sfToneBankStrongest(state->bank, NULL);
+    return tone < 0 ? 0 : state->bank->frequencies[tone] + state->centreFrequency;
+}
+
+static void basebandDestroy(void *context)
+{
+    BasebandState *state = context;
+    sfDownconverterDestroy(state->downconverter);
+    sfToneBankDestroy(state->bank);
+    free(state);
+}
+
+
+// "jacobsen" and "quadratic": SFPeakEstimator, one 1024 points FFT every 256 samples and an interpolated peak
+
+static void *jacobsenCreate(void)
+{
+    return sfPeakEstimatorCreate(SF_PEAK_DEFAULT_SIZE, SF_PEAK_DEFAULT_HOP, SAMPLE_RATE, SF_BASEBAND_LOW_FREQUENCY, SF_BASEBAND_HIGH_FREQUENCY, SFInterpolationJacobsen);
+}
+
+static void *quadraticCreate(void)
+{
+    return sfPeakEstimatorCreate(SF_PEAK_DEFAULT_SIZE, SF_PEAK_DEFAULT_HOP, SAMPLE_RATE, SF_BASEBAND_LOW_FREQUENCY, SF_BASEBAND_HIGH_FREQUENCY, SFInterpolationQuadratic);
+}
+
+static float peakProcess(void *context, int16_t *samples, int count)
+{
+    SFPeakEstimator *estimator = context;
+    sfPeakEstimatorProcessInt16(estimator, samples, count, NULL);
+    if (estimator->peak.power < SF_PEAK_MIN_POWER || estimator->peak.confidence < SF_PEAK_MIN_CONFIDENCE)
+        return 0;
+    return estimator->peak.frequency;
+}
+
+static void peakDestroy(void *context)
+{
+    sfPeakEstimatorDestroy(context);
+}
+
+
+const SFDetector sfDetectors[] = {
+    { "fft",        BACKGROUND_FRAMES,              lowAccuracyCreate,  lowAccuracyProcess, lowAccuracyDestroy },
+    { "floor",      BACKGROUND_FRAMES,              noiseFloorCreate,   lowAccuracyProcess, lowAccuracyDestroy },
+    { "vocoder",    VOCODER_WINDOW,                 vocoderCreate,      vocoderProcess,     vocoderDestroy },
+    { "estimator",  VOCODER_WINDOW,                 estimatorCreate,    estimatorProcess,   estimatorDestroy },
+    { "tonebank",   SF_TONEBANK_DEFAULT_LENGTH,     toneBankCreate,     toneBankProcess,    toneBankDestroy },
+    { "baseband",   SF_TONEBANK_DEFAULT_LENGTH + BASEBAND_DELAY, basebandCreate, basebandProcess, basebandDestroy },
+    { "jacobsen",   SF_PEAK_DEFAULT_SIZE,           jacobsenCreate,     peakProcess,        peakDestroy },
+    { "quadratic",  SF_PEAK_DEFAULT_SIZE,           quadraticCreate,    peakProcess,        peakDestroy },
+};
+const int sfDetectorCount = (int)(sizeof(sfDetectors) / sizeof(sfDetectors[0]));
+
+
+const SFDetector *sfFindDetector(const char *name)
+{
+    for (int d = 0; d < sfDetectorCount; d++) {
+        if (!strcmp(sfDetectors[d].name, name))
+            return &sfDetectors[d];
+    }
+    return NULL;
+}
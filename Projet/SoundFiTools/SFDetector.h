@@ -0,0 +1,43 @@
+//
+//  SFDetector.h
+//  SoundFiTools
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFDetector_h
+#define SoundFi_SFDetector_h
+
+#include <stdint.h>
+
+#define SAMPLE_RATE         44100
+#define CALLBACK_FRAMES     256         // nbrEchantillon while a message is received
+#define BACKGROUND_FRAMES   2048        // nbrEchantillon while waiting
+
+/** The frequency detectors of the engine, without Core Audio.
+
+ Each detector is fed callbacks of at most CALLBACK_FRAMES frames, like renderCallback does, and give back a frequency (0 when nothing is detected):
+
+ - "fft": fftGetFrequencyLowAccuracy, a 2048 samples FFT and a peak over 5e9
+ - "floor": the same FFT, the peak is the best SNR over the noise floor of the 17-21.5 kHz bins
+ - "vocoder": fftGetFrequencyHighAccuracy before SFVocoder, the whole smb2PitchShift
+ - "estimator": SFVocoder, the analysis half of the vocoder only
+ - "tonebank": Goertzel filters on the band plan only
+ - "baseband": SFDownconverter to 5.5 kHz, then the same tone bank on the complex stream
+ - "jacobsen" and "quadratic": SFPeakEstimator, one 1024 points FFT every 256 samples and an interpolated peak
+ */
+typedef struct SFDetector {
+    const char  *name;
+    int         windowLength;       // samples the result depend on
+    void        *(*create)(void);
+    float       (*process)(void *state, int16_t *samples, int count);
+    void        (*destroy)(void *state);
+} SFDetector;
+
+extern const SFDetector sfDetectors[];
+extern const int sfDetectorCount;
+
+/** The detector called name, NULL if there is none */
+const SFDetector *sfFindDetector(const char *name);
+
+#endif
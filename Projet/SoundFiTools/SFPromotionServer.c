@@ -0,0 +1,334 @@
+//
+//  SFPromotionServer.c
+//  SoundFiTools
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "SFPromotionServer.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL    0
+#endif
+
+#define REQUEST_SIZE    4096
+#define AREA_SIZE       (SF_SERVER_PROMOTIONS * (SF_SERVER_BODY + 48) + 4)
+
+
+/** Write a JSON string, escaped, at most capacity bytes (NUL included) */
+static int writeJsonString(char *out, int capacity, const char *string)
+{
+    int length = 0;
+    if (length + 1 < capacity)
+        out[length++] = '"';
+    for (const char *p = string; *p && length + 7 < capacity; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\')
+            length += sprintf(out + length, "\\%c", c);
+        else if (c < 0x20)
+            length += sprintf(out + length, "\\u%04x", c);
+        else
+            out[length++] = (char)c;
+    }
+    if (length + 1 < capacity)
+        out[length++] = '"';
+    out[length] = '\0';
+    return length;
+}
+
+/** FNV-1a of the body, quoted like an HTTP ETag */
+static void makeEtag(SFServedPromotion *promotion)
+{
+    unsigned int hash = 2166136261u;
+    for (const char *p = promotion->body; *p; p++)
+        hash = (hash ^ (unsigned char)*p) * 16777619u;
+    snprintf(promotion->etag, sizeof(promotion->etag), "\"%08x\"", hash);
+}
+
+
+int sfPromotionServerSet(SFPromotionServer *server, int id, const char *imageUrl, const char *text)
+{
+    pthread_mutex_lock(&server->mutex);
+    SFServedPromotion *promotion = NULL;
+    for (int i = 0; i < server->count && promotion == NULL; i++) {
+        if (server->promotions[i].id == id)
+            promotion = &server->promotions[i];
+    }
+    if (promotion == NULL && server->count < SF_SERVER_PROMOTIONS)
+        promotion = &server->promotions[server->count++];
+    if (promotion == NULL) {
+        pthread_mutex_unlock(&server->mutex);
+        return -1;
+    }
+
+    char url[SF_SERVER_BODY / 4], promotionText[SF_SERVER_BODY / 2];   // with the keys, under SF_SERVER_BODY
+    writeJsonString(url, sizeof(url), imageUrl);
+    writeJsonString(promotionText, sizeof(promotionText), text);
+    promotion->id = id;
+    snprintf(promotion->body, sizeof(promotion->body), "{\"id\":%d,\"image_url\":%s,\"Promotion\":%s}", id, url, promotionText);
+    makeEtag(promotion);
+    pthread_mutex_unlock(&server->mutex);
+    return 0;
+}
+
+
+int sfPromotionServerRead(SFPromotionServer *server, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
+
+    char line[SF_SERVER_BODY];
+    int count = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0')
+            continue;
+        char *imageUrl = strchr(line, '\t');
+        char *text = imageUrl ? strchr(imageUrl + 1, '\t') : NULL;
+        if (text == NULL)
+            continue;
+        *imageUrl++ = '\0';
+        *text++ = '\0';
+        if (sfPromotionServerSet(server, atoi(line), imageUrl, text) == 0)
+            count++;
+    }
+    fclose(file);
+    return count;
+}
+
+
+static void sendResponse(int client, int status, const char *etag, int maxAge, const char *body)
+{
+    const char *reason = status == 200 ? "OK" : status == 304 ? "Not Modified" : status == 404 ? "Not Found" : "Bad Request";
+    char header[512];
+    int length = snprintf(header, sizeof(header), "HTTP/1.0 %d %s\r\nContent-Type: application/json\r\nContent-Length: %d\r\n",
+                          status, reason, body ? (int)strlen(body) : 0);
+    if (etag != NULL)
+        length += snprintf(header + length, sizeof(header) - length, "ETag: %s\r\n", etag);
+    if (status == 200 || status == 304)
+        length += snprintf(header + length, sizeof(header) - length, "Cache-Control: max-age=%d\r\n", maxAge);
+    length += snprintf(header + length, sizeof(header) - length, "Connection: close\r\n\r\n");
+
+    // A client gone doesn't raise SIGPIPE
+    send(client, header, length, MSG_NOSIGNAL);
+    if (body != NULL)
+        send(client, body, strlen(body), MSG_NOSIGNAL);
+}
+
+/** The value of a header of the request, "" if it's not there */
+static void requestHeader(const char *request, const char *name, char *value, int capacity)
+{
+    value[0] = '\0';
+    size_t nameLength = strlen(name);
+    for (const char *line = strstr(request, "\r\n"); line != NULL; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, name, nameLength) || line[2 + nameLength] != ':')
+            continue;
+        const char *p = line + 3 + nameLength;
+        while (*p == ' ')
+            p++;
+        int length = (int)strcspn(p, "\r\n");
+        if (length >= capacity)
+            length = capacity - 1;
+        memcpy(value, p, length);
+        value[length] = '\0';
+        return;
+    }
+}
+
+static void handleRequest(SFPromotionServer *server, int client, char *area)
+{
+    char request[REQUEST_SIZE];
+    int length = 0;
+    while (length < REQUEST_SIZE - 1) {
+        ssize_t count = read(client, request + length, REQUEST_SIZE - 1 - length);
+        if (count <= 0)
+            break;
+        length += (int)count;
+        request[length] = '\0';
+        if (strstr(request, "\r\n\r\n"))
+            break;
+    }
+    request[length] = '\0';
+
+    if (server->latency > 0) {
+        struct timespec delay = { server->latency / 1000, (server->latency % 1000) * 1000000L };
+        nanosleep(&delay, NULL);
+    }
+
+    char ifNoneMatch[64];
+    requestHeader(request, "If-None-Match", ifNoneMatch, sizeof(ifNoneMatch));
+
+    pthread_mutex_lock(&server->mutex);
+    server->requests++;
+    if (!strncmp(request, "GET /test.php?id=", 17)) {
+        int id = atoi(request + 17);
+        SFServedPromotion *promotion = NULL;
+        for (int i = 0; i < server->count && promotion == NULL; i++) {
+            if (server->promotions[i].id == id)
+                promotion = &server->promotions[i];
+        }
+        if (promotion == NULL)
+            sendResponse(client, 404, NULL, 0, NULL);
+        else if (!strcmp(ifNoneMatch, promotion->etag)) {
+            server->notModified++;
+            sendResponse(client, 304, promotion->etag, server->maxAge, NULL);
+        }
+        else {
+            server->bytes += (long)strlen(promotion->body);
+            sendResponse(client, 200, promotion->etag, server->maxAge, promotion->body);
+        }
+    }
+    else if (!strncmp(request, "GET /promotions.php", 19)) {
+        // Every promotion with its ETag: "...,"etag":"\"0123abcd\""}
+        int used = sprintf(area, "[");
+        for (int i = 0; i < server->count; i++) {
+            const SFServedPromotion *promotion = &server->promotions[i];
+            char etag[48];
+            writeJsonString(etag, sizeof(etag), promotion->etag);
+            used += sprintf(area + used, "%s%.*s,\"etag\":%s}", i ? "," : "", (int)strlen(promotion->body) - 1, promotion->body, etag);
+        }
+        used += sprintf(area + used, "]");
+        server->bytes += used;
+        sendResponse(client, 200, NULL, server->maxAge, area);
+    }
+    else
+        sendResponse(client, 400, NULL, 0, NULL);
+    pthread_mutex_unlock(&server->mutex);
+}
+
+static void *serverThread(void *context)
+{
+    SFPromotionServer *server = context;
+    char *area = malloc(AREA_SIZE);
+    for (;;) {
+        int client = accept(server->socket, NULL, NULL);
+        if (client < 0)
+            break;
+        handleRequest(server, client, area);
+        close(client);
+    }
+    free(area);
+    return NULL;
+}
+
+
+SFPromotionServer *sfPromotionServerStart(int port, int maxAge, int latency)
+{
+    SFPromotionServer *server = calloc(1, sizeof(SFPromotionServer));
+    if (server == NULL)
+        return NULL;
+    server->maxAge = maxAge;
+    server->latency = latency;
+    pthread_mutex_init(&server->mutex, NULL);
+
+    struct sockaddr_in address = { 0 };
+    socklen_t addressLength = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int reuse = 1;
+
+    server->socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->socket < 0 || setsockopt(server->socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        bind(server->socket, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(server->socket, 16) != 0 ||
+        getsockname(server->socket, (struct sockaddr *)&address, &addressLength) != 0 ||
+        pthread_create(&server->thread, NULL, serverThread, server) != 0) {
+        if (server->socket >= 0)
+            close(server->socket);
+        pthread_mutex_destroy(&server->mutex);
+        free(server);
+        return NULL;
+    }
+    server->port = ntohs(address.sin_port);
+    return server;
+}
+
+
+void sfPromotionServerStop(SFPromotionServer *server)
+{
+    if (server == NULL)
+        return;
+    // accept() returns once the socket is shut down
+    shutdown(server->socket, SHUT_RDWR);
+    pthread_join(server->thread, NULL);
+    close(server->socket);
+    pthread_mutex_destroy(&server->mutex);
+    free(server);
+}
+
+
+/** The value of a header of the response in value, "" if it's not there */
+static void responseHeader(const char *headers, const char *name, char *value, int capacity)
+{
+    requestHeader(headers, name, value, capacity);
+}
+
+int sfPromotionServerGet(int port, const char *path, const char *ifNoneMatch, SFHttpResponse *response)
+{
+    memset(response, 0, sizeof(SFHttpResponse));
+
+    struct sockaddr_in address = { 0 };
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0)
+        return -1;
+    if (connect(server, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(server);
+        return -1;
+    }
+
+    char request[512];
+    int length = snprintf(request, sizeof(request), "GET %s HTTP/1.0\r\nHost: 127.0.0.1\r\n", path);
+    if (ifNoneMatch != NULL && ifNoneMatch[0])
+        length += snprintf(request + length, sizeof(request) - length, "If-None-Match: %s\r\n", ifNoneMatch);
+    length += snprintf(request + length, sizeof(request) - length, "\r\n");
+    if (write(server, request, length) != length) {
+        close(server);
+        return -1;
+    }
+
+    // HTTP/1.0 and Connection: close, the response ends with the connection
+    int capacity = 4096, used = 0;
+    char *data = malloc(capacity + 1);
+    ssize_t count;
+    while ((count = read(server, data + used, capacity - used)) > 0) {
+        used += (int)count;
+        if (used == capacity) {
+            capacity *= 2;
+            data = realloc(data, capacity + 1);
+        }
+    }
+    close(server);
+    data[used] = '\0';
+
+    char *body = strstr(data, "\r\n\r\n");
+    if (strncmp(data, "HTTP/1.", 7) || body == NULL) {
+        free(data);
+        return -1;
+    }
+    body[2] = '\0';     // the headers end with their last \r\n
+    response->status = atoi(data + 9);
+    responseHeader(data, "ETag", response->etag, sizeof(response->etag));
+    responseHeader(data, "Cache-Control", response->cacheControl, sizeof(response->cacheControl));
+    response->length = used - (int)(body + 4 - data);
+    if (response->length > 0) {
+        response->body = malloc(response->length + 1);
+        memcpy(response->body, body + 4, response->length);
+        response->body[response->length] = '\0';
+    }
+    free(data);
+    return 0;
+}
@@ -0,0 +1,88 @@
+//
+//  SFPromotionServer.h
+//  SoundFiTools
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+#ifndef SoundFi_SFPromotionServer_h
+#define SoundFi_SFPromotionServer_h
+
+#include <pthread.h>
+
+#define SF_SERVER_PROMOTIONS    64          // promotions served at most
+#define SF_SERVER_BODY          1024        // bytes of the JSON of one promotion
+
+/** A local stand-in of the promotion server (mynetshare.fr), to run SFPromotionCache and the engine without the real one.
+
+ It answers on 127.0.0.1, one request at a time on its own thread, HTTP/1.0:
+
+ - GET /test.php?id=N : the promotion of the spot, {"id":N,"image_url":"...","Promotion":"..."}, 404 if there is none,
+ - GET /promotions.php?lat=..&long=.. : every promotion, a JSON array with the "etag" of each one (the stand-in has only one area).
+
+ Each promotion has an ETag (a hash of its JSON) and the responses a Cache-Control max-age, a request with the same If-None-Match gets a 304 without body. latency is added to each response, like the round trip of a mobile network.
+ */
+typedef struct SFServedPromotion {
+    int         id;
+    char        etag[24];
+    char        body[SF_SERVER_BODY];
+} SFServedPromotion;
+
+typedef struct SFPromotionServer {
+    int         socket;
+    int         port;
+    int         maxAge;                     // seconds, in the Cache-Control of the responses
+    int         latency;                    // milliseconds added to each response
+    pthread_t   thread;
+    pthread_mutex_t mutex;                  // the promotions and the counters
+    SFServedPromotion promotions[SF_SERVER_PROMOTIONS];
+    int         count;
+
+    int         requests;                   // counters since the start
+    int         notModified;
+    long        bytes;                      // of the bodies sent
+} SFPromotionServer;
+
+/** The response of sfPromotionServerGet */
+typedef struct SFHttpResponse {
+    int         status;                     // 0 if the server can't be reached
+    char        etag[64];
+    char        cacheControl[64];
+    char        *body;                      // malloc'd, NUL terminated (free it), NULL without body
+    int         length;
+} SFHttpResponse;
+
+
+/** Start a server.
+
+ @param port The port, 0 for any free one (then read server->port)
+ @param maxAge The max-age of the responses, in seconds
+ @param latency Milliseconds added to each response
+ @return The server or NULL if it can't listen
+ */
+SFPromotionServer *sfPromotionServerStart(int port, int maxAge, int latency);
+
+/** Stop the server, the requests that follow fail like without network */
+void sfPromotionServerStop(SFPromotionServer *server);
+
+/** Add the promotion of a spot, or change it (its ETag change too).
+
+ @return 0, -1 if there is no room for it
+ */
+int sfPromotionServerSet(SFPromotionServer *server, int id, const char *imageUrl, const char *text);
+
+/** Read the promotions of a text file, one per line: id, image URL and text separated by tabulations, the lines that start with '#' are comments.
+
+ @return The number of promotions, -1 if the file can't be read
+ */
+int sfPromotionServerRead(SFPromotionServer *server, const char *path);
+
+/** A GET on a local server, what the engine does with NSURLSession.
+
+ @param path The path and the query, "/test.php?id=20125"
+ @param ifNoneMatch The ETag of the promotion in the cache, NULL for none
+ @return 0, -1 if the server can't be reached or the response is not HTTP
+ */
+int sfPromotionServerGet(int port, const char *path, const char *ifNoneMatch, SFHttpResponse *response);
+
+#endif
@@ -0,0 +1,2619 @@
+//
+//  sfbench.c
+//  SoundFiTools
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+// Offline benchmarks of the SoundFi reception engine. Everything here runs
+// without Core Audio so it can be used on a Linux box or in a CI:
+//
+//   cc -O2 -std=gnu99 -I../SoundFiCore sfbench.c SFAudioFile.c SFDetector.c SFPromotionServer.c ../SoundFiCore/*.c -lm -lpthread -o sfbench
+//
+//   ./sfbench detectors [-snr dB] [-message text] [-file capture.wav] [-save synth.wav]
+//   ./sfbench baseband -file capture.wav -out iq.wav
+//   ./sfbench parallel [-channels n] [-repeat n] [-snr dB]
+//   ./sfbench wakeups [-seconds n]
+//   ./sfbench realtime [-seconds n] [-frames n] [-detector name] [-slow ms]
+//   ./sfbench emission [-seconds n] [-message text]
+//   ./sfbench mfsk [-messages n] [-length n] [-snr dB]
+//   ./sfbench chirp [-trials n] [-snr dB] [-seconds n]
+//   ./sfbench stream [-file raw.txt] [-messages n] [-length n] [-errors p]
+//   ./sfbench duplex [-messages n] [-length n] [-snr dB] [-echo dB] [-taps n] [-step mu]
+//   ./sfbench lexicon [-words list.txt] [-trials n] [-errors p]
+//   ./sfbench zone [-trials n] [-snr dB]
+//   ./sfbench beacons [-seconds n] [-snr dB] [-fading dB]
+//   ./sfbench promotions [-entries n] [-latency ms] [-ttl s]
+//   ./sfbench alphabet [-trials n]
+//
+// The signal is either synthesised exactly like the emitter does it (256
+// frames callbacks, 26 callbacks of init tone, 5 callbacks per caracter, stop
+// tone, same fade in) after a lead of noise only, or read from a PCM/WAV capture.
+// mfsk send the same random messages in the single tone mode and in every mode
+// of sfMultiToneModes, and compare the payload (the frame header and the parity
+// of the coded modes are not counted) and the caracters received after the
+// error correction and the check of the frame. The check fails if a frame is
+// lost from 20 dB of SNR, or if a coded mode receives fewer frames than an
+// uncoded mode that sends as fast or slower, at any SNR. chirp compare the synchronisation
+// of the multi tone decoder on the end of its start tone and on the chirp preamble.
+// stream give received caracter strings to SFMessageStream one caracter at a
+// time, the recorded ones of a file (one per line, the raw field of sfdecode)
+// are written back analysed so they can be compared, the check counts the
+// allocations and the time from the stop tone to the message.
+// duplex send a message in each full duplex mode at the same time, the own one
+// loud through a room impulse response, and receive the one of the peer before
+// and after SFEchoCanceller.
+// lexicon send words of the vocabulary and random words it doesn't know
+// through the single tone reception (the strings of stream, then
+// SFMessageStream) and correct them with the phase 6 (SFLexicon, mapped from
+// the file sflexicon writes): the known words should be fixed, the others left
+// as they were received.
+// zone give the geomarketing beacon detections to the old zoneDetection and
+// to SFZoneEstimator and compare the time to decide the spot. beacons walk
+// between two beacons and compare the spot of the single peak of the spectrum
+// with the position SFBeaconScanner gives from every beacon in it.
+// promotions run the promotion cache against the local stand-in of the
+// promotion server (SFPromotionServer, sfpromo is the same server alone).
+// alphabet checks the frequency of every caracter of the custom alphabets
+// (SFAlphabet) and back, the default one against the band plan.
+
+#include <stdio.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "SFBandPlan.h"
+#include "SFDownconverter.h"
+#include "SFNoiseFloor.h"
+#include "SFRingBuffer.h"
+#include "SFAnalysisWorker.h"
+#include "SFOscillator.h"
+#include "SFVocoder.h"
+#include "SFMessageEncoder.h"
+#include "SFMessageDecoder.h"
+#include "SFMultiTone.h"
+#include "SFChirp.h"
+#include "SFEchoCanceller.h"
+#include "SFLexicon.h"
+#include "SFZoneEstimator.h"
+#include "SFBeaconScanner.h"
+#include "SFPromotionCache.h"
+#include "SFAlphabet.h"
+#include "SFAudioFile.h"
+#include "SFDetector.h"
+#include "SFPromotionServer.h"
+
+#define EMISSION_GAIN       8000.f      // Int16 level of an emitted amplitude of 1 once received
+#define LEAD_CALLBACKS      72          // noise before the message, the noise floor learn it during 8 FFT of 2048
+
+
+#pragma mark - Utilities
+
+static double cpuSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned int randomState = 0x5f3759df;
+
+static float randomUniform(void)
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return (randomState + 0.5f) / 4294967296.f;
+}
+
+static float randomGaussian(void)
+{
+    float u1 = randomUniform();
+    float u2 = randomUniform();
+    return sqrtf(-2.f * logf(u1)) * cosf(2.f * (float)M_PI * u2);
+}
+
+/** Index of the band plan tone closest to frequency, -1 if it's too far from every tone */
+static int nearestTone(const float *plan, float frequency)
+{
+    if (frequency <= 0)
+        return -1;
+
+    int best = -1;
+    float bestDistance = 1e9f;
+    for (int t = 0; t < SF_TONE_COUNT; t++) {
+        float distance = fabsf(plan[t] - frequency);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = t;
+        }
+    }
+    float tolerance = best >= SF_TONE_FIRST_GEO ? SF_GEO_SPACING / 2 : SF_CHAR_SPACING / 2;
+    return bestDistance <= tolerance ? best : -1;
+}
+
+
+#pragma mark - Allocation check
+
+// With glibc the allocator is wrapped so the realtime command can count the
+// allocations made by the producer thread (the one playing the render callback).
+// The sanitizers have their own allocator, the check is off with them.
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_THREAD__) && !defined(__SANITIZE_ADDRESS__)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+
+static __thread int countAllocations;
+static unsigned int producerAllocations;
+
+void *malloc(size_t size)
+{
+    if (countAllocations)
+        __atomic_add_fetch(&producerAllocations, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    if (countAllocations)
+        __atomic_add_fetch(&producerAllocations, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    if (countAllocations)
+        __atomic_add_fetch(&producerAllocations, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(pointer, size);
+}
+#define ALLOCATION_CHECK 1
+#else
+#define ALLOCATION_CHECK 0
+#endif
+
+
+#pragma mark - Signal
+
+typedef struct {
+    int16_t     *samples;
+    int         frameCount;
+    int         *truth;         // tone index emitted in each sample, -1 for silence (NULL for a capture)
+} Signal;
+
+
+/** Synthesise a message like getASCIIFrequency and emissionSampleCalcul do, plus white noise. */
+static Signal synthesiseMessage(const char *message, float snr)
+{
+    Signal signal = {0};
+    int length = (int)strlen(message);
+    int callbacks = LEAD_CALLBACKS + 26 + 5 * length + 26 + 8;     // silence, init, message, stop, silence
+
+    signal.frameCount = callbacks * CALLBACK_FRAMES;
+    signal.samples = malloc(signal.frameCount * sizeof(int16_t));
+    signal.truth = malloc(signal.frameCount * sizeof(int));
+
+    // Noise level relative to the power of a caracter tone (the amplitude after the fade in)
+    float characterAmplitude = 0.26f * EMISSION_GAIN;
+    float noiseDeviation = sqrtf(characterAmplitude * characterAmplitude / 2.f / powf(10.f, snr / 10.f));
+
+    double theta = 0;
+    float amplitude = 0;
+    int frame = 0;
+    for (int c = 0; c < callbacks; c++) {
+        int tone = -1;
+        float frequency = 0;
+        int symbol = c - LEAD_CALLBACKS;
+
+        if (symbol >= 0 && symbol < 26) {
+            tone = SF_TONE_START;
+            frequency = SF_START_FREQUENCY;
+        }
+        else if (symbol >= 26 && symbol < 26 + 5 * length) {
+            int character = (unsigned char)message[(symbol - 26) / 5];
+            if (character < SF_FIRST_CHAR || character >= SF_FIRST_CHAR + SF_CHAR_COUNT)
+                character = ' ';
+            tone = SF_TONE_FIRST_CHAR + character - SF_FIRST_CHAR;
+            frequency = sfCharFrequency(character);
+        }
+        else if (symbol >= 26 + 5 * length && symbol < 26 + 5 * length + 26) {
+            tone = SF_TONE_STOP;
+            frequency = SF_STOP_FREQUENCY;
+        }
+
+        if (frequency == SF_START_FREQUENCY && amplitude < 0.8f)
+            amplitude += 0.01f;
+        else if (frequency == SF_STOP_FREQUENCY && amplitude > 0)
+            amplitude -= 0.01f;
+
+        double increment = 2.0 * M_PI * frequency / SAMPLE_RATE;
+        for (int i = 0; i < CALLBACK_FRAMES; i++, frame++) {
+            float value = tone >= 0 ? (float)sin(theta) * amplitude * EMISSION_GAIN : 0;
+            value += randomGaussian() * noiseDeviation;
+            if (value > 32767.f) value = 32767.f;
+            if (value < -32768.f) value = -32768.f;
+            signal.samples[frame] = (int16_t)lrintf(value);
+            signal.truth[frame] = tone;
+
+            theta += increment;
+            if (theta > 2.0 * M_PI)
+                theta -= 2.0 * M_PI;
+        }
+    }
+    return signal;
+}
+
+
+static void freeSignal(Signal *signal)
+{
+    free(signal->samples);
+    free(signal->truth);
+}
+
+
+/** Run a detector on one channel of the signal, return the frequency found at the end of each callback.
+
+ @param samples First sample of the channel
+ @param stride Number of channels of an interleaved signal (1 for a mono one)
+ */
+static float *runDetector(const SFDetector *detector, const int16_t *samples, int frameCount, int stride, double *cpu)
+{
+    int callbacks = frameCount / CALLBACK_FRAMES;
+    float *result = malloc(callbacks * sizeof(float));
+    int16_t buffer[CALLBACK_FRAMES];
+    void *state = detector->create();
+
+    double start = cpuSeconds();
+    for (int c = 0; c < callbacks; c++) {
+        const int16_t *callback = samples + (long)c * CALLBACK_FRAMES * stride;
+        for (int i = 0; i < CALLBACK_FRAMES; i++)
+            buffer[i] = callback[i * stride];
+        result[c] = detector->process(state, buffer, CALLBACK_FRAMES);
+    }
+    if (cpu != NULL)
+        *cpu = cpuSeconds() - start;
+
+    detector->destroy(state);
+    return result;
+}
+
+
+#pragma mark - Emission
+
+// The three ways to render the emission: "sin()" is emissionSampleCalcul before
+// SFOscillator (a double sin() per sample), "rotator" is SFOscillator without
+// cache (its scratch table is computed at each change of tone), "cache" is
+// SFOscillator with the tables of the band plan.
+
+typedef struct {
+    double      theta;
+} SineLoop;
+
+static void sineLoopRender(SineLoop *loop, float frequency, float amplitude, float *buffer, int count)
+{
+    double increment = 2.0 * M_PI * frequency / SAMPLE_RATE;
+    for (int frame = 0; frame < count; frame++) {
+        buffer[frame] = sin(loop->theta) * amplitude;
+        loop->theta += increment;
+        if (loop->theta > 2.0 * M_PI)
+            loop->theta -= 2.0 * M_PI;
+    }
+}
+
+/** Tone and amplitude of each callback of an emission, like getASCIIFrequency and emissionSampleCalcul.
+
+ @param fade 0 for a constant amplitude of 0.8
+ @return The number of callbacks, frequencies and amplitudes are malloc'd
+ */
+static int emissionSequence(const char *message, int fade, float **frequencies, float **amplitudes)
+{
+    int length = (int)strlen(message);
+    int callbacks = 26 + 5 * length + 80;           // init, message, stop until the fade out is done
+    float amplitude = fade ? 0 : 0.8f;
+
+    *frequencies = malloc(callbacks * sizeof(float));
+    *amplitudes = malloc(callbacks * sizeof(float));
+    for (int c = 0; c < callbacks; c++) {
+        int frequency;
+        if (c < 26)
+            frequency = SF_START_FREQUENCY;
+        else if (c < 26 + 5 * length)
+            frequency = sfCharFrequency((unsigned char)message[(c - 26) / 5]);
+        else
+            frequency = SF_STOP_FREQUENCY;
+
+        if (fade && frequency == SF_START_FREQUENCY && amplitude < 0.8f)
+            amplitude += 0.01f;
+        else if (fade && frequency == SF_STOP_FREQUENCY && amplitude > 0)
+            amplitude -= 0.01f;
+        (*frequencies)[c] = frequency;
+        (*amplitudes)[c] = amplitude;
+    }
+    return callbacks;
+}
+
+/** In place radix 2 FFT in double, the float FFT would hide the spurs we look for */
+static void fftDouble(double *re, double *im, int n)
+{
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            double t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (int size = 2; size <= n; size <<= 1) {
+        double angle = -2.0 * M_PI / size;
+        for (int start = 0; start < n; start += size) {
+            for (int k = 0; k < size / 2; k++) {
+                double wr = cos(angle * k), wi = sin(angle * k);
+                int a = start + k, b = a + size / 2;
+                double xr = re[b] * wr - im[b] * wi;
+                double xi = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - xr; im[b] = im[a] - xi;
+                re[a] += xr; im[a] += xi;
+            }
+        }
+    }
+}
+
+/** SFDR and SNR of a tone that fall exactly on bin, in dB */
+static void tonePurity(const float *samples, int n, int bin, double *sfdr, double *snr)
+{
+    double *re = malloc(n * sizeof(double));
+    double *im = calloc(n, sizeof(double));
+    for (int i = 0; i < n; i++)
+        re[i] = samples[i];
+    fftDouble(re, im, n);
+
+    double carrier = re[bin] * re[bin] + im[bin] * im[bin];
+    double spur = 1e-300, noise = 1e-300;
+    for (int k = 1; k < n / 2; k++) {
+        if (k == bin)
+            continue;
+        double power = re[k] * re[k] + im[k] * im[k];
+        noise += power;
+        if (power > spur)
+            spur = power;
+    }
+    *sfdr = 10 * log10(carrier / spur);
+    *snr = 10 * log10(carrier / noise);
+    free(re);
+    free(im);
+}
+
+
+#pragma mark - Commands
+
+static int commandDetectors(int argc, char **argv)
+{
+    const char *message = "Hello SoundFi, 10% off today!";
+    const char *file = NULL;
+    const char *save = NULL;
+    float snr = 0;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-snr") && i + 1 < argc) snr = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-message") && i + 1 < argc) message = argv[++i];
+        else if (!strcmp(argv[i], "-file") && i + 1 < argc) file = argv[++i];
+        else if (!strcmp(argv[i], "-save") && i + 1 < argc) save = argv[++i];
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    Signal signal = {0};
+    if (file != NULL) {
+        float rate = SAMPLE_RATE;
+        signal.samples = sfReadAudioFile(file, SAMPLE_RATE, &signal.frameCount, &rate);
+        if (signal.samples == NULL) {
+            fprintf(stderr, "can't read %s\n", file);
+            return 1;
+        }
+        if (rate != SAMPLE_RATE)
+            fprintf(stderr, "warning: %s is at %.0f Hz, the engine expect %d Hz\n", file, rate, SAMPLE_RATE);
+    }
+    else {
+        signal = synthesiseMessage(message, snr);
+        if (save != NULL && sfWriteAudioFile(save, signal.samples, signal.frameCount, 1, SAMPLE_RATE) != 0)
+            fprintf(stderr, "can't write %s\n", save);
+    }
+
+    float plan[SF_TONE_COUNT];
+    sfBandPlanFrequencies(plan);
+
+    int callbacks = signal.frameCount / CALLBACK_FRAMES;
+    double seconds = (double)signal.frameCount / SAMPLE_RATE;
+    float *results[sfDetectorCount];
+    double cpu[sfDetectorCount];
+
+    for (int d = 0; d < sfDetectorCount; d++)
+        results[d] = runDetector(&sfDetectors[d], signal.samples, signal.frameCount, 1, &cpu[d]);
+
+    if (file != NULL)
+        printf("%s: %.2f s of audio, %d callbacks of %d frames\n", file, seconds, callbacks, CALLBACK_FRAMES);
+    else
+        printf("synthetic message \"%s\" at %.1f dB SNR: %.2f s of audio\n", message, snr, seconds);
+    printf("%-10s %12s %10s %s\n", "detector", "cpu us/s", "realtime", file ? "agreement with vocoder" : "symbol accuracy");
+
+    for (int d = 0; d < sfDetectorCount; d++) {
+        int evaluated = 0, correct = 0;
+
+        for (int c = 0; c < callbacks; c++) {
+            int end = (c + 1) * CALLBACK_FRAMES;
+            int begin = end - sfDetectors[d].windowLength;
+            if (begin < 0)
+                continue;
+
+            if (signal.truth != NULL) {
+                // Only count the windows that stay in one symbol, the others are ambiguous by construction
+                int expected = signal.truth[end - 1];
+                if (expected < 0 || signal.truth[begin] != expected)
+                    continue;
+                evaluated++;
+                if (nearestTone(plan, results[d][c]) == expected)
+                    correct++;
+            }
+            else {
+                int reference = nearestTone(plan, results[1][c]);
+                int tone = nearestTone(plan, results[d][c]);
+                if (reference < 0 && tone < 0)
+                    continue;
+                evaluated++;
+                if (reference == tone)
+                    correct++;
+            }
+        }
+
+        printf("%-10s %12.1f %9.4fx ", sfDetectors[d].name, cpu[d] * 1e6 / seconds, cpu[d] / seconds);
+        if (evaluated)
+            printf("%5.1f%% (%d/%d)\n", 100.0 * correct / evaluated, correct, evaluated);
+        else
+            printf("  n/a (no window inside a single symbol)\n");
+    }
+
+    for (int d = 0; d < sfDetectorCount; d++)
+        free(results[d]);
+    freeSignal(&signal);
+    return 0;
+}
+
+
+// Every channel of an interleaved recording is decoded by each detector, first
+// one channel after the other, then all the channels at the same time on
+// their own thread. The detectors keep their state in their instance, so the
+// results must be bit identical.
+
+typedef struct {
+    const SFDetector  *detector;
+    const int16_t   *samples;
+    int             frameCount;
+    int             stride;
+    float           *result;
+} ChannelJob;
+
+static void *channelThread(void *context)
+{
+    ChannelJob *job = context;
+    job->result = runDetector(job->detector, job->samples, job->frameCount, job->stride, NULL);
+    return NULL;
+}
+
+
+static int commandParallel(int argc, char **argv)
+{
+    static const char *messages[] = {
+        "Hello SoundFi, 10% off today!",
+        "Rendez-vous au rayon 4",
+        "SoundFi geo spot 12",
+        "The quick brown fox jumps over the lazy dog",
+    };
+    int channels = 4;
+    int repeat = 4;
+    float snr = 0;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-channels") && i + 1 < argc) channels = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-repeat") && i + 1 < argc) repeat = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-snr") && i + 1 < argc) snr = atof(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (channels < 1 || repeat < 1) {
+        fprintf(stderr, "-channels and -repeat must be positive\n");
+        return 1;
+    }
+
+    // Interleave one message per channel, the shortest ones are padded with silence
+    Signal *signals = calloc(channels, sizeof(Signal));
+    int frameCount = 0;
+    for (int ch = 0; ch < channels; ch++) {
+        signals[ch] = synthesiseMessage(messages[ch % 4], snr);
+        if (signals[ch].frameCount > frameCount)
+            frameCount = signals[ch].frameCount;
+    }
+    int16_t *interleaved = calloc((size_t)frameCount * channels, sizeof(int16_t));
+    for (int ch = 0; ch < channels; ch++)
+        for (int i = 0; i < signals[ch].frameCount; i++)
+            interleaved[(long)i * channels + ch] = signals[ch].samples[i];
+
+    int callbacks = frameCount / CALLBACK_FRAMES;
+    int failures = 0;
+
+    printf("%d channels, %d callbacks each, %d parallel runs\n", channels, callbacks, repeat);
+
+    for (int d = 0; d < sfDetectorCount; d++) {
+        float **sequential = malloc(channels * sizeof(float *));
+        for (int ch = 0; ch < channels; ch++)
+            sequential[ch] = runDetector(&sfDetectors[d], interleaved + ch, frameCount, channels, NULL);
+
+        int mismatches = 0;
+        for (int r = 0; r < repeat; r++) {
+            ChannelJob *jobs = calloc(channels, sizeof(ChannelJob));
+            pthread_t *threads = malloc(channels * sizeof(pthread_t));
+
+            for (int ch = 0; ch < channels; ch++) {
+                jobs[ch] = (ChannelJob){ &sfDetectors[d], interleaved + ch, frameCount, channels, NULL };
+                pthread_create(&threads[ch], NULL, channelThread, &jobs[ch]);
+            }
+            for (int ch = 0; ch < channels; ch++) {
+                pthread_join(threads[ch], NULL);
+                if (memcmp(jobs[ch].result, sequential[ch], callbacks * sizeof(float)) != 0)
+                    mismatches++;
+                free(jobs[ch].result);
+            }
+            free(jobs);
+            free(threads);
+        }
+
+        printf("%-10s %s", sfDetectors[d].name, mismatches ? "MISMATCH" : "identical");
+        if (mismatches)
+            printf(" (%d/%d channel runs differ)", mismatches, channels * repeat);
+        printf("\n");
+        failures += mismatches;
+
+        for (int ch = 0; ch < channels; ch++)
+            free(sequential[ch]);
+        free(sequential);
+    }
+
+    for (int ch = 0; ch < channels; ch++)
+        freeSignal(&signals[ch]);
+    free(signals);
+    free(interleaved);
+    return failures ? 1 : 0;
+}
+
+
+static int commandBaseband(int argc, char **argv)
+{
+    const char *input = NULL;
+    const char *output = NULL;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-file") && i + 1 < argc) input = argv[++i];
+        else if (!strcmp(argv[i], "-out") && i + 1 < argc) output = argv[++i];
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (input == NULL || output == NULL) {
+        fprintf(stderr, "baseband needs -file and -out\n");
+        return 1;
+    }
+
+    int frameCount = 0;
+    float rate = SAMPLE_RATE;
+    int16_t *samples = sfReadAudioFile(input, SAMPLE_RATE, &frameCount, &rate);
+    if (samples == NULL) {
+        fprintf(stderr, "can't read %s\n", input);
+        return 1;
+    }
+
+    SFDownconverter *downconverter = sfDownconverterCreate(rate, SF_BASEBAND_LOW_FREQUENCY, SF_BASEBAND_HIGH_FREQUENCY, SF_BASEBAND_DECIMATION);
+    if (downconverter == NULL) {
+        fprintf(stderr, "%.0f Hz is too low for the %d-%d Hz band\n", rate, SF_BASEBAND_LOW_FREQUENCY, SF_BASEBAND_HIGH_FREQUENCY);
+        free(samples);
+        return 1;
+    }
+
+    int capacity = frameCount / SF_BASEBAND_DECIMATION + 1;
+    float *re = malloc(capacity * sizeof(float));
+    float *im = malloc(capacity * sizeof(float));
+    int16_t *iq = malloc(2 * capacity * sizeof(int16_t));
+
+    double start = cpuSeconds();
+    int count = sfDownconverterProcessInt16(downconverter, samples, frameCount, re, im);
+    double cpu = cpuSeconds() - start;
+
+    // I on the left channel, Q on the right one. The band is half the amplitude of the tone once mixed, scale it back
+    for (int i = 0; i < count; i++) {
+        float valueRe = 2.f * re[i], valueIm = 2.f * im[i];
+        iq[2 * i] = (int16_t)lrintf(fmaxf(-32768.f, fminf(32767.f, valueRe)));
+        iq[2 * i + 1] = (int16_t)lrintf(fmaxf(-32768.f, fminf(32767.f, valueIm)));
+    }
+
+    int status = sfWriteAudioFile(output, iq, count, 2, (int)lrintf(downconverter->outputRate));
+    if (status != 0)
+        fprintf(stderr, "can't write %s\n", output);
+    else
+        printf("%s: %d samples at %.0f Hz -> %s: %d I/Q samples at %.1f Hz centred on %.0f Hz (%.1f us of CPU per second of audio)\n",
+               input, frameCount, rate, output, count, downconverter->outputRate, downconverter->centreFrequency,
+               cpu * 1e6 / (frameCount / rate));
+
+    sfDownconverterDestroy(downconverter);
+    free(samples);
+    free(re);
+    free(im);
+    free(iq);
+    return status != 0;
+}
+
+
+// The background detector run all the time, each start tone or geolocation
+// spot it finds in the noise wake up the high accuracy FFT (isInitiate or
+// geoIsInitiate) for nothing. The noise is white, from a quiet room to a
+// noisy store, and then a quiet room that become noisy in the middle.
+
+#define WAKEUP_STARTUP_SECONDS  2.f
+#define WAKEUP_STARTUP_RESETS   200
+
+static int isWakeup(float frequency)
+{
+    return (frequency >= 17650 && frequency < 17950) || (frequency >= 19900 && frequency < 21000);
+}
+
+static int commandWakeups(int argc, char **argv)
+{
+    static const float levels[] = { 30, 100, 300, 1000, 3000 };
+    static const char *names[] = { "fft", "floor" };
+    const int levelCount = (int)(sizeof(levels) / sizeof(levels[0]));
+    float seconds = 30;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-seconds") && i + 1 < argc) seconds = atof(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    int frameCount = (int)(seconds * SAMPLE_RATE) / CALLBACK_FRAMES * CALLBACK_FRAMES;
+    int16_t *samples = malloc(frameCount * sizeof(int16_t));
+
+    printf("false wake ups per minute on %.0f s of white noise\n", seconds);
+    printf("%-22s", "noise deviation");
+    for (int n = 0; n < 2; n++)
+        printf(" %10s", names[n]);
+    printf("\n");
+
+    for (int l = 0; l <= levelCount; l++) {
+        char label[32];
+
+        // The last run is a step from the quietest to the loudest level but one
+        for (int i = 0; i < frameCount; i++) {
+            float deviation = l < levelCount ? levels[l] : (i < frameCount / 2 ? levels[0] : levels[levelCount - 2]);
+            float value = deviation * randomGaussian();
+            samples[i] = (int16_t)(value > 32767 ? 32767 : (value < -32768 ? -32768 : value));
+        }
+        if (l < levelCount)
+            snprintf(label, sizeof(label), "%.0f", levels[l]);
+        else
+            snprintf(label, sizeof(label), "%.0f then %.0f", levels[0], levels[levelCount - 2]);
+        printf("%-22s", label);
+
+        for (int n = 0; n < 2; n++) {
+            const SFDetector *detector = sfFindDetector(names[n]);
+
+            float *result = runDetector(detector, samples, frameCount, 1, NULL);
+            int wakeups = 0;
+            for (int c = BACKGROUND_FRAMES / CALLBACK_FRAMES - 1; c < frameCount / CALLBACK_FRAMES; c += BACKGROUND_FRAMES / CALLBACK_FRAMES) {
+                if (isWakeup(result[c]))
+                    wakeups++;
+            }
+            printf(" %10.1f", wakeups * 60.f / seconds);
+            free(result);
+        }
+        printf("\n");
+    }
+
+    // The start of the floor detector: peaks at any frequency in the first seconds after the reset, while the floor is
+    // still the average of a few frames
+    const int startupFrames = (int)(WAKEUP_STARTUP_SECONDS * SAMPLE_RATE) / BACKGROUND_FRAMES * BACKGROUND_FRAMES;
+    const SFDetector *floorDetector = sfFindDetector("floor");
+    int peaks = 0, spectrums = 0, firstPeaks = 0;
+    for (int r = 0; r < WAKEUP_STARTUP_RESETS && startupFrames <= frameCount; r++) {
+        for (int i = 0; i < startupFrames; i++)
+            samples[i] = (int16_t)lrintf(levels[2] * randomGaussian());
+        float *result = runDetector(floorDetector, samples, startupFrames, 1, NULL);
+        for (int c = BACKGROUND_FRAMES / CALLBACK_FRAMES - 1; c < startupFrames / CALLBACK_FRAMES; c += BACKGROUND_FRAMES / CALLBACK_FRAMES) {
+            peaks += result[c] > 0;
+            firstPeaks += result[c] > 0 && c < 2 * SF_NOISE_WARMUP * BACKGROUND_FRAMES / CALLBACK_FRAMES;
+            spectrums++;
+        }
+        free(result);
+    }
+    printf("floor, first %.0f s after a reset (%d resets): %.2f%% of the spectrums with a peak, %d in the %d spectrums after the warm up\n",
+           WAKEUP_STARTUP_SECONDS, WAKEUP_STARTUP_RESETS, spectrums ? 100.0 * peaks / spectrums : 0, firstPeaks, SF_NOISE_WARMUP);
+
+    free(samples);
+    return 0;
+}
+
+
+// The render callback is played by a producer thread that write a buffer in
+// the ring at the pace of the audio clock, the analysis run on a
+// SFAnalysisWorker. The producer must never block nor allocate: each write is
+// timed and the allocations of the thread are counted. Without overrun the
+// worker must find the same frequencies as a direct run of the detector.
+
+typedef struct {
+    const SFDetector  *detector;
+    void            *state;
+    float           *result;
+    int             resultCount;
+    int             slow;           // microseconds added to each block, to provoke overruns
+} RealtimeAnalysis;
+
+typedef struct {
+    SFRingBuffer    *ring;
+    const int16_t   *samples;
+    int             frameCount;
+    int             frames;
+    double          maxWrite;       // seconds
+    double          totalWrite;
+    int             writes;
+} RealtimeProducer;
+
+static void realtimeProcess(void *context, const int16_t *samples, int count)
+{
+    RealtimeAnalysis *analysis = context;
+    analysis->result[analysis->resultCount++] = analysis->detector->process(analysis->state, (int16_t *)samples, count);
+    if (analysis->slow > 0) {
+        struct timespec sleep = { analysis->slow / 1000000, (analysis->slow % 1000000) * 1000L };
+        nanosleep(&sleep, NULL);
+    }
+}
+
+static double monotonicSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *producerThread(void *context)
+{
+    RealtimeProducer *producer = context;
+    struct timespec next;
+    long period = (long)(1e9 * producer->frames / SAMPLE_RATE);
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int offset = 0; offset + producer->frames <= producer->frameCount; offset += producer->frames) {
+        next.tv_nsec += period;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        // What renderCallback does now: copy the buffer and return
+#if ALLOCATION_CHECK
+        countAllocations = 1;
+#endif
+        double start = monotonicSeconds();
+        sfRingBufferWrite(producer->ring, producer->samples + offset, producer->frames);
+        double duration = monotonicSeconds() - start;
+#if ALLOCATION_CHECK
+        countAllocations = 0;
+#endif
+
+        producer->totalWrite += duration;
+        producer->writes++;
+        if (duration > producer->maxWrite)
+            producer->maxWrite = duration;
+    }
+    return NULL;
+}
+
+static int commandRealtime(int argc, char **argv)
+{
+    const char *name = "jacobsen";
+    float seconds = 5;
+    int frames = CALLBACK_FRAMES;
+    int slow = 0;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-seconds") && i + 1 < argc) seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-frames") && i + 1 < argc) frames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-detector") && i + 1 < argc) name = argv[++i];
+        else if (!strcmp(argv[i], "-slow") && i + 1 < argc) slow = (int)(atof(argv[++i]) * 1000);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    const SFDetector *detector = sfFindDetector(name);
+    if (detector == NULL || frames < 1 || frames > BACKGROUND_FRAMES) {
+        fprintf(stderr, "unknown detector %s or wrong buffer size\n", name);
+        return 1;
+    }
+
+    // Messages one after the other up to the duration
+    Signal message = synthesiseMessage("Hello SoundFi, 10% off today!", 10);
+    int frameCount = (int)(seconds * SAMPLE_RATE) / frames * frames;
+    int16_t *samples = malloc(frameCount * sizeof(int16_t));
+    for (int i = 0; i < frameCount; i++)
+        samples[i] = message.samples[i % message.frameCount];
+    freeSignal(&message);
+
+    // Reference: the detector called directly with the same buffers
+    int blocks = frameCount / frames;
+    float *reference = malloc(blocks * sizeof(float));
+    void *state = detector->create();
+    for (int b = 0; b < blocks; b++)
+        reference[b] = detector->process(state, samples + (long)b * frames, frames);
+    detector->destroy(state);
+
+    SFRingBuffer *ring = sfRingBufferCreate(SF_RING_DEFAULT_CAPACITY);
+    RealtimeAnalysis analysis = { detector, detector->create(), malloc(blocks * sizeof(float)), 0, slow };
+    SFAnalysisWorker *worker = sfAnalysisWorkerCreate(ring, SAMPLE_RATE, BACKGROUND_FRAMES, realtimeProcess, &analysis);
+    sfAnalysisWorkerSetBlockSize(worker, frames);
+    RealtimeProducer producer = { ring, samples, frameCount, frames, 0, 0, 0 };
+    pthread_t thread;
+
+    printf("%s: %.1f s played in real time by %d frames buffers\n", detector->name, seconds, frames);
+
+    sfAnalysisWorkerStart(worker);
+    pthread_create(&thread, NULL, producerThread, &producer);
+    pthread_join(thread, NULL);
+
+    // Let the worker take the last block
+    double deadline = monotonicSeconds() + 1.0;
+    while (sfRingBufferAvailable(ring) >= (uint32_t)frames && monotonicSeconds() < deadline) {
+        struct timespec sleep = { 0, 1000000 };
+        nanosleep(&sleep, NULL);
+    }
+    sfAnalysisWorkerStop(worker);
+
+    uint32_t overruns = sfRingBufferOverruns(ring);
+    int identical = analysis.resultCount == blocks && !memcmp(analysis.result, reference, blocks * sizeof(float));
+
+    printf("producer   %d writes, %.2f us average, %.2f us max", producer.writes, producer.totalWrite * 1e6 / producer.writes, producer.maxWrite * 1e6);
+#if ALLOCATION_CHECK
+    printf(", %u allocations\n", producerAllocations);
+#else
+    printf(", allocations not checked on this libc\n");
+#endif
+    printf("worker     %u blocks, %u overrun samples, %u underruns, %.1f ms max latency\n",
+           worker->blocks, overruns, worker->underruns, worker->maxLatency / 1000.f);
+    if (overruns == 0)
+        printf("results    %s to the direct run\n", identical ? "identical" : "DIFFERENT");
+    else
+        printf("results    not compared, the worker dropped samples\n");
+
+    int failed = (overruns == 0 && !identical);
+#if ALLOCATION_CHECK
+    failed |= producerAllocations != 0;
+#endif
+
+    sfAnalysisWorkerDestroy(worker);
+    sfRingBufferDestroy(ring);
+    detector->destroy(analysis.state);
+    free(analysis.result);
+    free(reference);
+    free(samples);
+    return failed ? 1 : 0;
+}
+
+
+static int commandEmission(int argc, char **argv)
+{
+    const char *message = "Hello SoundFi, 10% off today!";
+    float seconds = 60;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-message") && i + 1 < argc) message = argv[++i];
+        else if (!strcmp(argv[i], "-seconds") && i + 1 < argc) seconds = atof(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    float plan[SF_TONE_COUNT];
+    sfBandPlanFrequencies(plan);
+    SFOscillator *rotator = sfOscillatorCreate(SAMPLE_RATE, CALLBACK_FRAMES, NULL, 0);
+    SFOscillator *cache = sfOscillatorCreate(SAMPLE_RATE, CALLBACK_FRAMES, plan, SF_TONE_STOP + 1);
+    SineLoop loop = {0};
+    float buffer[CALLBACK_FRAMES];
+    float *frequencies, *amplitudes;
+    int callbacks = emissionSequence(message, 1, &frequencies, &amplitudes);
+    int repeat = (int)(seconds * SAMPLE_RATE / CALLBACK_FRAMES / callbacks) + 1;
+    double samples = (double)repeat * callbacks * CALLBACK_FRAMES;
+    double cpu[3];
+    volatile float sink = 0;
+
+    // Throughput: the message is sent again and again by callbacks of 256 frames
+    for (int m = 0; m < 3; m++) {
+        double start = cpuSeconds();
+        for (int r = 0; r < repeat; r++) {
+            if (m > 0)
+                sfOscillatorReset(m == 1 ? rotator : cache);
+            for (int c = 0; c < callbacks; c++) {
+                if (m == 0)
+                    sineLoopRender(&loop, frequencies[c], amplitudes[c], buffer, CALLBACK_FRAMES);
+                else
+                    sfOscillatorRender(m == 1 ? rotator : cache, frequencies[c], amplitudes[c], buffer, CALLBACK_FRAMES);
+                sink += buffer[c % CALLBACK_FRAMES];
+            }
+        }
+        cpu[m] = cpuSeconds() - start;
+    }
+    free(frequencies);
+    free(amplitudes);
+
+    // Spectral purity on a steady tone that fall on a bin of a 65536 points FFT (18949.22 Hz, bin 28160)
+    const int n = 65536, bin = 28160;
+    const float tone = (float)bin * SAMPLE_RATE / n;
+    float *steady[3];
+    double sfdr[3], snr[3];
+    loop.theta = 0;
+    sfOscillatorReset(rotator);
+    sfOscillatorReset(cache);
+    rotator->amplitude = cache->amplitude = 0.8f;              // steady, without the fade in
+    for (int m = 0; m < 3; m++) {
+        steady[m] = malloc(n * sizeof(float));
+        for (int c = 0; c < n / CALLBACK_FRAMES; c++) {
+            float *block = steady[m] + c * CALLBACK_FRAMES;
+            if (m == 0)
+                sineLoopRender(&loop, tone, 0.8f, block, CALLBACK_FRAMES);
+            else
+                sfOscillatorRender(m == 1 ? rotator : cache, tone, 0.8f, block, CALLBACK_FRAMES);
+        }
+        tonePurity(steady[m], n, bin, &sfdr[m], &snr[m]);
+    }
+
+    // Phase continuity: same message at a constant amplitude, compared to the sin() loop
+    callbacks = emissionSequence(message, 0, &frequencies, &amplitudes);
+    float reference[CALLBACK_FRAMES];
+    double maxError[3] = { 0, 0, 0 };
+    for (int m = 1; m < 3; m++) {
+        SFOscillator *oscillator = m == 1 ? rotator : cache;
+        loop.theta = 0;
+        sfOscillatorReset(oscillator);
+        oscillator->amplitude = 0.8f;
+        for (int c = 0; c < callbacks; c++) {
+            sineLoopRender(&loop, frequencies[c], amplitudes[c], reference, CALLBACK_FRAMES);
+            sfOscillatorRender(oscillator, frequencies[c], amplitudes[c], buffer, CALLBACK_FRAMES);
+            for (int i = 0; i < CALLBACK_FRAMES; i++) {
+                double error = fabs(buffer[i] - reference[i]);
+                if (error > maxError[m])
+                    maxError[m] = error;
+            }
+        }
+    }
+    free(frequencies);
+    free(amplitudes);
+
+    static const char *names[] = { "sin()", "rotator", "cache" };
+    printf("emission of \"%s\", %.0f s by callbacks of %d frames\n", message, samples / SAMPLE_RATE, CALLBACK_FRAMES);
+    printf("%-10s %12s %9s %10s %10s %16s\n", "method", "Msamples/s", "speedup", "SFDR dB", "SNR dB", "max error vs sin");
+    for (int m = 0; m < 3; m++) {
+        printf("%-10s %12.1f %8.1fx %10.1f %10.1f", names[m], samples / cpu[m] / 1e6, cpu[0] / cpu[m], sfdr[m], snr[m]);
+        if (m > 0)
+            printf(" %13.1f dB\n", 20 * log10(maxError[m] / 0.8 + 1e-30));
+        else
+            printf(" %16s\n", "-");
+        free(steady[m]);
+    }
+
+    sfOscillatorDestroy(rotator);
+    sfOscillatorDestroy(cache);
+    return 0;
+}
+
+
+#pragma mark - Multi tone
+
+/** Levenshtein distance of two sequences, row is a working buffer of m+1 ints */
+static int editDistance(const int *a, int n, const int *b, int m, int *row)
+{
+    for (int j = 0; j <= m; j++)
+        row[j] = j;
+    for (int i = 1; i <= n; i++) {
+        int diagonal = row[0];
+        row[0] = i;
+        for (int j = 1; j <= m; j++) {
+            int substitution = diagonal + (a[i - 1] != b[j - 1]);
+            int deletion = row[j] + 1;
+            int insertion = row[j - 1] + 1;
+            diagonal = row[j];
+            row[j] = substitution < deletion ? (substitution < insertion ? substitution : insertion) : (deletion < insertion ? deletion : insertion);
+        }
+    }
+    return row[m];
+}
+
+/** Render a message with the encoder at the level of a received emission (EMISSION_GAIN) after LEAD_CALLBACKS of noise */
+static int renderNoisyMessage(SFMessageEncoder *encoder, const char *message, int length, float noiseDeviation, int16_t *samples)
+{
+    float buffer[SF_EMISSION_FRAMES];
+    int frame = 0;
+
+    sfMessageEncoderStart(encoder, message, length);
+    for (int c = 0; c < LEAD_CALLBACKS + encoder->callbackCount + 8; c++) {
+        int message = c >= LEAD_CALLBACKS && sfMessageEncoderRender(encoder, buffer) > 0;
+        for (int i = 0; i < SF_EMISSION_FRAMES; i++, frame++) {
+            float value = (message ? buffer[i] * EMISSION_GAIN : 0) + randomGaussian() * noiseDeviation;
+            if (value > 32767.f) value = 32767.f;
+            if (value < -32768.f) value = -32768.f;
+            samples[frame] = (int16_t)lrintf(value);
+        }
+    }
+    return frame;
+}
+
+#define DRIFT_TAPS          32          // of the interpolation filter, a linear interpolation would cut the band at 18 kHz
+
+/** The samples of an emitter whose clock is ppm faster than the one of the receiver (Hann windowed sinc interpolation), return the frames written */
+static int applyDrift(const int16_t *samples, int frameCount, double ppm, int16_t *drifted)
+{
+    const double step = 1 + ppm * 1e-6;
+    int frame = 0;
+
+    for (double t = 0; t < frameCount; t = ++frame * step) {
+        int i = (int)t;
+        double f = t - i, value = 0;
+        for (int k = 1 - DRIFT_TAPS / 2; k <= DRIFT_TAPS / 2; k++) {
+            if (i + k < 0 || i + k >= frameCount)
+                continue;
+            double x = k - f;
+            double sinc = fabs(x) < 1e-9 ? 1 : sin(M_PI * x) / (M_PI * x);
+            value += samples[i + k] * sinc * (0.5 + 0.5 * cos(M_PI * x / (DRIFT_TAPS / 2)));
+        }
+        if (value > 32767) value = 32767;
+        if (value < -32768) value = -32768;
+        drifted[frame] = (int16_t)lrint(value);
+    }
+    return frame;
+}
+
+/** Receive the first message of samples like sfdecode does with the fft pipeline, then the multi tone decoders when their start tone is found.
+
+ @param text Receive the message, SF_MESSAGE_CAPACITY+1 bytes
+ @return Its length, 0 if nothing was received
+ */
+static int receiveMessage(const int16_t *samples, int frameCount, SFMessageDecoder *decoder, SFMultiToneDecoder **multiTone, char *text)
+{
+    const SFDetector *idleDetector = sfFindDetector("floor");
+    const SFDetector *receiveDetector = sfFindDetector("estimator");
+    void *idle = idleDetector->create();
+    void *receive = receiveDetector->create();
+    SFMultiToneDecoder *receiving = NULL;
+    int16_t buffer[CALLBACK_FRAMES];
+    float frequency = 0;
+    int length = 0;
+
+    sfMessageDecoderReset(decoder);
+    for (int position = 0; length == 0; ) {
+        if (receiving != NULL) {
+            if (position + SF_MESSAGE_RECEPTION_BUFFER > frameCount)
+                break;
+            SFMessageEvent event = sfMultiToneDecoderProcess(receiving, samples + position, SF_MESSAGE_RECEPTION_BUFFER);
+            position += SF_MESSAGE_RECEPTION_BUFFER;
+            if (event == SFMessageEventCompleted || event == SFMessageEventTimedOut) {
+                length = receiving->messageLength;
+                memcpy(text, receiving->message, length + 1);
+                int handover = receiving->handover;
+                receiving = NULL;
+                if (handover != SF_MFSK_SINGLE_TONE) {
+                    receiving = multiTone[handover];
+                    sfMultiToneDecoderReset(receiving);
+                }
+            }
+            continue;
+        }
+
+        int frames = decoder->receiving ? SF_MESSAGE_RECEPTION_BUFFER : SF_MESSAGE_IDLE_BUFFER;
+        if (position + frames > frameCount)
+            break;
+        for (int offset = 0; offset < frames; offset += CALLBACK_FRAMES) {
+            memcpy(buffer, samples + position + offset, CALLBACK_FRAMES * sizeof(int16_t));
+            frequency = decoder->receiving ? receiveDetector->process(receive, buffer, CALLBACK_FRAMES) : idleDetector->process(idle, buffer, CALLBACK_FRAMES);
+        }
+        position += frames;
+
+        int mode = decoder->receiving ? SF_MFSK_SINGLE_TONE : sfMultiToneFindMode((int)frequency);
+        if (mode != SF_MFSK_SINGLE_TONE) {
+            receiving = multiTone[mode];
+            sfMultiToneDecoderReset(receiving);
+            continue;
+        }
+
+        SFMessageEvent event = sfMessageDecoderPush(decoder, (int)frequency);
+        if (event == SFMessageEventCompleted || event == SFMessageEventTimedOut) {
+            length = decoder->messageLength;
+            memcpy(text, decoder->message, length + 1);
+        }
+    }
+
+    if (length == 0 && decoder->receiving) {
+        while (sfMessageDecoderPush(decoder, 0) != SFMessageEventTimedOut)
+            ;
+        length = decoder->messageLength;
+        memcpy(text, decoder->message, length + 1);
+    }
+    idleDetector->destroy(idle);
+    receiveDetector->destroy(receive);
+    return length;
+}
+
+#define MFSK_CLEAN_SNR      20.f        // dB, from there a lost frame is a fault of the modem, not of the noise
+
+/** Bits per second of the symbols of a mode, parity included */
+static double mfskSymbolRate(const SFMultiToneMode *mode)
+{
+    return mode->toneCount * mode->bits * SAMPLE_RATE / (mode->repeat * SF_MFSK_CALLBACK_FRAMES);
+}
+
+/** Bits per second of the single tone mode, one caracter of the band plan per symbol */
+static double mfskSingleToneRate(void)
+{
+    return log2(SF_CHAR_COUNT) * SAMPLE_RATE / (SF_EMISSION_CHAR_REPEAT * SF_MFSK_CALLBACK_FRAMES);
+}
+
+static int commandMfsk(int argc, char **argv)
+{
+    static const float defaultSnrs[] = { -12, -9, -6, -3, 0, 3, 6, 12, 20 };
+    const int modeCount = SF_MFSK_MODE_COUNT + 1;           // the single tone mode, then sfMultiToneModes
+    const float *snrs = defaultSnrs;
+    int snrCount = sizeof(defaultSnrs) / sizeof(defaultSnrs[0]);
+    float snr = 0;
+    double drift = 0;
+    int messageCount = 50, length = 24;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-messages") && i + 1 < argc) messageCount = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-length") && i + 1 < argc) length = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-drift") && i + 1 < argc) drift = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-snr") && i + 1 < argc) {
+            snr = atof(argv[++i]);
+            snrs = &snr;
+            snrCount = 1;
+        }
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (messageCount < 1 || length < 1 || length > SF_MESSAGE_CAPACITY || fabs(drift) > 5000) {
+        fprintf(stderr, "bad -messages, -length or -drift\n");
+        return 1;
+    }
+
+    // Random printable messages, the same for every mode and every SNR
+    char *messages = malloc(messageCount * (length + 1));
+    for (int m = 0; m < messageCount; m++) {
+        for (int i = 0; i < length; i++)
+            messages[m * (length + 1) + i] = (char)(SF_FIRST_CHAR + (int)(randomUniform() * SF_CHAR_COUNT));
+        messages[m * (length + 1) + length] = '\0';
+    }
+
+    // encoders[0] is the single tone mode, encoders[k] the mode k-1
+    SFMessageEncoder *encoders[SF_MFSK_MODE_COUNT + 1] = { NULL };
+    SFMultiToneDecoder *multiTone[SF_MFSK_MODE_COUNT] = { NULL };
+    int longest = 0;
+    for (int k = 0; k < modeCount; k++) {
+        SFEmissionPlan plan;
+        sfEmissionPlanDefault(&plan);
+        sfEmissionPlanSetMode(&plan, k - 1);
+        encoders[k] = sfMessageEncoderCreate(&plan);
+        if (k > 0)
+            multiTone[k - 1] = sfMultiToneDecoderCreate(SAMPLE_RATE, &sfMultiToneModes[k - 1]);
+        int frames = (LEAD_CALLBACKS + 8) * SF_EMISSION_FRAMES + sfMessageEncoderFrameCount(&plan, length);
+        if (frames > longest)
+            longest = frames;
+    }
+    SFMessageDecoder *decoder = sfMessageDecoderCreate();
+    int16_t *samples = malloc(longest * sizeof(int16_t));
+    int16_t *drifted = malloc((longest + longest / 100 + 1) * sizeof(int16_t));
+    char *text = malloc(SF_MESSAGE_CAPACITY + 1);
+    int *sent = malloc((SF_MESSAGE_CAPACITY + 1) * sizeof(int));
+    int *received = malloc((SF_MESSAGE_CAPACITY + 1) * sizeof(int));
+    int *row = malloc((SF_MESSAGE_CAPACITY + 2) * sizeof(int));
+    int *exacts = malloc(snrCount * modeCount * sizeof(int));
+
+    // Throughput of each mode: the payload (header and parity excluded) over the time of its symbols, and over the whole message with the start and stop tones
+    printf("%d random messages of %d caracters, SNR of a single tone caracter, emitter clock %+.0f ppm\n", messageCount, length, drift);
+    printf("%-5s %6s %6s %12s %7s %7s %9s %10s %12s\n", "mode", "start", "tones", "bits/symbol", "repeat", "parity", "symbols", "payload", "message");
+    for (int k = 0; k < modeCount; k++) {
+        const SFEmissionPlan *plan = &encoders[k]->plan;
+        const SFMultiToneMode *mode = k > 0 ? &sfMultiToneModes[k - 1] : NULL;
+        double bits = mode == NULL ? log2(SF_CHAR_COUNT) : mode->toneCount * mode->bits;
+        int symbols = mode == NULL ? length : sfMultiToneSymbolCount(mode, sfMultiToneFrameLength(mode, length));
+        double symbolSeconds = (double)plan->charRepeat * plan->frames / SAMPLE_RATE;
+        double seconds = (double)sfMessageEncoderFrameCount(plan, length) / SAMPLE_RATE;
+        printf("%-5d %6d %6d %12.1f %7d %7d %9d %6.0f b/s %10.3f s\n", k - 1, plan->startFrequency, mode != NULL ? mode->toneCount : 1, bits,
+               plan->charRepeat, mode != NULL ? mode->parity : 0, symbols, 8.0 * length / (symbols * symbolSeconds), seconds);
+    }
+
+    printf("\n%-6s", "SNR dB");
+    for (int k = 0; k < modeCount; k++)
+        printf("   mode %2d CER / ok", k - 1);
+    printf("\n");
+
+    for (int s = 0; s < snrCount; s++) {
+        float characterAmplitude = 0.26f * EMISSION_GAIN;
+        float noiseDeviation = sqrtf(characterAmplitude * characterAmplitude / 2.f / powf(10.f, snrs[s] / 10.f));
+        printf("%-6.0f", snrs[s]);
+
+        for (int k = 0; k < modeCount; k++) {
+            long characterErrors = 0;
+            int exact = 0;
+
+            for (int m = 0; m < messageCount; m++) {
+                const char *message = messages + m * (length + 1);
+                int frameCount = renderNoisyMessage(encoders[k], message, length, noiseDeviation, samples);
+                int textLength;
+                if (drift != 0) {
+                    frameCount = applyDrift(samples, frameCount, drift, drifted);
+                    textLength = receiveMessage(drifted, frameCount, decoder, multiTone, text);
+                }
+                else
+                    textLength = receiveMessage(samples, frameCount, decoder, multiTone, text);
+
+                for (int i = 0; i < length; i++)
+                    sent[i] = (unsigned char)message[i];
+                for (int i = 0; i < textLength; i++)
+                    received[i] = (unsigned char)text[i];
+                characterErrors += editDistance(sent, length, received, textLength, row);
+                exact += textLength == length && memcmp(text, message, length) == 0;
+            }
+            exacts[s * modeCount + k] = exact;
+            printf("   %9.4f / %3.0f%%", (double)characterErrors / (messageCount * length), 100.0 * exact / messageCount);
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    // No frame may be lost from MFSK_CLEAN_SNR: tones that leak into their neighbours or a lost symbol clock show there
+    int failures = 0;
+    for (int s = 0; s < snrCount; s++) {
+        for (int k = 0; k < modeCount && snrs[s] >= MFSK_CLEAN_SNR; k++) {
+            if (exacts[s * modeCount + k] < messageCount) {
+                printf("mode %d: %d frames of %d lost at %.0f dB\n", k - 1, messageCount - exacts[s * modeCount + k], messageCount, snrs[s]);
+                failures++;
+            }
+        }
+    }
+
+    // A coded mode must be worth its parity: at no SNR may it lose more frames than an uncoded mode that sends as fast or
+    // slower, the single tone mode included. The full duplex modes have half the band each, sfbench duplex checks them.
+    for (int m = 0; m < SF_MFSK_MODE_COUNT; m++) {
+        const SFMultiToneMode *mode = &sfMultiToneModes[m];
+        if (mode->parity == 0 || mode->bandWidth != SF_MFSK_BAND_WIDTH)
+            continue;
+        for (int k = 0; k < modeCount; k++) {
+            if (k > 0 && (sfMultiToneModes[k - 1].parity > 0 || mfskSymbolRate(&sfMultiToneModes[k - 1]) > mfskSymbolRate(mode)))
+                continue;
+            if (k == 0 && mfskSingleToneRate() > mfskSymbolRate(mode))
+                continue;
+            for (int s = 0; s < snrCount; s++) {
+                if (exacts[s * modeCount + m + 1] < exacts[s * modeCount + k]) {
+                    printf("mode %d: %d frames of %d received at %.0f dB, mode %d without parity %d\n", m, exacts[s * modeCount + m + 1],
+                           messageCount, snrs[s], k - 1, exacts[s * modeCount + k]);
+                    failures++;
+                }
+            }
+        }
+    }
+    printf("%s\n", failures ? "FAILED" : "OK");
+
+    for (int k = 0; k < modeCount; k++)
+        sfMessageEncoderDestroy(encoders[k]);
+    for (int m = 0; m < SF_MFSK_MODE_COUNT; m++)
+        sfMultiToneDecoderDestroy(multiTone[m]);
+    sfMessageDecoderDestroy(decoder);
+    free(messages);
+    free(samples);
+    free(drifted);
+    free(text);
+    free(sent);
+    free(received);
+    free(row);
+    free(exacts);
+    return failures != 0;
+}
+
+
+#pragma mark - Stream
+
+/** A received single tone string: each caracter of message 4 or 5 times, some of them replaced by a neighbour (±18 Hz) or by any caracter */
+static int synthesiseCaracters(const char *message, int length, float errors, char *raw)
+{
+    int n = 0;
+
+    for (int i = 0; i < length && n + 5 <= SF_MESSAGE_CAPACITY; i++) {
+        int repeat = 4 + (randomUniform() < 0.5f);
+        for (int r = 0; r < repeat; r++) {
+            int caracter = (unsigned char)message[i];
+            if (randomUniform() < errors) {
+                if (randomUniform() < 0.75f)
+                    caracter += randomUniform() < 0.5f ? -1 : 1;
+                else
+                    caracter = SF_FIRST_CHAR + (int)(randomUniform() * SF_CHAR_COUNT);
+            }
+            raw[n++] = (char)caracter;
+        }
+    }
+    return n;
+}
+
+static int commandStream(int argc, char **argv)
+{
+    const char *path = NULL;
+    int messageCount = 1000, length = 40;
+    float errors = 0.05f;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-file") && i + 1 < argc) path = argv[++i];
+        else if (!strcmp(argv[i], "-messages") && i + 1 < argc) messageCount = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-length") && i + 1 < argc) length = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-errors") && i + 1 < argc) errors = atof(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (messageCount < 1 || length < 1 || length > SF_MESSAGE_CAPACITY / 5 || errors < 0 || errors > 1) {
+        fprintf(stderr, "bad -messages, -length or -errors\n");
+        return 1;
+    }
+
+    FILE *file = NULL;
+    if (path != NULL && (file = fopen(path, "r")) == NULL) {
+        fprintf(stderr, "can't read %s\n", path);
+        return 1;
+    }
+
+    SFMessageStream *stream = malloc(sizeof(SFMessageStream));
+    char *raw = malloc(SF_MESSAGE_CAPACITY + 2);
+    char *message = malloc(length + 1);
+    int *sent = malloc((SF_MESSAGE_CAPACITY + 1) * sizeof(int));
+    int *received = malloc((SF_MESSAGE_CAPACITY + 1) * sizeof(int));
+    int *row = malloc((SF_MESSAGE_CAPACITY + 2) * sizeof(int));
+    double pushSeconds = 0, finishSeconds = 0, maxFinish = 0;
+    long caracters = 0, characterErrors = 0;
+    int streams = 0, exact = 0;
+    unsigned int allocations = 0;
+
+    for (;;) {
+        // A recorded stream is one line, the raw field of sfdecode; else a random message
+        int rawLength;
+        if (file != NULL) {
+            if (!fgets(raw, SF_MESSAGE_CAPACITY + 2, file))
+                break;
+            rawLength = (int)strcspn(raw, "\r\n");
+        }
+        else {
+            if (streams == messageCount)
+                break;
+            for (int i = 0; i < length; i++)
+                message[i] = (char)(SF_FIRST_CHAR + (int)(randomUniform() * SF_CHAR_COUNT));
+            message[length] = '\0';
+            rawLength = synthesiseCaracters(message, length, errors, raw);
+        }
+
+#if ALLOCATION_CHECK
+        unsigned int before = producerAllocations;
+        countAllocations = 1;
+#endif
+        double start = cpuSeconds();
+        sfMessageStreamReset(stream);
+        for (int i = 0; i < rawLength; i++)
+            sfMessageStreamPush(stream, raw[i]);
+        double stop = cpuSeconds();
+        int textLength = sfMessageStreamFinish(stream);
+        double end = cpuSeconds();
+#if ALLOCATION_CHECK
+        countAllocations = 0;
+        allocations += producerAllocations - before;
+#endif
+
+        pushSeconds += stop - start;
+        finishSeconds += end - stop;
+        if (end - stop > maxFinish)
+            maxFinish = end - stop;
+        caracters += rawLength;
+        streams++;
+
+        if (file != NULL)
+            printf("%s\t%d\n", stream->message, stream->quality);
+        else {
+            for (int i = 0; i < length; i++)
+                sent[i] = (unsigned char)message[i];
+            for (int i = 0; i < textLength; i++)
+                received[i] = (unsigned char)stream->message[i];
+            characterErrors += editDistance(sent, length, received, textLength, row);
+            exact += textLength == length && memcmp(stream->message, message, length) == 0;
+        }
+    }
+
+    FILE *summary = file != NULL ? stderr : stdout;
+    if (file == NULL)
+        fprintf(summary, "%d random messages of %d caracters, %.0f%% of the received caracters wrong: CER %.4f, %.0f%% exact\n",
+                streams, length, errors * 100, (double)characterErrors / (streams * length), 100.0 * exact / streams);
+    fprintf(summary, "%d streams, %ld caracters: %.1f ns per caracter, stop tone to message %.2f us average, %.2f us max",
+            streams, caracters, caracters ? pushSeconds * 1e9 / caracters : 0, streams ? finishSeconds * 1e6 / streams : 0, maxFinish * 1e6);
+#if ALLOCATION_CHECK
+    fprintf(summary, ", %u allocations\n", allocations);
+#else
+    fprintf(summary, ", allocations not checked on this libc\n");
+#endif
+
+    if (file != NULL)
+        fclose(file);
+    free(stream);
+    free(raw);
+    free(message);
+    free(sent);
+    free(received);
+    free(row);
+    return ALLOCATION_CHECK && allocations != 0;
+}
+
+
+#pragma mark - Lexicon
+
+#define LEXICON_DEFAULT_WORDS   "../SoundFi_DemoApp_15/SoundFi DemoApp/SoundFiLexicon.txt"
+#define LEXICON_FILE            "/tmp/sfbench-lexicon.bin"
+
+/** The words of a list for sflexicon: the runs of letters and digits of the lines that are not comments */
+static int readLexiconWords(const char *path, char ***words)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
+
+    char line[4096];
+    int count = 0, capacity = 0;
+    *words = NULL;
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#')
+            continue;
+        for (char *p = line; *p;) {
+            int length = 0;
+            while (isalnum((unsigned char)p[length]))
+                length++;
+            if (length == 0) {
+                p++;
+                continue;
+            }
+            if (count == capacity) {
+                capacity = capacity ? 2 * capacity : 256;
+                *words = realloc(*words, capacity * sizeof(char *));
+            }
+            (*words)[count++] = strndup(p, length);
+            p += length;
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+static int commandLexicon(int argc, char **argv)
+{
+    const char *path = LEXICON_DEFAULT_WORDS;
+    int trials = 10000;
+    float errors = 0.05f;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-words") && i + 1 < argc) path = argv[++i];
+        else if (!strcmp(argv[i], "-trials") && i + 1 < argc) trials = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-errors") && i + 1 < argc) errors = atof(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    char **words = NULL;
+    int wordCount = readLexiconWords(path, &words);
+    if (wordCount <= 0) {
+        fprintf(stderr, "can't read %s\n", path);
+        return 1;
+    }
+
+    // The engine maps the file written by sflexicon
+    SFLexicon *built = sfLexiconCreate((const char *const *)words, wordCount);
+    if (built == NULL || sfLexiconWrite(built, LEXICON_FILE) != 0) {
+        fprintf(stderr, "can't write %s\n", LEXICON_FILE);
+        return 1;
+    }
+    sfLexiconDestroy(built);
+    double openStart = cpuSeconds();
+    SFLexicon *lexicon = sfLexiconOpen(LEXICON_FILE);
+    double openSeconds = cpuSeconds() - openStart;
+    if (lexicon == NULL) {
+        fprintf(stderr, "can't map %s\n", LEXICON_FILE);
+        return 1;
+    }
+
+    SFMessageStream *stream = malloc(sizeof(SFMessageStream));
+    char *raw = malloc(SF_MESSAGE_CAPACITY + 2);
+    char word[SF_LEXICON_MAX_WORD + 1];
+    char corrected[2 * SF_LEXICON_MAX_WORD + 1];
+    int sent[2] = { 0 }, received[2] = { 0 }, fixed[2] = { 0 }, broken[2] = { 0 };    // [0] known words, [1] unknown ones
+    double correctSeconds = 0, maxSeconds = 0;
+
+    for (int t = 0; t < trials; t++) {
+        int unknown = t % 2;
+        int length;
+        if (!unknown) {
+            const char *known = words[(int)(randomUniform() * wordCount)];
+            length = (int)strlen(known);
+            if (length > SF_LEXICON_MAX_WORD)
+                continue;
+            memcpy(word, known, length);
+        }
+        else {
+            length = 4 + (int)(randomUniform() * 6);
+            for (int i = 0; i < length; i++)
+                word[i] = (char)('a' + (int)(randomUniform() * 26));
+            if (sfLexiconContains(lexicon, word, length))
+                continue;
+        }
+        word[length] = '\0';
+
+        int rawLength = synthesiseCaracters(word, length, errors, raw);
+        sfMessageStreamReset(stream);
+        for (int i = 0; i < rawLength; i++)
+            sfMessageStreamPush(stream, raw[i]);
+        int textLength = sfMessageStreamFinish(stream);
+
+        double start = cpuSeconds();
+        int correctedLength = sfLexiconCorrectText(lexicon, stream->message, textLength, corrected, sizeof(corrected));
+        double seconds = cpuSeconds() - start;
+        correctSeconds += seconds;
+        if (seconds > maxSeconds)
+            maxSeconds = seconds;
+
+        int before = textLength == length && !memcmp(stream->message, word, length);
+        int after = correctedLength == length && !memcmp(corrected, word, length);
+        sent[unknown]++;
+        received[unknown] += before;
+        fixed[unknown] += !before && after;
+        broken[unknown] += before && !after;
+    }
+
+    printf("%d words mapped in %.1f us, %.0f%% of the received caracters wrong\n", lexicon->wordCount, openSeconds * 1e6, errors * 100);
+    printf("known words:   %d, %.1f%% received right, %.1f%% after the correction (%d fixed, %d broken)\n",
+           sent[0], 100.0 * received[0] / sent[0], 100.0 * (received[0] + fixed[0] - broken[0]) / sent[0], fixed[0], broken[0]);
+    printf("unknown words: %d, %.1f%% received right, %.1f%% after the correction (%d changed to a known word)\n",
+           sent[1], 100.0 * received[1] / sent[1], 100.0 * (received[1] + fixed[1] - broken[1]) / sent[1], broken[1]);
+    printf("correction: %.2f us per word average, %.2f us max\n", correctSeconds * 1e6 / (sent[0] + sent[1]), maxSeconds * 1e6);
+
+    sfLexiconDestroy(lexicon);
+    remove(LEXICON_FILE);
+    for (int i = 0; i < wordCount; i++)
+        free(words[i]);
+    free(words);
+    free(stream);
+    free(raw);
+    return 0;
+}
+
+
+#pragma mark - Duplex
+
+#define ECHO_DELAY          441         // samples from the loudspeaker to the microphone, output and input latency included
+#define ECHO_MARGIN         32          // the canceller starts its taps a bit before the echo
+#define ECHO_ROOM_TAPS      64          // length of the impulse response of the room
+#define PEER_ATTENUATION    8.f         // the peer is 18 dB under a received emission (EMISSION_GAIN)
+
+/** The peer message alone until its stop tone, like a receiver in full duplex that only listen to the mode of the peer.
+
+ @return The length of the message, 0 if its start tone is missed or nothing was received
+ */
+static int receiveDuplex(const int16_t *samples, int frameCount, SFMultiToneDecoder *decoder, char *text)
+{
+    const SFDetector *idleDetector = sfFindDetector("floor");
+    void *idle = idleDetector->create();
+    int16_t buffer[CALLBACK_FRAMES];
+    int position = 0, length = 0, found = 0;
+
+    while (!found && position + SF_MESSAGE_IDLE_BUFFER <= frameCount) {
+        float frequency = 0;
+        for (int offset = 0; offset < SF_MESSAGE_IDLE_BUFFER; offset += CALLBACK_FRAMES) {
+            memcpy(buffer, samples + position + offset, CALLBACK_FRAMES * sizeof(int16_t));
+            frequency = idleDetector->process(idle, buffer, CALLBACK_FRAMES);
+        }
+        position += SF_MESSAGE_IDLE_BUFFER;
+        found = sfMultiToneFindMode((int)frequency) == decoder->mode - sfMultiToneModes;
+    }
+
+    sfMultiToneDecoderReset(decoder);
+    while (found && position + SF_MESSAGE_RECEPTION_BUFFER <= frameCount) {
+        SFMessageEvent event = sfMultiToneDecoderProcess(decoder, samples + position, SF_MESSAGE_RECEPTION_BUFFER);
+        position += SF_MESSAGE_RECEPTION_BUFFER;
+        if (event == SFMessageEventCompleted || event == SFMessageEventTimedOut) {
+            length = decoder->messageLength;
+            memcpy(text, decoder->message, length + 1);
+            break;
+        }
+    }
+    idleDetector->destroy(idle);
+    return length;
+}
+
+static int commandDuplex(int argc, char **argv)
+{
+    static const float defaultEchoes[] = { 0, 10, 20, 30, 40 };
+    const float *echoes = defaultEchoes;
+    int echoCount = sizeof(defaultEchoes) / sizeof(defaultEchoes[0]);
+    float echo = 0, snr = 10;
+    float step = SF_ECHO_DEFAULT_STEP;
+    int messageCount = 20, length = 24, taps = SF_ECHO_DEFAULT_TAPS;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-messages") && i + 1 < argc) messageCount = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-length") && i + 1 < argc) length = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-snr") && i + 1 < argc) snr = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-taps") && i + 1 < argc) taps = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-step") && i + 1 < argc) step = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-echo") && i + 1 < argc) {
+            echo = atof(argv[++i]);
+            echoes = &echo;
+            echoCount = 1;
+        }
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (messageCount < 1 || length < 1 || length > SF_MESSAGE_CAPACITY || taps < ECHO_MARGIN + ECHO_ROOM_TAPS || step <= 0 || step >= 2) {
+        fprintf(stderr, "bad -messages, -length, -taps or -step\n");
+        return 1;
+    }
+
+    // The device sends in the low half, the peer in the high half, both at the same time
+    SFEmissionPlan plan;
+    sfEmissionPlanDefault(&plan);
+    sfEmissionPlanSetMode(&plan, SF_MFSK_DUPLEX_LOW_MODE);
+    SFMessageEncoder *own = sfMessageEncoderCreate(&plan);
+    sfEmissionPlanSetMode(&plan, SF_MFSK_DUPLEX_HIGH_MODE);
+    SFMessageEncoder *peer = sfMessageEncoderCreate(&plan);
+    SFMultiToneDecoder *decoder = sfMultiToneDecoderCreate(SAMPLE_RATE, &sfMultiToneModes[SF_MFSK_DUPLEX_HIGH_MODE]);
+    SFEchoCanceller *canceller = sfEchoCancellerCreate(taps, ECHO_DELAY - ECHO_MARGIN, step);
+
+    // The own message starts LEAD_CALLBACKS/2 before the one of the peer and is a bit longer, it covers it from its start tone to its stop tone
+    int peerStart = LEAD_CALLBACKS * SF_EMISSION_FRAMES;
+    int ownStart = peerStart / 2;
+    int frameCount = peerStart + sfMessageEncoderFrameCount(&peer->plan, length) + 8 * SF_EMISSION_FRAMES;
+    frameCount -= frameCount % SF_EMISSION_FRAMES;
+    float *reference = calloc(frameCount, sizeof(float));
+    float *peerSignal = calloc(frameCount, sizeof(float));
+    int16_t *microphone = malloc(frameCount * sizeof(int16_t));
+    int16_t *cancelled = malloc(frameCount * sizeof(int16_t));
+    char *ownMessage = malloc(length + 1 + ECHO_ROOM_TAPS);
+    char *message = malloc(length + 1);
+    char *text = malloc(SF_MESSAGE_CAPACITY + 1);
+    float room[ECHO_ROOM_TAPS];
+
+    printf("%d messages of %d caracters in mode %d while sending in mode %d, peer SNR %.0f dB, canceller of %d taps\n",
+           messageCount, length, SF_MFSK_DUPLEX_HIGH_MODE, SF_MFSK_DUPLEX_LOW_MODE, snr, taps);
+    printf("%-8s %22s %22s %12s\n", "echo dB", "without canceller", "with canceller", "attenuation");
+
+    for (int e = 0; e < echoCount; e++) {
+        // The peer far enough to be received alone without error, the echo echoes[e] dB above it
+        float peerGain = EMISSION_GAIN / PEER_ATTENUATION;
+        float echoGain = peerGain * powf(10.f, echoes[e] / 20.f);
+        float characterAmplitude = 0.26f * peerGain;
+        float noiseDeviation = sqrtf(characterAmplitude * characterAmplitude / 2.f / powf(10.f, snr / 10.f));
+        int exact[2] = { 0, 0 };
+        long characterErrors[2] = { 0, 0 };
+        double attenuation = 0;
+
+        for (int m = 0; m < messageCount; m++) {
+            int ownLength = length + ECHO_ROOM_TAPS;
+            for (int i = 0; i < length; i++)
+                message[i] = (char)(SF_FIRST_CHAR + (int)(randomUniform() * SF_CHAR_COUNT));
+            message[length] = '\0';
+            for (int i = 0; i < ownLength; i++)
+                ownMessage[i] = (char)(SF_FIRST_CHAR + (int)(randomUniform() * SF_CHAR_COUNT));
+
+            // A decaying random impulse response for each message, the direct path first
+            for (int k = 0; k < ECHO_ROOM_TAPS; k++)
+                room[k] = (k == 0 ? 1.f : 0.5f * randomGaussian()) * expf(-k / 12.f);
+
+            memset(reference, 0, frameCount * sizeof(float));
+            memset(peerSignal, 0, frameCount * sizeof(float));
+            sfMessageEncoderStart(own, ownMessage, ownLength);
+            for (int frame = ownStart; frame + SF_EMISSION_FRAMES <= frameCount && sfMessageEncoderRender(own, reference + frame) > 0; frame += SF_EMISSION_FRAMES)
+                ;
+            sfMessageEncoderStart(peer, message, length);
+            for (int frame = peerStart; frame + SF_EMISSION_FRAMES <= frameCount && sfMessageEncoderRender(peer, peerSignal + frame) > 0; frame += SF_EMISSION_FRAMES)
+                ;
+
+            for (int n = 0; n < frameCount; n++) {
+                float value = peerSignal[n] * peerGain + randomGaussian() * noiseDeviation;
+                for (int k = 0; k < ECHO_ROOM_TAPS && n - ECHO_DELAY - k >= 0; k++)
+                    value += room[k] * reference[n - ECHO_DELAY - k] * echoGain;
+                if (value > 32767.f) value = 32767.f;
+                if (value < -32768.f) value = -32768.f;
+                microphone[n] = (int16_t)lrintf(value);
+            }
+
+            // The canceller is fed like the engine does, one callback at a time
+            memcpy(cancelled, microphone, frameCount * sizeof(int16_t));
+            sfEchoCancellerReset(canceller);
+            for (int frame = 0; frame < frameCount; frame += CALLBACK_FRAMES)
+                sfEchoCancellerProcess(canceller, reference + frame, cancelled + frame, CALLBACK_FRAMES);
+            attenuation += sfEchoCancellerAttenuation(canceller);
+
+            for (int k = 0; k < 2; k++) {
+                int textLength = receiveDuplex(k == 0 ? microphone : cancelled, frameCount, decoder, text);
+                int sent[SF_MESSAGE_CAPACITY + 1], received[SF_MESSAGE_CAPACITY + 1], row[SF_MESSAGE_CAPACITY + 2];
+                for (int i = 0; i < length; i++)
+                    sent[i] = (unsigned char)message[i];
+                for (int i = 0; i < textLength; i++)
+                    received[i] = (unsigned char)text[i];
+                characterErrors[k] += editDistance(sent, length, received, textLength, row);
+                exact[k] += textLength == length && memcmp(text, message, length) == 0;
+            }
+        }
+        printf("%-8.0f", echoes[e]);
+        for (int k = 0; k < 2; k++)
+            printf("   %9.4f CER / %3.0f%%", (double)characterErrors[k] / (messageCount * length), 100.0 * exact[k] / messageCount);
+        printf("   %9.1f dB\n", attenuation / messageCount);
+        fflush(stdout);
+    }
+
+    sfMessageEncoderDestroy(own);
+    sfMessageEncoderDestroy(peer);
+    sfMultiToneDecoderDestroy(decoder);
+    sfEchoCancellerDestroy(canceller);
+    free(reference);
+    free(peerSignal);
+    free(microphone);
+    free(cancelled);
+    free(ownMessage);
+    free(message);
+    free(text);
+    return 0;
+}
+
+
+#pragma mark - Chirp
+
+/** Render the preamble and the first symbols of a message after lead samples of noise, return the frames written */
+static int renderPreamble(SFMessageEncoder *encoder, int lead, int callbacks, float noiseDeviation, int16_t *samples)
+{
+    float buffer[SF_EMISSION_FRAMES];
+    int frame = 0;
+
+    sfMessageEncoderStart(encoder, "Preamble", 8);
+    for (int i = 0; i < lead; i++, frame++)
+        samples[frame] = (int16_t)lrintf(randomGaussian() * noiseDeviation);
+    for (int c = 0; c < callbacks; c++) {
+        int rendered = sfMessageEncoderRender(encoder, buffer) > 0;
+        for (int i = 0; i < SF_EMISSION_FRAMES; i++, frame++) {
+            float value = (rendered ? buffer[i] * EMISSION_GAIN : 0) + randomGaussian() * noiseDeviation;
+            if (value > 32767.f) value = 32767.f;
+            if (value < -32768.f) value = -32768.f;
+            samples[frame] = (int16_t)lrintf(value);
+        }
+    }
+    return frame;
+}
+
+/** The start tone found by the idle detector (buffers of 2048), then the decoder synchronised on its end.
+
+ @param detected Receive the sample where the start tone was found
+ @return The first sample of the first symbol for the decoder, -1 if the start tone is missed
+ */
+static double toneSynchronisation(const int16_t *samples, int frameCount, SFMultiToneDecoder *decoder, int *detected)
+{
+    const SFDetector *idleDetector = sfFindDetector("floor");
+    void *idle = idleDetector->create();
+    int16_t buffer[CALLBACK_FRAMES];
+    double symbol = -1;
+    int position = 0;
+
+    while (position + SF_MESSAGE_IDLE_BUFFER <= frameCount) {
+        float frequency = 0;
+        for (int offset = 0; offset < SF_MESSAGE_IDLE_BUFFER; offset += CALLBACK_FRAMES) {
+            memcpy(buffer, samples + position + offset, CALLBACK_FRAMES * sizeof(int16_t));
+            frequency = idleDetector->process(idle, buffer, CALLBACK_FRAMES);
+        }
+        position += SF_MESSAGE_IDLE_BUFFER;
+        if (sfMultiToneFindMode((int)frequency) == decoder->mode - sfMultiToneModes)
+            break;
+    }
+    *detected = position;
+
+    sfMultiToneDecoderReset(decoder);
+    int start = position;
+    while (position + SF_MESSAGE_RECEPTION_BUFFER <= frameCount && !decoder->synchronised) {
+        SFMessageEvent event = sfMultiToneDecoderProcess(decoder, samples + position, SF_MESSAGE_RECEPTION_BUFFER);
+        position += SF_MESSAGE_RECEPTION_BUFFER;
+        if (event == SFMessageEventTimedOut)
+            break;
+    }
+    if (decoder->synchronised)
+        symbol = start + decoder->symbolStart;
+    idleDetector->destroy(idle);
+    return symbol;
+}
+
+/** The chirp found by the matched filter, the mode told by the start tone that follows.
+
+ @param detected Receive the sample where the chirp was reported
+ @return The first sample of the first symbol, -1 if the chirp is missed or the mode is wrong
+ */
+static double chirpSynchronisation(const int16_t *samples, int frameCount, SFChirpDetector *detector, int mode, int *detected)
+{
+    int position = 0;
+
+    sfChirpDetectorReset(detector);
+    *detected = frameCount;
+    while (position + SF_MESSAGE_IDLE_BUFFER <= frameCount) {
+        int used = 0;
+        int found = sfChirpDetectorProcess(detector, samples + position, SF_MESSAGE_IDLE_BUFFER, &used);
+        position += used;
+        if (!found)
+            continue;
+        *detected = position;
+        if (sfMultiToneIdentifyMode(sfChirpDetectorFollowing(detector, NULL), SF_CHIRP_MODE_FRAMES, SAMPLE_RATE) != mode)
+            return -1;
+        return detector->chirpEnd + SF_CHIRP_MODE_FRAMES;
+    }
+    return -1;
+}
+
+static int commandChirp(int argc, char **argv)
+{
+    static const float defaultSnrs[] = { -24, -21, -18, -15, -12, -9, -6, -3, 0, 6 };
+    const float *snrs = defaultSnrs;
+    int snrCount = sizeof(defaultSnrs) / sizeof(defaultSnrs[0]);
+    float snr = 0;
+    int trials = 100, seconds = 600;
+    const int mode = 0;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-trials") && i + 1 < argc) trials = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-seconds") && i + 1 < argc) seconds = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-snr") && i + 1 < argc) {
+            snr = atof(argv[++i]);
+            snrs = &snr;
+            snrCount = 1;
+        }
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (trials < 1 || seconds < 1) {
+        fprintf(stderr, "bad -trials or -seconds\n");
+        return 1;
+    }
+
+    // The same mode with the start tone only and with the chirp preamble, up to its first symbols
+    SFEmissionPlan tonePlan, chirpPlan;
+    sfEmissionPlanDefault(&tonePlan);
+    sfEmissionPlanSetMode(&tonePlan, mode);
+    chirpPlan = tonePlan;
+    sfEmissionPlanSetChirp(&chirpPlan, SF_CHIRP_LENGTH);
+    SFMessageEncoder *toneEncoder = sfMessageEncoderCreate(&tonePlan);
+    SFMessageEncoder *chirpEncoder = sfMessageEncoderCreate(&chirpPlan);
+    SFMultiToneDecoder *decoder = sfMultiToneDecoderCreate(SAMPLE_RATE, &sfMultiToneModes[mode]);
+    SFChirpDetector *detector = sfChirpDetectorCreate(SAMPLE_RATE, SF_CHIRP_LENGTH, SF_CHIRP_MODE_FRAMES);
+    const int callbacks = tonePlan.initRepeat + 2 * tonePlan.charRepeat + 16;
+    const int longest = (LEAD_CALLBACKS + 1 + callbacks) * SF_EMISSION_FRAMES;
+    int16_t *samples = malloc((longest > SAMPLE_RATE ? longest : SAMPLE_RATE) * sizeof(int16_t));
+
+    printf("mode %d, %d trials per SNR (SNR of a single tone caracter), random lead of %d..%d samples\n", mode, trials,
+           LEAD_CALLBACKS * SF_EMISSION_FRAMES, (LEAD_CALLBACKS + 1) * SF_EMISSION_FRAMES - 1);
+    printf("preamble: start tone %d callbacks (%.0f ms), chirp %d samples + start tone %d callbacks (%.0f ms)\n\n",
+           tonePlan.initRepeat, 1000.0 * tonePlan.initRepeat * SF_EMISSION_FRAMES / SAMPLE_RATE,
+           SF_CHIRP_LENGTH, chirpPlan.initRepeat, 1000.0 * (SF_CHIRP_LENGTH + chirpPlan.initRepeat * SF_EMISSION_FRAMES) / SAMPLE_RATE);
+    printf("%-6s %24s %24s\n", "", "start tone", "chirp");
+    printf("%-6s %8s %8s %8s %8s %8s %8s\n", "SNR dB", "sync", "error", "latency", "sync", "error", "latency");
+
+    for (int s = 0; s < snrCount; s++) {
+        float characterAmplitude = 0.26f * EMISSION_GAIN;
+        float noiseDeviation = sqrtf(characterAmplitude * characterAmplitude / 2.f / powf(10.f, snrs[s] / 10.f));
+        int synchronised[2] = { 0 };
+        double error[2] = { 0 }, latency[2] = { 0 };
+
+        // Synchronised: the first symbol is found within a quarter of a symbol, else the symbols are shifted
+        for (int t = 0; t < trials; t++) {
+            int lead = LEAD_CALLBACKS * SF_EMISSION_FRAMES + (int)(randomUniform() * SF_EMISSION_FRAMES);
+            for (int k = 0; k < 2; k++) {
+                SFMessageEncoder *encoder = k == 0 ? toneEncoder : chirpEncoder;
+                int frameCount = renderPreamble(encoder, lead, callbacks, noiseDeviation, samples);
+                int preamble = encoder->chirpCallbacks * SF_EMISSION_FRAMES + encoder->plan.initRepeat * SF_EMISSION_FRAMES;
+                int detected = 0;
+                double symbol = k == 0 ? toneSynchronisation(samples, frameCount, decoder, &detected)
+                                       : chirpSynchronisation(samples, frameCount, detector, mode, &detected);
+                double offset = fabs(symbol - (lead + preamble));
+                if (symbol >= 0 && offset < decoder->symbolLength / 4) {
+                    synchronised[k]++;
+                    error[k] += offset;
+                    latency[k] += (double)(detected - lead) / SAMPLE_RATE;
+                }
+            }
+        }
+        printf("%-6.0f", snrs[s]);
+        for (int k = 0; k < 2; k++) {
+            if (synchronised[k] > 0)
+                printf(" %7.0f%% %8.1f %5.0f ms", 100.0 * synchronised[k] / trials, error[k] / synchronised[k], 1000.0 * latency[k] / synchronised[k]);
+            else
+                printf(" %7.0f%% %8s %8s", 0.0, "-", "-");
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    // False alarms of the matched filter on noise only, at the level of the lowest SNR
+    float characterAmplitude = 0.26f * EMISSION_GAIN;
+    float noiseDeviation = sqrtf(characterAmplitude * characterAmplitude / 2.f / powf(10.f, snrs[0] / 10.f));
+    int alarms = 0;
+    double cpu = 0;
+    sfChirpDetectorReset(detector);
+    for (int second = 0; second < seconds; second++) {
+        for (int i = 0; i < SAMPLE_RATE; i++)
+            samples[i] = (int16_t)lrintf(randomGaussian() * noiseDeviation);
+        double start = cpuSeconds();
+        for (int position = 0; position < SAMPLE_RATE; ) {
+            int used = 0;
+            if (sfChirpDetectorProcess(detector, samples + position, SAMPLE_RATE - position, &used)) {
+                alarms++;
+                sfChirpDetectorReset(detector);
+            }
+            position += used;
+        }
+        cpu += cpuSeconds() - start;
+    }
+    printf("\nnoise only: %d false chirps in %d s, matched filter %.2f%% of one core\n", alarms, seconds, 100.0 * cpu / seconds);
+
+    sfMessageEncoderDestroy(toneEncoder);
+    sfMessageEncoderDestroy(chirpEncoder);
+    sfMultiToneDecoderDestroy(decoder);
+    sfChirpDetectorDestroy(detector);
+    free(samples);
+    return 0;
+}
+
+
+#pragma mark - Zone
+
+// A beacon of one spot, then the beacon of another spot, in white noise. The
+// detections of the background detector (one per buffer of 2048) go to the
+// old zoneDetection (blocks of 25 detections, a spot validated by two blocks
+// in a row) and to SFZoneEstimator: time from the start of each beacon to the
+// decision of its spot, wrong decisions, and beacons never decided.
+
+#define ZONE_LEAD           1.f         // seconds of noise before the first beacon
+#define ZONE_BEACON         5.f         // seconds of each beacon
+#define ZONE_AMPLITUDE      0.26f       // of a beacon, like a caracter
+
+typedef struct {
+    int         data[25];               // curentFrequencyData
+    int         count;                  // nbrVal
+    int         lastSpot;               // lastPos
+    int         validSpot;              // lastPosValidate
+} BlockZone;
+
+/** The geolocalisation of the engine before SFZoneEstimator, return the spot validated by this detection or -1 */
+static int blockZoneUpdate(BlockZone *zone, int frequency)
+{
+    if (zone->count <= 24) {
+        zone->data[zone->count++] = frequency;
+        return -1;
+    }
+    zone->count = 0;
+
+    int average = 0;
+    double deviation = 0;
+    for (int i = 0; i < 25; i++)
+        average += zone->data[i];
+    average /= 25;
+    for (int i = 0; i < 25; i++)
+        deviation += pow(zone->data[i] - average, 2);
+    if (sqrt(deviation / 25.) > 25)
+        return -1;
+
+    int spot = (average - SF_GEO_MIN_FREQUENCY) / SF_GEO_SPACING;
+    int validated = -1;
+    if (spot == zone->lastSpot && spot != zone->validSpot) {
+        zone->validSpot = spot;
+        validated = spot;
+    }
+    zone->lastSpot = spot;
+    return validated;
+}
+
+static int commandZone(int argc, char **argv)
+{
+    int trials = 50;
+    float snr = 10;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-trials") && i + 1 < argc) trials = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-snr") && i + 1 < argc) snr = atof(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    const SFDetector *detector = sfFindDetector("fft");
+    const int step = BACKGROUND_FRAMES / CALLBACK_FRAMES;
+    const float bufferSeconds = (float)BACKGROUND_FRAMES / SAMPLE_RATE;
+    int leadFrames = (int)(ZONE_LEAD * SAMPLE_RATE);
+    int beaconFrames = (int)(ZONE_BEACON * SAMPLE_RATE);
+    int frameCount = (leadFrames + 2 * beaconFrames) / BACKGROUND_FRAMES * BACKGROUND_FRAMES;
+    int16_t *samples = malloc(frameCount * sizeof(int16_t));
+
+    float amplitude = ZONE_AMPLITUDE * EMISSION_GAIN;
+    float noiseDeviation = sqrtf(amplitude * amplitude / 2.f / powf(10.f, snr / 10.f));
+
+    // [0] the blocks of 25, [1] SFZoneEstimator
+    double total[2] = { 0 }, worst[2] = { 0 };
+    int decided[2] = { 0 }, wrong[2] = { 0 };
+    double updateSeconds = 0;
+    int updates = 0;
+
+    for (int t = 0; t < trials; t++) {
+        int spots[2];
+        spots[0] = (int)(randomUniform() * SF_GEO_SPOT_COUNT);
+        do
+            spots[1] = (int)(randomUniform() * SF_GEO_SPOT_COUNT);
+        while (spots[1] == spots[0]);
+
+        double phase = 2 * M_PI * randomUniform();
+        for (int i = 0; i < frameCount; i++) {
+            float value = randomGaussian() * noiseDeviation;
+            if (i >= leadFrames) {
+                int beacon = i >= leadFrames + beaconFrames;
+                phase = fmod(phase + 2 * M_PI * sfGeoFrequency(spots[beacon]) / SAMPLE_RATE, 2 * M_PI);
+                value += amplitude * sinf((float)phase);
+            }
+            if (value > 32767.f) value = 32767.f;
+            if (value < -32768.f) value = -32768.f;
+            samples[i] = (int16_t)lrintf(value);
+        }
+
+        float *result = runDetector(detector, samples, frameCount, 1, NULL);
+        BlockZone block = { .count = 0, .lastSpot = -1, .validSpot = -1 };
+        SFZoneEstimator zone;
+        sfZoneEstimatorReset(&zone);
+        double decision[2][2];          // [method][beacon] seconds from the start of the beacon
+        for (int m = 0; m < 2; m++)
+            decision[m][0] = decision[m][1] = -1;
+
+        for (int c = step - 1; c < frameCount / CALLBACK_FRAMES; c += step) {
+            int frequency = (int)result[c];
+            if (frequency <= SF_GEO_MIN_FREQUENCY || frequency >= SF_GEO_MAX_FREQUENCY)
+                continue;
+
+            int end = (c + 1) * CALLBACK_FRAMES;
+            int beacon = end > leadFrames + beaconFrames;
+            double seconds = (double)(end - leadFrames - beacon * beaconFrames) / SAMPLE_RATE;
+
+            double start = cpuSeconds();
+            int found[2];
+            found[1] = sfZoneEstimatorUpdate(&zone, frequency);
+            updateSeconds += cpuSeconds() - start;
+            updates++;
+            found[0] = blockZoneUpdate(&block, frequency);
+
+            for (int m = 0; m < 2; m++) {
+                if (found[m] < 0)
+                    continue;
+                if (end <= leadFrames || found[m] != spots[beacon])
+                    wrong[m]++;
+                else if (decision[m][beacon] < 0)
+                    decision[m][beacon] = seconds;
+            }
+        }
+
+        for (int m = 0; m < 2; m++)
+            for (int b = 0; b < 2; b++) {
+                if (decision[m][b] < 0)
+                    continue;
+                decided[m]++;
+                total[m] += decision[m][b];
+                if (decision[m][b] > worst[m])
+                    worst[m] = decision[m][b];
+            }
+        free(result);
+    }
+
+    static const char *names[] = { "blocks of 25", "SFZoneEstimator" };
+    printf("%d trials of two beacons of %.0f s at %.0f dB SNR, one detection every %.0f ms\n", trials, ZONE_BEACON, snr, bufferSeconds * 1000);
+    printf("%-16s %10s %10s %10s %8s\n", "", "decided", "average s", "worst s", "wrong");
+    for (int m = 0; m < 2; m++)
+        printf("%-16s %9.1f%% %10.2f %10.2f %8d\n", names[m], 50.0 * decided[m] / trials,
+               decided[m] ? total[m] / decided[m] : 0, worst[m], wrong[m]);
+    printf("update: %.3f us per detection\n", updates ? updateSeconds * 1e6 / updates : 0);
+
+    free(samples);
+    return 0;
+}
+
+
+#pragma mark - Beacons
+
+// The user walks from the beacon of one spot to the beacon of the next one:
+// the amplitude of the first goes from 1 to 0, the one of the second from 0
+// to 1, each one with its own slow fading, and a far beacon is heard 10 dB
+// under. The true position is the first spot plus the share of the second in
+// the amplitude. The 2048 points spectrum of SFVocoder (the geolocalisation
+// detector of the engine) gives the single peak frequency and the spectrum of
+// SFBeaconScanner: changes of spot, with and without SFZoneEstimator, and
+// error of the position.
+
+#define BEACON_FIRST_SPOT   6
+#define BEACON_FAR_SPOT     14
+#define BEACON_FAR_GAIN     0.32f       // -10 dB
+#define BEACON_FADING_STEP  0.1f        // seconds between two random fading gains, interpolated
+
+static int commandBeacons(int argc, char **argv)
+{
+    float seconds = 20;
+    float snr = 20;
+    float fading = 3;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-seconds") && i + 1 < argc) seconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-snr") && i + 1 < argc) snr = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-fading") && i + 1 < argc) fading = atof(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    const int spots[3] = { BEACON_FIRST_SPOT, BEACON_FIRST_SPOT + 1, BEACON_FAR_SPOT };
+    const int fadingFrames = (int)(BEACON_FADING_STEP * SAMPLE_RATE);
+    int frameCount = (int)(seconds * SAMPLE_RATE) / BACKGROUND_FRAMES * BACKGROUND_FRAMES;
+    int16_t *samples = malloc(frameCount * sizeof(int16_t));
+
+    float amplitude = ZONE_AMPLITUDE * EMISSION_GAIN;
+    float noiseDeviation = sqrtf(amplitude * amplitude / 2.f / powf(10.f, snr / 10.f));
+    double phases[3] = { 0 };
+    float gains[3][2];                  // fading gain at the start and at the end of the step
+    for (int b = 0; b < 3; b++)
+        gains[b][1] = powf(10.f, fading * randomGaussian() / 20.f);
+
+    for (int i = 0; i < frameCount; i++) {
+        if (i % fadingFrames == 0)
+            for (int b = 0; b < 3; b++) {
+                gains[b][0] = gains[b][1];
+                gains[b][1] = powf(10.f, fading * randomGaussian() / 20.f);
+            }
+        float walked = (float)i / frameCount;
+        float step = (float)(i % fadingFrames) / fadingFrames;
+        float levels[3] = { 1.f - walked, walked, BEACON_FAR_GAIN };
+        float value = randomGaussian() * noiseDeviation;
+        for (int b = 0; b < 3; b++) {
+            phases[b] = fmod(phases[b] + 2 * M_PI * sfGeoFrequency(spots[b]) / SAMPLE_RATE, 2 * M_PI);
+            value += amplitude * levels[b] * (gains[b][0] + step * (gains[b][1] - gains[b][0])) * sinf((float)phases[b]);
+        }
+        if (value > 32767.f) value = 32767.f;
+        if (value < -32768.f) value = -32768.f;
+        samples[i] = (int16_t)lrintf(value);
+    }
+
+    SFVocoder *vocoder = sfVocoderCreate(BACKGROUND_FRAMES, 4, SAMPLE_RATE, 101);
+    SFBeaconScanner *scanner = sfBeaconScannerCreate(BACKGROUND_FRAMES, SAMPLE_RATE, (float)BACKGROUND_FRAMES / SAMPLE_RATE);
+    SFZoneEstimator zones[2];
+
+    // [0] the single peak, [1] SFBeaconScanner
+    int lastSpot[2] = { -1, -1 }, spotChanges[2] = { 0 }, decisions[2] = { 0 }, wrongSpots[2] = { 0 }, heard[2] = { 0 };
+    double squaredError[2] = { 0 };
+    double scanSeconds = 0;
+    int buffers = 0, beaconTotal = 0;
+    for (int m = 0; m < 2; m++)
+        sfZoneEstimatorReset(&zones[m]);
+
+    for (int start = 0; start < frameCount; start += BACKGROUND_FRAMES) {
+        float frequency = 0;
+        sfVocoderProcessInt16(vocoder, samples + start, BACKGROUND_FRAMES, &frequency);
+        double begin = cpuSeconds();
+        beaconTotal += sfBeaconScannerUpdate(scanner, vocoder->magnitudes);
+        scanSeconds += cpuSeconds() - begin;
+        buffers++;
+
+        float truth = BEACON_FIRST_SPOT + (float)(start + BACKGROUND_FRAMES) / frameCount;
+        int trueSpot = (int)lrintf(truth);
+        float frequencies[2] = { frequency, sfBeaconScannerFrequency(scanner) };
+        for (int m = 0; m < 2; m++) {
+            if (frequencies[m] <= SF_GEO_MIN_FREQUENCY || frequencies[m] >= SF_GEO_MAX_FREQUENCY)
+                continue;
+            float position = (frequencies[m] - SF_GEO_MIN_FREQUENCY) / SF_GEO_SPACING - 0.5f;
+            int spot = (int)floorf(position + 0.5f);
+            heard[m]++;
+            squaredError[m] += (position - truth) * (position - truth);
+            wrongSpots[m] += spot != trueSpot;
+            if (lastSpot[m] >= 0 && spot != lastSpot[m])
+                spotChanges[m]++;
+            lastSpot[m] = spot;
+            if (sfZoneEstimatorUpdate(&zones[m], frequencies[m]) >= 0)
+                decisions[m]++;
+        }
+    }
+
+    static const char *names[] = { "single peak", "SFBeaconScanner" };
+    printf("walk from spot %d to spot %d in %.0f s, a far beacon at -10 dB, %.0f dB SNR, %.0f dB fading\n",
+           spots[0], spots[1], seconds, snr, fading);
+    printf("%-16s %8s %14s %10s %12s %10s\n", "", "heard", "spot changes", "decisions", "wrong spot", "rms error");
+    for (int m = 0; m < 2; m++)
+        printf("%-16s %7.1f%% %14d %10d %11.1f%% %10.2f\n", names[m], 100.0 * heard[m] / buffers, spotChanges[m], decisions[m],
+               heard[m] ? 100.0 * wrongSpots[m] / heard[m] : 0, heard[m] ? sqrt(squaredError[m] / heard[m]) : 0);
+    printf("%.1f beacons per spectrum, scan %.2f us per spectrum\n", (float)beaconTotal / buffers, scanSeconds * 1e6 / buffers);
+
+    sfVocoderDestroy(vocoder);
+    sfBeaconScannerDestroy(scanner);
+    free(samples);
+    return 0;
+}
+
+
+#pragma mark - Promotions
+
+// The promotions of the spots on a local SFPromotionServer with a mobile
+// network latency. Each spot validated by zoneDetection is notified the old
+// way (a GET of test.php?id= then the parse of its response) and from
+// SFPromotionCache filled by one prefetch of the area: time from the spot to
+// the promotion. Then the clock of the cache goes past the max-age, one
+// promotion is changed on the server, and every promotion is revalidated with
+// its ETag (304 without body, 200 for the changed one). At last the cache is
+// written, the server stopped and the file read in a new cache: the
+// promotions are still there without network.
+
+#define PROMOTION_PATH      "/tmp/sfbench-promotions.bin"
+
+/** The id of the promotion of an entry: the frequency of a spot, then ids over the band */
+static int promotionId(int entry)
+{
+    return entry < SF_GEO_SPOT_COUNT ? (int)sfGeoFrequency(entry) : SF_GEO_MAX_FREQUENCY + entry;
+}
+
+static int commandPromotions(int argc, char **argv)
+{
+    int entries = SF_GEO_SPOT_COUNT;
+    int latency = 150;
+    int ttl = 3600;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-entries") && i + 1 < argc) entries = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-latency") && i + 1 < argc) latency = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-ttl") && i + 1 < argc) ttl = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (entries < 1 || entries > SF_SERVER_PROMOTIONS) {
+        fprintf(stderr, "-entries must be from 1 to %d\n", SF_SERVER_PROMOTIONS);
+        return 1;
+    }
+
+    SFPromotionServer *server = sfPromotionServerStart(0, ttl, latency);
+    if (server == NULL) {
+        fprintf(stderr, "can't start the promotion server\n");
+        return 1;
+    }
+    for (int e = 0; e < entries; e++) {
+        char imageUrl[64], text[128];
+        snprintf(imageUrl, sizeof(imageUrl), "http://mynetshare.fr/img/%d.png", promotionId(e));
+        snprintf(text, sizeof(text), "Promotion du rayon %d : -%d%% sur « l’article \"%d\" »", e, 5 + e % 40, e);
+        sfPromotionServerSet(server, promotionId(e), imageUrl, text);
+    }
+
+    char path[128];
+    SFHttpResponse response;
+    double now = 0;                     // clock of the cache, moved by hand
+    int failures = 0;
+
+    // The old way: one request per spot, the notification waits for it
+    SFPromotionCache *cache = sfPromotionCacheCreate(0);
+    double requestTotal = 0, requestWorst = 0;
+    long bytes = server->bytes;
+    for (int e = 0; e < entries; e++) {
+        double start = monotonicSeconds();
+        snprintf(path, sizeof(path), "/test.php?id=%d", promotionId(e));
+        if (sfPromotionServerGet(server->port, path, NULL, &response) != 0 || response.status != 200 ||
+            sfPromotionCacheStore(cache, promotionId(e), response.body, response.length, response.etag,
+                                  sfPromotionMaxAge(response.cacheControl), now) != 0)
+            failures++;
+        double seconds = monotonicSeconds() - start;
+        requestTotal += seconds;
+        if (seconds > requestWorst)
+            requestWorst = seconds;
+        free(response.body);
+    }
+    long requestBytes = server->bytes - bytes;
+    sfPromotionCacheDestroy(cache);
+
+    // Prefetch of the area, then a lookup per spot
+    cache = sfPromotionCacheCreate(0);
+    bytes = server->bytes;
+    double start = monotonicSeconds();
+    int stored = -1;
+    if (sfPromotionServerGet(server->port, "/promotions.php?lat=48.8566&long=2.3522", NULL, &response) == 0 && response.status == 200)
+        stored = sfPromotionCacheStoreArea(cache, response.body, response.length, sfPromotionMaxAge(response.cacheControl), now);
+    double prefetchSeconds = monotonicSeconds() - start;
+    long prefetchBytes = server->bytes - bytes;
+    free(response.body);
+    if (stored != entries)
+        failures++;
+
+    double lookupTotal = 0, lookupWorst = 0;
+    for (int e = 0; e < entries; e++) {
+        const SFPromotion *promotion = NULL;
+        start = monotonicSeconds();
+        SFPromotionState state = sfPromotionCacheLookup(cache, promotionId(e), now, &promotion);
+        double seconds = monotonicSeconds() - start;
+        if (state != SFPromotionFresh || promotion->text[0] == '\0')
+            failures++;
+        lookupTotal += seconds;
+        if (seconds > lookupWorst)
+            lookupWorst = seconds;
+    }
+
+    // Past the max-age: every promotion is stale, one changed on the server
+    now += ttl + 1;
+    int changed = entries / 2;
+    sfPromotionServerSet(server, promotionId(changed), "http://mynetshare.fr/img/nouveau.png", "Nouvelle promotion");
+    int notModified = server->notModified, requests = server->requests, reloaded = 0;
+    bytes = server->bytes;
+    for (int e = 0; e < entries; e++) {
+        const SFPromotion *promotion = NULL;
+        if (sfPromotionCacheLookup(cache, promotionId(e), now, &promotion) != SFPromotionStale) {
+            failures++;
+            continue;
+        }
+        snprintf(path, sizeof(path), "/test.php?id=%d", promotionId(e));
+        if (sfPromotionServerGet(server->port, path, promotion->etag, &response) != 0)
+            failures++;
+        else if (response.status == 304)
+            sfPromotionCacheRevalidate(cache, promotionId(e), sfPromotionMaxAge(response.cacheControl), now);
+        else if (response.status == 200 && sfPromotionCacheStore(cache, promotionId(e), response.body, response.length, response.etag,
+                                                                 sfPromotionMaxAge(response.cacheControl), now) == 0)
+            reloaded++;
+        else
+            failures++;
+        free(response.body);
+    }
+    notModified = server->notModified - notModified;
+    requests = server->requests - requests;
+    long revalidationBytes = server->bytes - bytes;
+    const SFPromotion *promotion = NULL;
+    if (sfPromotionCacheLookup(cache, promotionId(changed), now, &promotion) != SFPromotionFresh || strcmp(promotion->text, "Nouvelle promotion"))
+        failures++;
+
+    // Without network, from the file
+    if (sfPromotionCacheSave(cache, PROMOTION_PATH) != 0)
+        failures++;
+    sfPromotionCacheDestroy(cache);
+    int port = server->port;
+    sfPromotionServerStop(server);
+
+    cache = sfPromotionCacheCreate(0);
+    int loaded = sfPromotionCacheLoad(cache, PROMOTION_PATH);
+    int offline = 0;
+    for (int e = 0; e < entries; e++) {
+        if (sfPromotionCacheLookup(cache, promotionId(e), now, NULL) != SFPromotionMissing)
+            offline++;
+    }
+    snprintf(path, sizeof(path), "/test.php?id=%d", promotionId(0));
+    int unreachable = sfPromotionServerGet(port, path, NULL, &response) != 0;
+    sfPromotionCacheDestroy(cache);
+
+    printf("%d promotions, %d ms of latency, max-age %d s\n", entries, latency, ttl);
+    printf("%-22s %12s %12s %10s %10s\n", "", "average ms", "worst ms", "requests", "bytes");
+    printf("%-22s %12.3f %12.3f %10d %10ld\n", "request per spot", requestTotal * 1000 / entries, requestWorst * 1000, entries, requestBytes);
+    printf("%-22s %12.3f %12.3f %10d %10ld\n", "prefetch of the area", prefetchSeconds * 1000, prefetchSeconds * 1000, 1, prefetchBytes);
+    printf("%-22s %12.5f %12.5f %10d %10d\n", "lookup per spot", lookupTotal * 1000 / entries, lookupWorst * 1000, 0, 0);
+    printf("revalidation: %d requests, %d not modified, %d changed, %ld bytes\n", requests, notModified, reloaded, revalidationBytes);
+    printf("without network: %d promotions read from %s, %d of %d served, server %s\n", loaded, PROMOTION_PATH, offline, entries,
+           unreachable ? "unreachable" : "still answering");
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures != 0;
+}
+
+
+#pragma mark - Alphabet
+
+// The custom alphabets of the first emitters (soundCloud, SFAlphabet): every
+// caracter goes to its frequency and back, within half a slot of it, and the
+// frequencies out of the slots give no caracter. The default alphabet must
+// stay the 94 caracters of the band plan those emitters use in the field.
+
+#define ALPHABET_MAX_FREQUENCY  20000       // userMaxFreq of personaliseFrequencyValue
+
+/** Errors of the round trip of an alphabet compiled from caracters */
+static int checkAlphabet(const SFAlphabet *alphabet, const char *caracters, int length)
+{
+    int errors = 0;
+    const int low = -alphabet->spacing / 2, high = alphabet->spacing - alphabet->spacing / 2 - 1;   // offsets read in a slot
+
+    if (alphabet->count != length)
+        errors++;
+    for (int i = 0; i < length; i++) {
+        const unsigned char caracter = (unsigned char)caracters[i];
+        const int frequency = alphabet->minFrequency + i * alphabet->spacing;
+        if (memchr(caracters, caracter, i) == NULL && sfAlphabetFrequency(alphabet, caracter) != frequency)
+            errors++;
+        if (sfAlphabetCaracter(alphabet, frequency) != (char)caracter || sfAlphabetCaracter(alphabet, frequency + low) != (char)caracter ||
+            sfAlphabetCaracter(alphabet, frequency + high) != (char)caracter)
+            errors++;
+    }
+    for (int c = 0; c < SF_ALPHABET_SIZE; c++) {
+        if (memchr(caracters, c, length) == NULL && sfAlphabetFrequency(alphabet, (unsigned char)c) != 0)
+            errors++;
+    }
+    if (sfAlphabetCaracter(alphabet, alphabet->minFrequency + low - 1) != 0 ||
+        sfAlphabetCaracter(alphabet, alphabet->minFrequency + length * alphabet->spacing + low) != 0)
+        errors++;
+    return errors;
+}
+
+static int commandAlphabet(int argc, char **argv)
+{
+    int trials = 1000;
+
+    for (int i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-trials") && i + 1 < argc) trials = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (trials < 0) {
+        fprintf(stderr, "bad -trials\n");
+        return 1;
+    }
+
+    // The default alphabet on the band plan of the single tone emitters, '~' (19692 Hz) out of it
+    const char *defaultCaracters = SF_ALPHABET_DEFAULT;
+    const int defaultLength = (int)strlen(defaultCaracters);
+    SFAlphabet *alphabet = sfAlphabetCreate(defaultCaracters, defaultLength, SF_FIRST_CHAR_FREQUENCY, SF_CHAR_SPACING);
+    int defaultErrors = defaultLength != SF_ALPHABET_DEFAULT_COUNT;
+    defaultErrors += checkAlphabet(alphabet, defaultCaracters, defaultLength);
+    for (int i = 0; i < defaultLength; i++) {
+        if (defaultCaracters[i] != SF_FIRST_CHAR + i || sfAlphabetFrequency(alphabet, (unsigned char)defaultCaracters[i]) != sfCharFrequency(defaultCaracters[i]))
+            defaultErrors++;
+    }
+    if (sfAlphabetFrequency(alphabet, '~') != 0 || sfAlphabetCaracter(alphabet, sfCharFrequency('~')) != 0 || sfAlphabetCaracter(alphabet, SF_STOP_FREQUENCY) != 0)
+        defaultErrors++;
+    sfAlphabetDestroy(alphabet);
+
+    // A personalised band, like personaliseFrequencyValue: the alphabet spread up to ALPHABET_MAX_FREQUENCY
+    const char *personal = "0123456789ABCDEF";
+    const int personalLength = (int)strlen(personal);
+    alphabet = sfAlphabetCreate(personal, personalLength, 18500, (ALPHABET_MAX_FREQUENCY - 18500) / personalLength);
+    int personalErrors = checkAlphabet(alphabet, personal, personalLength);
+    sfAlphabetDestroy(alphabet);
+
+    // Random alphabets, caracters twice in them included, on random bands
+    int randomErrors = 0, failedTrials = 0;
+    char caracters[SF_ALPHABET_SIZE];
+    for (int t = 0; t < trials; t++) {
+        int length = 1 + (int)(randomUniform() * (SF_ALPHABET_SIZE - 1));
+        for (int i = 0; i < length; i++)
+            caracters[i] = (char)(1 + (int)(randomUniform() * (SF_ALPHABET_SIZE - 1)));
+        int minFrequency = 15000 + (int)(randomUniform() * 5000);
+        int spacing = 1 + (int)(randomUniform() * 100);
+        alphabet = sfAlphabetCreate(caracters, length, minFrequency, spacing);
+        int errors = checkAlphabet(alphabet, caracters, length);
+        randomErrors += errors;
+        failedTrials += errors > 0;
+        sfAlphabetDestroy(alphabet);
+    }
+
+    printf("default alphabet: %d caracters, %d-%d Hz, %d errors\n", defaultLength, sfCharFrequency(defaultCaracters[0]),
+           sfCharFrequency(defaultCaracters[defaultLength - 1]), defaultErrors);
+    printf("personalised alphabet: %d caracters from 18500 Hz, %d errors\n", personalLength, personalErrors);
+    printf("random alphabets: %d, %d errors in %d of them\n", trials, randomErrors, failedTrials);
+    int failures = defaultErrors + personalErrors + randomErrors;
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures != 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: sfbench <command> [options]\n"
+            "  detectors [-snr dB] [-message text] [-file capture] [-save synth.wav]\n"
+            "      compare the CPU and the accuracy of every detector\n"
+            "  baseband -file capture -out iq.wav\n"
+            "      downconvert the 17-21.5 kHz band of a capture to a stereo I/Q file at 5.5 kHz\n"
+            "  parallel [-channels n] [-repeat n] [-snr dB]\n"
+            "      decode interleaved channels on parallel threads, check the results are identical to sequential runs\n"
+            "  wakeups [-seconds n]\n"
+            "      count the false start and geolocation detections of the background detectors on noise only, and the peaks of the floor after a reset\n"
+            "  realtime [-seconds n] [-frames n] [-detector name] [-slow ms]\n"
+            "      feed a detector through the ring buffer and the analysis worker at the audio pace\n"
+            "  emission [-seconds n] [-message text]\n"
+            "      compare the speed and the spectral purity of the sin() loop and of SFOscillator\n"
+            "  mfsk [-messages n] [-length n] [-snr dB] [-drift ppm]\n"
+            "      send random messages in the single tone and every multi tone mode through noise, payload and caracter error rate,\n"
+            "      FAILED if a frame is lost from 20 dB or if a coded mode does worse than an uncoded one as fast or slower,\n"
+            "      -drift runs the clock of the emitter faster (or slower) than the one of the receiver\n"
+            "  chirp [-trials n] [-snr dB] [-seconds n]\n"
+            "      synchronisation rate, error and latency of the start tone and of the chirp preamble, false chirps on noise\n"
+            "  stream [-file raw.txt] [-messages n] [-length n] [-errors p]\n"
+            "      analyse single tone caracter streams one caracter at a time (SFMessageStream), recorded ones (one per line) or random ones\n"
+            "  duplex [-messages n] [-length n] [-snr dB] [-echo dB] [-taps n] [-step mu]\n"
+            "      receive the peer in the high full duplex mode while sending in the low one, with and without the echo canceller\n"
+            "  lexicon [-words list.txt] [-trials n] [-errors p]\n"
+            "      correct received words with the domain vocabulary (SFLexicon), known words fixed and unknown ones left alone\n"
+            "  zone [-trials n] [-snr dB]\n"
+            "      time to decide the geomarketing spot of a beacon and of the next one, blocks of 25 detections and SFZoneEstimator\n"
+            "  beacons [-seconds n] [-snr dB] [-fading dB]\n"
+            "      walk between two beacons, position from the single peak and from every beacon of the spectrum (SFBeaconScanner)\n"
+            "  promotions [-entries n] [-latency ms] [-ttl s]\n"
+            "      time from a spot to its promotion, request per spot and SFPromotionCache after one prefetch, ETag revalidation, offline\n"
+            "  alphabet [-trials n]\n"
+            "      caracter to frequency and back for the default, a personalised and random custom alphabets (SFAlphabet)\n");
+}
+
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    if (!strcmp(argv[1], "detectors"))
+        return commandDetectors(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "baseband"))
+        return commandBaseband(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "parallel"))
+        return commandParallel(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "wakeups"))
+        return commandWakeups(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "realtime"))
+        return commandRealtime(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "emission"))
+        return commandEmission(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "mfsk"))
+        return commandMfsk(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "chirp"))
+        return commandChirp(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "stream"))
+        return commandStream(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "duplex"))
+        return commandDuplex(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "lexicon"))
+        return commandLexicon(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "zone"))
+        return commandZone(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "beacons"))
+        return commandBeacons(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "promotions"))
+        return commandPromotions(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "alphabet"))
+        return commandAlphabet(argc - 2, argv + 2);
+
+    usage();
+    return 1;
+}
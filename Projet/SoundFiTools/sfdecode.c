@@ -0,0 +1,600 @@
+//
+//  sfdecode.c
+//  SoundFiTools
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+// Offline decoder of SoundFi captures. The samples go through the detectors of
+// the engine (SFDetector) and the messaging logic of SoundFiAudioSession
+// (SFMessageDecoder: messagingReceptionSampleTreatment, checkTimeOut and
+// startAnalysis), with the same buffer sizes, without Core Audio:
+//
+//   cc -O2 -std=gnu99 -I../SoundFiCore sfdecode.c SFAudioFile.c SFDetector.c ../SoundFiCore/*.c -lm -lpthread -o sfdecode
+//
+//   ./sfdecode [-detector fft|tonebank|baseband|interpolated] [-idle name] [-receive name]
+//              [-threads n] [-rate hz] [-chirp] [-list paths.txt] capture.wav ...
+//
+// The files are spread on the threads by a work stealing pool: each thread
+// start with a slice of the list and take the half of the slice of an other
+// thread when its own is empty. One JSON object is written per file, on one
+// line, as soon as the file is decoded (so not in the order of the list):
+//
+//   {"file":"a.wav","duration":12.000,"cpu":0.0153,"speed":784.3,"messages":[
+//     {"text":"Hello","raw":"HHHHeeeelll...","receptionQuality":21,"start":1.672,"end":3.547,"end_reason":"stop"}]}
+//
+// end_reason is "stop" (stop tone), "timeout" (checkTimeOut) or "eof" (the
+// capture ends during the message). A file that can't be decoded give
+// {"file":"b.wav","error":"..."}. A summary is written on stderr.
+//
+// A start tone of a multi tone mode (SFMultiTone.h) found by the idle detector
+// hand the following buffers to SFMultiToneDecoder until the end of its frame
+// (end_reason "frame"), these messages have "mode", "tones" and "type"
+// ("message", "payment" or "data") fields and their raw text is the received frame,
+// header included. In a coded mode raw has the parity too, and "corrected" and
+// "failed_blocks" tell what the Reed-Solomon decoder did. The frames that are
+// cut or whose CRC doesn't match are not written, "rejected" counts them.
+//
+// The messages are followed while they are received, like the engine does for
+// messageProgress:confidence: and messageHeader:length:, "first" is the time the
+// first caracter of the text was known (the end of the buffer that gave it) and
+// "header", for a multi tone frame, the time its header was read.
+//
+// -chirp wait for the chirp preamble (SFChirp.h) instead of a start tone: the
+// matched filter gives the end of the chirp, the start tone that follows tells
+// the mode and the decoder starts on the first symbol, at the sample.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "SFMessageDecoder.h"
+#include "SFMessageEncoder.h"
+#include "SFMultiTone.h"
+#include "SFChirp.h"
+#include "SFAudioFile.h"
+#include "SFDetector.h"
+
+
+#pragma mark - Pipeline
+
+// The detectors used by sampleTreatment in each SFDetectorMode of the engine
+
+typedef struct {
+    const char          *name;
+    const SFDetector    *idle;              // while waiting for a start tone
+    const SFDetector    *receive;           // while a message is received
+    int                 idleFrames;         // buffer size while waiting
+    int                 chirp;              // wait for the chirp preamble instead of the idle detector
+} Pipeline;
+
+static int setupPipeline(Pipeline *pipeline, const char *mode)
+{
+    pipeline->name = mode;
+    pipeline->idleFrames = SF_MESSAGE_IDLE_BUFFER;
+    pipeline->chirp = 0;
+
+    if (!strcmp(mode, "fft")) {                     // SFDetectorFFT: fftGetFrequencyLowAccuracy then fftGetFrequencyHighAccuracy
+        pipeline->idle = sfFindDetector("floor");
+        pipeline->receive = sfFindDetector("estimator");
+    }
+    else if (!strcmp(mode, "tonebank") || !strcmp(mode, "baseband")) {
+        pipeline->idle = pipeline->receive = sfFindDetector(mode);
+    }
+    else if (!strcmp(mode, "interpolated")) {       // SFDetectorInterpolated: 2048 frames buffers cut in slices of 256
+        pipeline->idle = pipeline->receive = sfFindDetector("jacobsen");
+        pipeline->idleFrames = SF_MESSAGE_RECEPTION_BUFFER;
+    }
+    else {
+        return -1;
+    }
+    return 0;
+}
+
+
+#pragma mark - Output
+
+typedef struct {
+    char    *text;
+    int     length;
+    int     capacity;
+} Output;
+
+static void appendText(Output *output, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void appendText(Output *output, const char *format, ...)
+{
+    for (;;) {
+        va_list arguments;
+        va_start(arguments, format);
+        int written = vsnprintf(output->text + output->length, output->capacity - output->length, format, arguments);
+        va_end(arguments);
+
+        if (written < output->capacity - output->length) {
+            output->length += written;
+            return;
+        }
+        output->capacity = 2 * output->capacity + written + 1;
+        output->text = realloc(output->text, output->capacity);
+    }
+}
+
+/** Append a JSON string, the captures names and the messages may contain anything */
+static void appendString(Output *output, const char *string, int length)
+{
+    appendText(output, "\"");
+    for (int i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)string[i];
+        if (c == '"' || c == '\\')
+            appendText(output, "\\%c", c);
+        else if (c < 0x20 || c == 0x7f)
+            appendText(output, "\\u%04x", c);
+        else
+            appendText(output, "%c", c);
+    }
+    appendText(output, "\"");
+}
+
+
+#pragma mark - Decoding
+
+static double threadCpuSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double wallSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void appendMessage(Output *output, int count, const SFMessageDecoder *decoder, double start, double first, double end, const char *reason)
+{
+    appendText(output, "%s{\"text\":", count ? "," : "");
+    appendString(output, decoder->message, decoder->messageLength);
+    appendText(output, ",\"raw\":");
+    appendString(output, decoder->raw, decoder->rawLength);
+    appendText(output, ",\"receptionQuality\":%d,\"start\":%.3f,\"end\":%.3f,\"end_reason\":\"%s\"", decoder->quality, start, end, reason);
+    if (first >= 0)
+        appendText(output, ",\"first\":%.3f", first);
+    if (decoder->dropped)
+        appendText(output, ",\"dropped\":%d", decoder->dropped);
+    appendText(output, "}");
+}
+
+static const char *frameTypeName(SFFrameType type)
+{
+    switch (type) {
+        case SFFrameTypePayment:    return "payment";
+        case SFFrameTypeData:       return "data";
+        default:                    return "message";
+    }
+}
+
+static void appendMultiToneMessage(Output *output, int count, const SFMultiToneDecoder *decoder, double start, double header, double first, double end, const char *reason)
+{
+    appendText(output, "%s{\"text\":", count ? "," : "");
+    appendString(output, decoder->message, decoder->messageLength);
+    appendText(output, ",\"raw\":");
+    appendString(output, decoder->frame, decoder->frameLength);
+    appendText(output, ",\"mode\":%d,\"tones\":%d,\"type\":\"%s\",\"receptionQuality\":%d,\"start\":%.3f,\"end\":%.3f,\"end_reason\":\"%s\"",
+               (int)(decoder->mode - sfMultiToneModes), decoder->toneCount, frameTypeName(decoder->frameType),
+               decoder->quality, start, end, reason);
+    if (decoder->rs != NULL)
+        appendText(output, ",\"corrected\":%d,\"failed_blocks\":%d", decoder->corrected, decoder->failedBlocks);
+    if (header >= 0)
+        appendText(output, ",\"header\":%.3f", header);
+    if (first >= 0)
+        appendText(output, ",\"first\":%.3f", first);
+    if (decoder->dropped)
+        appendText(output, ",\"dropped\":%d", decoder->dropped);
+    appendText(output, "}");
+}
+
+/** Decode one capture, the JSON line is written in output.
+
+ @return The duration of the capture in seconds, 0 if it can't be read
+ */
+static double decodeFile(const Pipeline *pipeline, const char *path, float rawRate, Output *output)
+{
+    int frameCount = 0;
+    float rate = rawRate;
+    int16_t *samples = sfReadAudioFile(path, rawRate, &frameCount, &rate);
+
+    output->length = 0;
+    appendText(output, "{\"file\":");
+    appendString(output, path, (int)strlen(path));
+
+    if (samples == NULL) {
+        appendText(output, ",\"error\":\"can't read the file\"}\n");
+        return 0;
+    }
+    if (rate != SAMPLE_RATE) {
+        appendText(output, ",\"error\":\"sample rate %.0f Hz, the engine expect %d Hz\"}\n", rate, SAMPLE_RATE);
+        free(samples);
+        return 0;
+    }
+
+    double cpu = threadCpuSeconds();
+    SFMessageDecoder *decoder = sfMessageDecoderCreate();
+    void *idle = pipeline->idle->create();
+    void *receive = pipeline->receive == pipeline->idle ? idle : pipeline->receive->create();
+    SFMultiToneDecoder *multiTone[SF_MFSK_MODE_COUNT] = { NULL };
+    SFMultiToneDecoder *receiving = NULL;   // multi tone message in progress
+    for (int mode = 0; mode < SF_MFSK_MODE_COUNT; mode++)
+        multiTone[mode] = sfMultiToneDecoderCreate(SAMPLE_RATE, &sfMultiToneModes[mode]);
+    int16_t buffer[CALLBACK_FRAMES];
+    float frequency = 0;
+    double start = 0;
+    double header = -1, first = -1;         // the message followed while it is received
+    char partial[SF_FRAME_MAX_LENGTH];
+    int count = 0;
+    int rejected = 0;                       // multi tone frames cut or corrupted
+    int position = 0;
+    SFChirpDetector *chirp = pipeline->chirp ? sfChirpDetectorCreate(SAMPLE_RATE, SF_CHIRP_LENGTH, SF_CHIRP_MODE_FRAMES) : NULL;
+    int chirpBase = 0;                      // sample 0 of the chirp detector
+
+    appendText(output, ",\"messages\":[");
+
+    // One engine buffer per step: nbrEchantillon frames, the detector is fed by callbacks of 256 frames
+    for (;;) {
+        if (receiving != NULL) {
+            if (position + SF_MESSAGE_RECEPTION_BUFFER > frameCount)
+                break;
+            SFMessageEvent event = sfMultiToneDecoderProcess(receiving, samples + position, SF_MESSAGE_RECEPTION_BUFFER);
+            position += SF_MESSAGE_RECEPTION_BUFFER;
+            if (event == SFMessageEventCaracter) {
+                if (header < 0 && receiving->expectedSymbols > 0)
+                    header = (double)position / SAMPLE_RATE;
+                if (first < 0 && sfMultiToneDecoderPartial(receiving, partial, NULL) > 0)
+                    first = (double)position / SAMPLE_RATE;
+            }
+            if (event == SFMessageEventCompleted || event == SFMessageEventTimedOut) {
+                if (receiving->rejected)
+                    rejected++;
+                else if (receiving->messageLength > 0)
+                    appendMultiToneMessage(output, count++, receiving, start, header, first, (double)position / SAMPLE_RATE, event == SFMessageEventCompleted ? "frame" : "timeout");
+                header = first = -1;
+                // The start tone was the one of an other mode
+                int handover = receiving->handover;
+                receiving = handover != SF_MFSK_SINGLE_TONE ? multiTone[handover] : NULL;
+                if (receiving != NULL)
+                    sfMultiToneDecoderReset(receiving);
+                chirpBase = position;
+            }
+            continue;
+        }
+
+        int frames = decoder->receiving ? SF_MESSAGE_RECEPTION_BUFFER : pipeline->idleFrames;
+        if (position + frames > frameCount)
+            break;
+
+        // Chirp preamble: the message starts at the sample after the start tone of its mode
+        if (chirp != NULL && !decoder->receiving) {
+            int used = 0;
+            int found = sfChirpDetectorProcess(chirp, samples + position, frames, &used);
+            position += used;
+            if (!found)
+                continue;
+
+            int following = 0;
+            int mode = sfMultiToneIdentifyMode(sfChirpDetectorFollowing(chirp, &following), SF_CHIRP_MODE_FRAMES, SAMPLE_RATE);
+            int chirpEnd = chirpBase + (int)chirp->chirpEnd;
+            start = (double)(chirpEnd - SF_CHIRP_LENGTH) / SAMPLE_RATE;
+            position = mode == SF_MFSK_NO_MODE ? chirpEnd : chirpEnd + SF_CHIRP_MODE_FRAMES;
+            sfChirpDetectorReset(chirp);
+            chirpBase = position;
+
+            header = first = -1;
+            if (mode >= 0 && multiTone[mode] != NULL) {
+                receiving = multiTone[mode];
+                sfMultiToneDecoderResetAtSymbol(receiving);
+            }
+            else if (mode == SF_MFSK_SINGLE_TONE) {
+                sfMessageDecoderPush(decoder, SF_START_FREQUENCY);
+            }
+            continue;
+        }
+
+        const SFDetector *detector = decoder->receiving ? pipeline->receive : pipeline->idle;
+        void *state = decoder->receiving ? receive : idle;
+        for (int offset = 0; offset < frames; offset += CALLBACK_FRAMES) {
+            memcpy(buffer, samples + position + offset, CALLBACK_FRAMES * sizeof(int16_t));
+            frequency = detector->process(state, buffer, CALLBACK_FRAMES);
+        }
+        position += frames;
+
+        // Start tone of a multi tone message: the negotiation of messagingReceptionSampleTreatment
+        int mode = decoder->receiving ? SF_MFSK_SINGLE_TONE : sfMultiToneFindMode((int)frequency);
+        if (mode != SF_MFSK_SINGLE_TONE && multiTone[mode] != NULL) {
+            receiving = multiTone[mode];
+            sfMultiToneDecoderReset(receiving);
+            start = (double)(position - frames) / SAMPLE_RATE;
+            header = first = -1;
+            continue;
+        }
+
+        SFMessageEvent event = sfMessageDecoderPush(decoder, (int)frequency);
+        if (event == SFMessageEventStarted) {
+            start = (double)(position - frames) / SAMPLE_RATE;
+            first = -1;
+        }
+        else if (event == SFMessageEventCaracter && first < 0 && decoder->stream.messageLength > 0)
+            first = (double)position / SAMPLE_RATE;
+        else if ((event == SFMessageEventCompleted || event == SFMessageEventTimedOut) && decoder->rawLength > 0)
+            appendMessage(output, count++, decoder, start, first, (double)position / SAMPLE_RATE, event == SFMessageEventCompleted ? "stop" : "timeout");
+        if (event == SFMessageEventCompleted || event == SFMessageEventTimedOut)
+            chirpBase = position;
+    }
+    sfChirpDetectorDestroy(chirp);
+
+    // The capture ends during a message: what the engine would give at the time out. A multi tone frame can end
+    // with the capture, the decoder get the last samples then silence until it decides.
+    if (receiving != NULL) {
+        static const int16_t silence[SF_MESSAGE_RECEPTION_BUFFER];
+        SFMessageEvent event = sfMultiToneDecoderProcess(receiving, samples + position, frameCount - position);
+        while (event != SFMessageEventCompleted && event != SFMessageEventTimedOut)
+            event = sfMultiToneDecoderProcess(receiving, silence, SF_MESSAGE_RECEPTION_BUFFER);
+        if (receiving->rejected)
+            rejected++;
+        else if (receiving->messageLength > 0)
+            appendMultiToneMessage(output, count++, receiving, start, header, first, (double)frameCount / SAMPLE_RATE, "eof");
+    }
+    if (decoder->receiving) {
+        while (sfMessageDecoderPush(decoder, 0) != SFMessageEventTimedOut)
+            ;
+        if (decoder->rawLength > 0)
+            appendMessage(output, count++, decoder, start, first, (double)position / SAMPLE_RATE, "eof");
+    }
+
+    cpu = threadCpuSeconds() - cpu;
+    double duration = (double)frameCount / SAMPLE_RATE;
+    appendText(output, "]");
+    if (rejected)
+        appendText(output, ",\"rejected\":%d", rejected);
+    appendText(output, ",\"duration\":%.3f,\"cpu\":%.4f,\"speed\":%.1f}\n", duration, cpu, cpu > 0 ? duration / cpu : 0);
+
+    if (receive != idle)
+        pipeline->receive->destroy(receive);
+    pipeline->idle->destroy(idle);
+    for (int mode = 0; mode < SF_MFSK_MODE_COUNT; mode++)
+        sfMultiToneDecoderDestroy(multiTone[mode]);
+    sfMessageDecoderDestroy(decoder);
+    free(samples);
+    return duration;
+}
+
+
+#pragma mark - Work stealing pool
+
+typedef struct {
+    pthread_mutex_t lock;
+    int             begin;              // files [begin, end) of the list not taken yet
+    int             end;
+} WorkQueue;
+
+typedef struct {
+    WorkQueue       *queues;
+    int             queueCount;
+    int             self;
+
+    const Pipeline  *pipeline;
+    char            **files;
+    float           rawRate;
+    pthread_mutex_t *outputLock;
+
+    int             decoded;
+    int             failed;
+    int             stolen;
+    double          seconds;
+} Worker;
+
+/** Next file for the worker: the front of its queue, or the back half of the queue of an other worker */
+static int takeFile(Worker *worker)
+{
+    WorkQueue *own = &worker->queues[worker->self];
+    int file = -1;
+
+    pthread_mutex_lock(&own->lock);
+    if (own->begin < own->end)
+        file = own->begin++;
+    pthread_mutex_unlock(&own->lock);
+    if (file >= 0)
+        return file;
+
+    // Only one lock at a time: the own queue is empty and nobody else add to it
+    for (int k = 1; k < worker->queueCount; k++) {
+        WorkQueue *victim = &worker->queues[(worker->self + k) % worker->queueCount];
+        int begin = 0, end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->begin < victim->end) {
+            end = victim->end;
+            begin = end - (end - victim->begin + 1) / 2;
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (begin < end) {
+            pthread_mutex_lock(&own->lock);
+            own->begin = begin + 1;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            worker->stolen++;
+            return begin;
+        }
+    }
+    return -1;
+}
+
+static void *workerThread(void *context)
+{
+    Worker *worker = context;
+    Output output = {0};
+    int file;
+
+    while ((file = takeFile(worker)) >= 0) {
+        double seconds = decodeFile(worker->pipeline, worker->files[file], worker->rawRate, &output);
+        if (seconds > 0) {
+            worker->decoded++;
+            worker->seconds += seconds;
+        }
+        else {
+            worker->failed++;
+        }
+
+        pthread_mutex_lock(worker->outputLock);
+        fwrite(output.text, 1, output.length, stdout);
+        fflush(stdout);
+        pthread_mutex_unlock(worker->outputLock);
+    }
+    free(output.text);
+    return NULL;
+}
+
+
+#pragma mark - Main
+
+/** Read one path per line, the empty lines are ignored */
+static int readList(const char *path, char ***files, int *fileCount)
+{
+    FILE *list = fopen(path, "r");
+    if (list == NULL)
+        return -1;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), list)) {
+        size_t length = strcspn(line, "\r\n");
+        if (length == 0)
+            continue;
+        line[length] = 0;
+        *files = realloc(*files, (*fileCount + 1) * sizeof(char *));
+        (*files)[(*fileCount)++] = strdup(line);
+    }
+    fclose(list);
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: sfdecode [options] capture.wav ...\n"
+            "  -detector mode   fft (default), tonebank, baseband or interpolated, like setDetectorMode:\n"
+            "  -idle name       detector while waiting for a message (fft floor vocoder estimator\n"
+            "  -receive name    detector during a message             tonebank baseband jacobsen quadratic)\n"
+            "  -threads n       decoding threads (default: all the cores)\n"
+            "  -rate hz         sample rate of the raw PCM files (default 44100)\n"
+            "  -chirp           wait for the chirp preamble instead of a start tone\n"
+            "  -list file       read the captures from a file, one path per line\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *mode = "fft";
+    const char *idleName = NULL;
+    const char *receiveName = NULL;
+    int threadCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    float rawRate = SAMPLE_RATE;
+    int chirp = 0;
+    char **files = NULL;
+    int fileCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-detector") && i + 1 < argc)
+            mode = argv[++i];
+        else if (!strcmp(argv[i], "-idle") && i + 1 < argc)
+            idleName = argv[++i];
+        else if (!strcmp(argv[i], "-receive") && i + 1 < argc)
+            receiveName = argv[++i];
+        else if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+            threadCount = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-rate") && i + 1 < argc)
+            rawRate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-chirp"))
+            chirp = 1;
+        else if (!strcmp(argv[i], "-list") && i + 1 < argc) {
+            if (readList(argv[++i], &files, &fileCount) != 0) {
+                fprintf(stderr, "can't read %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        }
+        else {
+            files = realloc(files, (fileCount + 1) * sizeof(char *));
+            files[fileCount++] = strdup(argv[i]);
+        }
+    }
+
+    Pipeline pipeline;
+    if (setupPipeline(&pipeline, mode) != 0) {
+        fprintf(stderr, "unknown detector mode %s\n", mode);
+        return 1;
+    }
+    if (idleName != NULL)
+        pipeline.idle = sfFindDetector(idleName);
+    if (receiveName != NULL)
+        pipeline.receive = sfFindDetector(receiveName);
+    pipeline.chirp = chirp;
+    if (pipeline.idle == NULL || pipeline.receive == NULL || fileCount == 0 || rawRate <= 0) {
+        usage();
+        return 1;
+    }
+    if (threadCount < 1)
+        threadCount = 1;
+    if (threadCount > fileCount)
+        threadCount = fileCount;
+
+    // Each thread start with a contiguous slice of the list
+    WorkQueue *queues = calloc(threadCount, sizeof(WorkQueue));
+    Worker *workers = calloc(threadCount, sizeof(Worker));
+    pthread_t *threads = calloc(threadCount, sizeof(pthread_t));
+    pthread_mutex_t outputLock = PTHREAD_MUTEX_INITIALIZER;
+
+    for (int t = 0; t < threadCount; t++) {
+        pthread_mutex_init(&queues[t].lock, NULL);
+        queues[t].begin = (int)((long)fileCount * t / threadCount);
+        queues[t].end = (int)((long)fileCount * (t + 1) / threadCount);
+        workers[t] = (Worker){ .queues = queues, .queueCount = threadCount, .self = t, .pipeline = &pipeline, .files = files, .rawRate = rawRate, .outputLock = &outputLock };
+    }
+
+    double wall = wallSeconds();
+    for (int t = 0; t < threadCount; t++)
+        pthread_create(&threads[t], NULL, workerThread, &workers[t]);
+
+    int decoded = 0, failed = 0, stolen = 0;
+    double seconds = 0;
+    for (int t = 0; t < threadCount; t++) {
+        pthread_join(threads[t], NULL);
+        decoded += workers[t].decoded;
+        failed += workers[t].failed;
+        stolen += workers[t].stolen;
+        seconds += workers[t].seconds;
+    }
+    wall = wallSeconds() - wall;
+
+    // The other threads may steal from a queue until they are all finished
+    for (int t = 0; t < threadCount; t++)
+        pthread_mutex_destroy(&queues[t].lock);
+
+    fprintf(stderr, "%d files (%d failed), %.1f s of audio in %.2f s on %d threads, %.0fx realtime, %d steals\n",
+            decoded + failed, failed, seconds, wall, threadCount, wall > 0 ? seconds / wall : 0, stolen);
+
+    for (int f = 0; f < fileCount; f++)
+        free(files[f]);
+    free(files);
+    free(queues);
+    free(workers);
+    free(threads);
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,149 @@
+//
+//  sflexicon.c
+//  SoundFiTools
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+// Compiler of the vocabulary of the phase 6 (SFLexicon.h): the word lists are
+// read, cut in words like the corrector cuts the messages (the runs of letters
+// and digits, so an URL gives its tokens) and written as the trie that the
+// engine maps in memory (SoundFiLexicon.bin in the bundle):
+//
+//   cc -O2 -std=gnu99 -I../SoundFiCore sflexicon.c ../SoundFiCore/*.c -lm -lpthread -o sflexicon
+//
+//   ./sflexicon -out lexicon.bin words.txt ...
+//   ./sflexicon -check lexicon.bin [text ...]
+//
+// The lines that start with '#' are comments. -check map a vocabulary and
+// correct the texts given (or the lines of stdin), one JSON object per text:
+//
+//   {"text":"Bienvenue sur mynetshqre.fr","corrected":"Bienvenue sur mynetshare.fr"}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFLexicon.h"
+
+
+static int isWordCaracter(int caracter)
+{
+    return (caracter >= 'a' && caracter <= 'z') || (caracter >= 'A' && caracter <= 'Z') || (caracter >= '0' && caracter <= '9');
+}
+
+/** Add the words of a list to words, return -1 if it can't be read */
+static int readWords(const char *path, char ***words, int *count, int *capacity)
+{
+    FILE *file = !strcmp(path, "-") ? stdin : fopen(path, "r");
+    if (file == NULL)
+        return -1;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#')
+            continue;
+        for (char *p = line; *p;) {
+            if (!isWordCaracter((unsigned char)*p)) {
+                p++;
+                continue;
+            }
+            char *start = p;
+            while (isWordCaracter((unsigned char)*p))
+                p++;
+            if (*count == *capacity) {
+                *capacity = *capacity ? 2 * *capacity : 256;
+                *words = realloc(*words, *capacity * sizeof(char *));
+            }
+            (*words)[(*count)++] = strndup(start, p - start);
+        }
+    }
+    if (file != stdin)
+        fclose(file);
+    return 0;
+}
+
+static void writeString(const char *string)
+{
+    putchar('"');
+    for (const char *p = string; *p; p++) {
+        if (*p == '"' || *p == '\\')
+            printf("\\%c", *p);
+        else if ((unsigned char)*p < 0x20)
+            printf("\\u%04x", (unsigned char)*p);
+        else
+            putchar(*p);
+    }
+    putchar('"');
+}
+
+static void checkText(const SFLexicon *lexicon, const char *text)
+{
+    int length = (int)strlen(text);
+    char *corrected = malloc(2 * length + 1);
+    sfLexiconCorrectText(lexicon, text, length, corrected, 2 * length + 1);
+    printf("{\"text\":");
+    writeString(text);
+    printf(",\"corrected\":");
+    writeString(corrected);
+    printf("}\n");
+    free(corrected);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: sflexicon -out lexicon.bin words.txt ...\n"
+            "       sflexicon -check lexicon.bin [text ...]\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 3 && !strcmp(argv[1], "-check")) {
+        SFLexicon *lexicon = sfLexiconOpen(argv[2]);
+        if (lexicon == NULL) {
+            fprintf(stderr, "can't map %s\n", argv[2]);
+            return 1;
+        }
+        if (argc > 3)
+            for (int i = 3; i < argc; i++)
+                checkText(lexicon, argv[i]);
+        else {
+            char line[4096];
+            while (fgets(line, sizeof(line), stdin)) {
+                line[strcspn(line, "\r\n")] = '\0';
+                checkText(lexicon, line);
+            }
+        }
+        sfLexiconDestroy(lexicon);
+        return 0;
+    }
+
+    if (argc < 4 || strcmp(argv[1], "-out")) {
+        usage();
+        return 1;
+    }
+
+    char **words = NULL;
+    int count = 0, capacity = 0;
+    for (int i = 3; i < argc; i++) {
+        if (readWords(argv[i], &words, &count, &capacity) != 0) {
+            fprintf(stderr, "can't read %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    SFLexicon *lexicon = sfLexiconCreate((const char *const *)words, count);
+    if (lexicon == NULL || sfLexiconWrite(lexicon, argv[2]) != 0) {
+        fprintf(stderr, "can't write %s\n", argv[2]);
+        return 1;
+    }
+    fprintf(stderr, "%d words, %d nodes, %zu bytes\n", lexicon->wordCount, lexicon->nodeCount,
+            sizeof(SFLexiconHeader) + lexicon->nodeCount * sizeof(SFLexiconNode));
+
+    sfLexiconDestroy(lexicon);
+    for (int i = 0; i < count; i++)
+        free(words[i]);
+    free(words);
+    return 0;
+}
@@ -0,0 +1,97 @@
+//
+//  sfpromo.c
+//  SoundFiTools
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+// Local stand-in of the promotion server (SFPromotionServer.h), to run the
+// engine and its promotion cache (SFPromotionCache.h) without mynetshare.fr:
+//
+//   cc -O2 -std=gnu99 -I../SoundFiCore sfpromo.c SFPromotionServer.c -lpthread -o sfpromo
+//
+//   ./sfpromo [-port n] [-ttl s] [-latency ms] promotions.txt
+//
+// One promotion per line of the file: id of the spot (its frequency, see
+// sfGeoFrequency), image URL and text separated by tabulations. The engine
+// is pointed to it with setPromotionServer: @"http://<address>:<port>/". The
+// file is read again on SIGHUP, the promotions changed get a new ETag, and the
+// counters are written on stderr on SIGINT.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "SFPromotionServer.h"
+
+static volatile sig_atomic_t reload = 0;
+static volatile sig_atomic_t stop = 0;
+
+static void handleSignal(int signal)
+{
+    if (signal == SIGHUP)
+        reload = 1;
+    else
+        stop = 1;
+}
+
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: sfpromo [-port n] [-ttl s] [-latency ms] promotions.txt\n"
+            "  serve the promotions of the file on 127.0.0.1 like mynetshare.fr (test.php?id= and promotions.php),\n"
+            "  with ETag, Cache-Control max-age and an added latency, SIGHUP read the file again\n");
+}
+
+
+int main(int argc, char **argv)
+{
+    int port = 8080, maxAge = 3600, latency = 0;
+    const char *path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-port") && i + 1 < argc) port = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-ttl") && i + 1 < argc) maxAge = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-latency") && i + 1 < argc) latency = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && path == NULL) path = argv[i];
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (path == NULL) {
+        usage();
+        return 1;
+    }
+
+    SFPromotionServer *server = sfPromotionServerStart(port, maxAge, latency);
+    if (server == NULL) {
+        fprintf(stderr, "can't listen on port %d\n", port);
+        return 1;
+    }
+    int count = sfPromotionServerRead(server, path);
+    if (count < 0) {
+        fprintf(stderr, "can't read %s\n", path);
+        sfPromotionServerStop(server);
+        return 1;
+    }
+    fprintf(stderr, "%d promotions on http://127.0.0.1:%d/, max-age %d s, latency %d ms\n", count, server->port, maxAge, latency);
+
+    signal(SIGHUP, handleSignal);
+    signal(SIGINT, handleSignal);
+    signal(SIGTERM, handleSignal);
+    while (!stop) {
+        pause();
+        if (reload) {
+            reload = 0;
+            fprintf(stderr, "%d promotions read again\n", sfPromotionServerRead(server, path));
+        }
+    }
+
+    fprintf(stderr, "%d requests, %d not modified, %ld bytes of body\n", server->requests, server->notModified, server->bytes);
+    sfPromotionServerStop(server);
+    return 0;
+}
@@ -0,0 +1,344 @@
+//
+//  sfrender.c
+//  SoundFiTools
+//
+//  Copyright (c) 2014 SoundFi. All rights reserved.
+//
+
+// Offline renderer of SoundFi messages, the batch version of GenerateAudioMessage.
+// Each message goes through SFMessageEncoder, the emission of SoundFiAudioSession
+// (getASCIIFrequency and emissionSampleCalcul) without Core Audio, so the file
+// hold the buffers the emitter give to the audio unit. It links the sources of the
+// GenerateAudioMessage target only (no decoder, no tone bank), so a source the
+// emitter needs and the app doesn't compile breaks this build too:
+//
+//   cc -O2 -std=gnu99 -I../SoundFiCore sfrender.c SFAudioFile.c ../SoundFiCore/{SFOscillator,SFMessageEncoder,SFMultiToneMode,SFReedSolomon,SFFrame,SFFft,SFChirp}.c -lm -lpthread -o sfrender
+//
+//   ./sfrender [-out dir] [-int16] [-raw] [-threads n] [-lead ms] [-trail ms] [-snr dB]
+//              [-rate hz] [-frames n] [-start hz] [-first hz] [-spacing hz] [-stop hz]
+//              [-init n] [-repeat n] [-tail n] [-amplitude a] [-fade step] [-mode n]
+//              [-chirp] messages.txt ...
+//
+// The message lists have one message per line ("-" read stdin), the empty lines
+// are skipped. The files are numbered in the order of the lists (000001.wav ...)
+// and one JSON object per file is written on stdout, in the same order:
+//
+//   {"file":"out/000001.wav","text":"Hello","frames":12544,"duration":0.284}
+//
+// so a list of captures and of their expected text can be given to sfdecode or
+// to any receiver test. By default the samples are float 32 bits, exactly the
+// Float32 of renderToneCallback; -int16 convert them (x32767, rounded) for the
+// tools that expect a capture. -mode n send the messages in the multi tone mode
+// n of sfMultiToneModes (SFMultiTone.h), with its start tone and its symbol
+// length: each message is a frame (SFFrame.h) followed by a one callback stop
+// tone, the coded modes with their Reed-Solomon parity. -chirp start the
+// messages with the chirp preamble (SFChirp.h) and a short start tone.
+//
+// A receiver need some noise to learn its floor (SFNoiseFloor see the leakage
+// of a tone over digital silence as broadband noise): -snr add white noise, the
+// same for a message whatever the thread (the generator is seeded with its
+// number), at a level relative to the caracter tones.
+//
+// The messages are rendered in parallel, each thread take the next message of
+// the list (an atomic counter) and keep its own encoder.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "SFMessageEncoder.h"
+#include "SFAudioFile.h"
+
+
+#pragma mark - Messages
+
+typedef struct {
+    char    *text;
+    int     length;
+    char    *path;
+    int     frames;
+    int     failed;             // until the file is written
+} Message;
+
+/** Read one message per line, the empty lines are ignored */
+static int readMessages(const char *path, Message **messages, int *messageCount)
+{
+    FILE *list = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if (list == NULL)
+        return -1;
+
+    char line[8192];
+    while (fgets(line, sizeof(line), list)) {
+        size_t length = strcspn(line, "\r\n");
+        if (length == 0)
+            continue;
+        line[length] = 0;
+        *messages = realloc(*messages, (*messageCount + 1) * sizeof(Message));
+        (*messages)[(*messageCount)++] = (Message){ .text = strdup(line), .length = (int)length, .failed = 1 };
+    }
+    if (list != stdin)
+        fclose(list);
+    return 0;
+}
+
+static void printString(const char *string, int length)
+{
+    putchar('"');
+    for (int i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)string[i];
+        if (c == '"' || c == '\\')
+            printf("\\%c", c);
+        else if (c < 0x20 || c == 0x7f)
+            printf("\\u%04x", c);
+        else
+            putchar(c);
+    }
+    putchar('"');
+}
+
+
+#pragma mark - Rendering
+
+typedef struct {
+    const SFEmissionPlan    *plan;
+    Message                 *messages;
+    int                     messageCount;
+    int                     *next;              // next message to render, shared
+    int                     int16;
+    int                     leadFrames;         // silence before and after the message
+    int                     trailFrames;
+    float                   noiseDeviation;     // 0 without noise
+
+    double                  seconds;            // audio rendered by the thread
+} Renderer;
+
+/** Gaussian noise, xorshift and Box-Muller, the state is the one of the message */
+static float randomGaussian(unsigned int *state)
+{
+    float u[2];
+    for (int i = 0; i < 2; i++) {
+        *state ^= *state << 13;
+        *state ^= *state >> 17;
+        *state ^= *state << 5;
+        u[i] = (*state + 1.f) / 4294967296.f;
+    }
+    return sqrtf(-2.f * logf(u[0])) * cosf(2.f * (float)M_PI * u[1]);
+}
+
+/** Render one message in samples (lead, callbacks of the encoder, trail) */
+static int renderMessage(Renderer *renderer, SFMessageEncoder *encoder, const Message *message, int index, float *samples)
+{
+    int frame = renderer->leadFrames;
+
+    memset(samples, 0, frame * sizeof(float));
+    sfMessageEncoderStart(encoder, message->text, message->length);
+    for (int frames; (frames = sfMessageEncoderRender(encoder, samples + frame)) > 0; )
+        frame += frames;
+    memset(samples + frame, 0, renderer->trailFrames * sizeof(float));
+    frame += renderer->trailFrames;
+
+    if (renderer->noiseDeviation > 0) {
+        unsigned int state = 0x5f3759df ^ (unsigned int)(index + 1) * 2654435761u;
+        for (int i = 0; i < frame; i++)
+            samples[i] += randomGaussian(&state) * renderer->noiseDeviation;
+    }
+    return frame;
+}
+
+static void *renderThread(void *context)
+{
+    Renderer *renderer = context;
+    const SFEmissionPlan *plan = renderer->plan;
+    SFMessageEncoder *encoder = sfMessageEncoderCreate(plan);
+    float *samples = NULL;
+    int16_t *converted = NULL;
+    int capacity = 0;
+    int index;
+
+    while (encoder != NULL && (index = __atomic_fetch_add(renderer->next, 1, __ATOMIC_RELAXED)) < renderer->messageCount) {
+        Message *message = &renderer->messages[index];
+        int frames = renderer->leadFrames + sfMessageEncoderFrameCount(plan, message->length) + renderer->trailFrames;
+
+        if (frames > capacity) {
+            capacity = frames;
+            samples = realloc(samples, capacity * sizeof(float));
+            converted = realloc(converted, capacity * sizeof(int16_t));
+        }
+        message->frames = renderMessage(renderer, encoder, message, index, samples);
+
+        int status;
+        if (renderer->int16) {
+            for (int i = 0; i < message->frames; i++) {
+                float value = samples[i] * 32767.f;
+                if (value > 32767.f) value = 32767.f;
+                if (value < -32768.f) value = -32768.f;
+                converted[i] = (int16_t)lrintf(value);
+            }
+            status = sfWriteAudioFile(message->path, converted, message->frames, 1, (int)plan->sampleRate);
+        }
+        else {
+            status = sfWriteAudioFileFloat(message->path, samples, message->frames, 1, (int)plan->sampleRate);
+        }
+        message->failed = status != 0;
+        renderer->seconds += (double)message->frames / plan->sampleRate;
+    }
+
+    free(samples);
+    free(converted);
+    sfMessageEncoderDestroy(encoder);
+    return NULL;
+}
+
+
+#pragma mark - Main
+
+static double wallSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: sfrender [options] messages.txt ...\n"
+            "  -out dir         directory of the files (default .)\n"
+            "  -int16           PCM 16 bits instead of float 32 bits\n"
+            "  -raw             raw little endian samples (.pcm) instead of WAV\n"
+            "  -threads n       rendering threads (default: all the cores)\n"
+            "  -lead ms         silence before the message (default 0)\n"
+            "  -trail ms        silence after the message (default 0)\n"
+            "  -snr dB          add white noise, SNR of a caracter tone (default none)\n"
+            "emission, default getASCIIFrequency and emissionSampleCalcul:\n"
+            "  -rate hz         sample rate (44100)\n"
+            "  -frames n        frames per callback (256)\n"
+            "  -start hz        init tone (17800)\n"
+            "  -first hz        tone of ' ' (18000)\n"
+            "  -spacing hz      between two caracters (18)\n"
+            "  -stop hz         stop tone (19728)\n"
+            "  -init n          callbacks of init tone (26)\n"
+            "  -repeat n        callbacks per caracter (5)\n"
+            "  -tail n          callbacks of stop tone (26), after -mode to change the one of a mode\n"
+            "  -amplitude a     end of the fade in (0.8)\n"
+            "  -fade step       amplitude change per callback of init or stop tone (0.01)\n"
+            "  -mode n          multi tone mode, 0..%d in sfMultiToneModes, with its start tone, repeat and tail (single tone)\n"
+            "  -chirp           chirp preamble, then %d callbacks of start tone without fade in\n", SF_MFSK_MODE_COUNT - 1, SF_EMISSION_CHIRP_INIT_REPEAT);
+}
+
+int main(int argc, char **argv)
+{
+    SFEmissionPlan plan;
+    const char *directory = ".";
+    int threadCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int int16 = 0, raw = 0, chirp = 0;
+    float lead = 0, trail = 0, snr = INFINITY;
+    Message *messages = NULL;
+    int messageCount = 0;
+
+    sfEmissionPlanDefault(&plan);
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-out") && i + 1 < argc) directory = argv[++i];
+        else if (!strcmp(argv[i], "-int16")) int16 = 1;
+        else if (!strcmp(argv[i], "-raw")) raw = 1;
+        else if (!strcmp(argv[i], "-threads") && i + 1 < argc) threadCount = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-lead") && i + 1 < argc) lead = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-trail") && i + 1 < argc) trail = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-snr") && i + 1 < argc) snr = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-rate") && i + 1 < argc) plan.sampleRate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-frames") && i + 1 < argc) plan.frames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-start") && i + 1 < argc) plan.startFrequency = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-first") && i + 1 < argc) plan.firstCharFrequency = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-spacing") && i + 1 < argc) plan.charSpacing = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-stop") && i + 1 < argc) plan.stopFrequency = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-init") && i + 1 < argc) plan.initRepeat = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-repeat") && i + 1 < argc) plan.charRepeat = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-tail") && i + 1 < argc) plan.stopRepeat = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-amplitude") && i + 1 < argc) plan.amplitude = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-fade") && i + 1 < argc) plan.fadeStep = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-mode") && i + 1 < argc) sfEmissionPlanSetMode(&plan, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "-chirp")) chirp = 1;
+        else if (argv[i][0] == '-' && argv[i][1] != 0) {
+            usage();
+            return 1;
+        }
+        else if (readMessages(argv[i], &messages, &messageCount) != 0) {
+            fprintf(stderr, "can't read %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    // The duration of the chirp of 44100 Hz, in whole callbacks
+    if (chirp && plan.frames > 0) {
+        int length = (int)lroundf(SF_CHIRP_LENGTH * plan.sampleRate / 44100.f / plan.frames) * plan.frames;
+        sfEmissionPlanSetChirp(&plan, length);
+    }
+
+    // The plan is checked once here, the threads create their own encoder
+    SFMessageEncoder *check = sfMessageEncoderCreate(&plan);
+    if (check == NULL || messageCount == 0 || lead < 0 || trail < 0) {
+        usage();
+        return 1;
+    }
+    sfMessageEncoderDestroy(check);
+
+    mkdir(directory, 0755);
+    for (int m = 0; m < messageCount; m++) {
+        size_t size = strlen(directory) + 32;
+        messages[m].path = malloc(size);
+        snprintf(messages[m].path, size, "%s/%06d.%s", directory, m + 1, raw ? "pcm" : "wav");
+    }
+
+    if (threadCount < 1)
+        threadCount = 1;
+    if (threadCount > messageCount)
+        threadCount = messageCount;
+
+    // Power of a caracter tone a²/2 over the noise power
+    float noiseDeviation = isinf(snr) ? 0 : sqrtf(plan.amplitude * plan.amplitude / 2 / powf(10.f, snr / 10.f));
+    int next = 0;
+    Renderer *renderers = calloc(threadCount, sizeof(Renderer));
+    pthread_t *threads = calloc(threadCount, sizeof(pthread_t));
+    double wall = wallSeconds();
+    for (int t = 0; t < threadCount; t++) {
+        renderers[t] = (Renderer){ .plan = &plan, .messages = messages, .messageCount = messageCount, .next = &next, .int16 = int16,
+                                   .leadFrames = (int)(lead * plan.sampleRate / 1000), .trailFrames = (int)(trail * plan.sampleRate / 1000),
+                                   .noiseDeviation = noiseDeviation };
+        pthread_create(&threads[t], NULL, renderThread, &renderers[t]);
+    }
+
+    double seconds = 0;
+    for (int t = 0; t < threadCount; t++) {
+        pthread_join(threads[t], NULL);
+        seconds += renderers[t].seconds;
+    }
+    wall = wallSeconds() - wall;
+
+    int failed = 0;
+    for (int m = 0; m < messageCount; m++) {
+        printf("{\"file\":");
+        printString(messages[m].path, (int)strlen(messages[m].path));
+        printf(",\"text\":");
+        printString(messages[m].text, messages[m].length);
+        if (messages[m].failed)
+            printf(",\"error\":\"can't write the file\"}\n");
+        else
+            printf(",\"frames\":%d,\"duration\":%.3f}\n", messages[m].frames, messages[m].frames / plan.sampleRate);
+        failed += messages[m].failed;
+        free(messages[m].text);
+        free(messages[m].path);
+    }
+
+    fprintf(stderr, "%d messages (%d failed), %.1f s of audio in %.2f s on %d threads, %.0fx realtime\n",
+            messageCount, failed, seconds, wall, threadCount, wall > 0 ? seconds / wall : 0);
+
+    free(messages);
+    free(renderers);
+    free(threads);
+    return failed ? 2 : 0;
+}
@@ -15,6 +15,8 @@
 @interface DialViewController : SOMessagingViewController <SoundFiEngineDelegate> {
     AppDelegate *appDelegate;
     FDStatusBarNotifierView *notifierView;
+    SOMessage *receivingMessage;        // bubble of the note in progress, nil between the messages
+    NSData *receivingConfidence;        // of each caracter of receivingMessage
 }
 
 @end
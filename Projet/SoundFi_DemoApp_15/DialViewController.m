@@ -46,20 +46,60 @@
 
 - (void)messageReceived:(NSString *)theMessage {
     NSLog(@"Yolo : %@", theMessage);
-    if (theMessage.length > 6) {
-        if ([theMessage hasPrefix:@"Note:"]) {
-            theMessage = [theMessage substringFromIndex:5];
-            SOMessage *msg = [[SOMessage alloc] init];
-            msg.text = theMessage;
+    BOOL isNote = theMessage.length > 6 && [theMessage hasPrefix:@"Note:"];
+    NSString *text = isNote ? [theMessage substringFromIndex:5] : nil;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        // The bubble shown during the reception get the final text, or goes away if it was not a note
+        SOMessage *msg = receivingMessage;
+        receivingMessage = nil;
+        receivingConfidence = nil;
+        if (msg != nil && !isNote) {
+            [self.dataSource removeObject:msg];
+            [self refreshMessages];
+        }
+        else if (msg != nil) {
+            msg.text = text;
+            [self refreshMessages];
+        }
+        else if (isNote) {
+            msg = [[SOMessage alloc] init];
+            msg.text = text;
             msg.fromMe = NO;
-            dispatch_async(dispatch_get_main_queue(), ^{
-                [self receiveMessage:msg];
-            });
+            [self receiveMessage:msg];
         }
+    });
+}
+
+// The note is shown while it is received, the caracters the engine is not sure of are lighter
+- (void)messageProgress:(NSString *)partialMessage confidence:(NSData *)confidence {
+    NSString *text = nil;
+    NSData *levels = nil;
+    if (partialMessage != nil) {
+        if (partialMessage.length <= 5 || ![partialMessage hasPrefix:@"Note:"])
+            return;
+        text = [partialMessage substringFromIndex:5];
+        levels = [confidence subdataWithRange:NSMakeRange(5, confidence.length - 5)];
     }
-    
-    
-    
+    dispatch_async(dispatch_get_main_queue(), ^{
+        if (text == nil) {                      // dropped, the frame was wrong
+            if (receivingMessage != nil)
+                [self.dataSource removeObject:receivingMessage];
+            receivingMessage = nil;
+            receivingConfidence = nil;
+            [self refreshMessages];
+            return;
+        }
+        receivingConfidence = levels;
+        if (receivingMessage == nil) {
+            receivingMessage = [[SOMessage alloc] init];
+            receivingMessage.text = text;
+            [self receiveMessage:receivingMessage];
+        }
+        else {
+            receivingMessage.text = text;
+            [self refreshMessages];
+        }
+    });
 }
 
 - (void)localisationData:(NSString*)imgPromo :(NSString*)txtPromo{}
@@ -70,6 +110,25 @@
 - (void)startingReception { }
 
 
+#pragma mark - UITableView data source
+- (UITableViewCell *)tableView:(UITableView *)tableView cellForRowAtIndexPath:(NSIndexPath *)indexPath
+{
+    SOMessageCell *cell = (SOMessageCell *)[super tableView:tableView cellForRowAtIndexPath:indexPath];
+    
+    // Same text and font, so the size of the bubble doesn't change: only the alpha of each caracter follows its confidence
+    if (receivingMessage != nil && cell.message == receivingMessage && receivingConfidence.length == receivingMessage.text.length) {
+        NSMutableAttributedString *text = [cell.textView.attributedText mutableCopy];
+        const uint8_t *levels = receivingConfidence.bytes;
+        UIColor *color = cell.textView.textColor;
+        for (NSUInteger i = 0; i < receivingConfidence.length; i++) {
+            CGFloat alpha = 0.3 + 0.7 * levels[i] / SF_CONFIDENCE_MAX;
+            [text addAttribute:NSForegroundColorAttributeName value:[color colorWithAlphaComponent:alpha] range:NSMakeRange(i, 1)];
+        }
+        cell.textView.attributedText = text;
+    }
+    return cell;
+}
+
 #pragma mark - SOMessaging data source
 - (NSMutableArray *)messages
 {
@@ -14,15 +14,40 @@
 //  
 #import <Foundation/Foundation.h>
 #import <AudioToolbox/AudioToolbox.h>
-#import <UIKit/UITextChecker.h>
 #import <UIKit/UIApplication.h>
 #import <AVFoundation/AVFoundation.h>
 #import <Accelerate/Accelerate.h>
 #import <CoreLocation/CoreLocation.h>
 #import "AESCrypt.h"
 #import <AFNetworking.h>
-
-#define SPELLCHECKER 0
+#include "SFBandPlan.h"
+#include "SFToneBank.h"
+#include "SFVocoder.h"
+#include "SFDownconverter.h"
+#include "SFPeakEstimator.h"
+#include "SFNoiseFloor.h"
+#include "SFRingBuffer.h"
+#include "SFAnalysisWorker.h"
+#include "SFMessageDecoder.h"
+#include "SFOscillator.h"
+#include "SFMessageEncoder.h"
+#include "SFMultiTone.h"
+#include "SFChirp.h"
+#include "SFEchoCanceller.h"
+#include "SFLexicon.h"
+#include "SFZoneEstimator.h"
+#include "SFBeaconScanner.h"
+#include "SFPromotionCache.h"
+
+#define SPELLCHECKER 1                   // phase 6 of the analysis, the words are corrected with the vocabulary of SoundFiLexicon.bin
+
+//Time outs in seconds, the counters count samples so they don't depend on the IO buffer size
+#define SF_TIMEOUT_MESSAGING    1.74    // end of a message (300 buffers of 256 frames before)
+#define SF_TIMEOUT_GEOLOC       23.2    // end of a geolocation (500 buffers of 2048 frames)
+#define SF_TIMEOUT_PAIEMENT     32.5    // end of the paiement (700 buffers of 2048 frames)
+#define SF_TIMEOUT_PROCESS      3.0     // one step of the paiement process
+#define SF_PROGRESS_PERIOD      0.1     // between two calls of messageProgress:confidence:, in seconds of samples
+#define SF_IO_BUFFER_FRAMES     2048    // IO buffer of the duplex graph, set once by initAudioSession
 
 @protocol SoundFiEngineDelegate <NSObject>
 @optional
@@ -36,6 +61,38 @@
  @param theMessage A string containing the message you just received
  */
 - (void) messageReceived:(NSString*) theMessage;
+/**---------------------------------------------------------------------------------------
+ * DataReceived
+ *  ---------------------------------------------------------------------------------------
+ */
+
+/** This method is called when you have received binary data sent with sendData: (multi tone modes only)
+ 
+ @param theData The bytes as they were sent
+ */
+- (void) dataReceived:(NSData*) theData;
+/**---------------------------------------------------------------------------------------
+ * MessageProgress
+ *  ---------------------------------------------------------------------------------------
+ */
+
+/** This method is called while a message is received, each time more caracters are known, so you can show it before its end. The caracters already given don't change, only the last ones can be added. messageReceived: gives the final message (corrected in a coded mode) ; if the message is dropped (frame cut or corrupted) this method is called with nil instead.
+ 
+ @param partialMessage The beginning of the message received so far, nil if it is dropped
+ @param confidence One byte per caracter of partialMessage, from 0 (a guess) to SF_CONFIDENCE_MAX (sure)
+ */
+- (void) messageProgress:(NSString*)partialMessage confidence:(NSData*)confidence;
+/**---------------------------------------------------------------------------------------
+ * MessageHeader
+ *  ---------------------------------------------------------------------------------------
+ */
+
+/** This method is called when the header of a multi tone frame is read, before its body : you know what is coming and how long it will take.
+ 
+ @param type The type of the frame (SFFrameTypeMessage, SFFrameTypePayment or SFFrameTypeData)
+ @param length Bytes of the message
+ */
+- (void) messageHeader:(SFFrameType)type length:(int)length;
 /**---------------------------------------------------------------------------------------
  * StartingReception
  *  ---------------------------------------------------------------------------------------
@@ -130,6 +187,14 @@ enum {
 };
 typedef int SFMessagingMode;
 
+enum {
+    SFDetectorFFT = 0,          // fftGetFrequencyLowAccuracy / fftGetFrequencyHighAccuracy
+    SFDetectorToneBank = 1,     // Goertzel filters on the band plan frequencies only
+    SFDetectorBaseband = 2,     // 17-21.5 kHz band brought to 5.5 kHz, then the Goertzel filters
+    SFDetectorInterpolated = 3, // one windowed FFT every 256 samples, interpolated peak and confidence
+};
+typedef int SFDetectorMode;
+
 /**
  
  SoundFiAudioSession is the audio Engine of the SoundFi technologie. This class  include all the differrent mode that SoundFi provide : messaging, locating and paiement
@@ -165,10 +230,9 @@ typedef int SFMessagingMode;
     //Global audio Session
     AVAudioSession *mySession;
     
-    //AudioUnit for emission and reception
+    //AudioUnit for emission and reception, one graph for both : the emission is the bus 0 of the mixer, the mic the bus 1
     AudioUnit           audioUnit;
     AudioUnit           mixerUnit;
-    AudioUnit           emissionUnit;
     
     //Graph component
     AUNode              ioNode;
@@ -179,11 +243,11 @@ typedef int SFMessagingMode;
     int                 sampleFrequency;
     float               sampleRate;
     
-    //Ampty sample to clean I/O
-    AudioUnitSampleType *emptySample;
-    
     //Callback Setup
-    SInt16              *samplesBuffer;
+    SInt16              *samplesBuffer;     // written by renderCallback only
+    SFRingBuffer        *sampleRing;        // renderCallback -> analysisWorker
+    SFAnalysisWorker    *analysisWorker;    // run sampleTreatment out of the render thread
+    SInt16              *workerSamples;     // block being analysed by the worker
     
     // fft
     FFTSetup            fftSetup;			// fft predefined structure required by vdsp fft functions
@@ -197,6 +261,24 @@ typedef int SFMessagingMode;
     void                *dataBuffer;        //  input buffer from mic/line
     float               *outputBuffer;      //  fft conversion buffer
     float               *analysisBuffer;    //  fft analysis buffer
+    SFVocoder           *vocoder256;        //  phase vocoder for the hight accuracy analysis, one state
+    SFVocoder           *vocoder2048;       //  for each buffer size (nbrEchantillon)
+    SFVocoder           *lastVocoder;       //  the one use by the last buffer
+    SFNoiseFloor        *noiseFloor;        //  noise floor of the 17-21.5 kHz bins for the low accuracy analysis
+    float               *noiseMagnitudes;   //  squared magnitudes of the last low accuracy fft
+    
+    // tone bank
+    SFToneBank          *toneBank;          // Goertzel filters on the band plan
+    SFDetectorMode      detectorMode;       // detector use by sampleTreatment
+    
+    // baseband front end
+    SFDownconverter     *downconverter;     // heterodyne + decimation of the ultrasonic band
+    SFToneBank          *basebandToneBank;  // Goertzel filters on the baseband stream
+    float               *basebandRe;        // baseband samples of the current buffer
+    float               *basebandIm;
+    
+    // interpolated peak
+    SFPeakEstimator     *peakEstimator;     // Jacobsen estimator on the 17-21.5 kHz band
     
     //Transaction information for the clasic message
     BOOL                isInitiate;
@@ -205,21 +287,57 @@ typedef int SFMessagingMode;
     BOOL                emissionMode;
     
     //Reception mode variables for the clasic message
-    NSMutableString     *messageReceive;
+    SFMessageStream     messageStream;      // caracters of the single tone message, analysed as they are received
+    int                 receptionQuality;   // of the last message : <20 very bad, 20-40 not so bad, 40-70 some errors, >70 perfect
+    SFLexicon           *lexicon;           // vocabulary of the phase 6, mapped from the bundle, NULL if it is missing
     
     //Emission mode variables for the clasic message
     double              amplitude;
-    double              theta;
+    SFOscillator        *oscillator;        // phase continuous sine, tables of the band plan
     NSString            *myMessage;
     pthread_mutex_t     emissionMutex;
-    int                 nbCaracRepeat;
-    BOOL                initSequence;
-    int                 nbrRepeatInit;
     BOOL                emissionCanBeStop;
     float                 minimumVolume;
     
+    //Multi tone mode (SFMultiTone.h), several tones per symbol
+    int                 multiToneMode;      // mode of the next emissions (sfMultiToneModes), SF_MFSK_SINGLE_TONE for the single tone mode
+    SFMessageEncoder    *messageEncoder;    // emission in the mode of multiToneMode, single tone included
+    NSData              *encodedMessage;    // bytes read by messageEncoder
+    float               *encoderSamples;    // last callback of messageEncoder
+    int                 encoderOffset;      // samples of encoderSamples already sent
+    SFMultiToneDecoder  *multiToneDecoders[SF_MFSK_MODE_COUNT];
+    SFMultiToneDecoder  *multiToneReceiving;// decoder of the message in progress, NULL in single tone mode
+    
+    //Progressive delivery of the message in progress (messageProgress:confidence:, messageHeader:length:)
+    int                 progressLength;     // caracters already given to the delegate
+    long long           progressSampleTime; // workerSampleCount at the last call
+    BOOL                headerReceived;     // messageHeader:length: was called for the frame in progress
+    
+    //Chirp preamble (SFChirp.h), the end of the chirp gives the first symbol to the sample
+    BOOL                chirpPreamble;      // send the chirp before a short start tone, search it before the detectors
+    int                 chirpLength;        // samples of the chirp sent by messageEncoder
+    SFChirpDetector     *chirpDetector;     // matched filter, run by the analysis worker
+    
+    //Full duplex (SFEchoCanceller.h), the mic keeps listening to the other half of the band during the emission
+    BOOL                fullDuplex;         // send in a full duplex mode without stopping the reception
+    SFEchoCanceller     *echoCanceller;     // subtract the emission from the blocks of the worker
+    SFMessageEncoder    *echoEncoder;       // the emission rendered again on the worker, reference of echoCanceller
+    float               *echoSamples;       // last callback of echoEncoder
+    float               *echoReference;     // reference of the block being analysed, aligned on the mic
+    pthread_mutex_t     echoMutex;          // echoEncoder and echoCanceller, between the worker and the main thread
+    SFFrameType         emissionType;       // frame of the emission in progress, for echoEncoder
+    int                 emissionCount;      // emissions started, the worker restart echoEncoder on a new one
+    int                 echoEmission;       // emission followed by echoEncoder
+    BOOL                echoRunning;        // echoEncoder has not sent its stop symbol yet
+    int                 echoOffset;         // samples of echoSamples already used
+    long long           echoIndex;          // samples of the emission already rendered by echoEncoder
+    Float64             emissionSampleTime; // sample time of the first sample of the emission, -1 until renderToneCallback send it
+    Float64             micSampleOffset;    // sample time of the mic minus the samples written in sampleRing
+    long long           ringSamples;        // samples written in sampleRing by renderCallback
+    long long           workerSampleCount;  // samples taken from sampleRing by analysisWorkerProcess
+    
     //Share mode's variable
-    int                 compteur;           //Use to define when there is a time out
+    int                 compteur;           //Use to define when there is a time out, in samples
     
     // Delegate to respond back
     id <SoundFiEngineDelegate> _delegate;
@@ -232,8 +350,13 @@ typedef int SFMessagingMode;
     
     
     //Géomarketing variable
-    int                 *curentFrequencyData;
-    int                 nbrVal;
+    SFZoneEstimator     zoneEstimator;              // spot of the zone from the beacon frequencies, updated at each one
+    SFBeaconScanner     *beaconScanner;             // every beacon of the 2048 points spectrum and the position between them
+    SFPromotionCache    *promotionCache;            // promotions of the spots, kept in Library/Caches between the launches
+    dispatch_queue_t    promotionQueue;             // serial queue of every access to promotionCache
+    NSURLSession        *promotionSession;          // requests of the promotions, without the NSURLCache (promotionCache does it)
+    NSString            *promotionServer;           // base URL of test.php and promotions.php
+    NSString            *promotionPath;             // file of promotionCache
     int                 nbrSpotInZone;              // Nombre de spot dans la zone
     NSMutableArray      *zoneArray;                 // Liste des spots (noms) qui compose la zone
     NSString            *currentPos;
@@ -287,7 +410,7 @@ typedef int SFMessagingMode;
  */
 /** Allow you to start SoundFi engine for receiving or sending function.
  
- This function start the audio unit for send of receiving, and proceed to a sound check in case of sendingMode is use.
+ This function start the audio unit for send of receiving, and proceed to a sound check in case of sendingMode is use. The graph is the same in both modes and stays running : after a message the reception is back on the next buffer.
  
  @param mode The mode that you want to use, SFReceivingMode or SFSendingMode
  @param message The string to send (only if you use SFSendingMode, otherwise put nil)
@@ -302,6 +425,22 @@ typedef int SFMessagingMode;
 
 
 
+/**---------------------------------------------------------------------------------------
+ * SendData
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Send binary data (a ciphertext, compressed data...) without encoding it in text.
+ 
+ The single tone mode only carry the printable caracters, the data is sent in the multi tone mode chosen by setMultiToneMode:, SF_MFSK_BINARY_MODE is the one made for it. The receiver give it to dataReceived:, or to the payment in base64 (the form of AESCrypt) if the payment is enabled.
+ 
+ @param data The bytes to send, SF_FRAME_MAX_LENGTH at most
+ @return Return 1 if every thing is ok, 0 if the volume is too low or the engine is in the single tone mode.
+ @see setMultiToneMode:
+ */
+-(int)sendData:(NSData*)data;
+
+
+
 /**---------------------------------------------------------------------------------------
  * @name Emission methods
  * EmissionSampleCalcul
@@ -310,7 +449,9 @@ typedef int SFMessagingMode;
 
 /** Create the audio wave with the required frequency for a given sample.
  
- This function will generate an audio sinusoidal wave for each audio sample needed. This function is called in the renderCallBack.
+ This function will generate an audio sinusoidal wave for each audio sample needed. The messages don't use it any more, they are rendered by SFMessageEncoder whose callbacks don't depend on numFrames, this one fade on each call.
+ 
+ The samples come from the oscillator (no sin() per sample, the band plan tones are precomputed), the amplitude goes linearly over the buffer to its new value so the fade in and fade out are smooth.
  
  @param frequence This is the desired frequency for this sample (int).
  @param numFrames The number of frame that required the audio hardware (int).
@@ -325,16 +466,68 @@ typedef int SFMessagingMode;
  *  ---------------------------------------------------------------------------------------
  */
 
-/** Coordinate the state of the emission and asign a frequency to a caracter.
+/** The frequency of the emission at this moment.
  
- This function make the link between the audio and the string to send. For each audioSample needed, this function will tell what frequency we need.
+ The message is rendered by messageEncoder on its own sample clock, this is the tone of the callback of 256 frames being sent (the first tone of the symbol in a multi tone mode).
  
- @return Return the frequency associate with the caracter or the init/stop frequency
+ @return Return the frequency associate with the caracter or the init/stop frequency, 0 during the chirp or once the message is sent
  */
 -(int)getASCIIFrequency;
 
 
 
+/**---------------------------------------------------------------------------------------
+ * SetMultiToneMode
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Choose how the next messages are sent.
+ 
+ In the single tone mode (the default) each caracter is one tone of the band plan. In a multi tone mode the 18000-19712 Hz band is cut in up to 4 sub-bands and a symbol is one tone in each sub-band at the same time, 4 to 12 bits per symbol instead of one caracter (6.6 bits), the tones of a sub-band as far apart as the resolution of the receiver window. The coded modes send one louder tone for shorter symbols with a Reed-Solomon parity, the receiver fix the wrong bytes itself: they receive far under the SNR of the other modes, not faster. The binary mode (SF_MFSK_BINARY_MODE) is one tone of 16 at a time, for sendData: and the payment ID, sent as bytes instead of base64. The mode is announced by its own start tone, under the one of the single tone mode, so the receivers that don't know this mode ignore the message. A receiver accept every mode, it follow the start tone it hear (FFT and interpolated detectors).
+ 
+ The full duplex modes (SF_MFSK_DUPLEX_LOW_MODE, SF_MFSK_DUPLEX_HIGH_MODE) only use a half of the band, see setFullDuplex:. An other mode turns the full duplex off.
+ 
+ @param mode A mode of sfMultiToneModes or SF_MFSK_SINGLE_TONE, an other value or a call during an emission is ignored
+ @see sfMultiToneModes
+ @see setFullDuplex:
+ */
+-(void)setMultiToneMode:(int)mode;
+
+
+
+/**---------------------------------------------------------------------------------------
+ * SetChirpPreamble
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Start the messages with a chirp instead of the 26 callbacks of start tone.
+ 
+ The emitter send a chirp from 17000 to 19500 Hz (46 ms), then the start tone of the mode for 3 callbacks only, at the level of the message. The receiver find the chirp with a matched filter (SFChirpDetector): the end of the chirp is known to the sample whatever the size of the IO buffers, the start tone that follows tells the mode, and the first symbol is taken at its exact position. The preamble is 64 ms instead of 151 ms and it's found at a lower level than the start tone.
+ 
+ The receiver search the chirp before the detectors and still accept the messages with the start tone alone, an emitter that send the chirp need a receiver that enabled it too. A call during an emission is ignored.
+ 
+ @param enable TRUE for the chirp preamble, FALSE for the start tone (the default)
+ @see setMultiToneMode:
+ */
+-(void)setChirpPreamble:(BOOL)enable;
+
+
+
+/**---------------------------------------------------------------------------------------
+ * SetFullDuplex
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Send and receive at the same time, the two devices of a payment answer each other without waiting for the end of the other message.
+ 
+ The full duplex modes cut the band in two: SF_MFSK_DUPLEX_LOW_MODE send in 18000-19000 Hz, SF_MFSK_DUPLEX_HIGH_MODE in 19800-21000 Hz. One device send in one, the other one in the other: the emission doesn't stop the reception anymore, and the receiver never follows a start tone of its own mode. The mic still hears the emission 20 to 30 dB above the other device, the emission is rendered a second time on the analysis worker and subtracted from the mic by an adaptive filter (SFEchoCanceller) before the detectors. The reference is aligned on the mic with the sample times of the render callbacks, the delay of the filter is the input and output latency of the session when the full duplex is enabled.
+ 
+ The geolocation band (20-21 kHz) is in the high half, the geolocation is off while a message is received as in the other modes.
+ 
+ @param enable TRUE to keep the reception during the emissions. If the mode of setMultiToneMode: is not a full duplex mode, SF_MFSK_DUPLEX_LOW_MODE is chosen. FALSE go back to the half duplex, a call during an emission is ignored.
+ @see setMultiToneMode:
+ */
+-(void)setFullDuplex:(BOOL)enable;
+
+
+
 /**---------------------------------------------------------------------------------------
  * @name TimeOut methods
  * checkTimeOut
@@ -397,6 +590,53 @@ typedef int SFMessagingMode;
 
 
 
+/**---------------------------------------------------------------------------------------
+ * SetDetectorMode
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Choose the frequency detector used by sampleTreatment.
+ 
+ - SFDetectorFFT : the two FFT (low accuracy in background, phase vocoder in foreground), the default one.
+ - SFDetectorToneBank : a bank of Goertzel filters tuned on the SoundFi frequencies (start, caracters, stop and geo spots). It only look at the frequencies we use, so it's cheaper than the phase vocoder and give the exact frequency of the tone whatever the buffer size is.
+ - SFDetectorBaseband : the same filters behind a front end that mix the 17-21.5 kHz band down to 0 Hz and decimate it by 8, so the filters run on 8 times less samples.
+ - SFDetectorInterpolated : a single 1024 points FFT every 256 samples, the peak is placed between the bins by interpolation (within a few Hz) and only kept if its confidence is high enough. It's as cheap as the low accuracy FFT and accurate enough for every mode, so the blocks of the worker stay at 2048 frames: the block is cut in slices of 256 frames and the reception methods are called for each slice.
+ 
+ @param mode SFDetectorFFT, SFDetectorToneBank, SFDetectorBaseband or SFDetectorInterpolated
+ @see sampleTreatment
+ */
+-(void)setDetectorMode:(SFDetectorMode)mode;
+
+
+
+/**---------------------------------------------------------------------------------------
+ * SetDetectionMargin
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Change how far over the noise a frequency must be to be accepted by the low accuracy FFT.
+ 
+ Each bin of the 17-21.5 kHz band has its own noise floor, learned continuously while the engine is waiting (SFNoiseFloor). A peak is accepted when its SNR is over this margin, so the same value works on every device and in every place. A lower margin detect farther emitters but wake up the engine more often on noise.
+ 
+ @param margin Margin in dB (SF_NOISE_DEFAULT_MARGIN, 12 dB, by default)
+ @see signalToNoiseRatio:
+ */
+-(void)setDetectionMargin:(float)margin;
+
+
+
+/**---------------------------------------------------------------------------------------
+ * SignalToNoiseRatio
+ *  ---------------------------------------------------------------------------------------
+ */
+/** SNR of a frequency in the last low accuracy FFT.
+ 
+ @param frequency A frequency of the 17-21.5 kHz band (Hz)
+ @return The power of its bin over the noise floor of the bin, in dB (0 outside of the band)
+ @see setDetectionMargin:
+ */
+-(float)signalToNoiseRatio:(int)frequency;
+
+
+
 /**---------------------------------------------------------------------------------------
  * @name Engine informations methods
  * LocalisationModeIsEnable
@@ -414,6 +654,36 @@ typedef int SFMessagingMode;
 -(BOOL)backgroundIsEnable;
 -(BOOL)engineIsRunning;
 
+/** Quality of the last message received, computed by the analysis
+ 
+ @return The caracters kept minus the caracters rejected : <20 very bad, 20-40 not so bad, 40-70 some errors, >70 perfect
+ */
+-(int)receptionQuality;
+
+/** Position of the user between the geomarketing beacons, computed from every beacon heard in the last spectrum (SFBeaconScanner)
+ 
+ @return The position in spots: the nearest spot, moved toward its louder neighbour by the ratio of their levels (3.5 is halfway between the spots 3 and 4), -1 if no beacon is heard
+ */
+-(float)localisationPosition;
+
+/** Change the server of the promotions, a local stand-in of mynetshare.fr for the tests (the sfpromo tool)
+ 
+ @param url The base URL of test.php and promotions.php, @"http://mynetshare.fr/" by default
+ */
+-(void)setPromotionServer:(NSString*)url;
+
+/**---------------------------------------------------------------------------------------
+ * AnalysisStatistics
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Health of the reception analysis, done by a worker thread out of the render callback
+ 
+ @param overruns Samples dropped because the worker was too slow (may be NULL)
+ @param underruns Times the worker stayed without samples more than 2 buffers (may be NULL)
+ @param maxLatency Longest time a sample waited before being analysed, in seconds (may be NULL)
+ */
+-(void)analysisStatistics:(uint32_t*)overruns :(uint32_t*)underruns :(float*)maxLatency;
+
 /**---------------------------------------------------------------------------------------
  * @name Engine control methods
  * EnableBackground
@@ -7,31 +7,36 @@
 //
 
 #import "SoundFiAudioSession.h"
+#import "NSData+Base64.h"
+#import "NSString+Base64.h"
 #include <pthread.h>
+#include <limits.h>
 
 
 /**---------------------------------------------------------------------------------------
- * Smb2PitchShift
+ * MagnitudeSquared
  *  ---------------------------------------------------------------------------------------
  */
-/** FFT alorithme for hight accurancy analysis
- 
- This was take from http://www.dspdimension.com/ and modify to apply a hight pass filter, and some modification.
- 
- @see fftGetFrequencyHighAccuracy
- */
-void smb2PitchShift(float pitchShift, long numSampsToProcess, long fftFrameSize,
-                    long osamp, float sampleRate, float *indata, float *outdata,
-                    FFTSetup fftSetup, float * frequency,void* userData);
+float MagnitudeSquared(float x, float y) {
+    return ((x*x) + (y*y));
+}
 
 
 
 /**---------------------------------------------------------------------------------------
- * MagnitudeSquared
+ * HeaderField
  *  ---------------------------------------------------------------------------------------
  */
-float MagnitudeSquared(float x, float y) {
-    return ((x*x) + (y*y));
+/** Value of a header of an HTTP response, nil if it is not there. The names are compared without the case: iOS 7 give "Etag" for "ETag".
+ 
+ */
+static NSString *headerField(NSHTTPURLResponse *response, NSString *name)
+{
+    for (NSString *field in [response allHeaderFields]) {
+        if ([field caseInsensitiveCompare:name]==NSOrderedSame)
+            return [[response allHeaderFields] objectForKey:field];
+    }
+    return nil;
 }
 
 
@@ -72,12 +77,14 @@ void fixedPointToSInt16( SInt32 * source, SInt16 * target, int length ) {
  */
 /** FFT function to get frequency of an audio sample
  
- This function is use for foreground processing or ponctual background processing. It can give the frequency close to 1Hz but use pretty much CPU, do not use this all the time or it will use to much battery.
+ This function is use for foreground processing or ponctual background processing. It can give the frequency close to 1Hz but use more CPU than the low accuracy one, do not use this all the time or it will use to much battery.
+ 
+ It use the analysis half of the smb2PitchShift phase vocoder (SFVocoder) : the pitch shift synthesis, the inverse FFT and the output buffer were computed for nothing since renderCallback throw the sample away.
  
  @param inRefCon Typically allow to pass parameters to this function (to make the function working pass a SoundFiAudioSession instance)
  @param inNumberFrames The number of frame use to process audio
  @param sampleBuffer the buffer that contain the audio sample
- @see smb2PitchShift
+ @see SFVocoder
  */
 OSStatus fftGetFrequencyHighAccuracy (
                                       void *inRefCon,
@@ -86,50 +93,27 @@ OSStatus fftGetFrequencyHighAccuracy (
     
     SoundFiAudioSession *THIS = (__bridge SoundFiAudioSession *)inRefCon;
     
-    float *outputBuffer = THIS->outputBuffer;
-    float *analysisBuffer = THIS->analysisBuffer;
-    int nbrEchantillon = THIS-> nbrEchantillon;
-    
-    FFTSetup fftSetup = THIS->fftSetup;      // fft setup structures need to support vdsp functions
-    
-    
-    uint32_t stride = 1;                    // interleaving factor for vdsp functions
-    int bufferCapacity = nbrEchantillon;               // maximum size of fft buffers
-    
-    float pitchShift = 1.0;                 // pitch shift factor 1=normal, range is .5->2.0
-    long osamp = 4;                         // oversampling factor
-    long fftSize = nbrEchantillon;                     // fft size
-    
-    
     float frequency;                        // analysis frequency result
     
+    // fft size follow nbrEchantillon, each size has its own state (FIFO, last spectrum)
+    SFVocoder *vocoder = (THIS->nbrEchantillon == 2048) ? THIS->vocoder2048 : THIS->vocoder256;
     
-    //	ConvertInt16ToFloat
-    vDSP_vflt16((SInt16 *) sampleBuffer, stride, (float *) analysisBuffer, stride, bufferCapacity );
-
-    pitchShift = (0.5 * 1.5) + .5;
-    
-    // osamp should be at least 4
-    
-    osamp = 4;
-    fftSize = nbrEchantillon;
-    
-    smb2PitchShift( pitchShift , (long) inNumberFrames,
-                   fftSize,  osamp, (float) THIS->sampleRate,
-                   (float *) analysisBuffer , (float *) outputBuffer,
-                   fftSetup, &frequency,inRefCon);
-    
-    
-    THIS->sampleFrequency = (int) frequency;
-    
-    
-    // now convert from float to Sint16
-    vDSP_vfixr16((float *) outputBuffer, stride, (SInt16 *) sampleBuffer, stride, bufferCapacity );
+    // The FIFO of the other size is old, don't mix it with this sample
+    if (vocoder != THIS->lastVocoder) {
+        sfVocoderReset(vocoder);
+        THIS->lastVocoder = vocoder;
+    }
     
+    // frequency is the average of the frames analysed during this buffer
+    if (sfVocoderProcessInt16(vocoder, sampleBuffer, inNumberFrames, &frequency) > 0) {
+        THIS->sampleFrequency = (int) frequency;
+        
+        // All the beacons of the zone are in the spectrum, not only the loudest one
+        if (vocoder == THIS->vocoder2048 && THIS->geoIsInitiate && THIS->beaconScanner != NULL)
+            sfBeaconScannerUpdate(THIS->beaconScanner, vocoder->magnitudes);
+    }
     
     return noErr;
-    
-    
 }
 
 
@@ -202,23 +186,16 @@ OSStatus fftGetFrequencyLowAccuracy (   void                        *inRefCon,
         
         vDSP_ztoc(&A, 1, (COMPLEX *)analysisBuffer, 2, nOver2);
         
-        // Determine the dominant frequency by taking the magnitude squared and
-        // saving the bin which it resides in. This isn't precise and doesn't
-        // necessary get the "fundamental" frequency, but its quick and sort of works...
+        // Determine the dominant frequency from the magnitude squared of the bins of the
+        // SoundFi band. Each bin is compared to its own noise floor (no more fixed 5e9
+        // threshold): the peak is the bin with the best SNR over the margin.
         
-        // note there are vdsp functions to do the amplitude calcs
+        SFNoiseFloor *noise = THIS->noiseFloor;
+        DSPSplitComplex band = { A.realp + noise->firstBin, A.imagp + noise->firstBin };
+        vDSP_zvmags(&band, 1, THIS->noiseMagnitudes + noise->firstBin, 1, noise->binCount);
+        int bin = sfNoiseFloorUpdate(noise, THIS->noiseMagnitudes);
         
-        float dominantFrequency = 0;
-        int bin = -1;
-        for (int i=100; i<n; i+=2) {
-            float curFreq = MagnitudeSquared(analysisBuffer[i], analysisBuffer[i+1]);
-            if ((curFreq > dominantFrequency) && (curFreq >5000000000)) { //1000000000 is the minimal "amplitude" to accept the pic
-                dominantFrequency = curFreq;                              // This value may be changed in function of mode
-                bin = (i+1)/2;
-            }
-        }
-        
-        dominantFrequency = bin*(THIS->sampleRate/bufferCapacity);
+        float dominantFrequency = (bin < 0) ? 0 : bin*(THIS->sampleRate/bufferCapacity);
         
         THIS->sampleFrequency = (int) dominantFrequency;
         
@@ -248,17 +225,119 @@ OSStatus fftGetFrequencyLowAccuracy (   void                        *inRefCon,
 
 
 
+/**---------------------------------------------------------------------------------------
+ * ToneBankGetFrequency
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Tone bank function to get frequency of an audio sample
+ 
+ Only the energy of the SoundFi frequencies is computed (Goertzel filters on the last 1024 samples), so the result is always one of the band plan frequencies, or 0 when there is no clear tone. The CPU cost does not depend on the buffer size and it can be used in background as in foreground.
+ 
+ @param inRefCon Typically allow to pass parameters to this function (to make the function working pass a SoundFiAudioSession instance)
+ @param inNumberFrames The number of frame use to process audio
+ @param sampleBuffer the buffer that contain the audio sample
+ @see toneBankSetup
+ */
+OSStatus toneBankGetFrequency ( void *inRefCon,
+                                UInt32 inNumberFrames,
+                                SInt16 *sampleBuffer)
+{
+    SoundFiAudioSession *THIS = (__bridge SoundFiAudioSession*)inRefCon;
+    SFToneBank *toneBank = THIS->toneBank;
+    
+    if (sfToneBankProcessInt16(toneBank, sampleBuffer, inNumberFrames)) {
+        int tone = sfToneBankStrongest(toneBank, NULL);
+        THIS->sampleFrequency = (tone < 0) ? 0 : (int)toneBank->frequencies[tone];
+    }
+    
+    return noErr;
+}
+
+
+
+/**---------------------------------------------------------------------------------------
+ * BasebandGetFrequency
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Front end + tone bank function to get frequency of an audio sample
+ 
+ The sample is first mixed with a 19250 Hz oscillator and decimated by 8 (SFDownconverter), only the 17-21.5 kHz band is kept and the stream is now at 5512.5 Hz. The Goertzel filters then run on this complex stream, with the band plan frequencies minus 19250 Hz.
+ 
+ @param inRefCon Typically allow to pass parameters to this function (to make the function working pass a SoundFiAudioSession instance)
+ @param inNumberFrames The number of frame use to process audio
+ @param sampleBuffer the buffer that contain the audio sample
+ @see basebandSetup
+ */
+OSStatus basebandGetFrequency ( void *inRefCon,
+                                UInt32 inNumberFrames,
+                                SInt16 *sampleBuffer)
+{
+    SoundFiAudioSession *THIS = (__bridge SoundFiAudioSession*)inRefCon;
+    SFToneBank *toneBank = THIS->basebandToneBank;
+    int updated = 0;
+    
+    // basebandRe and basebandIm hold the result of 2048 frames
+    while (inNumberFrames > 0) {
+        UInt32 chunk = inNumberFrames < 2048 ? inNumberFrames : 2048;
+        int count = sfDownconverterProcessInt16(THIS->downconverter, sampleBuffer, chunk, THIS->basebandRe, THIS->basebandIm);
+        updated |= sfToneBankProcessComplex(toneBank, THIS->basebandRe, THIS->basebandIm, count);
+        sampleBuffer += chunk;
+        inNumberFrames -= chunk;
+    }
+    
+    if (updated) {
+        int tone = sfToneBankStrongest(toneBank, NULL);
+        THIS->sampleFrequency = (tone < 0) ? 0 : (int)(toneBank->frequencies[tone] + THIS->downconverter->centreFrequency);
+    }
+    
+    return noErr;
+}
+
+
+
+/**---------------------------------------------------------------------------------------
+ * InterpolatedGetFrequency
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Single FFT function to get frequency of an audio sample
+ 
+ A 1024 points FFT with a Hann window is computed every 256 samples on the 17-21.5 kHz band, the peak is placed between the bins with the Jacobsen estimator (SFPeakEstimator). The frequency is within a few Hz, as with the phase vocoder, but there is no phase from the previous frame so the result does not depend on the buffer size. The peak is only kept if it's loud enough and if the main lobe hold most of the band energy, otherwise the frequency is 0.
+ 
+ @param inRefCon Typically allow to pass parameters to this function (to make the function working pass a SoundFiAudioSession instance)
+ @param inNumberFrames The number of frame use to process audio
+ @param sampleBuffer the buffer that contain the audio sample
+ @see interpolatedSetup
+ */
+OSStatus interpolatedGetFrequency ( void *inRefCon,
+                                    UInt32 inNumberFrames,
+                                    SInt16 *sampleBuffer)
+{
+    SoundFiAudioSession *THIS = (__bridge SoundFiAudioSession*)inRefCon;
+    SFPeak peak;
+    
+    if (sfPeakEstimatorProcessInt16(THIS->peakEstimator, sampleBuffer, inNumberFrames, &peak) > 0) {
+        if (peak.power < SF_PEAK_MIN_POWER || peak.confidence < SF_PEAK_MIN_CONFIDENCE)
+            THIS->sampleFrequency = 0;
+        else
+            THIS->sampleFrequency = (int)peak.frequency;
+    }
+    
+    return noErr;
+}
+
+
+
 /**---------------------------------------------------------------------------------------
  * RenderToneCallback
  *  ---------------------------------------------------------------------------------------
  */
 /** A callBack function use in audio processing (emission)
  
- This function is call during the emission mode. It will request an audio sample from hardware, that we fill with our desired sample (at our given frequency) and then put in the mircrophone to create the sound.
+ This function is the input bus 0 of the mixer, it is called as long as the graph runs. In the emission mode it fill the buffer with the message, else with silence : switching between emission and reception is only the emissionMode flag, the graph is never stopped nor rebuilt.
  
  @param userData Typically allow to pass parameters to this function (to make the function working pass a SoundFiAudioSession instance)
  @param actionFlags Don't really know what is this but not usefull
- @param audioTimeStamp Don't really know what is this but not usefull
+ @param audioTimeStamp The sample time of the first emitted sample is kept, the echo canceller of the full duplex aligns the emission on the mic with it
  @param busNumber The number of the bus the function have to use (automatic)
  @param numFrames The number of frame use to process audio
  @param buffers The buffer that contain the audio sample
@@ -275,12 +354,15 @@ OSStatus renderToneCallback(void *userData,
     
     pthread_mutex_lock(&THIS->emissionMutex);
     
-    //If emissionMode = TRUE then start sending stuff
+    //If emissionMode = TRUE then start sending stuff, the symbols follow the sample clock whatever numFrames is
     if (THIS->emissionMode) {
-        int frequence;
-        
-        frequence = [THIS getASCIIFrequency];
-        [THIS emissionSampleCalcul:frequence :numFrames :(Float32 *)buffers->mBuffers[0].mData];
+        if (THIS->emissionSampleTime < 0)
+            THIS->emissionSampleTime = audioTimeStamp->mSampleTime;
+        [THIS messageSampleCalcul:numFrames :(Float32 *)buffers->mBuffers[0].mData];
+    }
+    else {
+        memset(buffers->mBuffers[0].mData, 0, buffers->mBuffers[0].mDataByteSize);
+        *actionFlags |= kAudioUnitRenderAction_OutputIsSilence;
     }
     pthread_mutex_unlock(&THIS->emissionMutex);
     
@@ -295,11 +377,11 @@ OSStatus renderToneCallback(void *userData,
  */
 /** A callBack function use in audio processing (reception)
  
- This function is call during the reception mode. It will request an audio sample from hardware, that we analyse. Before ending the function, you had to set the sample to an empty sample to avoid echo.
+ This function is call during the reception mode. It will request an audio sample from hardware and copy it in sampleRing, the analysis is done by analysisWorker (see analysisWorkerProcess). The render thread must never wait : no lock, no allocation, no Objective-C message here. Before ending the function, you had to set the sample to an empty sample to avoid echo.
  
  @param userData Typically allow to pass parameters to this function (to make the function working pass a SoundFiAudioSession instance)
  @param actionFlags Don't really know what is this but not usefull
- @param audioTimeStamp Don't really know what is this but not usefull
+ @param audioTimeStamp Sample time of the buffer, the same clock as the emission bus : micSampleOffset gives the sample time of the samples of the ring
  @param busNumber The number of the bus the function have to use (automatic)
  @param numFrames The number of frame use to process audio
  @param buffers The buffer that contain the audio sample
@@ -314,44 +396,69 @@ OSStatus renderCallback(void *userData,
     
     SoundFiAudioSession *THIS=(__bridge SoundFiAudioSession*)userData;
     AudioUnit audioUnit=(THIS->audioUnit);
-    int compteur = THIS->compteur;
     
-    //If recepetionMode = TRUE then start recording and analysis stuff
+    //If recepetionMode = TRUE then start recording, the analysis is done by the worker
     if(THIS->receptionMode)
     {
         AudioUnitSampleType *echantillonAudio;
         OSStatus status = AudioUnitRender(audioUnit, actionFlags, audioTimeStamp,1, numFrames, buffers);
         
         if(status != noErr) {
-            NSLog(@"Arror AudioUnitRender %d",(int)status);
             return status;
         }
         
         echantillonAudio=(AudioUnitSampleType*) buffers->mBuffers[0].mData;
         
         fixedPointToSInt16(echantillonAudio, THIS->samplesBuffer, numFrames);
-        
-        [THIS sampleTreatment:numFrames];
-        
-        compteur=THIS->compteur;
-        buffers->mBuffers[0].mData=THIS->emptySample;
-        if(THIS->isInitiate || THIS->geoIsInitiate)
-        {
-            THIS->compteur=compteur+1;
-        }
-        
-        if (THIS->paiementMode) {
-            THIS->compteurProcess++;
-            [THIS checkProcessTimeOut];
-        }
-        [THIS checkTimeOut];
-        
-        
+        THIS->micSampleOffset = audioTimeStamp->mSampleTime - THIS->ringSamples;
+        THIS->ringSamples += sfRingBufferWrite(THIS->sampleRing, THIS->samplesBuffer, numFrames);
     }
     
+    //The mic must not go to the speaker, the mixer only plays the emission bus
+    memset(buffers->mBuffers[0].mData, 0, buffers->mBuffers[0].mDataByteSize);
+    *actionFlags |= kAudioUnitRenderAction_OutputIsSilence;
     return noErr;
 }
 
+
+/**---------------------------------------------------------------------------------------
+ * AnalysisWorkerProcess
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Analysis of one buffer, called by analysisWorker on its thread
+ 
+ This is what renderCallback did before : the detection, the decoding and the time out. The worker give blocks of nbrEchantillon samples (see setReceptionBufferSize:), the time out counters count their samples. In full duplex the emission is first subtracted from the block (echoCancellation).
+ 
+ @param inRefCon The SoundFiAudioSession
+ @param samples The block, valid until the function return
+ @param count Number of samples
+ */
+void analysisWorkerProcess(void *inRefCon, const int16_t *samples, int count) {
+    SoundFiAudioSession *THIS=(__bridge SoundFiAudioSession*)inRefCon;
+    
+    long long first = THIS->workerSampleCount;
+    THIS->workerSampleCount += count;
+    if(!THIS->receptionMode)
+        return;
+    
+    THIS->workerSamples=(SInt16*)samples;
+    if (THIS->fullDuplex)
+        [THIS echoCancellation:count :first];                   //The block is the worker's own buffer, it is changed in place
+    [THIS sampleTreatment:count];
+    
+    if(THIS->isInitiate || THIS->geoIsInitiate)
+    {
+        THIS->compteur=THIS->compteur+count;
+    }
+    
+    if (THIS->paiementMode) {
+        if (THIS->compteurProcess < INT_MAX-count)     //timeOutProcess is INT_MAX between the steps
+            THIS->compteurProcess=THIS->compteurProcess+count;
+        [THIS checkProcessTimeOut];
+    }
+    [THIS checkTimeOut];
+}
+
 /**
  
  */
@@ -363,12 +470,36 @@ OSStatus renderCallback(void *userData,
 }
 
 -(void)initPaiement;
+-(void)initPromotions;                                                              //Setup the promotion cache and its session
+-(void)promotionForSpot:(int)spotId;                                                //Notify the promotion of a spot, from the cache or the server
+-(void)prefetchPromotions;                                                          //Store every promotion of the GPS area in the cache
+-(void)sendNotification:(const SFPromotion*)promotion;                              //Give a promotion to the delegate and pop a notification
 -(void)fftSetup;                                                                    //Setup the fft stuff
+-(void)toneBankSetup;                                                               //Setup the Goertzel filters
+-(void)basebandSetup;                                                               //Setup the baseband front end
+-(void)interpolatedSetup;                                                           //Setup the interpolated peak estimator
+-(void)oscillatorSetup;                                                             //Setup the emission oscillator
+-(void)multiToneSetup;                                                              //Setup the multi tone decoders
+-(void)chirpSetup;                                                                  //Setup the chirp preamble
+-(void)echoCancellerSetup;                                                          //Setup the full duplex reference buffers
+-(void)lexiconSetup;                                                                //Map the vocabulary of the phase 6
+-(void)echoCancellation:(int)numFrames : (long long)first;                          //Subtract the emission from the block of the worker
+-(BOOL)acceptMode:(int)mode;                                                        //A start tone of this mode can be followed
+-(BOOL)chirpReceptionSampleTreatment:(int)numFrames;                                //Matched filter of the chirp preamble
+-(void)messageSampleCalcul:(int)numFrames : (Float32 *)buffer;                      //Emission of the message by the encoder
+-(void)multiToneReceptionSampleTreatment:(int)numFrames;                            //Reception in multi tone mode
+-(void)resetMessageProgress;                                                        //A new message starts, nothing is given to the delegate yet
+-(void)messageProgress;                                                             //Give the beginning of the message in progress to the delegate
+-(void)dropMessageProgress;                                                         //The message given in progress is dropped
+-(void)setReceptionBufferSize:(int)size;                                            //Change the analysis block size if the detector need it
+-(void)receptionSampleTreatment;                                                    //Call the reception methods of the active modes
 -(void)setupCallback;                                                               //Setup the callback variable
 -(int)initAudioStreams;                                                             //Setup the Audio route and audio units
 -(int)initAudioSession;                                                             //Setup the audioSession spec
 
 -(int)stopProcessingAudio;                                                          //Stop audio processing
+-(void)startGraph;                                                                  //Start the duplex graph if it is not running
+-(int)startEmission:(NSData*)payload : (SFFrameType)type;                           //Send a payload, a frame of this type in multi tone mode
 
 -(void)startAnalysis;                                                               //Analysis of the received message
 
@@ -404,6 +535,7 @@ OSStatus renderCallback(void *userData,
  This function init all the variables of the engine. By default, the messaging and localisation mode are enable, the engine is configure to allow background tasking by default (that can be change later by the user). This fonction will call every sub init methods.
  
  - initGeoloc
+ - initPromotions
  - initAudioSession
  - setupCallback
  - fftSetup
@@ -453,14 +585,24 @@ OSStatus renderCallback(void *userData,
     sampleFrequency=1000;
     
     [self initGeoloc];
+    [self initPromotions];
     [self initPaiement];
     [self initAudioSession];
     [self setupCallback];
     [self fftSetup];
+    [self toneBankSetup];
+    [self basebandSetup];
+    [self interpolatedSetup];
+    [self oscillatorSetup];
+    [self multiToneSetup];
+    [self chirpSetup];
+    [self echoCancellerSetup];
+    [self lexiconSetup];
     [self initAudioStreams];
     
     pthread_mutex_init(&emissionMutex, NULL);
-    nbCaracRepeat=0;
+    pthread_mutex_init(&echoMutex, NULL);
+    [self setMultiToneMode:SF_MFSK_SINGLE_TONE];
     
     [self startAudioUnit:SFReceivingMode:NULL];
     
@@ -477,7 +619,7 @@ OSStatus renderCallback(void *userData,
  @see init
  */
 -(void)initPaiement{
-    timeOutProcess=20000;
+    timeOutProcess=INT_MAX;
 #if DEBUG
     myID=@"{id_user:\"134513455\"";
     cryptedPassAES=@"tRbVQ9KjTWqcOQ9r7pyCUI7hkMdg8f13lISsT0H6y9s=";
@@ -507,12 +649,7 @@ OSStatus renderCallback(void *userData,
     [zoneArray addObject:@"Cuisine"];
 #endif
     
-    curentFrequencyData = malloc(sizeof(int)*25);
-    for (int i=0; i<25; i++) {curentFrequencyData[i]=1;}
-    
-    [self zoneDetection:curentFrequencyData];
-    
-    nbrVal=0;
+    sfZoneEstimatorReset(&zoneEstimator);
     currentPos=@"Aucune";
     lastPos=@"Aucune";
     
@@ -536,6 +673,43 @@ OSStatus renderCallback(void *userData,
 }
 
 
+/**---------------------------------------------------------------------------------------
+ * InitPromotions
+ *  ---------------------------------------------------------------------------------------
+ */
+
+/** This method deal with the initilisation of the promotion cache
+ 
+ The promotions of the spots are kept in promotionCache (SFPromotionCache, parsed once when they are received) with their ETag and their expiry date, and written in Library/Caches/SoundFiPromotions.bin: the promotions of the last area are there at the next launch, even without network. Every access to the cache is done on promotionQueue, the completion handlers of promotionSession included.
+ 
+ @see promotionForSpot:
+ @see prefetchPromotions
+ @see init
+ */
+-(void)initPromotions{
+    promotionServer=@"http://mynetshare.fr/";
+    promotionQueue=dispatch_queue_create("fr.soundfi.promotions", DISPATCH_QUEUE_SERIAL);
+    promotionCache=sfPromotionCacheCreate(SF_PROMOTION_CAPACITY);
+    
+    //Pas de NSURLCache : les 304 doivent arriver jusqu'à promotionCache
+    NSURLSessionConfiguration *configuration=[NSURLSessionConfiguration ephemeralSessionConfiguration];
+    configuration.URLCache=nil;
+    configuration.requestCachePolicy=NSURLRequestReloadIgnoringLocalCacheData;
+    promotionSession=[NSURLSession sessionWithConfiguration:configuration];
+    
+    NSString *caches=[NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) firstObject];
+    promotionPath=[caches stringByAppendingPathComponent:@"SoundFiPromotions.bin"];
+    dispatch_async(promotionQueue, ^{
+        int count=sfPromotionCacheLoad(promotionCache, [promotionPath fileSystemRepresentation]);
+#if DEBUG
+        NSLog(@"%d promotions en cache",count);
+#else
+        (void)count;
+#endif
+    });
+}
+
+
 /**---------------------------------------------------------------------------------------
  * InitAudioStream
  *  ---------------------------------------------------------------------------------------
@@ -543,7 +717,7 @@ OSStatus renderCallback(void *userData,
 
 /** This method deal with the initilisation of the audioStream, mainly the AudioGraph
  
- This method represent mainly the initialisation of the reception.
+ This method represent the initialisation of the reception and of the emission.
  It set all the parameters of stream including IO and mixer and the graph. This function proceed in 6 step :
  
  - Define the ASBD (Audio Stream Basic Description)
@@ -553,7 +727,7 @@ OSStatus renderCallback(void *userData,
  - Configure AudioUnit (including callback setup)
  - Initialize graph
  
- NOTE : The mixer is not really use here but implement for futur feature.
+ The mixer has 2 input bus : the emission (renderToneCallback, Float32) on bus 0 and the mic (renderCallback, which only feed the analysis and give silence) on bus 1. The graph is started once and runs in both modes, the emission only flip emissionMode.
  
  @see init
  @return 1 un case of error, else 0
@@ -698,18 +872,19 @@ OSStatus renderCallback(void *userData,
                           sizeof (maximumFramesPerSlice)
                           );
     
-    //Activitate input bus 1, done here but if we increase the number
-    // of output, this must be done with the UI
+    //Activitate input bus 0 (emission) and 1 (mic)
     AudioUnitParameterValue isOn;
     isOn=kMultiChannelMixerParam_Enable;
-    AudioUnitSetParameter (
-                           mixerUnit,
-                           kMultiChannelMixerParam_Enable,
-                           kAudioUnitScope_Input,
-                           1,
-                           isOn,
-                           0
-                           );
+    for (AudioUnitElement bus=0; bus<busCount; bus++) {
+        AudioUnitSetParameter (
+                               mixerUnit,
+                               kMultiChannelMixerParam_Enable,
+                               kAudioUnitScope_Input,
+                               bus,
+                               isOn,
+                               0
+                               );
+    }
     //Set the monoStream format
     AudioUnitSetProperty (
                           mixerUnit,
@@ -720,6 +895,25 @@ OSStatus renderCallback(void *userData,
                           sizeof (streamDescription)
                           );
     
+    //The emission bus take the Float32 samples of the encoder
+    AudioStreamBasicDescription emissionDescription;
+    emissionDescription.mSampleRate       = sampleRate;
+    emissionDescription.mFormatID         = kAudioFormatLinearPCM;
+    emissionDescription.mFormatFlags      = kAudioFormatFlagsNativeFloatPacked | kAudioFormatFlagIsNonInterleaved;
+    emissionDescription.mBytesPerPacket   = 4;
+    emissionDescription.mFramesPerPacket  = 1;
+    emissionDescription.mBytesPerFrame    = 4;
+    emissionDescription.mChannelsPerFrame = 1;
+    emissionDescription.mBitsPerChannel   = 4 * 8;
+    AudioUnitSetProperty (
+                          mixerUnit,
+                          kAudioUnitProperty_StreamFormat,
+                          kAudioUnitScope_Input,
+                          0,
+                          &emissionDescription,
+                          sizeof (emissionDescription)
+                          );
+    
     //Set the sample rate
     AudioUnitSetProperty (
                           mixerUnit,
@@ -740,6 +934,15 @@ OSStatus renderCallback(void *userData,
     err = AUGraphSetNodeInputCallback (myGraph,mixerNode,1,&inputCallbackStruct); //1 => input du mixer  0 => sortie
     if(err!=noErr){NSLog(@"Error NodeInputCallBack");}
     
+    //And one in the input bus 0 for the emission
+    AURenderCallbackStruct emissionCallbackStruct;
+    
+    emissionCallbackStruct.inputProc        = renderToneCallback;
+    emissionCallbackStruct.inputProcRefCon  = (__bridge void *)(self);
+    
+    err = AUGraphSetNodeInputCallback (myGraph,mixerNode,0,&emissionCallbackStruct);
+    if(err!=noErr){NSLog(@"Error NodeInputCallBack emission");}
+    
     //  connect the output of the mixer with the output of the IOunit
     // This is mandatory, else the mixer won't need any sample
     // and your callback won't be call.
@@ -799,67 +1002,200 @@ OSStatus renderCallback(void *userData,
         NSLog(@"Error - unable to allocate FFT setup buffers" );
     }
     
-    //Call this two function to do a little trick
+    // phase vocoders, one for each value of nbrEchantillon so nothing is allocated in the audio thread
+    // (osamp 4, only the bins k>100 like smb2PitchShift)
+    vocoder256 = sfVocoderCreate(256, 4, sampleRate, 101);
+    vocoder2048 = sfVocoderCreate(2048, 4, sampleRate, 101);
+    lastVocoder = NULL;
+    if (vocoder256 == NULL || vocoder2048 == NULL) {
+        NSLog(@"Error - unable to allocate the phase vocoder" );
+    }
+    
+    // beacons of the geolocalisation, read in the spectrum of vocoder2048 (one per buffer of 2048)
+    beaconScanner = sfBeaconScannerCreate(2048, sampleRate, 2048/sampleRate);
+    if (beaconScanner == NULL) {
+        NSLog(@"Error - unable to allocate the beacon scanner" );
+    }
+    
+    // noise floor of the 17-21.5 kHz bins, one low accuracy fft every maxFrames samples
+    float freqPerBin = sampleRate/maxFrames;
+    noiseFloor = sfNoiseFloorCreate((int)ceilf(SF_BASEBAND_LOW_FREQUENCY/freqPerBin), (int)(SF_BASEBAND_HIGH_FREQUENCY/freqPerBin), maxFrames/sampleRate);
+    noiseMagnitudes = (float*)calloc(fftNOver2, sizeof(float));
+    if (noiseFloor == NULL) {
+        NSLog(@"Error - unable to allocate the noise floor" );
+    }
+    
+    //Call this function to do a little trick (the vocoder has nothing to initialise anymore)
     fftGetFrequencyLowAccuracy( (__bridge void*)self, maxFrames, samplesBuffer);
-    fftGetFrequencyHighAccuracy( (__bridge void*)self, maxFrames, samplesBuffer);
 }
 
 
 /**---------------------------------------------------------------------------------------
- * EmissionSetup
+ * ToneBankSetup
  *  ---------------------------------------------------------------------------------------
  */
-
-/** Like an emissionInit, this function setup the audioUnit for emission
+/** Create the Goertzel filters use by toneBankGetFrequency.
+ 
+ One filter for each frequency of the band plan : the start tone, the 95 caracters, the stop tone and the geo spots.
  
- This method perform the initialisation in 4 steps :
+ @see init
+ @see setDetectorMode:
+ */
+-(void)toneBankSetup {
+    float frequencies[SF_TONE_COUNT];
+    
+    sfBandPlanFrequencies(frequencies);
+    toneBank = sfToneBankCreate(sampleRate, frequencies, SF_TONE_COUNT, SF_TONEBANK_DEFAULT_LENGTH);
+    if (toneBank == NULL) {
+        NSLog(@"Error - unable to allocate the tone bank" );
+    }
+    detectorMode = SFDetectorFFT;
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * BasebandSetup
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Create the front end and the Goertzel filters use by basebandGetFrequency.
  
- - Create the component description
- - Find the output component
- - Create the ASBD (Audio Stream Basic Description)
- - Assign the component to the AudioUnit
+ The filters are the band plan frequencies moved by the downconverter (minus its centre frequency), at its output sample rate. The window is 1024 samples of the original stream, 128 once decimated.
  
  @see init
+ @see setDetectorMode:
  */
--(void)emissionSetup {
-    //Configure the description for the output component
-    AudioComponentDescription DescComposantSortie;
-    DescComposantSortie.componentType = kAudioUnitType_Output;
-    DescComposantSortie.componentSubType = kAudioUnitSubType_RemoteIO;
-    DescComposantSortie.componentManufacturer = kAudioUnitManufacturer_Apple;
-    DescComposantSortie.componentFlags = 0;
-    DescComposantSortie.componentFlagsMask = 0;
+-(void)basebandSetup {
+    float frequencies[SF_TONE_COUNT];
     
-    //Find a component matching with the description
-    AudioComponent composantSortie = AudioComponentFindNext(NULL, &DescComposantSortie);
+    downconverter = sfDownconverterCreate(sampleRate, SF_BASEBAND_LOW_FREQUENCY, SF_BASEBAND_HIGH_FREQUENCY, SF_BASEBAND_DECIMATION);
+    if (downconverter == NULL) {
+        NSLog(@"Error - unable to allocate the baseband front end" );
+        return;
+    }
     
-    //Assign the instance to the uniteSon
-    AudioComponentInstanceNew(composantSortie, &emissionUnit);
+    sfBandPlanFrequencies(frequencies);
+    for (int i=0; i<SF_TONE_COUNT; i++) {
+        frequencies[i] -= downconverter->centreFrequency;
+    }
+    basebandToneBank = sfToneBankCreate(downconverter->outputRate, frequencies, SF_TONE_COUNT, SF_TONEBANK_DEFAULT_LENGTH/SF_BASEBAND_DECIMATION);
     
-    //Create the callbackStruct and assign it to the RenderTone function
-    //inputProcRefCon=self allow us to acces information in the RenderTone function
-    AURenderCallbackStruct input;
-    input.inputProc = renderToneCallback;
-    input.inputProcRefCon = (__bridge void *)(self);
-    AudioUnitSetProperty(emissionUnit,kAudioUnitProperty_SetRenderCallback,kAudioUnitScope_Input,0,&input,sizeof(input));
+    basebandRe = (float*)malloc((2048/SF_BASEBAND_DECIMATION+1) * sizeof(float));
+    basebandIm = (float*)malloc((2048/SF_BASEBAND_DECIMATION+1) * sizeof(float));
     
+    if (basebandToneBank == NULL) {
+        NSLog(@"Error - unable to allocate the baseband tone bank" );
+    }
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * InterpolatedSetup
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Create the peak estimator use by interpolatedGetFrequency.
+ 
+ The search is limited to the band of the baseband front end (17-21.5 kHz), every SoundFi tone is in it.
+ 
+ @see init
+ @see setDetectorMode:
+ */
+-(void)interpolatedSetup {
+    peakEstimator = sfPeakEstimatorCreate(SF_PEAK_DEFAULT_SIZE, SF_PEAK_DEFAULT_HOP, sampleRate, SF_BASEBAND_LOW_FREQUENCY, SF_BASEBAND_HIGH_FREQUENCY, SFInterpolationJacobsen);
+    if (peakEstimator == NULL) {
+        NSLog(@"Error - unable to allocate the peak estimator" );
+    }
+}
+
+
+/**---------------------------------------------------------------------------------------
+ * OscillatorSetup
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Create the oscillator use by emissionSampleCalcul.
+ 
+ The start tone, the 95 caracters and the stop tone are precomputed for buffers of 256 frames, the IO buffers of SF_IO_BUFFER_FRAMES are rendered in several pieces.
+ 
+ @see init
+ */
+-(void)oscillatorSetup {
+    float frequencies[SF_TONE_COUNT];
     
-    //ASBD configuration
-    AudioStreamBasicDescription streamFormat;
-    streamFormat.mSampleRate = sampleRate;
-    streamFormat.mFormatID = kAudioFormatLinearPCM;
-    streamFormat.mFormatFlags = kAudioFormatFlagsNativeFloatPacked | kAudioFormatFlagIsNonInterleaved;
-    streamFormat.mBytesPerPacket = 4;
-    streamFormat.mFramesPerPacket = 1;
-    streamFormat.mBytesPerFrame = 4;
-    streamFormat.mChannelsPerFrame = 1;
-    streamFormat.mBitsPerChannel = 4 * 8;
+    sfBandPlanFrequencies(frequencies);
+    oscillator = sfOscillatorCreate(sampleRate, SF_OSCILLATOR_DEFAULT_BLOCK, frequencies, SF_TONE_STOP+1);
+    if (oscillator == NULL) {
+        NSLog(@"Error - unable to allocate the emission oscillator" );
+    }
+}
+
+
+/** Create the decoders of the multi tone modes, one per mode of sfMultiToneModes, and the buffer of the emission.
+ 
+ The encoder itself is created by setMultiToneMode: when the mode is chosen, the single tone one by init.
+ 
+ @see init
+ */
+-(void)multiToneSetup {
+    multiToneMode=SF_MFSK_SINGLE_TONE;
+    for (int mode=0; mode<SF_MFSK_MODE_COUNT; mode++) {
+        multiToneDecoders[mode] = sfMultiToneDecoderCreate(sampleRate, &sfMultiToneModes[mode]);
+        if (multiToneDecoders[mode] == NULL) {
+            NSLog(@"Error - unable to allocate the decoder of the mode %d", mode);
+        }
+    }
+    encoderSamples = malloc(SF_EMISSION_FRAMES*sizeof(float));
+}
+
+
+/** Create the matched filter of the reception, the encoders send the chirp themselves (sfEmissionPlanSetChirp). The preamble is off until setChirpPreamble:.
+ 
+ The chirp lasts SF_CHIRP_LENGTH samples of 44100 Hz, in whole callbacks of 256 frames.
+ 
+ @see init
+ */
+-(void)chirpSetup {
+    chirpLength = (int)lroundf(SF_CHIRP_LENGTH*sampleRate/44100.f/SF_EMISSION_FRAMES)*SF_EMISSION_FRAMES;
     
-    //Put the ASBD to the uniteSon
-    AudioUnitSetProperty(emissionUnit,kAudioUnitProperty_StreamFormat,kAudioUnitScope_Input,0,&streamFormat,sizeof(AudioStreamBasicDescription));
+    chirpPreamble=FALSE;
+    chirpDetector = sfChirpDetectorCreate(sampleRate, chirpLength, SF_CHIRP_MODE_FRAMES);
+    if (chirpDetector == NULL) {
+        NSLog(@"Error - unable to allocate the chirp preamble");
+    }
+}
+
+
+/** The buffers of the full duplex, the canceller itself is created by setFullDuplex: with the latency of the route in use.
+ 
+ The worker give blocks of 2048 samples at most, the reference of a block is as long.
+ 
+ @see init
+ */
+-(void)echoCancellerSetup {
+    fullDuplex=FALSE;
+    emissionSampleTime=-1;
+    echoSamples = malloc(SF_EMISSION_FRAMES*sizeof(float));
+    echoReference = malloc(2048*sizeof(float));
 }
 
 
+/**---------------------------------------------------------------------------------------
+ * LexiconSetup
+ *  ---------------------------------------------------------------------------------------
+ */
+
+/** Map the vocabulary of the phase 6 (SoundFiLexicon.bin, written by the sflexicon tool from SoundFiLexicon.txt). The file is mapped, not read: nothing to parse, the pages are loaded the first time a message is corrected.
+ 
+ @see analysisPhase6:
+ @see init
+ */
+-(void)lexiconSetup {
+    NSString *path=[[NSBundle mainBundle] pathForResource:@"SoundFiLexicon" ofType:@"bin"];
+    lexicon = path ? sfLexiconOpen([path fileSystemRepresentation]) : NULL;
+#if DEBUG
+    if (lexicon==NULL)
+        NSLog(@"No vocabulary, the phase 6 is skipped");
+#endif
+}
+
 /**---------------------------------------------------------------------------------------
  * CallBack setup
  *  ---------------------------------------------------------------------------------------
@@ -878,15 +1214,22 @@ OSStatus renderCallback(void *userData,
     receptionMode=FALSE;
     emissionMode=FALSE;
     
-    emptySample=malloc(nbrEchantillon*sizeof(AudioUnitSampleType));
-    for (int i=0; i<nbrEchantillon; i++) {
-        emptySample[i]=0;
+    samplesBuffer=(SInt16*)malloc(SF_IO_BUFFER_FRAMES *sizeof(float));
+    for (int i=0; i<SF_IO_BUFFER_FRAMES; i++) {
+        samplesBuffer[i]=0.;
     }
     
-    samplesBuffer=(SInt16*)malloc(nbrEchantillon *sizeof(float));
-    for (int i=0; i<nbrEchantillon; i++) {
-        samplesBuffer[i]=0.;
+    // The render thread only fill the ring, the worker empty it by buffers of nbrEchantillon
+    sampleRing=sfRingBufferCreate(SF_RING_DEFAULT_CAPACITY);
+    analysisWorker=sfAnalysisWorkerCreate(sampleRing, sampleRate, 2048, analysisWorkerProcess, (__bridge void*)self);
+    if (analysisWorker != NULL) {
+        sfAnalysisWorkerSetBlockSize(analysisWorker, nbrEchantillon);
+        sfAnalysisWorkerStart(analysisWorker);
     }
+#if DEBUG
+    else
+        NSLog(@"Analysis worker not created");
+#endif
 }
 
 
@@ -912,8 +1255,8 @@ OSStatus renderCallback(void *userData,
     
     [mySession setPreferredSampleRate: 44100.0 error: &audioSessionError];
     
-    [mySession setPreferredIOBufferDuration: ((float)nbrEchantillon/sampleRate) error: &audioSessionError]; //Number of sample must depend of the mode WALE 2048
-    // and so the fft size in the code 256 -> 2048 everywhere
+    // The IO buffer is the same for the life of the graph, emission and reception: the worker cuts it in blocks of nbrEchantillon
+    [mySession setPreferredIOBufferDuration: ((float)SF_IO_BUFFER_FRAMES/sampleRate) error: &audioSessionError];
     NSNotificationCenter *nc = [NSNotificationCenter defaultCenter];
     [nc addObserver:self selector:@selector(interruptionDetected:) name:AVAudioSessionInterruptionNotification object:nil];
     
@@ -928,81 +1271,259 @@ OSStatus renderCallback(void *userData,
 
 -(void)emissionSampleCalcul:(int)frequence : (int)numFrames : (Float32 *)buffer
 {
-    double theta_increment = 2.0 * M_PI * frequence / sampleRate;     // θ(n) = 2πƒ n / r
-    
-    //This portion is used for fade In and fade Out
-    if (frequence == 17800 && amplitude < 0.8)
-        amplitude+=0.01;
-    else if (frequence == 19728 && amplitude > 0)
-        amplitude-=0.01;
-    
-    //Sinusoïde création
-    for (UInt32 frame = 0; frame < numFrames; frame++)
-    {
-        buffer[frame] = 0;
-        buffer[frame] = sin(theta) * amplitude;
-        
-        theta += theta_increment;
-        if (theta > 2.0 * M_PI)
-        {
-            theta -= 2.0 * M_PI;
-        }
-    }
+    //This portion is used for fade In and fade Out, the messages do the same in SFMessageEncoder
+    if (frequence == SF_START_FREQUENCY && amplitude < SF_EMISSION_AMPLITUDE)
+        amplitude+=SF_EMISSION_FADE_STEP;
+    else if (frequence == SF_STOP_FREQUENCY && amplitude > 0)
+        amplitude-=SF_EMISSION_FADE_STEP;
+    
+    //Sinusoïde création, the phase follow from the last buffer
+    sfOscillatorRender(oscillator, frequence, amplitude, buffer, numFrames);
 }
 
 
 
--(int)getASCIIFrequency
+/** Send the message of the encoder, in the single tone mode as in the multi tone modes.
+ 
+ The encoder renders callbacks of SF_EMISSION_FRAMES frames on its own sample clock, they are cut or joined to fill the buffer: the length of the symbols doesn't depend on the IO buffer size the hardware gives.
+ */
+-(void)messageSampleCalcul:(int)numFrames : (Float32 *)buffer
 {
-    int frequence;
-    
-    [self.delegate progressStatut:(((float)compteur)/[myMessage length])];
-    
-    if (initSequence) {
-        if (nbrRepeatInit>=25) {
-            initSequence=FALSE;
-        }
-        nbrRepeatInit++;
-        return 17800;
-    }
-    
-    if (compteur < [myMessage length]) {
-        frequence=18000 +(((int)[myMessage characterAtIndex:compteur]-32)*18);
-    }
-    else {
-        if (emissionCanBeStop) {
-            emissionCanBeStop=FALSE;
-            [self.delegate finishEmission];
-            dispatch_after(dispatch_time(DISPATCH_TIME_NOW,1), dispatch_get_main_queue(), ^{
-                [self relaunchReception];
-            });
+    const SFEmissionPlan *plan = &messageEncoder->plan;
+    int preamble = messageEncoder->chirpCallbacks + plan->initRepeat;
+    int symbolCallbacks = MAX(messageEncoder->callbackCount - preamble - plan->stopRepeat, 1);
+    
+    [self.delegate progressStatut:MIN(MAX((float)(messageEncoder->callback - preamble)/symbolCallbacks, 0.f), 1.f)];
+    
+    for (int frame=0; frame<numFrames; ) {
+        if (encoderOffset >= plan->frames) {
+            if (sfMessageEncoderRender(messageEncoder, encoderSamples) == 0) {
+                //The stop symbol is sent, silence until the emission unit is stopped
+                memset(buffer+frame, 0, (numFrames-frame)*sizeof(Float32));
+                if (emissionCanBeStop) {
+                    emissionCanBeStop=FALSE;
+                    [self.delegate finishEmission];
+                    dispatch_after(dispatch_time(DISPATCH_TIME_NOW,1), dispatch_get_main_queue(), ^{
+                        [self relaunchReception];
+                    });
 #if DEBUG
-            NSLog(@"STOP");
+                    NSLog(@"STOP");
 #endif
+                }
+                return;
+            }
+            encoderOffset=0;
         }
-        return 19728;
+        int count = MIN(numFrames-frame, plan->frames-encoderOffset);
+        memcpy(buffer+frame, encoderSamples+encoderOffset, count*sizeof(Float32));
+        frame+=count;
+        encoderOffset+=count;
     }
+}
+
+
+
+-(void)setMultiToneMode:(int)mode
+{
+    if (emissionMode || (mode != SF_MFSK_SINGLE_TONE && (mode < 0 || mode >= SF_MFSK_MODE_COUNT)))
+        return;
     
-    if (nbCaracRepeat==4) {
-        compteur = compteur+1;
-        nbCaracRepeat = 0;
+    SFEmissionPlan plan;
+    sfEmissionPlanDefault(&plan);
+    sfEmissionPlanSetMode(&plan, mode);
+    plan.sampleRate = sampleRate;
+    if (chirpPreamble)
+        sfEmissionPlanSetChirp(&plan, chirpLength);
+    SFMessageEncoder *encoder = sfMessageEncoderCreate(&plan);
+    if (encoder == NULL) {
+        NSLog(@"Error - unable to allocate the encoder of the mode %d", mode);
+        return;
     }
-    else
-        nbCaracRepeat=nbCaracRepeat+1;
     
-    return frequence;
+    //The same emission rendered on the worker for the echo canceller, in the full duplex modes only
+    SFMessageEncoder *echo = NULL;
+    if (sfMultiToneDuplexPeer(mode) != SF_MFSK_SINGLE_TONE)
+        echo = sfMessageEncoderCreate(&plan);
+    
+    pthread_mutex_lock(&emissionMutex);
+    SFMessageEncoder *previous = messageEncoder;
+    messageEncoder = encoder;
+    multiToneMode = mode;
+    pthread_mutex_unlock(&emissionMutex);
+    sfMessageEncoderDestroy(previous);
+    
+    pthread_mutex_lock(&echoMutex);
+    previous = echoEncoder;
+    echoEncoder = echo;
+    echoRunning = FALSE;
+    if (echo == NULL)
+        fullDuplex = FALSE;
+    pthread_mutex_unlock(&echoMutex);
+    sfMessageEncoderDestroy(previous);
+}
+
+
+
+-(void)setFullDuplex:(BOOL)enable
+{
+    if (emissionMode)
+        return;
+    if (!enable) {
+        fullDuplex=FALSE;
+        return;
+    }
+    if (sfMultiToneDuplexPeer(multiToneMode) == SF_MFSK_SINGLE_TONE)
+        [self setMultiToneMode:SF_MFSK_DUPLEX_LOW_MODE];
+    
+    //The echo comes back after the output and the input latency, the taps start a bit before
+    int delay = (int)(([mySession inputLatency]+[mySession outputLatency])*sampleRate) - SF_ECHO_DEFAULT_TAPS/4;
+    SFEchoCanceller *canceller = sfEchoCancellerCreate(SF_ECHO_DEFAULT_TAPS, MAX(delay, 0), SF_ECHO_DEFAULT_STEP);
+    if (canceller == NULL || echoEncoder == NULL) {
+        NSLog(@"Error - unable to allocate the echo canceller");
+        sfEchoCancellerDestroy(canceller);
+        return;
+    }
+    
+    pthread_mutex_lock(&echoMutex);
+    SFEchoCanceller *previous = echoCanceller;
+    echoCanceller = canceller;
+    fullDuplex = TRUE;
+    pthread_mutex_unlock(&echoMutex);
+    sfEchoCancellerDestroy(previous);
+#if DEBUG
+    NSLog(@"Full duplex mode %d, echo delay %d samples", multiToneMode, delay);
+#endif
+}
+
+
+
+-(void)setChirpPreamble:(BOOL)enable
+{
+    if (emissionMode || (enable && chirpDetector == NULL))
+        return;
+    
+    chirpPreamble=enable;
+    sfChirpDetectorReset(chirpDetector);
+    
+    //The encoder is created again with the preamble
+    [self setMultiToneMode:multiToneMode];
+}
+
+
+
+-(int)getASCIIFrequency
+{
+    //The callback in encoderSamples, or the next one once it is sent
+    int callback = encoderOffset < messageEncoder->plan.frames ? messageEncoder->callback-1 : messageEncoder->callback;
+    
+    return sfMessageEncoderFrequency(messageEncoder, callback);
 }
 
 
 #pragma mark - Reception Methods
 
+/**---------------------------------------------------------------------------------------
+ * EchoCancellation
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Subtract the emission from the block of the worker (full duplex).
+ 
+ echoEncoder render the emission a second time on the worker, started with the same frame when the worker see a new emission. The samples of the ring have the sample time of the mic (micSampleOffset), the emission started at emissionSampleTime on the same clock : the reference of each sample of the block is the sample of the emission sent at the same time, the canceller add the latency. Before and after the emission the reference is silence, the end of the echo is still removed.
+ 
+ @param numFrames Frames of the block in workerSamples
+ @param first Number of the first sample of the block in sampleRing
+ */
+-(void)echoCancellation:(int)numFrames : (long long)first {
+    pthread_mutex_lock(&echoMutex);
+    
+    //A snapshot of the emission only, renderToneCallback takes emissionMutex on every callback : the frame is encoded (Reed-Solomon, tone table) out of it
+    pthread_mutex_lock(&emissionMutex);
+    int count = emissionCount;
+    SFFrameType type = emissionType;
+    Float64 start = emissionSampleTime;
+    NSData *message = encodedMessage;       //Immutable, kept alive by this reference when startEmission replace it
+    pthread_mutex_unlock(&emissionMutex);
+
+    if (echoEncoder != NULL && echoEmission != count && start >= 0) {
+        echoEmission = count;
+        sfMessageEncoderStartFrame(echoEncoder, type, [message bytes], (int)[message length]);
+        echoOffset = echoEncoder->plan.frames;
+        echoIndex = 0;
+        echoRunning = TRUE;
+    }
+
+    //Index in the emission of the first sample of the block
+    long long index = (long long)llround(first + micSampleOffset - start);
+    for (int n=0; n<numFrames; n++, index++) {
+        echoReference[n] = 0;
+        if (!echoRunning || index < echoIndex)
+            continue;
+        while (echoIndex <= index) {
+            if (echoOffset >= echoEncoder->plan.frames) {
+                if (sfMessageEncoderRender(echoEncoder, echoSamples) == 0) {
+                    echoRunning = FALSE;
+                    break;
+                }
+                echoOffset = 0;
+            }
+            echoOffset++;
+            echoIndex++;
+        }
+        if (echoRunning)
+            echoReference[n] = echoSamples[echoOffset-1];
+    }
+    sfEchoCancellerProcess(echoCanceller, echoReference, workerSamples, numFrames);
+    
+    pthread_mutex_unlock(&echoMutex);
+}
+
+
+
+/** In full duplex the receiver never follows its own mode, the canceller leaves enough of the emission to be heard as a start tone */
+-(BOOL)acceptMode:(int)mode {
+    return mode == SF_MFSK_SINGLE_TONE || (multiToneDecoders[mode] != NULL && !(fullDuplex && mode == multiToneMode));
+}
+
 -(void)sampleTreatment:(int)numFrames {
-    if (!(isInitiate || geoIsInitiate)) {
-        fftGetFrequencyLowAccuracy( (__bridge void*)self, numFrames, samplesBuffer);    //Background FFT
+    if (multiToneReceiving != NULL) {
+        // A multi tone message is received, its decoder has its own filters
+        [self multiToneReceptionSampleTreatment:numFrames];
+        return;
+    }
+    
+    if (chirpPreamble && !isInitiate && (simpleMessagingMode || paiementMode)) {
+        // The chirp is searched before the detectors, they don't see the preamble
+        if ([self chirpReceptionSampleTreatment:numFrames])
+            return;
+    }
+    
+    if (detectorMode == SFDetectorInterpolated) {
+        // The buffer stay at 2048 frames, it's cut in slices of 256 frames so the reception methods
+        // see the same flow of frequencies as with the 256 frames buffers of the messaging.
+        for (int offset=0; offset<numFrames; offset+=SF_PEAK_DEFAULT_HOP) {
+            int frames = MIN(SF_PEAK_DEFAULT_HOP, numFrames-offset);
+            interpolatedGetFrequency( (__bridge void*)self, frames, workerSamples+offset);  //Single FFT + interpolation
+            [self receptionSampleTreatment];
+        }
+        return;
+    }
+    
+    if (detectorMode == SFDetectorToneBank) {
+        toneBankGetFrequency( (__bridge void*)self, numFrames, workerSamples);          //Goertzel filters, background and foreground
+    }
+    else if (detectorMode == SFDetectorBaseband) {
+        basebandGetFrequency( (__bridge void*)self, numFrames, workerSamples);          //Front end + Goertzel filters
+    }
+    else if (!(isInitiate || geoIsInitiate)) {
+        fftGetFrequencyLowAccuracy( (__bridge void*)self, numFrames, workerSamples);    //Background FFT
     }
     else {
-        fftGetFrequencyHighAccuracy( (__bridge void*)self, numFrames, samplesBuffer);   //Foreground FFT
+        fftGetFrequencyHighAccuracy( (__bridge void*)self, numFrames, workerSamples);   //Foreground FFT
     }
+    [self receptionSampleTreatment];
+}
+
+-(void)receptionSampleTreatment {
     if (geolocalisationMode)
         [self geolocalisationReceptionSampleTreatment];
     
@@ -1013,6 +1534,48 @@ OSStatus renderCallback(void *userData,
         [self paiementReceptionSampleTreatment];
 }
 
+-(void)setDetectorMode:(SFDetectorMode)mode {
+    if (mode == SFDetectorToneBank && toneBank == NULL)
+        return;
+    if (mode == SFDetectorBaseband && basebandToneBank == NULL)
+        return;
+    if (mode == SFDetectorInterpolated && peakEstimator == NULL)
+        return;
+    if (mode == SFDetectorToneBank && detectorMode != SFDetectorToneBank)
+        sfToneBankReset(toneBank);
+    if (mode == SFDetectorBaseband && detectorMode != SFDetectorBaseband) {
+        sfDownconverterReset(downconverter);
+        sfToneBankReset(basebandToneBank);
+    }
+    if (mode == SFDetectorInterpolated && detectorMode != SFDetectorInterpolated)
+        sfPeakEstimatorReset(peakEstimator);
+    detectorMode = mode;
+}
+
+-(void)setDetectionMargin:(float)margin {
+    sfNoiseFloorSetMargin(noiseFloor, margin);
+}
+
+-(float)signalToNoiseRatio:(int)frequency {
+    return sfNoiseFloorSnr(noiseFloor, (int)(frequency*fftBufferCapacity/sampleRate + 0.5f));
+}
+
+/** Change the size of the blocks the worker gives to the reception.
+ 
+ The FFT detectors need 256 frames blocks to follow a message and 2048 frames ones to save the battery the rest of the time. With SFDetectorInterpolated the detection does not depend on the block size, the block is kept at 2048 frames and cut in slices by sampleTreatment. Only the worker is changed, it is called from its thread : the IO buffer of the session stays at SF_IO_BUFFER_FRAMES, the ring between the render thread and the worker cuts it in blocks of any size.
+ 
+ @param size 256 or 2048
+ */
+-(void)setReceptionBufferSize:(int)size {
+    if (detectorMode == SFDetectorInterpolated) {
+        if (nbrEchantillon == 2048)
+            return;
+        size = 2048;
+    }
+    nbrEchantillon=size;
+    sfAnalysisWorkerSetBlockSize(analysisWorker, nbrEchantillon);
+}
+
 /**---------------------------------------------------------------------------------------
  * @name Reception methods
  * GeolocalisationSampleTreatment
@@ -1021,40 +1584,45 @@ OSStatus renderCallback(void *userData,
 
 /** Treatment of geolocalisation frequency.
  
+ With the FFT detector the zone estimator is given the position between all the beacons of the spectrum (SFBeaconScanner), with the other
+ detectors the frequency of the loudest one.
+ 
  @see sampleTreatment
  */
 -(void)geolocalisationReceptionSampleTreatment{
     if(geoIsInitiate) {
-        if(sampleFrequency>20000 && sampleFrequency<21000){
-            if (nbrVal>24) {
-                nbrVal=0;
-                [self zoneDetection:curentFrequencyData];
-            }
-            else {
-                curentFrequencyData[nbrVal]=sampleFrequency;
-                nbrVal++;
-                compteur=0;
-            }
-        }
-        else if (sampleFrequency>=17650 && sampleFrequency<17950 && simpleMessagingMode){       // Détection d'un message
+        //Position entre les balises entendues, ou la fréquence de la plus forte si le détecteur n'a pas le spectre de 2048
+        BOOL scanned = beaconScanner!=NULL && detectorMode==SFDetectorFFT && nbrEchantillon==2048;
+        float beaconFrequency = scanned ? sfBeaconScannerFrequency(beaconScanner) : sampleFrequency;
+        
+        if (sampleFrequency>=17650 && sampleFrequency<17950 && simpleMessagingMode){            // Détection d'un message
             //Arret de la géolocalisation
             geolocalisationMode=FALSE;
             geoIsInitiate=FALSE;
             
             //Changmement de la rate
-            nbrEchantillon=256;
-            [mySession setPreferredIOBufferDuration: ((float)nbrEchantillon/sampleRate) error: nil];
+            [self setReceptionBufferSize:256];
             
             //Démarage de la réception
+            [self resetMessageProgress];
             [self.delegate startingReception];
             compteur=0;
             isInitiate=TRUE;
         }
+        else if(beaconFrequency>20000 && beaconFrequency<21000){
+            int spot=sfZoneEstimatorUpdate(&zoneEstimator, beaconFrequency);
+            if (spot>=0)
+                [self zoneDetection:spot frequency:(int)lround(zoneEstimator.mean)];
+            compteur=0;
+        }
     }
     else {
         if (sampleFrequency>=19900 && sampleFrequency<21000 && !geoIsInitiate) {
             compteur=0;
             geoIsInitiate=TRUE;
+            sfZoneEstimatorReset(&zoneEstimator);      //Les détections d'avant la mise en veille sont périmées
+            if (beaconScanner!=NULL)
+                sfBeaconScannerReset(beaconScanner);
             
         }
     }
@@ -1074,8 +1642,8 @@ OSStatus renderCallback(void *userData,
     if(isInitiate) {
         
         if (sampleFrequency>=17995 && sampleFrequency<=19710) {                 //Ajout d'un caractère à la chaine finale
-            NSString *res = [NSString stringWithFormat:@"%c",(char)((sampleFrequency-17995)/18+32)];
-            [messageReceive appendString:res];
+            sfMessageStreamPush(&messageStream, (char)((sampleFrequency-17995)/18+32));
+            [self messageProgress];
             compteur=0;
         }
         else if(sampleFrequency>=19720 && sampleFrequency<=19736) {             //Fin du message
@@ -1088,8 +1656,7 @@ OSStatus renderCallback(void *userData,
             compteur=0;
             
             //Changement de la rate pour la géoloc
-            nbrEchantillon=2048;
-            [mySession setPreferredIOBufferDuration: ((float)nbrEchantillon/sampleRate) error: nil];
+            [self setReceptionBufferSize:2048];
             //Finalisation de la réception
             [self startAnalysis];
             isInitiate=FALSE;
@@ -1097,6 +1664,8 @@ OSStatus renderCallback(void *userData,
         
     }
     else {
+        int mode = sfMultiToneFindMode(sampleFrequency);
+        
         if (sampleFrequency>=17650 && sampleFrequency<17950 && !isInitiate) {   //Détection d'un début de message
 #if DEBUG
             NSLog(@"Gogo");
@@ -1107,20 +1676,245 @@ OSStatus renderCallback(void *userData,
             geoIsInitiate=FALSE;
             
             //Changement de la rate d'écoute
-            nbrEchantillon=256;
-            [mySession setPreferredIOBufferDuration: ((float)nbrEchantillon/sampleRate) error: nil];
+            [self setReceptionBufferSize:256];
             
             //Démarrage de l'écoute
+            sfMessageStreamReset(&messageStream);
+            [self resetMessageProgress];
             [self.delegate startingReception];
             compteur=0;
             isInitiate=TRUE;
             
         }
+        else if (mode!=SF_MFSK_SINGLE_TONE && [self acceptMode:mode] && !isInitiate) {       //Début d'un message multi tone
+#if DEBUG
+            NSLog(@"Gogo mode %d", mode);
+#endif
+            geolocalisationMode=FALSE;
+            geoIsInitiate=FALSE;
+            [self setReceptionBufferSize:256];
+            
+            //Les échantillons suivants vont au décodeur du mode (multiToneReceptionSampleTreatment)
+            multiToneReceiving=multiToneDecoders[mode];
+            sfMultiToneDecoderReset(multiToneReceiving);
+            [self resetMessageProgress];
+            [self.delegate startingReception];
+            compteur=0;
+            isInitiate=TRUE;
+        }
     }
     
     
 }
 
+
+
+/**---------------------------------------------------------------------------------------
+ * ChirpReceptionSampleTreatment
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Search the chirp preamble in the block of the worker, then start the message at its first symbol.
+ 
+ The matched filter keeps the samples that follow the chirp: the start tone tells the mode, the samples after it are the first symbols. They are given to the decoder of the mode (or to the detectors in slices of 256 frames in the single tone mode) with the rest of the block, like the buffers that come after. A chirp without start tone after it is a false detection, the detectors get the block as usual.
+ 
+ @param numFrames Frames of the block in workerSamples
+ @return TRUE if the block was used by the preamble or the message, FALSE if the detectors must treat it
+ @see sampleTreatment
+ */
+-(BOOL)chirpReceptionSampleTreatment:(int)numFrames {
+    int used=0;
+    
+    if (!sfChirpDetectorProcess(chirpDetector, workerSamples, numFrames, &used))
+        return chirpDetector->found;    // the start tone after the chirp is not complete
+    
+    int count=0;
+    const int16_t *following = sfChirpDetectorFollowing(chirpDetector, &count);
+    int mode = sfMultiToneIdentifyMode(following, SF_CHIRP_MODE_FRAMES, sampleRate);
+    if (mode == SF_MFSK_NO_MODE || ![self acceptMode:mode]) {
+        sfChirpDetectorReset(chirpDetector);
+        return FALSE;
+    }
+#if DEBUG
+    NSLog(@"Gogo chirp mode %d (peak %.0f)", mode, chirpDetector->peak);
+#endif
+    
+    //Comme à la détection du start tone
+    if (simpleMessagingMode) {
+        geolocalisationMode=FALSE;
+        geoIsInitiate=FALSE;
+    }
+    [self setReceptionBufferSize:256];
+    if (mode != SF_MFSK_SINGLE_TONE) {
+        multiToneReceiving=multiToneDecoders[mode];
+        sfMultiToneDecoderResetAtSymbol(multiToneReceiving);
+    }
+    [self resetMessageProgress];
+    [self.delegate startingReception];
+    compteur=0;
+    compteurProcess=0;
+    isInitiate=TRUE;
+    
+    //Les symboles déjà reçus, puis la fin du bloc
+    SInt16 *block = workerSamples;
+    const int16_t *symbols[2] = { following+SF_CHIRP_MODE_FRAMES, block+used };
+    int lengths[2] = { count-SF_CHIRP_MODE_FRAMES, numFrames-used };
+    for (int part=0; part<2; part++) {
+        for (int offset=0; offset<lengths[part] && isInitiate; offset+=SF_MESSAGE_RECEPTION_BUFFER) {
+            workerSamples = (SInt16*)symbols[part]+offset;
+            [self sampleTreatment:MIN(SF_MESSAGE_RECEPTION_BUFFER, lengths[part]-offset)];
+        }
+    }
+    workerSamples = block;
+    sfChirpDetectorReset(chirpDetector);
+    return TRUE;
+}
+
+
+
+/**---------------------------------------------------------------------------------------
+ * MultiToneReceptionSampleTreatment
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Treatment of a multi tone message, the samples are given to the decoder of its mode instead of the frequency detectors.
+ 
+ The decoder find the symbols on the clock of the emitter and decide them with its own filters. The header of the frame gives its length, so the reception ends on its last symbol without waiting for the stop tone. The message is given like startAnalysis does, without the analysis phases: there is no repetition to remove, in a coded mode the Reed-Solomon code has fixed the wrong bytes, and a frame whose header or CRC is wrong is dropped as soon as it is known. The type of the frame tells who get it, messageReceived for a message, transactionUpdate for a step of the payment, dataReceived for binary data (transactionUpdate in base64 during a payment).
+ 
+ @see messagingReceptionSampleTreatment
+ @see paiementReceptionSampleTreatment
+ */
+-(void)multiToneReceptionSampleTreatment:(int)numFrames {
+    SFMessageEvent event = sfMultiToneDecoderProcess(multiToneReceiving, workerSamples, numFrames);
+    
+    if (event == SFMessageEventCaracter) {
+        compteur=0;
+        [self messageProgress];
+    }
+    if (event != SFMessageEventCompleted && event != SFMessageEventTimedOut)
+        return;
+    
+    //Le ton de début était celui d'un autre mode, son décodeur prend la suite
+    int handover = multiToneReceiving->handover;
+    if (handover != SF_MFSK_SINGLE_TONE && [self acceptMode:handover]) {
+        multiToneReceiving=multiToneDecoders[handover];
+        sfMultiToneDecoderReset(multiToneReceiving);
+        [self resetMessageProgress];
+        compteur=0;
+        return;
+    }
+    
+#if DEBUG
+    NSLog(@"Stop %d tones (%d symbols, quality %d, %d bytes corrected, %d blocks failed%@)", multiToneReceiving->toneCount, multiToneReceiving->symbolCount, multiToneReceiving->quality, multiToneReceiving->corrected, multiToneReceiving->failedBlocks, multiToneReceiving->rejected ? @", frame rejected" : @"");
+#endif
+    NSData *payload = [NSData dataWithBytes:multiToneReceiving->message length:multiToneReceiving->messageLength];
+    SFFrameType type = multiToneReceiving->frameType;
+    BOOL rejected = multiToneReceiving->rejected;
+    receptionQuality=multiToneReceiving->quality;
+    multiToneReceiving=NULL;
+    
+    //Retour à l'écoute comme à la fin d'un message
+    compteur=0;
+    isInitiate=FALSE;
+    if (!paiementMode) {
+        geolocalisationMode=TRUE;
+        [self setReceptionBufferSize:2048];
+    }
+    
+    if (rejected || [payload length]==0) {
+        [self dropMessageProgress];
+        return;
+    }
+    NSString *message = [[NSString alloc] initWithData:payload encoding:NSISOLatin1StringEncoding];
+    if (type==SFFrameTypeMessage && simpleMessagingMode)
+        [self.delegate messageReceived:message];
+    else if (type==SFFrameTypePayment && paiementMode)
+        [self transactionUpdate:message];
+    else if (type==SFFrameTypeData && paiementMode)                         //Un chiffré reçu en binaire, le paiement le compare en base64 comme AESCrypt le donne
+        [self transactionUpdate:[NSString base64StringFromData:payload length:[payload length]]];
+    else if (type==SFFrameTypeData && simpleMessagingMode && [self.delegate respondsToSelector:@selector(dataReceived:)])
+        [self.delegate dataReceived:payload];
+}
+
+/**---------------------------------------------------------------------------------------
+ * ResetMessageProgress
+ *  ---------------------------------------------------------------------------------------
+ */
+/** A new message starts (start tone or chirp), nothing of it was given to the delegate yet
+ 
+ @see messageProgress
+ */
+-(void)resetMessageProgress {
+    progressLength=0;
+    progressSampleTime=workerSampleCount-(long long)(SF_PROGRESS_PERIOD*sampleRate);
+    headerReceived=FALSE;
+}
+
+/**---------------------------------------------------------------------------------------
+ * MessageProgress
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Give the beginning of the message in progress to the delegate (messageProgress:confidence:), and the header of a multi tone frame as soon as it is read (messageHeader:length:).
+ 
+ The caracters of messageStream are final as soon as phase 5 writes them, the confidence of each one is the times it was seen in a row. In multi tone mode they are the bytes received before the Reed-Solomon correction, their confidence comes from the decisions of the tones (sfMultiToneDecoderPartial), only a message frame is given. The delegate is called when the message grew, at most once every SF_PROGRESS_PERIOD seconds of samples: a fast mode receives several bytes per buffer, the UI doesn't need to be reloaded for each one. The end of the message is given by messageReceived: anyway.
+ 
+ @see messagingReceptionSampleTreatment
+ @see multiToneReceptionSampleTreatment
+ */
+-(void)messageProgress {
+    if (multiToneReceiving!=NULL && !headerReceived && multiToneReceiving->expectedSymbols>0 && !multiToneReceiving->rejected) {
+        headerReceived=TRUE;
+        if ([self.delegate respondsToSelector:@selector(messageHeader:length:)])
+            [self.delegate messageHeader:multiToneReceiving->frameType length:multiToneReceiving->payloadLength];
+    }
+    
+    if (!simpleMessagingMode || ![self.delegate respondsToSelector:@selector(messageProgress:confidence:)])
+        return;
+    if (workerSampleCount-progressSampleTime < (long long)(SF_PROGRESS_PERIOD*sampleRate))
+        return;
+    
+    NSString *partialMessage=nil;
+    NSData *confidence=nil;
+    if (multiToneReceiving!=NULL) {
+        if (multiToneReceiving->frameType!=SFFrameTypeMessage)
+            return;
+        NSMutableData *bytes=[NSMutableData dataWithLength:multiToneReceiving->payloadLength];
+        NSMutableData *levels=[NSMutableData dataWithLength:multiToneReceiving->payloadLength];
+        int length=sfMultiToneDecoderPartial(multiToneReceiving, [bytes mutableBytes], [levels mutableBytes]);
+        if (length<=progressLength)
+            return;
+        [bytes setLength:length];
+        [levels setLength:length];
+        progressLength=length;
+        partialMessage=[[NSString alloc] initWithData:bytes encoding:NSISOLatin1StringEncoding];
+        confidence=levels;
+    }
+    else {
+        int length=messageStream.messageLength;
+        if (length<=progressLength)
+            return;
+        progressLength=length;
+        partialMessage=[[NSString alloc] initWithBytes:messageStream.message length:length encoding:NSASCIIStringEncoding];
+        confidence=[NSData dataWithBytes:messageStream.confidence length:length];
+    }
+    
+    progressSampleTime=workerSampleCount;
+    [self.delegate messageProgress:partialMessage confidence:confidence];
+}
+
+/**---------------------------------------------------------------------------------------
+ * DropMessageProgress
+ *  ---------------------------------------------------------------------------------------
+ */
+/** The message in progress won't be given by messageReceived: (frame cut, corrupted or timed out), the delegate forget what it received of it
+ 
+ @see messageProgress
+ */
+-(void)dropMessageProgress {
+    if (progressLength>0 && simpleMessagingMode && [self.delegate respondsToSelector:@selector(messageProgress:confidence:)])
+        [self.delegate messageProgress:nil confidence:nil];
+    progressLength=0;
+}
+
+
 /**---------------------------------------------------------------------------------------
  * PaiementReceptionSampleTreatment
  *  ---------------------------------------------------------------------------------------
@@ -1133,8 +1927,7 @@ OSStatus renderCallback(void *userData,
     
     if(isInitiate) {
         if (sampleFrequency>=17995 && sampleFrequency<=19710) {                 //Ajout d'un caractère à la chaine finale
-            NSString *res = [NSString stringWithFormat:@"%c",(char)((sampleFrequency-17995)/18+32)];
-            [messageReceive appendString:res];
+            sfMessageStreamPush(&messageStream, (char)((sampleFrequency-17995)/18+32));
             compteur=0;
         }
         else if(sampleFrequency>=19720 && sampleFrequency<=19736) {             //Fin du message
@@ -1148,20 +1941,36 @@ OSStatus renderCallback(void *userData,
         
     }
     else {
+        int mode = sfMultiToneFindMode(sampleFrequency);
+        
         if (sampleFrequency>=17650 && sampleFrequency<17950 && !isInitiate) {   //Détection d'un début de message
 #if DEBUG
             NSLog(@"Gogo");
 #endif
             
             //Changement de la rate
-            nbrEchantillon=256;
-            [mySession setPreferredIOBufferDuration: ((float)nbrEchantillon/sampleRate) error: nil];
+            [self setReceptionBufferSize:256];
+            sfMessageStreamReset(&messageStream);
+            [self resetMessageProgress];
             [self.delegate startingReception];
             compteur=0;
             compteurProcess=0;
             isInitiate=TRUE;
             
         }
+        else if (mode!=SF_MFSK_SINGLE_TONE && [self acceptMode:mode] && !isInitiate) {       //Début d'une trame multi tone
+#if DEBUG
+            NSLog(@"Gogo mode %d", mode);
+#endif
+            [self setReceptionBufferSize:256];
+            multiToneReceiving=multiToneDecoders[mode];
+            sfMultiToneDecoderReset(multiToneReceiving);
+            [self resetMessageProgress];
+            [self.delegate startingReception];
+            compteur=0;
+            compteurProcess=0;
+            isInitiate=TRUE;
+        }
     }
     
 }
@@ -1175,51 +1984,43 @@ OSStatus renderCallback(void *userData,
  * ZoneDetection
  *  ---------------------------------------------------------------------------------------
  */
-/** Use to deal with the location of the user in function of the received frequency.
+/** Use to deal with the location of the user in function of the spot decided by the zone estimator.
  
- Made he average frequency of the last 100 frequency record, and then check the standart deviation to determine if the samples are concluding
+ The spot is decided by zoneEstimator as soon as the frequencies received are concluding (SFZoneEstimator: mean and standard deviation of the last
+ detections updated at each one, a decision once the confidence is over SF_ZONE_CONFIDENCE), a few buffers after the beacon is heard. The estimator
+ only give a spot when it change, a spot already validated is not sent again to the server.
  
  NOTE:May use GPS localisation in futur implementation.
  
- @param data The array of frequency (int* 100)
+ The promotion of the spot is notified by promotionForSpot:, from promotionCache when it's there: the time from the spot to the notification is a lookup, not a request to the server.
+ 
+ @param spot The spot in the zone, -1 if the user is out of the zone
+ @param avrgFreq The mean frequency received (the id of the spot for the server is its frequency, sfGeoFrequency, the mean moves a little at each detection)
  @see geolocalisationReceptionSampleTreatment
+ @see promotionForSpot:
  @exception outRange Can raise an NSExeption if the location is out range of the location's array
  @exception outZone Raise if the user is not in a zone under soundFi technologie
  */
--(void) zoneDetection:(int*)data
+-(void) zoneDetection:(int)spot frequency:(int)avrgFreq
 {
     
     //Vérifie si on est en sortie de zone
-    if(data==nil){
+    if(spot<0){
         NSLog(@"Zone non couverte");
         [self.delegate localisationData:@"Hors Zone" :@"Nop"];
         return;
     }
     
     NSString *lieu;
-
-    int avrgFreq=0;
-    double ecartType=0;
-    
-    //Calcul de la moyenne
-    for (int i=0; i<25; i++) {avrgFreq+=data[i];}
-    avrgFreq/=25;
     
-    //Calcul de l'écart type pour détecter les passages entre 2 zones
-    for (int i=0; i<25; i++) {ecartType+=pow(data[i]-avrgFreq,2);}
-    ecartType=sqrt(ecartType/25.);
-    
-    //Vérification de la cohésion des diverse fréquences
-    if(ecartType>25){
-        NSLog(@"Echantillon non concluant / Passage entre 2 zones");
-        printf("Frequence moyenne :%d     Ecart type:%f\n",avrgFreq,ecartType);
-        return;
-    }
+#if DEBUG
+    printf("Spot %d    Frequence moyenne :%d     Ecart type:%f\n",spot,avrgFreq,sfZoneEstimatorDeviation(&zoneEstimator));
+#endif
     
-    //Détermine sa position en fonction de la fréquence
-    nbrSpotInZone=20;
+    //Détermine sa position en fonction du spot
+    nbrSpotInZone=SF_GEO_SPOT_COUNT;
     @try {
-        lieu=[zoneArray objectAtIndex:(avrgFreq-20000)/(1000/nbrSpotInZone)];
+        lieu=[zoneArray objectAtIndex:spot];
     }
     @catch (NSException *outRange) {
         return;
@@ -1227,52 +2028,113 @@ OSStatus renderCallback(void *userData,
     currentPos=lieu;
     
     //Si position validé, on l'envoie au serveur qui renvoie une promotion
-    if ([lastPos isEqualToString:currentPos] && ![lastPosValidate isEqualToString:currentPos]) { //TEST
+    if (![lastPosValidate isEqualToString:currentPos]) {
         
         lastPosValidate=currentPos;
-        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-            NSString* urlContents;
-            NSURL* url;
+        [self promotionForSpot:(int)sfGeoFrequency(spot)];
+    }
+    lastPos=currentPos;
+}
+
+/**---------------------------------------------------------------------------------------
+ * PromotionForSpot
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Notify the promotion of a spot.
+ 
+ The promotion is looked for in promotionCache:
+ 
+ - fresh, it's notified, nothing is sent to the server,
+ - stale, it's notified and revalidated: the request is sent with its ETag in If-None-Match, a 304 make it fresh again, a 200 replace it for the next time,
+ - missing, the request is sent and the promotion is notified when it's received.
+ 
+ The cache is written in promotionPath after each response.
+ 
+ @param spotId The id of the spot for the server, its frequency
+ @see zoneDetection:frequency:
+ */
+-(void)promotionForSpot:(int)spotId{
+    dispatch_async(promotionQueue, ^{
+        const SFPromotion *promotion=NULL;
+        SFPromotionState state=sfPromotionCacheLookup(promotionCache, spotId, [[NSDate date] timeIntervalSince1970], &promotion);
+        if (state!=SFPromotionMissing)
+            [self sendNotification:promotion];
+        if (state==SFPromotionFresh)
+            return;
+        
+        NSURL *url=[NSURL URLWithString:[NSString stringWithFormat:@"%@test.php?id=%d",promotionServer,spotId]];
+        NSMutableURLRequest *request=[NSMutableURLRequest requestWithURL:url];
+        if (promotion!=NULL && promotion->etag[0])
+            [request setValue:[NSString stringWithUTF8String:promotion->etag] forHTTPHeaderField:@"If-None-Match"];
+        
+        [[promotionSession dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+            if (error!=nil || ![response isKindOfClass:[NSHTTPURLResponse class]])
+                return;
+            NSHTTPURLResponse *httpResponse=(NSHTTPURLResponse*)response;
+            NSString *cacheControl=headerField(httpResponse, @"Cache-Control");
+            NSString *etag=headerField(httpResponse, @"ETag");
             
-            url = [NSURL URLWithString:[NSString stringWithFormat:@"http://mynetshare.fr/test.php?id=%d",avrgFreq]];
-            urlContents = [NSString stringWithContentsOfURL:url encoding:NSUTF8StringEncoding error:nil];
-            [self sendNotification:urlContents];
+            dispatch_async(promotionQueue, ^{
+                double now=[[NSDate date] timeIntervalSince1970];
+                double maxAge=sfPromotionMaxAge([cacheControl UTF8String]);
+                if (httpResponse.statusCode==304)
+                    sfPromotionCacheRevalidate(promotionCache, spotId, maxAge, now);
+                else if (httpResponse.statusCode==200 &&
+                         sfPromotionCacheStore(promotionCache, spotId, [data bytes], (int)[data length], [etag UTF8String], maxAge, now)==0 &&
+                         state==SFPromotionMissing) {
+                    const SFPromotion *received=NULL;
+                    sfPromotionCacheLookup(promotionCache, spotId, now, &received);
+                    [self sendNotification:received];
+                }
+                else
+                    return;
+                sfPromotionCacheSave(promotionCache, [promotionPath fileSystemRepresentation]);
+            });
+        }] resume];
+    });
+}
+
+/**---------------------------------------------------------------------------------------
+ * PrefetchPromotions
+ *  ---------------------------------------------------------------------------------------
+ */
+/** Store every promotion of the area of the user in promotionCache, in one request.
+ 
+ Called when the server tells the GPS position is in a SoundFi zone: the promotions of its spots are in the cache before the first beacon is heard. promotions.php give a JSON array of the promotions, each one with its "id" and its "etag".
+ 
+ @see locationManager:didUpdateToLocation:fromLocation:
+ */
+-(void)prefetchPromotions{
+    NSURL *url=[NSURL URLWithString:[NSString stringWithFormat:@"%@promotions.php?lat=%f&long=%f",promotionServer,lastLat,lastLong]];
+    [[promotionSession dataTaskWithURL:url completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        if (error!=nil || ![response isKindOfClass:[NSHTTPURLResponse class]] || ((NSHTTPURLResponse*)response).statusCode!=200)
+            return;
+        NSString *cacheControl=headerField((NSHTTPURLResponse*)response, @"Cache-Control");
+        
+        dispatch_async(promotionQueue, ^{
+            int count=sfPromotionCacheStoreArea(promotionCache, [data bytes], (int)[data length], sfPromotionMaxAge([cacheControl UTF8String]), [[NSDate date] timeIntervalSince1970]);
 #if DEBUG
-            NSLog(@"%@",urlContents);
-            currentPos=@"Nop";
+            NSLog(@"%d promotions dans la zone",count);
 #endif
+            if (count>0)
+                sfPromotionCacheSave(promotionCache, [promotionPath fileSystemRepresentation]);
         });
-        
-    }
-    lastPos=currentPos;
+    }] resume];
 }
 
 /**---------------------------------------------------------------------------------------
  * sendNotification
  *  ---------------------------------------------------------------------------------------
  */
-/** Delegate method for LocationManager to update user location.
+/** Give a promotion of promotionCache to the delegate.
  
- Pop a notification in background processing and add the promotion in the promotion array.
+ Pop a notification in background processing and add the promotion in the promotion array. Called on promotionQueue, the promotion is only valid until the next change of the cache.
  
  */
--(void)sendNotification:(NSString*)data{
-    
-    NSString *promotionText=@"Null";
-    NSString *imgUrl=@"Null";
-    
-    NSRegularExpression *regex = [NSRegularExpression regularExpressionWithPattern:@"\"image_url\":.*\"," options:0 error:NULL];
-    NSTextCheckingResult *match = [regex firstMatchInString:data options:0 range:NSMakeRange(0, [data length])];
-    
-    imgUrl=[data substringWithRange:[match rangeAtIndex:0]];
-    imgUrl=[[imgUrl componentsSeparatedByString:@"\""]objectAtIndex:3];
-    
-    regex = [NSRegularExpression regularExpressionWithPattern:@"\"Promotion\":.*" options:0 error:NULL];
-    match = [regex firstMatchInString:data options:0 range:NSMakeRange(0, [data length])];
-    
-    promotionText=[data substringWithRange:[match rangeAtIndex:0]];
-    promotionText=[[promotionText componentsSeparatedByString:@"\""]objectAtIndex:3];
+-(void)sendNotification:(const SFPromotion*)promotion{
     
+    NSString *promotionText=[NSString stringWithUTF8String:promotion->text];
+    NSString *imgUrl=promotion->imageUrl[0] ? [NSString stringWithUTF8String:promotion->imageUrl] : @"Null";
     
     [self.delegate localisationData:imgUrl :promotionText];
     
@@ -1310,6 +2172,8 @@ OSStatus renderCallback(void *userData,
 #endif
         
         if ([urlContents isEqualToString:@"inZone"]) {
+            if (!isInZone)
+                [self prefetchPromotions];                                                      //Les promotions de la zone avant le premier spot
             isInZone=TRUE;
             if (![self engineIsRunning] && [self backgroundIsEnable])
                 [self startAudioUnit:SFReceivingMode :nil];                                     //On démare l'arrière plan
@@ -1378,13 +2242,13 @@ OSStatus renderCallback(void *userData,
 {
     int limite=0;
     
-    //Affecte la limite en fonction du mode qui a déclenché le timeout
+    //Affecte la limite en fonction du mode qui a déclenché le timeout, en échantillons
     if (geoIsInitiate)
-        limite=500;
+        limite=(int)(SF_TIMEOUT_GEOLOC*sampleRate);
     else if(isInitiate)
-        limite=300;
+        limite=(int)(SF_TIMEOUT_MESSAGING*sampleRate);
     else if(paiementMode)
-        limite=700;
+        limite=(int)(SF_TIMEOUT_PAIEMENT*sampleRate);
     
     
     if ((geoIsInitiate || isInitiate) && compteur>limite) {    //The time out must depend of the mode use WALE
@@ -1398,11 +2262,13 @@ OSStatus renderCallback(void *userData,
         //Remise à 0 du mode géo et message
         isInitiate=FALSE;
         geoIsInitiate=FALSE;
+        if (multiToneReceiving!=NULL)
+            [self dropMessageProgress];
+        multiToneReceiving=NULL;
         
         //Réactivation du mode géo et changement de la rate
         geolocalisationMode=TRUE;
-        nbrEchantillon=2048;
-        [mySession setPreferredIOBufferDuration: ((float)nbrEchantillon/sampleRate) error: nil];
+        [self setReceptionBufferSize:2048];
         
         if (simpleMessagingMode)
             [self startAnalysis];
@@ -1478,281 +2344,32 @@ OSStatus renderCallback(void *userData,
 
 /**---------------------------------------------------------------------------------------
  * @name Analysis methods
- * AnalysisPhase1
- *  ---------------------------------------------------------------------------------------
- */
-/** This is the first step of the analysis
- 
- The purpose of this method is to remove init dans stop string that can be place in the message that is send. Actually you have to manually change it if you want. The default init and stop string are :
- 
- - init:
- - :stop
- 
- @see startAnalysis
- */
--(void)analysisPhase1
-{
-    NSArray *component;
-    component=[messageReceive componentsSeparatedByString:@"init:"];
-    component=[component[[component count]-1] componentsSeparatedByString:@":stop"];
-    messageReceive=component[0];
-}
-
-
-/**---------------------------------------------------------------------------------------
- * AnalysisPhase2
- *  ---------------------------------------------------------------------------------------
- */
-/** Second step of the analysis phase
- 
- The purpose of the phase is analysing the string and remove some pattern. We are looking for substring like "aba", and considère that "b" is an error and should be a "a", because each caracter are repeated 4 times. The difference in the ASCII table must be less than 1 to proced to the correction. (wont work with "bkb")
- 
- @see startAnalysis
- 
- */
--(void)analysisPhase2
-{
-    NSMutableString *chainePhase2=[[NSMutableString alloc]init];
-    int i=1;
-    
-    [chainePhase2 appendFormat:@"%c",[messageReceive characterAtIndex:0]];
-    while (i<[messageReceive length]-1) {
-        char previous=[messageReceive characterAtIndex:i-1];
-        char current=[messageReceive characterAtIndex:i];
-        char next=[messageReceive characterAtIndex:i+1];
-        
-        int ecart=previous-current;
-        
-        if (previous == next) {
-            if (ecart==0)
-                [chainePhase2 appendFormat:@"%c",current];
-        }
-        else
-            [chainePhase2 appendFormat:@"%c",current];
-        i++;
-    }
-    [chainePhase2 appendFormat:@"%c",[messageReceive characterAtIndex:[messageReceive length]-1]];
-    
-    messageReceive=[[NSMutableString alloc]init];
-    messageReceive=chainePhase2;
-}
-
-
-/**---------------------------------------------------------------------------------------
- * AnalysisPhase3
- *  ---------------------------------------------------------------------------------------
- */
-/** Third step of the analysis phase
- 
- The purpose of the phase is analysing the string and remove some pattern. We are looking for substring like "bacb", and considère that "ac" is an error and should be "bb", because each caracter are repeated 4 times. The difference in the ASCII table must be less than 1 to proced to the correction. (wont work with "bjkb")
- 
- @see startAnalysis
- 
- */
--(void)analysisPhase3 {
-    int i=0;
-    NSMutableString *chainePhase3=[[NSMutableString alloc]init];
-    
-    while (i<[messageReceive length]-3) {
-        char un=[messageReceive characterAtIndex:i];
-        char deux=[messageReceive characterAtIndex:i+1];
-        char trois=[messageReceive characterAtIndex:i+2];
-        char quatre=[messageReceive characterAtIndex:i+3];
-        
-        if(un==quatre){
-            if (un-deux!=0 && un-trois!=0) {
-                [chainePhase3 appendFormat:@"%c",un];
-                i=i+3;
-            }
-            else
-            {
-                [chainePhase3 appendFormat:@"%c",un];
-                i++;
-            }
-        }
-        else {
-            [chainePhase3 appendFormat:@"%c",un];
-            i++;
-        }
-        
-    }
-    
-    while (i<[messageReceive length]) {
-        char un=[messageReceive characterAtIndex:i];
-        [chainePhase3 appendFormat:@"%c",un];
-        i++;
-    }
-    
-    messageReceive=[[NSMutableString alloc]init];
-    messageReceive=chainePhase3;
-    
-}
-
-
-
-
-/**---------------------------------------------------------------------------------------
- * AnalysisPhase4
- *  ---------------------------------------------------------------------------------------
- */
-/** Fourth step of the analysis phase
- 
- The purpose of the phase is analysing the string and remove some pattern. We are looking for substring like "fgg", and considère that "f" is an error and should be "g", because each caracter are repeated 4 times. The difference in the ASCII table must be less than 1 to proced to the correction. (wont work with "bcc")
- 
- This function is similar to analysisPhase2.
- 
- @see startAnalysis
- @see analysisPhase2
- */
--(void)analysisPhase4
-{
-    int i=0;
-    NSMutableString *chainePhase4=[[NSMutableString alloc]init];
-    
-    while (i<[messageReceive length]-2) {
-        char un=[messageReceive characterAtIndex:i];
-        char deux=[messageReceive characterAtIndex:i+1];
-        char trois=[messageReceive characterAtIndex:i+2];
-        
-        if((un==deux && trois!=deux)|| (un==trois && trois!=deux)) {
-            if (fabs(trois-deux)==1) {
-                [chainePhase4 appendFormat:@"%c",un];
-                [chainePhase4 appendFormat:@"%c",un];
-                [chainePhase4 appendFormat:@"%c",un];
-                i=i+3;
-            }
-            else {
-                [chainePhase4 appendFormat:@"%c",un];
-                i++;
-            }
-        }
-        else if(deux==trois && un!=deux) {
-            if (fabs(un-deux)==1) {
-                [chainePhase4 appendFormat:@"%c",deux];
-                [chainePhase4 appendFormat:@"%c",deux];
-                [chainePhase4 appendFormat:@"%c",deux];
-                i=i+3;
-            }
-            else {
-                [chainePhase4 appendFormat:@"%c",un];
-                i++;
-            }
-        }
-        else {
-            [chainePhase4 appendFormat:@"%c",un];
-            i++;
-        }
-        
-    }
-    
-    while (i<[messageReceive length]) {
-        char un=[messageReceive characterAtIndex:i];
-        [chainePhase4 appendFormat:@"%c",un];
-        i++;
-    }
-    
-    messageReceive=[[NSMutableString alloc]init];
-    messageReceive=chainePhase4;
-}
-
-
-/**---------------------------------------------------------------------------------------
- * AnalysisPhase5
- *  ---------------------------------------------------------------------------------------
- */
-/** Fifth step of the analysis phase
- 
- The purpose of the phase is analysing the string and deduct the good caracter. In the string, we consider that every caracter that is repeated 2 times is a valid caracter. And if it's repeated more than 5 times, it's a double letter.
- 
- Following this logic if we have this cases :
- 
- - "aa" -> a
- - "abhgcc" -> c
- - "aaaaaa" -> aa
- 
- @see startAnalysis
- 
- */
--(void)analysisPhase5
-{
-    int i=0;
-    int compt=0;
-    NSMutableString *chaineFinale=[[NSMutableString alloc]init];
-    while (i<[messageReceive length]-2) {
-        NSString *un=[NSString stringWithFormat:@"%c",[messageReceive characterAtIndex:i]];
-        NSString *deux=[NSString stringWithFormat:@"%c",[messageReceive characterAtIndex:i+1]];
-        if ([un isEqualToString:deux]) {
-            [chaineFinale appendString:un] ;
-            i=i+2;
-            while ([[NSString stringWithFormat:@"%c",[messageReceive characterAtIndex:i]]isEqualToString:un] && (i<[messageReceive length]-1)) {
-                i++;
-                compt++;
-                if (compt>5) {
-                    [chaineFinale appendString:un];
-                    compt=0;
-                }
-            }
-        }
-        else {
-            i++;
-        }
-        
-        compt=0;
-    }
-    messageReceive=[[NSMutableString alloc]init];
-    messageReceive=chaineFinale;
-    
-}
-
-
-/**---------------------------------------------------------------------------------------
  * AnalysisPhase6
  *  ---------------------------------------------------------------------------------------
  */
 /** Sixth step of the analysis phase
  
- The purpose of the phase is analysing the string and correct the wrong word. This function proceed by analysing each word of the final text and check if it match with a word in the dictionnary.
+ The purpose of the phase is analysing the string and correct the wrong word. Each word (the letters and digits between the other caracters, so an URL is corrected token by token) is looked for in the vocabulary of the domain, SoundFiLexicon.bin (store names, product words, URL tokens) mapped by lexiconSetup, and replaced by the closest word if it is not in it. The distance is weighted by the errors of the reception: a caracter read as the one of the next tone costs less than any other error (SFLexicon).
  
- In this way, a word like "Helo" would be correct to "Hello".
+ In this way, a word like "Cqrrefour" would be correct to "Carrefour". A word that is not close to the vocabulary is not changed, the phase doesn't "correct" the product codes or the names it doesn't know. A word takes a few microseconds, nothing is allocated but the result.
  
- Note : Be carefull, this phase could lead to error, for example, it don't work on url (don"t worry it's design to ignor URL). Morevover this phase is optional and can be disable by changing the #define SPELLCHECKER to 0.
+ Morevover this phase is optional and can be disable by changing the #define SPELLCHECKER to 0.
  
+ @param message The message after the phases 1 to 5
+ @return The message with the corrected words
  @see startAnalysis
+ @see lexiconSetup
  
  */
--(void) analysisPhase6 {
-    
-    UITextChecker *checker = [[UITextChecker alloc] init];
-    
-    NSMutableString *chaineFinale=[[NSMutableString alloc]init];
-    NSArray *mot=[messageReceive componentsSeparatedByString:@" "];
-    
-    for (int i=0; i<[mot count]; i++) {
-        if ([mot[i] rangeOfString:@"http://"].location==NSNotFound) {
-            NSRange checkRange = NSMakeRange(0, [mot[i] length]);
-            
-            NSRange misspelledRange = [checker rangeOfMisspelledWordInString:mot[i]
-                                                                       range:checkRange
-                                                                  startingAt:checkRange.location
-                                                                        wrap:NO
-                                                                    language:@"fr_FR"];
-            
-            NSArray *arrGuessed = [checker guessesForWordRange:misspelledRange inString:mot[i] language:@"fr_FR"];
-            
-            if ([arrGuessed count]>0) {
-                [chaineFinale appendString:[mot[i] stringByReplacingCharactersInRange:misspelledRange withString:[arrGuessed objectAtIndex:0]]];
-            }
-            else
-                [chaineFinale appendString:mot[i]];
-        }
-        else
-            [chaineFinale appendString:mot[i]];
-        
-        [chaineFinale appendString:@" "];
-    }
+-(NSString*) analysisPhase6:(NSString*)message {
+    if (lexicon==NULL)
+        return message;
     
-    messageReceive=[[NSMutableString alloc]init];
-    messageReceive=chaineFinale;
+    NSData *text=[message dataUsingEncoding:NSASCIIStringEncoding allowLossyConversion:YES];
+    int capacity=2*(int)[text length]+1;    // a correction adds SF_LEXICON_MAX_COST/SF_LEXICON_REPEAT_COST caracters at most to a word
+    NSMutableData *corrected=[NSMutableData dataWithLength:capacity];
+    int length=sfLexiconCorrectText(lexicon, [text bytes], (int)[text length], [corrected mutableBytes], capacity);
+    return [[NSString alloc] initWithBytes:[corrected bytes] length:length encoding:NSASCIIStringEncoding];
 }
 
 
@@ -1762,55 +2379,38 @@ OSStatus renderCallback(void *userData,
  */
 /** Analysis of the message receive during the transaction
  
- This function is the one you have to use if you want to analyse a string send by soundFi. It will manage all the step from 1 to 6
+ This function is the one you have to use if you want to analyse a string send by soundFi. The phases 1 to 5 are done by messageStream (SFMessageStream) while the caracters are received, the same code as the offline decoder: at the stop tone only the last caracters are left, the message is ready at once. Then the phase 6 if SPELLCHECKER is set, for messageReceived only.
  
- [self analysisPhase1];
- [self analysisPhase2];
- [self analysisPhase3];
- [self analysisPhase4];
- [self analysisPhase5];
- 
- #if SPELLCHECKER
- [self analysisPhase6];
- #endif
- 
- @see analysisPhase1
- @see analysisPhase2
- @see analysisPhase3
- @see analysisPhase4
- @see analysisPhase5
- @see analysisPhase6
+ @see sfMessageStreamPush
+ @see analysisPhase6:
  
  */
 -(void)startAnalysis
 {
-    if ([messageReceive length]<=0) {
+    if (messageStream.received<=0) {
         return;
     }
     
-#if DEBUG
-    NSLog(@"INIT /**/**/**/ : %@",messageReceive);
-#endif
-    
-    [self analysisPhase1];
-    [self analysisPhase2];
-    [self analysisPhase3];
-    [self analysisPhase4];
-    [self analysisPhase5];
+    int length=sfMessageStreamFinish(&messageStream);
+    receptionQuality=messageStream.quality;
+    NSString *message=[[NSString alloc] initWithBytes:messageStream.message length:length encoding:NSASCIIStringEncoding];
     
+    //Seulement le texte de l'utilisateur, le paiement compare ce qui a été reçu (identifiants, chiffrés en base64)
 #if SPELLCHECKER
-    [self analysisPhase6];
+    NSString *corrected=[self analysisPhase6:message];
+#else
+    NSString *corrected=message;
 #endif
     
 #if DEBUG
-    NSLog(@"RES /**/**/**/ : %@",messageReceive);
+    NSLog(@"RES /**/**/**/ : %@ (%d caracters received, quality %d)",corrected,messageStream.received,receptionQuality);
 #endif
     
     if (simpleMessagingMode)
-        [self.delegate messageReceived:[NSString stringWithString:messageReceive]];
+        [self.delegate messageReceived:corrected];
     if (paiementMode)
-        [self transactionUpdate:[NSString stringWithString:messageReceive]];
-    messageReceive=[[NSMutableString alloc]init];
+        [self transactionUpdate:message];
+    sfMessageStreamReset(&messageStream);
 }
 
 
@@ -1825,41 +2425,72 @@ OSStatus renderCallback(void *userData,
     
     if (mode==SFReceivingMode) {
         receptionMode=TRUE;
-        nbrEchantillon=2048;
-        [mySession setPreferredIOBufferDuration: ((float)nbrEchantillon/sampleRate) error: nil];
-        messageReceive = [[NSMutableString alloc]init];
-#if DEBUG
-        NSLog(@"Démarrage du graph, compteur : %d",compteur);
-#endif
-        OSStatus status = AUGraphStart(myGraph);
-        if (status)
-            NSLog(@"AUGraphStart Error");
+        [self setReceptionBufferSize:2048];
+        sfMessageStreamReset(&messageStream);
+        [self startGraph];
     }
     else {
-        if (![self volumeControl]) {
-            [self.delegate soundToLow];
-            return 0;
+        NSData *temp = [message dataUsingEncoding:NSASCIIStringEncoding allowLossyConversion:YES]; // Deal with special
+        return [self startEmission:temp :paiementMode ? SFFrameTypePayment : SFFrameTypeMessage];  // caracter like è é À...
+    }
+    
+    return 1;
+}
+
+
+
+-(int)sendData:(NSData*)data
+{
+    if (multiToneMode == SF_MFSK_SINGLE_TONE) {
+        NSLog(@"Error - binary payloads need a multi tone mode");
+        return 0;
+    }
+    compteur=0;
+    compteurProcess=0;
+    engineIsRunning=TRUE;
+    return [self startEmission:data :SFFrameTypeData];
+}
+
+
+
+/** Start the emission of a payload, the text of startAudioUnit or the bytes of sendData.
+ 
+ In the single tone mode the payload is sent caracter by caracter, so it must be printable ASCII. In a multi tone mode it is the payload of a frame of the given type, any byte can be sent. Both are rendered by messageEncoder.
+ */
+-(int)startEmission:(NSData*)payload : (SFFrameType)type
+{
+    if (![self volumeControl]) {
+        [self.delegate soundToLow];
+        return 0;
+    }
+    if (!emissionMode) {
+        //The reception stop listening, the graph keeps running. In full duplex it goes on, the worker subtract the emission.
+        if (!fullDuplex) {
+            receptionMode=FALSE;
+            isInitiate=FALSE;
+            geoIsInitiate=FALSE;
         }
-        if (!emissionMode) {
-            [self stopProcessingAudio];
-            
-            NSData *temp = [message dataUsingEncoding:NSASCIIStringEncoding allowLossyConversion:YES]; // Deal with special
-            myMessage = [[NSString alloc] initWithData:temp encoding:NSASCIIStringEncoding];           // caracter like è é À...
-            
-            emissionCanBeStop=TRUE;
-            emissionMode=TRUE;
-            initSequence=TRUE;
-            nbrRepeatInit=0;
-            amplitude=0;
+        
+        pthread_mutex_lock(&emissionMutex);
+        myMessage = [[NSString alloc] initWithData:payload encoding:NSASCIIStringEncoding];
+        encodedMessage = payload;
+        sfMessageEncoderStartFrame(messageEncoder, type, [encodedMessage bytes], (int)[encodedMessage length]);
+        encoderOffset = SF_EMISSION_FRAMES;
+        emissionType = type;
+        emissionSampleTime = -1;
+        emissionCount++;
+        
+        emissionCanBeStop=TRUE;
+        amplitude=0;
+        sfOscillatorReset(oscillator);
+        emissionMode=TRUE;
+        pthread_mutex_unlock(&emissionMutex);
 #if DEBUG
-            NSLog(@"Envoie du message");
+        NSLog(@"Envoie du message");
 #endif
-            [self emissionSetup];
-            nbrEchantillon=256;
-            [mySession setPreferredIOBufferDuration: ((float)nbrEchantillon/sampleRate) error: nil];
-            AudioUnitInitialize(emissionUnit);
-            AudioOutputUnitStart(emissionUnit);
-        }
+        //The IO buffer doesn't change, the encoder keeps its own sample clock whatever numFrames is
+        engineIsRunning=TRUE;
+        [self startGraph];
     }
     
     return 1;
@@ -1880,28 +2511,22 @@ OSStatus renderCallback(void *userData,
  */
 -(int)stopProcessingAudio
 {
-    if (receptionMode) {
-        Boolean isRunning = false;
+    Boolean isRunning = false;
 #if DEBUG
-        NSLog(@"Arret du graph, compteur : %d",compteur);
+    NSLog(@"Arret du graph, compteur : %d",compteur);
 #endif
-        OSStatus status = AUGraphIsRunning(myGraph, &isRunning);
-        if (isRunning)
-            status = AUGraphStop(myGraph);
-        if (status)
-            NSLog(@"AUGraphStop Error");
-    }
-    else if (emissionMode) {
-#if DEBUG
-        NSLog(@"Stop Emission");
-#endif
-        AudioOutputUnitStop(emissionUnit);
-    }
+    OSStatus status = AUGraphIsRunning(myGraph, &isRunning);
+    if (isRunning)
+        status = AUGraphStop(myGraph);
+    if (status)
+        NSLog(@"AUGraphStop Error");
     
     engineIsRunning=FALSE;
     
     receptionMode=FALSE;
+    pthread_mutex_lock(&emissionMutex);
     emissionMode=FALSE;
+    pthread_mutex_unlock(&emissionMutex);
     
     isInitiate=FALSE;
     geoIsInitiate=FALSE;
@@ -1910,28 +2535,47 @@ OSStatus renderCallback(void *userData,
 
 
 
+/** Start the graph if it is not running, the emission and the reception share it.
+ 
+ Once started the graph runs until stopProcessingAudio (interruption, background) : going from a mode to the other is a flag, the next buffer is already in the new mode.
+ */
+-(void)startGraph
+{
+    Boolean isRunning = false;
+    
+    AUGraphIsRunning(myGraph, &isRunning);
+    if (isRunning)
+        return;
+#if DEBUG
+    NSLog(@"Démarrage du graph, compteur : %d",compteur);
+#endif
+    OSStatus status = AUGraphStart(myGraph);
+    if (status)
+        NSLog(@"AUGraphStart Error");
+}
+
+
+
 /**---------------------------------------------------------------------------------------
  * RelauchReception
  *  ---------------------------------------------------------------------------------------
  */
 /** This function is use after finishing a message sending
  
- Permit to restart the listening and put in waiting state for a message. It will proceed to a usleep to avoid lldb due to audio still processing on sending.
+ Permit to restart the listening and put in waiting state for a message. The graph is still running, the emission bus give silence from the next buffer and the mic feed the analysis again. In full duplex the reception never stopped, a message may be in progress : only the emission ends.
  
  */
 -(void)relaunchReception
 {
-    usleep(40000);
-    [self stopProcessingAudio];
-    usleep(100000);
 #if DEBUG
     NSLog(@"Je relance l'écoute");
 #endif
-    AudioUnitUninitialize(emissionUnit);
-    AudioComponentInstanceDispose(emissionUnit);
-    emissionUnit=nil;
+    pthread_mutex_lock(&emissionMutex);
+    emissionMode=FALSE;
+    pthread_mutex_unlock(&emissionMutex);
+    if (fullDuplex && receptionMode)
+        return;
     [self startAudioUnit:SFReceivingMode:NULL];
-    
 }
 
 #pragma mark - Volume control
@@ -2124,6 +2768,24 @@ OSStatus renderCallback(void *userData,
  @return TRUE if the engine is running
  */
 -(BOOL)engineIsRunning{return engineIsRunning;}
+-(int)receptionQuality{return receptionQuality;}
+-(float)localisationPosition{return (beaconScanner!=NULL && geoIsInitiate) ? beaconScanner->position : -1;}
+
+-(void)setPromotionServer:(NSString*)url{
+    NSString *server=[url hasSuffix:@"/"] ? [url copy] : [url stringByAppendingString:@"/"];
+    dispatch_async(promotionQueue, ^{
+        promotionServer=server;
+    });
+}
+
+-(void)analysisStatistics:(uint32_t*)overruns :(uint32_t*)underruns :(float*)maxLatency {
+    if (overruns)
+        *overruns = sampleRing ? sfRingBufferOverruns(sampleRing) : 0;
+    if (underruns)
+        *underruns = analysisWorker ? __atomic_load_n(&analysisWorker->underruns, __ATOMIC_RELAXED) : 0;
+    if (maxLatency)
+        *maxLatency = analysisWorker ? __atomic_load_n(&analysisWorker->maxLatency, __ATOMIC_RELAXED)/1e6f : 0;
+}
 
 
 #pragma mark - BackGround and Foreground management
@@ -2210,7 +2872,6 @@ OSStatus renderCallback(void *userData,
 - (void) transactionUpdate:(NSString*) theMessage{
     
     compteurProcess=0;
-    usleep(40000);
     if ([theMessage isEqualToString:@"TimeOut"]) {
         timeOut=TRUE;
     }
@@ -2219,7 +2880,7 @@ OSStatus renderCallback(void *userData,
     switch (transactionState) {
         case 0: {                                                       // Acquitement du prix reçu
             paiementInformation=theMessage;
-            timeOutProcess=516;  //Time out de 3 sec set
+            timeOutProcess=(int)(SF_TIMEOUT_PROCESS*sampleRate);  //Time out de 3 sec set
             transactionState++;
             dispatch_async( dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
                 [self startAudioUnit:SFSendingMode:theMessage];
@@ -2234,7 +2895,7 @@ OSStatus renderCallback(void *userData,
             else {
                 if ([theMessage isEqualToString:@"GoodPrice"]) {
                     [self.delegate transactionData:paiementInformation];// Delegate pour envoyer le prix à l'UI
-                    timeOutProcess=20000;
+                    timeOutProcess=INT_MAX;
                     
                     [[NSOperationQueue mainQueue] addOperationWithBlock:^ {
                         UIAlertView * alert = [[UIAlertView alloc] initWithTitle:@"CODE" message:@"Entrer votre code secret" delegate:self cancelButtonTitle:@"Ok" otherButtonTitles:nil];
@@ -2254,9 +2915,12 @@ OSStatus renderCallback(void *userData,
             
             break;
         case 2: {                                                         // Envoie de mon id à la caisse
-            timeOutProcess=516;   // Set du timeOut à 3 sec soit 516 frames
+            timeOutProcess=(int)(SF_TIMEOUT_PROCESS*sampleRate);   // Set du timeOut à 3 sec, en échantillons
             dispatch_async( dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-                [self startAudioUnit:SFSendingMode:myID];
+                if (multiToneMode != SF_MFSK_SINGLE_TONE)
+                    [self sendData:[NSData base64DataFromString:myID]];          //Le chiffré part tel quel, sans le tiers de plus du base64
+                else
+                    [self startAudioUnit:SFSendingMode:myID];
             });
             transactionState++;
         }
@@ -2269,7 +2933,7 @@ OSStatus renderCallback(void *userData,
             else {
                 if ([theMessage isEqualToString:myID]) {
                     //NSLog(@"Il a reçu le bon ID");
-                    timeOutProcess=20000;   //Remet le timeOut à l'infini (si déclenché gros problème)
+                    timeOutProcess=INT_MAX;   //Remet le timeOut à l'infini (si déclenché gros problème)
                     transactionState++;
                     //[sw_id setOn:TRUE];
                     dispatch_async( dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
@@ -2296,7 +2960,7 @@ OSStatus renderCallback(void *userData,
 #endif
                 [self.delegate transactionFinalState:paiementStatut];
                 transactionState++;
-                timeOutProcess=20000;
+                timeOutProcess=INT_MAX;
                 
                 [self endPaiementProcess];
             }
@@ -2338,12 +3002,12 @@ OSStatus renderCallback(void *userData,
     timer=nil;
     simpleMessagingMode=FALSE;
     isInitiate=FALSE;
-    messageReceive=[[NSMutableString alloc]init];
+    sfMessageStreamReset(&messageStream);
     
     
     [self relaunchReception];
     transactionState=0;
-    timeOutProcess=20000;
+    timeOutProcess=INT_MAX;
     
     //Démarrage du mode de paiement
     paiementMode=TRUE;
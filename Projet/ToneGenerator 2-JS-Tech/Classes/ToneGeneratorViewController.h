@@ -17,6 +17,7 @@
 #import <AudioUnit/AudioUnit.h>
 #import <AudioToolbox/AudioToolbox.h>
 #import <AVFoundation/AVFoundation.h>
+#include "SFOscillator.h"
 
 @interface ToneGeneratorViewController : UIViewController
 {
@@ -28,7 +29,7 @@
 @public
 	double frequency;
 	double sampleRate;
-	double theta;
+	SFOscillator *oscillator;
 }
 
 @property (nonatomic, retain) IBOutlet UISlider *frequencySlider;
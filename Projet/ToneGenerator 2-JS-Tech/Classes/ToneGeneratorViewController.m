@@ -30,27 +30,13 @@ OSStatus RenderTone(
 	// Get the tone parameters out of the view controller
 	ToneGeneratorViewController *viewController =
 		(ToneGeneratorViewController *)inRefCon;
-	double theta = viewController->theta;
-	double theta_increment = 2.0 * M_PI * viewController->frequency / viewController->sampleRate;
 
 	// This is a mono tone generator so we only need the first buffer
 	const int channel = 0;
 	Float32 *buffer = (Float32 *)ioData->mBuffers[channel].mData;
 	
-	// Generate the samples
-	for (UInt32 frame = 0; frame < inNumberFrames; frame++) 
-	{
-		buffer[frame] = sin(theta) * amplitude;
-		
-		theta += theta_increment;
-		if (theta > 2.0 * M_PI)
-		{
-			theta -= 2.0 * M_PI;
-		}
-	}
-	
-	// Store the theta back in the view controller
-	viewController->theta = theta;
+	// Generate the samples, the phase follow from the last buffer
+	sfOscillatorRender(viewController->oscillator, viewController->frequency, amplitude, buffer, inNumberFrames);
 
 	return noErr;
 }
@@ -170,6 +156,9 @@ void ToneInterruptionListener(void *inClientData, UInt32 inInterruptionState)
 	OSErr err = AudioComponentInstanceNew(defaultOutput, &toneUnit);
 	NSAssert1(toneUnit, @"Error creating unit: %ld", err);
 	
+	// The tone start from phase 0 and fade in over the first buffer
+	sfOscillatorReset(oscillator);
+	
 	// Set our tone rendering function on the unit
 	AURenderCallbackStruct input;
 	input.inputProc = RenderTone;
@@ -244,6 +233,8 @@ void ToneInterruptionListener(void *inClientData, UInt32 inInterruptionState)
 
 	[self sliderChanged:frequencySlider];
 	sampleRate = 44100;
+	oscillator = sfOscillatorCreate(sampleRate, 1024, NULL, 0);
+	NSAssert(oscillator, @"Can't allocate the oscillator");
 
 	OSStatus result = AudioSessionInitialize(NULL, NULL, ToneInterruptionListener, self);
 	if (result == kAudioSessionNoError)
@@ -285,6 +276,7 @@ void ToneInterruptionListener(void *inClientData, UInt32 inInterruptionState)
     [_bL release];
     [_bN release];
     [_bStop release];
+    sfOscillatorDestroy(oscillator);
     [super dealloc];
 }
 @end
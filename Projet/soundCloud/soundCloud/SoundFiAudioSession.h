@@ -145,7 +145,6 @@ typedef int SFBufferSizeValue;
     int                 userStartFreq;
     int                 userStopFreq;
     int                 numberOfAlphaInDictionnary;
-    NSMutableArray      *userDictionnary;
     
     //test
     int test;
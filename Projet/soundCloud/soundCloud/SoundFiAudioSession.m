@@ -8,6 +8,54 @@
 
 #import "SoundFiAudioSession.h"
 #include <pthread.h>
+#include <libkern/OSAtomic.h>
+
+#include "SFAlphabet.h"
+
+#define SF_RECEIVED_CAPACITY    2048    //Caracters of a received message, each one 4 or 5 times (phase 5 count them)
+
+/** Compile an alphabet (SFAlphabet.h), the caracters over 255 are ignored.
+ 
+ @return The table (sfAlphabetDestroy) or NULL
+ */
+static SFAlphabet *alphabetCreate(NSString *alpha, int minFrequency, int spacing)
+{
+    char caracters[SF_ALPHABET_SIZE];
+    int length = 0;
+    for (NSUInteger i = 0; i < [alpha length] && length < SF_ALPHABET_SIZE; i++) {
+        unichar caracter = [alpha characterAtIndex:i];
+        if (caracter < SF_ALPHABET_SIZE)
+            caracters[length++] = (char)caracter;
+    }
+    return sfAlphabetCreate(caracters, length, minFrequency, spacing);
+}
+
+enum {
+    SFAlphabetReaderRender,         //getASCIIFrequency, render callback
+    SFAlphabetReaderReception,      //messagingReceptionSampleTreatment, recording callback
+    SFAlphabetReaderCount
+};
+
+/** The current alphabet for a callback, until alphabetRelease.
+ 
+ The table is published in inUse (a hazard pointer) before it is read, then the current one is read again: if setAlphabet swapped it in between, the callback takes the new one. setAlphabet swap first and look at inUse after, so a table it sees free is not read any more. No lock, the callback never waits.
+ */
+static inline const SFAlphabet *alphabetAcquire(SFAlphabet * volatile *current, const SFAlphabet * volatile *inUse)
+{
+    const SFAlphabet *table;
+    do {
+        table = *current;
+        *inUse = table;
+        OSMemoryBarrier();
+    } while (table != *current);
+    return table;
+}
+
+static inline void alphabetRelease(const SFAlphabet * volatile *inUse)
+{
+    OSMemoryBarrier();      //The reads of the table are done
+    *inUse = NULL;
+}
 
 /**
  
@@ -60,7 +108,13 @@
     BOOL                emissionMode;
     
     //Reception mode variables for the clasic message
-    NSMutableString     *messageReceive;
+    NSMutableString     *messageReceive;    //Built by startAnalysis on the main queue, from a completed buffer
+    char                receivedCaracters[2][SF_RECEIVED_CAPACITY];    //Written by the recording callback, one while the analysis read the other
+    int                 receivedBuffer;     //Buffer of the message being received
+    int                 receivedLength;
+    volatile int        completedBuffer;    //Buffer given to the analysis by finishReception
+    volatile int        completedLength;
+    dispatch_source_t   analysisSource;     //Wake the analysis on the main queue, without allocation in the callback
     
     //Emission mode variables for the clasic message
     double              amplitude;
@@ -97,6 +151,11 @@
     //Monofrequency emission
     int     monoFrequency;
     BOOL    sendMonoFrequency;
+    
+    //Alphabet of the messages, read by the callbacks
+    SFAlphabet * volatile   alphabet;
+    const SFAlphabet * volatile alphabetInUse[SFAlphabetReaderCount];    //Table each callback is reading, NULL out of it
+    NSMutableArray          *retiredAlphabets;  //Previous tables (NSValue), freed once no callback hold them
 }
 
 /**---------------------------------------------------------------------------------------
@@ -174,6 +233,7 @@
 -(int)stopProcessingAudio;                                                          //Stop audio processing
 
 -(void)startAnalysis;                                                               //Analysis of the received message
+-(void)finishReception;                                                             //Give the received caracters to startAnalysis, from the recording callback
 
 -(void)interruptionDetected:(NSNotification *)notification;                         //Call when the audioEngine is stop by ther process
 
@@ -583,12 +643,16 @@ OSStatus renderCallback(void *userData,
     userStartFreq=17800;
     userStopFreq=19728;
     userFreqEspacement=18;
-    numberOfAlphaInDictionnary=94;
-    userDictionnary = [[NSMutableArray alloc]init];
-    NSString *alpha = @" !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~";
-    for (int i =0; i<numberOfAlphaInDictionnary; i++) {
-        [userDictionnary addObject:[NSString stringWithFormat:@"%c",[alpha characterAtIndex:i]]];
-    }
+    retiredAlphabets = [[NSMutableArray alloc]init];
+    [self setAlphabet:@"" SF_ALPHABET_DEFAULT];
+    
+    //The received messages are analysed on the main queue, the recording callback only wakes it
+    analysisSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_ADD, 0, 0, dispatch_get_main_queue());
+    __weak SoundFiAudioSession *weakSelf = self;
+    dispatch_source_set_event_handler(analysisSource, ^{
+        [weakSelf startAnalysis];
+    });
+    dispatch_resume(analysisSource);
     
     //Notification listening for background and foreground
     [[NSNotificationCenter defaultCenter] addObserver: self
@@ -1084,12 +1148,16 @@ OSStatus renderCallback(void *userData,
     }
     
     if (compteur < [myMessage length]) {
-        frequence=userMinFreq +( [self getIndex:[NSString stringWithFormat:@"%c",[myMessage characterAtIndex:compteur]]]*userFreqEspacement);
-        //NSLog(@"Lettre : %@  // At freq : %d",[NSString stringWithFormat:@"%c",[myMessage characterAtIndex:compteur]],frequence);
-        if (frequence==-userMinFreq) {
+        unichar caracter = [myMessage characterAtIndex:compteur];
+        const SFAlphabet *table = alphabetAcquire(&alphabet, &alphabetInUse[SFAlphabetReaderRender]);
+        frequence = caracter < SF_ALPHABET_SIZE ? sfAlphabetFrequency(table, caracter) : 0;
+        alphabetRelease(&alphabetInUse[SFAlphabetReaderRender]);
+        //NSLog(@"Lettre : %C  // At freq : %d",caracter,frequence);
+#if DEBUG
+        if (frequence==0) {
             NSLog(@"Not in dico");
-            frequence=0;
         }
+#endif
     }
     else {
         if (emissionCanBeStop) {
@@ -1167,17 +1235,13 @@ OSStatus renderCallback(void *userData,
         if (sampleFrequency>=userMinFreq-(frequencySpacing/2) && sampleFrequency<=userMaxFreq+(frequencySpacing/2)) {
                                                                                                     //Ajout d'un caractère à la chaine finale
             //NSString *res = [NSString stringWithFormat:@"%c",(char)((sampleFrequency-17995)/18+32)];
-            NSString *res;
-            @try {
-                res = [userDictionnary objectAtIndex:round(((float)(sampleFrequency-userMinFreq)/userFreqEspacement))];
-                //NSLog(@"%d    %@",sampleFrequency,[userDictionnary objectAtIndex:round(((float)(sampleFrequency-userMinFreq)/userFreqEspacement))]);
+            const SFAlphabet *table = alphabetAcquire(&alphabet, &alphabetInUse[SFAlphabetReaderReception]);
+            char res = sfAlphabetCaracter(table, sampleFrequency);
+            alphabetRelease(&alphabetInUse[SFAlphabetReaderReception]);
+            //NSLog(@"Frequency : %d // Res : %c",sampleFrequency,res);
+            if (res != 0 && receivedLength < SF_RECEIVED_CAPACITY) {
+                receivedCaracters[receivedBuffer][receivedLength++] = res;
             }
-            @catch (NSException *exception) {
-                NSLog(@"Exception:%@",exception);
-                res=@"";
-            }
-            //NSLog(@"Frequency : %d // Res : %@",sampleFrequency,res);
-            [messageReceive appendString:res];
             compteur=0;
         }
         else if(sampleFrequency>=userStopFreq-(frequencySpacing/2) && sampleFrequency<=userStopFreq+(frequencySpacing/2)) { //Fin du message
@@ -1187,7 +1251,7 @@ OSStatus renderCallback(void *userData,
             
             //Finalisation de la réception
             compteur=0;
-            [self startAnalysis];
+            [self finishReception];
             isInitiate=FALSE;
         }
         
@@ -1230,11 +1294,24 @@ OSStatus renderCallback(void *userData,
         
         
         if (simpleMessagingMode)
-            [self startAnalysis];
+            [self finishReception];
     }
     
 }
 
+/** Give the caracters received to the analysis and start the other buffer.
+ 
+ Called by the recording callback : nothing is allocated here, startAnalysis build the string on the main queue (analysisSource). A message lasts far longer than the analysis, the buffer is read before the callback write it again.
+ */
+-(void)finishReception{
+    completedBuffer = receivedBuffer;
+    completedLength = receivedLength;
+    OSMemoryBarrier();
+    receivedBuffer = 1 - receivedBuffer;
+    receivedLength = 0;
+    dispatch_source_merge_data(analysisSource, 1);
+}
+
 #pragma mark - Audio Session interruption detection
 
 /**---------------------------------------------------------------------------------------
@@ -1567,7 +1644,7 @@ OSStatus renderCallback(void *userData,
  */
 /** Analysis of the message receive during the transaction
  
- This function is the one you have to use if you want to analyse a string send by soundFi. It will manage all the step from 1 to 6
+ This function is the one you have to use if you want to analyse a string send by soundFi. It will manage all the step from 1 to 6. It runs on the main queue (analysisSource), on the caracters given by finishReception.
  
  [self analysisPhase1];
  [self analysisPhase2];
@@ -1589,6 +1666,8 @@ OSStatus renderCallback(void *userData,
  */
 -(void)startAnalysis
 {
+    OSMemoryBarrier();
+    messageReceive = [[NSMutableString alloc]initWithBytes:receivedCaracters[completedBuffer] length:completedLength encoding:NSISOLatin1StringEncoding];
     if ([messageReceive length]<=0) {
         return;
     }
@@ -1640,7 +1719,7 @@ OSStatus renderCallback(void *userData,
         receptionMode=TRUE;
         //nbrEchantillon=512;
         //[mySession setPreferredIOBufferDuration: ((float)nbrEchantillon/sampleRate) error: nil];
-        messageReceive = [[NSMutableString alloc]init];
+        receivedLength = 0;
 #if DEBUG
         NSLog(@"Démarrage du graph, compteur : %d",compteur);
 #endif
@@ -1923,40 +2002,79 @@ OSStatus renderCallback(void *userData,
 #pragma mark - User Personalisation
 
 -(void)personaliseFrequencyValue:(int)bandStartFrequency : (NSString*)yourAlpha{
+    if ([yourAlpha length] == 0) {
+        return;
+    }
     numberOfAlphaInDictionnary = (int)[yourAlpha length];
     userMinFreq = bandStartFrequency;
     userMaxFreq = 20000;
     
-    [userDictionnary removeAllObjects];
-    for (int i =0; i<numberOfAlphaInDictionnary; i++) {
-        [userDictionnary addObject:[NSString stringWithFormat:@"%c",[yourAlpha characterAtIndex:i]]];
-    }
-    
     userStartFreq = userMinFreq - 200;
     userStopFreq = userMaxFreq + 200;
     
     userFreqEspacement = (userMaxFreq - userMinFreq)/numberOfAlphaInDictionnary;
+    
+    [self setAlphabet:yourAlpha];
+}
+
+/** Compile the alphabet with userMinFreq and userFreqEspacement, and give it to the callbacks.
+ 
+ The new table replace the current one in one atomic swap. The previous one is retired: it is freed once no callback holds it (alphabetAcquire), here or on a later swap.
+ 
+ @param alpha The caracters, in the order of their frequencies
+ */
+-(void)setAlphabet:(NSString*)alpha{
+    SFAlphabet *newAlphabet = alphabetCreate(alpha, userMinFreq, userFreqEspacement);
+    if (newAlphabet == NULL) {
+        return;
+    }
+    numberOfAlphaInDictionnary = newAlphabet->count;
+    
+    SFAlphabet *oldAlphabet;
+    do {
+        oldAlphabet = alphabet;
+    } while (!OSAtomicCompareAndSwapPtrBarrier(oldAlphabet, newAlphabet, (void * volatile *)&alphabet));
+    
+    if (oldAlphabet != NULL) {
+        [retiredAlphabets addObject:[NSValue valueWithPointer:oldAlphabet]];
+    }
+    [self reclaimAlphabets];
 }
 
--(int)getIndex:(NSString*)theChar{
-    for (int i=0; i<[userDictionnary count]; i++) {
-        if ([theChar isEqualToString:[userDictionnary objectAtIndex:i]]) {
-            return i;
+/** Free the retired alphabets that no callback is reading. A callback that starts now takes the current table, the ones in alphabetInUse wait for the next call */
+-(void)reclaimAlphabets{
+    OSMemoryBarrier();
+    for (NSInteger i = (NSInteger)[retiredAlphabets count]-1; i >= 0; i--) {
+        SFAlphabet *table = [retiredAlphabets[i] pointerValue];
+        BOOL held = FALSE;
+        for (int reader = 0; reader < SFAlphabetReaderCount; reader++) {
+            held = held || alphabetInUse[reader] == table;
+        }
+        if (!held) {
+            sfAlphabetDestroy(table);
+            [retiredAlphabets removeObjectAtIndex:i];
         }
     }
-    return -1;
+}
+
+-(void)dealloc{
+    dispatch_source_cancel(analysisSource);
+    sfAlphabetDestroy(alphabet);
+    for (NSValue *table in retiredAlphabets) {
+        sfAlphabetDestroy([table pointerValue]);
+    }
 }
 
 -(void)printASCIItoFrequencyTable{
     printf("=====Frequency to ASCII Array =====\n");
-    for(int i =0;i<=[userDictionnary count];i++){
-        @try {
-            printf("%d  =>  %s    ",userMinFreq+userFreqEspacement*i,[[userDictionnary objectAtIndex:i] UTF8String]);
-            i++;
-            printf("%d  =>  %s\n",userMinFreq+userFreqEspacement*i,[[userDictionnary objectAtIndex:i] UTF8String]);
+    const SFAlphabet *table = alphabet;
+    for(int i =0;i<table->count;i++){
+        printf("%d  =>  %c    ",table->minFrequency+table->spacing*i,table->caracterOf[i]);
+        i++;
+        if (i<table->count) {
+            printf("%d  =>  %c",table->minFrequency+table->spacing*i,table->caracterOf[i]);
         }
-        @catch (NSException *exception) {}
-
+        printf("\n");
     }
     printf("Start : %d     Stop : %d\n",userStartFreq,userStopFreq);
     printf("===================================\n");